@@ -17,6 +17,7 @@
 #include "core/menumanager.hpp"
 #include "core/applicationactions.hpp"
 #include "application.hpp"
+#include "daemon.hpp"
 #include "features.hpp"
 
 // Needed to register Gobby resource explicitly:
@@ -29,9 +30,11 @@ extern "C" {
 
 #include "util/i18n.hpp"
 #include "util/file.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <gtkmm/icontheme.h>
 #include <gtkmm/builder.h>
+#include <glibmm/fileutils.h>
 
 #include <iostream>
 
@@ -78,6 +81,7 @@ public:
 	Preferences preferences;
 	CertificateManager certificate_manager;
 	GtkSourceLanguageManager* language_manager;
+	LanguageIndex language_index;
 
 	ApplicationActions application_actions;
 	MenuManager menu_manager;
@@ -91,8 +95,9 @@ Gobby::Application::Data::Data(Gobby::Application& application):
 	preferences(config),
 	certificate_manager(preferences),
 	language_manager(gtk_source_language_manager_get_default()),
+	language_index(language_manager),
 	application_actions(application),
-	menu_manager(language_manager),
+	menu_manager(language_index),
 	m_application_commands(application, application_actions,
 	                       file_chooser, preferences,
 	                       certificate_manager),
@@ -133,6 +138,19 @@ Gobby::Application::Application():
 		}, { "new-instance", 'n', 0, G_OPTION_ARG_NONE, NULL,
 		  _("Start a new gobby instance also if there is one "
 		     "already running"), NULL
+		}, { "profile-stalls", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+		  _("Measure how long callbacks in the main loop take, and "
+		    "write a report to FILE on exit"), _("FILE")
+		}, { "headless", 0, 0, G_OPTION_ARG_NONE, NULL,
+		  _("Only run the built-in server, without opening a "
+		    "window"), NULL
+		}, { "config", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+		  _("Use FILE instead of the default configuration file in "
+		    "headless mode"), _("FILE")
+		}, { "connection-metrics", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+		  _("Append the traffic of each client of the built-in "
+		    "server to FILE once a minute, as one line of JSON per "
+		    "client"), _("FILE")
 		/*}, { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY,
 		     NULL, NULL, N_("[FILE1 or URI1] [FILE2 or URI2] [...]")
 		*/}, { NULL }
@@ -164,10 +182,66 @@ int Gobby::Application::on_handle_local_options(
 		options_dict->remove("new-instance");
 	}
 
+	std::string stall_report_filename;
+	if(options_dict->lookup_value("profile-stalls",
+	                              stall_report_filename))
+	{
+		StallProfiler::enable();
+		m_stall_report_filename = stall_report_filename;
+		options_dict->remove("profile-stalls");
+	}
+
+	std::string connection_metrics_filename;
+	if(options_dict->lookup_value("connection-metrics",
+	                              connection_metrics_filename))
+	{
+		m_connection_metrics_filename = connection_metrics_filename;
+		options_dict->remove("connection-metrics");
+	}
+
+	bool headless;
+	if(options_dict->lookup_value("headless", headless))
+	{
+		std::string config_file = config_filename("config.xml");
+		options_dict->lookup_value("config", config_file);
+		return run_headless(config_file);
+	}
+
 	// Continue normal processing
 	return -1;
 }
 
+int Gobby::Application::run_headless(const std::string& config_file)
+{
+	try
+	{
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		int result;
+
+		{
+			Daemon daemon(config_file,
+			              m_connection_metrics_filename);
+			result = daemon.run();
+		}
+
+		write_stall_report();
+		return result;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
+
 void Gobby::Application::on_startup()
 {
 	Gtk::Application::on_startup();
@@ -198,13 +272,35 @@ void Gobby::Application::on_startup()
 		set_menubar(m_data->menu_manager.get_menu());
 
 		m_gobby_window = new Gobby::Window(
-			m_data->config, m_data->language_manager,
+			m_data->config, m_data->language_index,
 			m_data->file_chooser, m_data->preferences,
 			m_data->certificate_manager);
 
 		m_window.reset(m_gobby_window);
 		add_window(*m_gobby_window);
 
+		m_data->m_application_commands.set_self_hoster(
+			&m_gobby_window->get_self_hoster());
+
+		if(!m_connection_metrics_filename.empty())
+		{
+			m_connection_metrics_log.reset(
+				new ConnectionMetricsLog(
+					m_gobby_window->get_self_hoster().
+						get_directory(),
+					m_connection_metrics_filename));
+		}
+
+		if(StallProfiler::is_enabled())
+		{
+			add_action("stall-report", sigc::mem_fun(
+				*this, &Application::on_stall_report));
+			Glib::RefPtr<Gio::Menu>::cast_dynamic(
+				m_data->menu_manager.get_app_menu())->append(
+					_("Main Loop Stalls"),
+					"app.stall-report");
+		}
+
 		m_window->show();
 	}
 	catch(const Glib::Exception& ex)
@@ -217,6 +313,32 @@ void Gobby::Application::on_startup()
 	}
 }
 
+void Gobby::Application::on_shutdown()
+{
+	m_connection_metrics_log.reset(NULL);
+	m_stall_report_dialog.reset(NULL);
+	write_stall_report();
+
+	Gtk::Application::on_shutdown();
+}
+
+void Gobby::Application::write_stall_report()
+{
+	if(m_stall_report_filename.empty())
+		return;
+
+	try
+	{
+		Glib::file_set_contents(m_stall_report_filename,
+		                        StallProfiler::to_json());
+	}
+	catch(const Glib::Exception& ex)
+	{
+		g_warning("Could not write stall report: %s",
+		          ex.what().c_str());
+	}
+}
+
 void Gobby::Application::on_activate()
 {
 	Gtk::Application::on_activate();
@@ -267,3 +389,18 @@ void Gobby::Application::handle_error(const std::string& message)
 
 	m_window->show();
 }
+
+void Gobby::Application::on_stall_report()
+{
+	if(m_stall_report_dialog.get() == NULL)
+	{
+		m_stall_report_dialog =
+			StallReportDialog::create(*m_gobby_window);
+	}
+	else
+	{
+		m_stall_report_dialog->refresh();
+	}
+
+	m_stall_report_dialog->present();
+}
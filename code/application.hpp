@@ -18,6 +18,8 @@
 #define _GOBBY_APPLICATION_HPP_
 
 #include "window.hpp"
+#include "core/connectionmetricslog.hpp"
+#include "dialogs/stall-report-dialog.hpp"
 
 #include <gtkmm/application.h>
 
@@ -32,7 +34,10 @@ public:
 protected:
 	int on_handle_local_options(
 		const Glib::RefPtr<Glib::VariantDict>& options_dict);
+	int run_headless(const std::string& config_file);
+
 	virtual void on_startup();
+	virtual void on_shutdown();
 
 	virtual void on_activate();
 	virtual void on_open(const type_vec_files& files,
@@ -40,12 +45,21 @@ protected:
 
 	void handle_error(const std::string& message);
 
+	void on_stall_report();
+	void write_stall_report();
+
 	class Data;
 	std::unique_ptr<Data> m_data;
 
 	Application();
 	std::unique_ptr<Gtk::Window> m_window;
 	Gobby::Window* m_gobby_window;
+
+	std::string m_stall_report_filename;
+	std::unique_ptr<StallReportDialog> m_stall_report_dialog;
+
+	std::string m_connection_metrics_filename;
+	std::unique_ptr<ConnectionMetricsLog> m_connection_metrics_log;
 };
 
 }
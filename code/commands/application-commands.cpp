@@ -26,7 +26,8 @@ Gobby::ApplicationCommands::ApplicationCommands(
 	m_application(application),
 	m_file_chooser(file_chooser),
 	m_preferences(preferences),
-	m_cert_manager(cert_manager)
+	m_cert_manager(cert_manager),
+	m_self_hoster(NULL)
 {
 	actions.preferences->signal_activate().connect(
 		sigc::hide(sigc::mem_fun(
@@ -36,6 +37,12 @@ Gobby::ApplicationCommands::ApplicationCommands(
 			*this, &ApplicationCommands::on_quit)));
 }
 
+void Gobby::ApplicationCommands::set_self_hoster(
+	const SelfHoster* self_hoster)
+{
+	m_self_hoster = self_hoster;
+}
+
 void Gobby::ApplicationCommands::on_preferences()
 {
 	Gtk::Window* parent = m_application.get_windows()[0];
@@ -44,7 +51,7 @@ void Gobby::ApplicationCommands::on_preferences()
 	{
 		m_preferences_dialog = PreferencesDialog::create(
 			*parent, m_file_chooser,
-			m_preferences, m_cert_manager);
+			m_preferences, m_cert_manager, m_self_hoster);
 	}
 
 	m_preferences_dialog->present();
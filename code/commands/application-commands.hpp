@@ -40,6 +40,10 @@ public:
 	                    Preferences& preferences,
 	                    CertificateManager& cert_manager);
 
+	// Lets the preferences dialog show statistics about the documents
+	// hosted by self_hoster.
+	void set_self_hoster(const SelfHoster* self_hoster);
+
 protected:
 	void on_preferences();
 	void on_quit();
@@ -48,6 +52,7 @@ protected:
 	FileChooser& m_file_chooser;
 	Preferences& m_preferences;
 	CertificateManager& m_cert_manager;
+	const SelfHoster* m_self_hoster;
 
 	std::unique_ptr<PreferencesDialog> m_preferences_dialog;
 };
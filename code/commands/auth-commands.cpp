@@ -56,32 +56,19 @@ Gobby::AuthCommands::AuthCommands(Gtk::Window& parent,
                                   Browser& browser,
                                   StatusBar& statusbar,
                                   ConnectionManager& connection_manager,
-                                  const Preferences& preferences):
+                                  AuthManager& auth_manager):
 	m_parent(parent),
 	m_browser(browser),
 	m_statusbar(statusbar),
 	m_connection_manager(connection_manager),
-	m_preferences(preferences)
+	m_auth_manager(auth_manager)
 {
-	GError* error = NULL;
-	m_sasl_context = inf_sasl_context_new(&error);
-
-	if(!m_sasl_context)
-	{
-		std::string error_message =
-			std::string("SASL initialization error: ") +
-			error->message;
-		g_error_free(error);
-		throw std::runtime_error(error_message);
-	}
-
-	inf_sasl_context_set_callback(
-		m_sasl_context, &AuthCommands::sasl_callback_static,
-		this, NULL);
+	m_auth_manager.set_password_query(sigc::mem_fun(
+		*this, &AuthCommands::on_password_query));
 
 	// Set SASL context for new and existing connections:
-	m_connection_manager.set_sasl_context(m_sasl_context,
-	                                      "ANONYMOUS PLAIN");
+	m_connection_manager.set_sasl_context(
+		m_auth_manager.get_sasl_context(), "ANONYMOUS PLAIN");
 
 	g_signal_connect(
 		G_OBJECT(m_browser.get_store()),
@@ -112,7 +99,8 @@ Gobby::AuthCommands::AuthCommands(Gtk::Window& parent,
 Gobby::AuthCommands::~AuthCommands()
 {
 	m_connection_manager.set_sasl_context(NULL, NULL);
-	inf_sasl_context_unref(m_sasl_context);
+	m_auth_manager.set_password_query(
+		AuthManager::SlotPasswordQuery());
 
 	for(RetryMap::iterator iter = m_retries.begin();
 	    iter != m_retries.end(); ++iter)
@@ -121,143 +109,48 @@ Gobby::AuthCommands::~AuthCommands()
 	}
 }
 
-void Gobby::AuthCommands::set_sasl_error(InfXmppConnection* connection,
-                                         const gchar* message)
+void Gobby::AuthCommands::on_password_query(InfSaslContextSession* session,
+                                            InfXmppConnection* xmpp)
 {
-	GError* error = g_error_new_literal(
-		inf_authentication_detail_error_quark(),
-		INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
-		message
-	);
-
-	inf_xmpp_connection_set_sasl_error(connection, error);
-	g_error_free(error);
-}
-
-void Gobby::AuthCommands::sasl_callback(InfSaslContextSession* session,
-                                        InfXmppConnection* xmpp,
-                                        Gsasl_property prop)
-{
-	const Glib::ustring username = m_preferences.user.name;
-	const std::string correct_password = m_preferences.user.password;
-	const char* password;
-	gsize password_len;
-	gchar cmp;
+	RetryMap::iterator i = m_retries.find(xmpp);
+	if(i == m_retries.end())
+		i = insert_retry_info(xmpp);
+	RetryInfo& info(i->second);
 
-	switch(prop)
+	if(!info.last_password.empty())
 	{
-	case GSASL_ANONYMOUS_TOKEN:
 		inf_sasl_context_session_set_property(
-			session, GSASL_ANONYMOUS_TOKEN, username.c_str());
-		inf_sasl_context_session_continue(session, GSASL_OK);
-		break;
-	case GSASL_AUTHID:
-		inf_sasl_context_session_set_property(
-			session, GSASL_AUTHID, username.c_str());
-		inf_sasl_context_session_continue(session, GSASL_OK);
-		break;
-	case GSASL_PASSWORD:
-		{
-			RetryMap::iterator i = m_retries.find(xmpp);
-			if(i == m_retries.end())
-				i = insert_retry_info(xmpp);
-			RetryInfo& info(i->second);
-
-			if(!info.last_password.empty())
-			{
-				inf_sasl_context_session_set_property(
-					session, GSASL_PASSWORD,
-					info.last_password.c_str());
-
-				inf_sasl_context_session_continue(session,
-				                                  GSASL_OK);
-			}
-			else
-			{
-				// Query user for password
-				g_assert(info.password_dialog == NULL);
-
-				gchar* remote_id;
-				g_object_get(G_OBJECT(xmpp),
-				             "remote-hostname", &remote_id,
-					     NULL);
-				Glib::ustring remote_id_(remote_id);
-				g_free(remote_id);
-
-				std::unique_ptr<PasswordDialog> dialog =
-					PasswordDialog::create(
-						m_parent, remote_id_,
-						info.retries);
-				info.password_dialog = dialog.release();
-				info.password_dialog->add_button(
-					_("_Cancel"), Gtk::RESPONSE_CANCEL);
-				info.password_dialog->add_button(
-					_("_Ok"), Gtk::RESPONSE_ACCEPT);
-
-				Gtk::Dialog& dlg = *info.password_dialog;
-				dlg.signal_response().connect(sigc::bind(
-					sigc::mem_fun(
-						*this,
-						&AuthCommands::on_response),
-					session, xmpp));
-
-				info.password_dialog->present();
-			}
-		}
-
-		break;
-	case GSASL_VALIDATE_ANONYMOUS:
-		if(m_preferences.user.require_password)
-		{
-			inf_sasl_context_session_continue(
-				session,
-				GSASL_AUTHENTICATION_ERROR
-			);
-
-			set_sasl_error(xmpp, _("Password required"));
-		}
-		else
-		{
-			inf_sasl_context_session_continue(session, GSASL_OK);
-		}
-
-		break;
-	case GSASL_VALIDATE_SIMPLE:
-		password = inf_sasl_context_session_get_property(
-			session, GSASL_PASSWORD);
-
-		/* length-independent string compare */
-		cmp = 0;
-		password_len = strlen(password);
-		for(unsigned i = 0; i < correct_password.size(); ++i)
-		{
-			if(i < password_len)
-				cmp |= (password[i] ^ correct_password[i]);
-			else
-				cmp |= (0x00 ^ correct_password[i]);
-		}
-
-		if(password_len != correct_password.size())
-			cmp = 0xFF;
-
-		if(cmp != 0)
-		{
-			inf_sasl_context_session_continue(
-				session,
-				GSASL_AUTHENTICATION_ERROR
-			);
-
-			set_sasl_error(xmpp, _("Incorrect password"));
-		}
-		else
-		{
-			inf_sasl_context_session_continue(session, GSASL_OK);
-		}
+			session, GSASL_PASSWORD, info.last_password.c_str());
 
-		break;
-	default:
-		inf_sasl_context_session_continue(session, GSASL_NO_CALLBACK);
-		break;
+		inf_sasl_context_session_continue(session, GSASL_OK);
+	}
+	else
+	{
+		// Query user for password
+		g_assert(info.password_dialog == NULL);
+
+		gchar* remote_id;
+		g_object_get(G_OBJECT(xmpp),
+		             "remote-hostname", &remote_id,
+		             NULL);
+		Glib::ustring remote_id_(remote_id);
+		g_free(remote_id);
+
+		std::unique_ptr<PasswordDialog> dialog =
+			PasswordDialog::create(
+				m_parent, remote_id_, info.retries);
+		info.password_dialog = dialog.release();
+		info.password_dialog->add_button(
+			_("_Cancel"), Gtk::RESPONSE_CANCEL);
+		info.password_dialog->add_button(
+			_("_Ok"), Gtk::RESPONSE_ACCEPT);
+
+		Gtk::Dialog& dlg = *info.password_dialog;
+		dlg.signal_response().connect(sigc::bind(
+			sigc::mem_fun(*this, &AuthCommands::on_response),
+			session, xmpp));
+
+		info.password_dialog->present();
 	}
 }
 
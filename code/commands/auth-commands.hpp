@@ -19,9 +19,9 @@
 
 #include "dialogs/password-dialog.hpp"
 
+#include "core/authmanager.hpp"
 #include "core/browser.hpp"
 #include "core/statusbar.hpp"
-#include "core/preferences.hpp"
 
 #include <gtkmm/window.h>
 #include <sigc++/trackable.h>
@@ -36,23 +36,10 @@ public:
 	             Browser& browser,
 	             StatusBar& statusbar,
 	             ConnectionManager& connection_manager,
-	             const Preferences& preferences);
+	             AuthManager& auth_manager);
 
 	~AuthCommands();
-
-	InfSaslContext* get_sasl_context() { return m_sasl_context; }
 protected:
-	static void sasl_callback_static(InfSaslContextSession* session,
-	                                 Gsasl_property prop,
-					 gpointer session_data,
-					 gpointer user_data)
-	{
-		AuthCommands* auth = static_cast<AuthCommands*>(user_data);
-
-		auth->sasl_callback(
-			session, INF_XMPP_CONNECTION(session_data), prop);
-	}
-
 	static void set_browser_callback_static(InfGtkBrowserModel*,
 	                                        GtkTreePath*,
 	                                        GtkTreeIter*,
@@ -82,12 +69,8 @@ protected:
 		auth->browser_error_callback(browser, error);
 	}
 
-	void set_sasl_error(InfXmppConnection* connection,
-	                    const gchar* message);
-
-	void sasl_callback(InfSaslContextSession* session,
-	                   InfXmppConnection* xmpp,
-	                   Gsasl_property prop);
+	void on_password_query(InfSaslContextSession* session,
+	                       InfXmppConnection* xmpp);
 
 	void set_browser_callback(InfBrowser* old_browser,
 	                          InfBrowser* new_browser);
@@ -118,8 +101,7 @@ protected:
 	Browser& m_browser;
 	StatusBar& m_statusbar;
 	ConnectionManager& m_connection_manager;
-	const Preferences& m_preferences;
-	InfSaslContext* m_sasl_context;
+	AuthManager& m_auth_manager;
 
 	RetryMap m_retries;
 };
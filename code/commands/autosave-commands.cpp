@@ -19,6 +19,7 @@
 #include "operations/operation-save.hpp"
 
 #include "core/sessionuserview.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <glibmm/main.h>
 
@@ -163,6 +164,9 @@ protected:
 
 	bool on_timeout()
 	{
+		StallProfiler::Scope profile(
+			"AutosaveCommands::Info::on_timeout");
+
 		const std::string& key = m_view.get_info_storage_key();
 		const DocumentInfoStorage::Info* info =
 			m_commands.m_info_storage.get_info(key);
@@ -175,7 +179,8 @@ protected:
 				Gio::File::create_for_uri(info->uri);
 			m_commands.m_operations.save_document(
 				m_view, file,
-				info->encoding, info->eol_style);
+				info->encoding, info->eol_style,
+				Operations::IO_PRIORITY_AUTOSAVE);
 
 			g_assert(m_save_op != NULL);
 
@@ -584,7 +584,11 @@ void Gobby::BrowserCommands::on_activate(InfBrowser* browser,
 			inf_browser_get_pending_request(
 				browser, iter, "subscribe-session");
 
-		// If there is already a request don't re-request
+		// If there is already a request don't re-request, but make
+		// sure the document is shown once it has finished. The
+		// request might have been made in the background, for
+		// example to search the document, and then nobody else
+		// would add it to the folder.
 		if(request == NULL)
 		{
 			std::unique_ptr<RequestInfo> info(new RequestInfo(
@@ -604,6 +608,20 @@ void Gobby::BrowserCommands::on_activate(InfBrowser* browser,
 				m_request_map[request] = info.release();
 			}
 		}
+		else if(m_request_map.find(request) == m_request_map.end())
+		{
+			std::unique_ptr<RequestInfo> info(new RequestInfo(
+				*this, browser, iter, m_status_bar));
+
+			g_signal_connect(
+				G_OBJECT(request), "finished",
+				G_CALLBACK(
+					RequestInfo::on_node_finished_static),
+				info.get());
+
+			info->set_request(request);
+			m_request_map[request] = info.release();
+		}
 	}
 }
 
@@ -631,7 +649,22 @@ void Gobby::BrowserCommands::on_finished(InfRequest* request,
 			inf_browser_get_session(browser, iter);
 		g_assert(proxy != NULL);
 
-		m_folder_manager.add_document(browser, iter, proxy, NULL);
+		// Someone else waiting for the same request might have
+		// added the document already.
+		InfSession* session;
+		g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+		SessionView* view = m_folder_manager.lookup_document(session);
+		g_object_unref(session);
+
+		if(view != NULL)
+		{
+			m_folder_manager.switch_to_document(*view);
+		}
+		else
+		{
+			m_folder_manager.add_document(browser, iter,
+			                              proxy, NULL);
+		}
 	}
 	else
 	{
@@ -17,6 +17,10 @@
 #include "commands/edit-commands.hpp"
 #include "util/i18n.hpp"
 
+#include <libinftext/inf-text-buffer.h>
+
+#include <algorithm>
+
 namespace
 {
 
@@ -24,10 +28,15 @@ namespace
 
 Gobby::EditCommands::EditCommands(Gtk::Window& parent,
                                   WindowActions& actions,
+                                  Browser& browser,
+                                  FolderManager& folder_manager,
                                   const Folder& folder,
-                                  StatusBar& status_bar):
-	m_parent(parent), m_actions(actions), m_folder(folder),
-	m_status_bar(status_bar), m_current_view(NULL)
+                                  StatusBar& status_bar,
+                                  Operations& operations):
+	m_parent(parent), m_actions(actions), m_browser(browser),
+	m_folder_manager(folder_manager), m_folder(folder),
+	m_status_bar(status_bar), m_operations(operations),
+	m_current_view(NULL)
 {
 	actions.undo->signal_activate().connect(sigc::hide(
 		sigc::mem_fun(*this, &EditCommands::on_undo)));
@@ -47,6 +56,8 @@ Gobby::EditCommands::EditCommands(Gtk::Window& parent,
 		sigc::mem_fun(*this, &EditCommands::on_find_prev)));
 	actions.find_replace->signal_activate().connect(sigc::hide(
 		sigc::mem_fun(*this, &EditCommands::on_find_replace)));
+	actions.find_in_documents->signal_activate().connect(sigc::hide(
+		sigc::mem_fun(*this, &EditCommands::on_find_in_documents)));
 	actions.goto_line->signal_activate().connect(sigc::hide(
 		sigc::mem_fun(*this, &EditCommands::on_goto_line)));
 
@@ -321,44 +332,92 @@ void Gobby::EditCommands::on_find_text_changed()
 // libinfinity supports caret-aware requests, by generating undo-caret and
 // redo-caret requests.
 namespace {
-	GtkTextMark* check = NULL;
-
-	void recaret_i(GtkTextBuffer* buffer,
-	               GtkTextIter* location,
-	               gchar* text,
-	               gint len,
-	               gpointer user_data)
+	// Keeps track of the rightmost position touched by the operations
+	// an undo or redo results in. This listens to the InfTextBuffer
+	// instead of the GtkTextBuffer, so that this only needs to do some
+	// integer arithmetic for every single operation, instead of looking
+	// up and moving a text mark. The cursor is then placed only once,
+	// after all operations have been applied.
+	class CaretTracker
 	{
-		if(!check)
+	public:
+		CaretTracker(InfTextBuffer* buffer):
+			m_buffer(buffer), m_position(0), m_valid(false)
 		{
-			check = gtk_text_buffer_create_mark(buffer, NULL, location, FALSE);
+			m_inserted_handler = g_signal_connect_after(
+				G_OBJECT(buffer), "text-inserted",
+				G_CALLBACK(on_text_inserted_static), this);
+			m_erased_handler = g_signal_connect_after(
+				G_OBJECT(buffer), "text-erased",
+				G_CALLBACK(on_text_erased_static), this);
 		}
-		else
+
+		~CaretTracker()
 		{
+			g_signal_handler_disconnect(m_buffer,
+			                            m_inserted_handler);
+			g_signal_handler_disconnect(m_buffer,
+			                            m_erased_handler);
+		}
+
+		void place_cursor(GtkTextBuffer* buffer) const
+		{
+			if(!m_valid) return;
+
 			GtkTextIter iter;
-			gtk_text_buffer_get_iter_at_mark(buffer, &iter, check);
-			if(gtk_text_iter_get_offset(&iter) < gtk_text_iter_get_offset(location))
-				gtk_text_buffer_move_mark(buffer, check, location);
+			gtk_text_buffer_get_iter_at_offset(
+				buffer, &iter, m_position);
+			gtk_text_buffer_select_range(buffer, &iter, &iter);
 		}
-	}
 
-	void recaret_e(GtkTextBuffer* buffer,
-	               GtkTextIter* start,
-	               GtkTextIter* end,
-	               gpointer user_data)
-	{
-		if(!check)
+	private:
+		static void on_text_inserted_static(InfTextBuffer* buffer,
+		                                    guint pos,
+		                                    InfTextChunk* chunk,
+		                                    InfUser* user,
+		                                    gpointer user_data)
 		{
-			check = gtk_text_buffer_create_mark(buffer, NULL, start, FALSE);
+			static_cast<CaretTracker*>(user_data)->on_text_inserted(
+				pos, inf_text_chunk_get_length(chunk));
 		}
-		else
+
+		static void on_text_erased_static(InfTextBuffer* buffer,
+		                                  guint pos,
+		                                  InfTextChunk* chunk,
+		                                  InfUser* user,
+		                                  gpointer user_data)
 		{
-			GtkTextIter iter;
-			gtk_text_buffer_get_iter_at_mark(buffer, &iter, check);
-			if(gtk_text_iter_get_offset(&iter) < gtk_text_iter_get_offset(start))
-				gtk_text_buffer_move_mark(buffer, check, start);
+			static_cast<CaretTracker*>(user_data)->on_text_erased(
+				pos, inf_text_chunk_get_length(chunk));
 		}
-	}
+
+		void on_text_inserted(guint pos, guint len)
+		{
+			// The position moves along with text inserted before
+			// it, and ends up behind the inserted text.
+			if(m_valid && pos <= m_position)
+				m_position += len;
+			if(!m_valid || m_position < pos + len)
+				m_position = pos + len;
+			m_valid = true;
+		}
+
+		void on_text_erased(guint pos, guint len)
+		{
+			if(m_valid && pos < m_position)
+				m_position -= std::min(len, m_position - pos);
+			if(!m_valid || m_position < pos)
+				m_position = pos;
+			m_valid = true;
+		}
+
+		InfTextBuffer* m_buffer;
+		gulong m_inserted_handler;
+		gulong m_erased_handler;
+
+		guint m_position;
+		bool m_valid;
+	};
 }
 
 void Gobby::EditCommands::on_undo()
@@ -368,8 +427,10 @@ void Gobby::EditCommands::on_undo()
 		return;
 	}
 
-	gulong i_ = g_signal_connect_after(m_current_view->get_text_buffer(), "insert-text", G_CALLBACK(recaret_i), NULL);
-	gulong e_ = g_signal_connect_after(m_current_view->get_text_buffer(), "delete-range", G_CALLBACK(recaret_e), NULL);
+	GtkTextBuffer* buffer =
+		GTK_TEXT_BUFFER(m_current_view->get_text_buffer());
+	CaretTracker tracker(INF_TEXT_BUFFER(inf_session_get_buffer(
+		INF_SESSION(m_current_view->get_session()))));
 
 	inf_adopted_session_undo(
 		INF_ADOPTED_SESSION(m_current_view->get_session()),
@@ -377,18 +438,7 @@ void Gobby::EditCommands::on_undo()
 		m_current_view->get_undo_grouping().get_undo_size()
 	);
 
-	g_signal_handler_disconnect(m_current_view->get_text_buffer(), i_);
-	g_signal_handler_disconnect(m_current_view->get_text_buffer(), e_);
-
-	if(check)
-	{
-		GtkTextIter check_iter;
-		gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), &check_iter, check);
-		gtk_text_buffer_select_range(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), &check_iter, &check_iter);
-		gtk_text_buffer_delete_mark(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), check);
-		check = NULL;
-	}
-
+	tracker.place_cursor(buffer);
 	m_current_view->scroll_to_cursor_position(0.0);
 }
 
@@ -399,8 +449,10 @@ void Gobby::EditCommands::on_redo()
 		return;
 	}
 
-	gulong i_ = g_signal_connect_after(m_current_view->get_text_buffer(), "insert-text", G_CALLBACK(recaret_i), NULL);
-	gulong e_ = g_signal_connect_after(m_current_view->get_text_buffer(), "delete-range", G_CALLBACK(recaret_e), NULL);
+	GtkTextBuffer* buffer =
+		GTK_TEXT_BUFFER(m_current_view->get_text_buffer());
+	CaretTracker tracker(INF_TEXT_BUFFER(inf_session_get_buffer(
+		INF_SESSION(m_current_view->get_session()))));
 
 	inf_adopted_session_redo(
 		INF_ADOPTED_SESSION(m_current_view->get_session()),
@@ -408,18 +460,7 @@ void Gobby::EditCommands::on_redo()
 		m_current_view->get_undo_grouping().get_redo_size()
 	);
 
-	g_signal_handler_disconnect(m_current_view->get_text_buffer(), i_);
-	g_signal_handler_disconnect(m_current_view->get_text_buffer(), e_);
-
-	if(check)
-	{
-		GtkTextIter check_iter;
-		gtk_text_buffer_get_iter_at_mark(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), &check_iter, check);
-		gtk_text_buffer_select_range(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), &check_iter, &check_iter);
-		gtk_text_buffer_delete_mark(GTK_TEXT_BUFFER(m_current_view->get_text_buffer()), check);
-		check = NULL;
-	}
-
+	tracker.place_cursor(buffer);
 	m_current_view->scroll_to_cursor_position(0.0);
 }
 
@@ -495,6 +536,17 @@ void Gobby::EditCommands::on_find_replace()
 	m_find_dialog->present();
 }
 
+void Gobby::EditCommands::on_find_in_documents()
+{
+	if(!m_find_in_documents_dialog.get())
+	{
+		m_find_in_documents_dialog = FindInDocumentsDialog::create(
+			m_parent, m_folder_manager, m_browser, m_operations);
+	}
+
+	m_find_in_documents_dialog->present();
+}
+
 void Gobby::EditCommands::on_goto_line()
 {
 	if(!m_goto_dialog.get())
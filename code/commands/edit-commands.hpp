@@ -18,6 +18,7 @@
 #define _GOBBY_EDIT_COMMANDS_HPP_
 
 #include "dialogs/find-dialog.hpp"
+#include "dialogs/find-in-documents-dialog.hpp"
 #include "dialogs/goto-dialog.hpp"
 #include "dialogs/preferences-dialog.hpp"
 
@@ -36,7 +37,9 @@ class EditCommands: public sigc::trackable
 {
 public:
 	EditCommands(Gtk::Window& parent, WindowActions& actions,
-	             const Folder& folder, StatusBar& status_bar);
+	             Browser& browser, FolderManager& folder_manager,
+	             const Folder& folder, StatusBar& status_bar,
+	             Operations& operations);
 	~EditCommands();
 
 protected:
@@ -100,14 +103,19 @@ protected:
 	void on_find_next();
 	void on_find_prev();
 	void on_find_replace();
+	void on_find_in_documents();
 	void on_goto_line();
 
 	Gtk::Window& m_parent;
 	WindowActions& m_actions;
+	Browser& m_browser;
+	FolderManager& m_folder_manager;
 	const Folder& m_folder;
 	StatusBar& m_status_bar;
+	Operations& m_operations;
 
 	std::unique_ptr<FindDialog> m_find_dialog;
+	std::unique_ptr<FindInDocumentsDialog> m_find_in_documents_dialog;
 	std::unique_ptr<GotoDialog> m_goto_dialog;
 
 	TextSessionView* m_current_view;
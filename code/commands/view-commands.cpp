@@ -101,13 +101,13 @@ Gobby::ViewCommands::Fullscreen::~Fullscreen()
 
 Gobby::ViewCommands::ViewCommands(Gtk::Window& parent,
                                   WindowActions& actions,
-                                  GtkSourceLanguageManager* language_manager,
+                                  const LanguageIndex& language_index,
                                   const Folder& text_folder,
                                   ClosableFrame& chat_frame,
 	                          const Folder& chat_folder,
                                   Preferences& preferences):
 	m_parent(parent), m_actions(actions),
-	m_language_manager(language_manager),
+	m_language_index(language_index),
 	m_text_folder(text_folder), m_chat_frame(chat_frame),
 	m_chat_folder(chat_folder), m_preferences(preferences),
 	m_current_view(NULL)
@@ -499,8 +499,7 @@ void Gobby::ViewCommands::on_menu_language_changed()
 	GtkSourceLanguage* language = NULL;
 	if(!language_id.empty())
 	{
-		language = gtk_source_language_manager_get_language(
-			m_language_manager, language_id.c_str());
+		language = m_language_index.get_language(language_id);
 
 		// The language should exist by construction, if the languages
 		// available in the language manager don't change at runtime
@@ -35,7 +35,7 @@ private:
 
 public:
 	ViewCommands(Gtk::Window& window, WindowActions& actions,
-	             GtkSourceLanguageManager* language_manager,
+	             const LanguageIndex& language_index,
 	             const Folder& text_folder, ClosableFrame& chat_frame,
 	             const Folder& chat_folder, Preferences& preferences);
 	~ViewCommands();
@@ -73,7 +73,7 @@ protected:
 
 	Gtk::Window& m_parent;
 	WindowActions& m_actions;
-	GtkSourceLanguageManager* m_language_manager;
+	const LanguageIndex& m_language_index;
 	const Folder& m_text_folder;
 	ClosableFrame& m_chat_frame;
 	const Folder& m_chat_folder;
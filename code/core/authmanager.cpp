@@ -0,0 +1,155 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/authmanager.hpp"
+#include "util/i18n.hpp"
+
+#include <libinfinity/common/inf-error.h>
+
+#include <cstring>
+#include <stdexcept>
+
+Gobby::AuthManager::AuthManager(const Preferences& preferences):
+	m_preferences(preferences)
+{
+	GError* error = NULL;
+	m_sasl_context = inf_sasl_context_new(&error);
+
+	if(!m_sasl_context)
+	{
+		std::string error_message =
+			std::string("SASL initialization error: ") +
+			error->message;
+		g_error_free(error);
+		throw std::runtime_error(error_message);
+	}
+
+	inf_sasl_context_set_callback(
+		m_sasl_context, &AuthManager::sasl_callback_static,
+		this, NULL);
+}
+
+Gobby::AuthManager::~AuthManager()
+{
+	inf_sasl_context_unref(m_sasl_context);
+}
+
+void Gobby::AuthManager::set_password_query(const SlotPasswordQuery& slot)
+{
+	m_password_query = slot;
+}
+
+void Gobby::AuthManager::set_sasl_error(InfXmppConnection* connection,
+                                        const gchar* message)
+{
+	GError* error = g_error_new_literal(
+		inf_authentication_detail_error_quark(),
+		INF_AUTHENTICATION_DETAIL_ERROR_AUTHENTICATION_FAILED,
+		message
+	);
+
+	inf_xmpp_connection_set_sasl_error(connection, error);
+	g_error_free(error);
+}
+
+void Gobby::AuthManager::sasl_callback(InfSaslContextSession* session,
+                                       InfXmppConnection* xmpp,
+                                       Gsasl_property prop)
+{
+	const Glib::ustring username = m_preferences.user.name;
+	const std::string correct_password = m_preferences.user.password;
+	const char* password;
+	gsize password_len;
+	gchar cmp;
+
+	switch(prop)
+	{
+	case GSASL_ANONYMOUS_TOKEN:
+		inf_sasl_context_session_set_property(
+			session, GSASL_ANONYMOUS_TOKEN, username.c_str());
+		inf_sasl_context_session_continue(session, GSASL_OK);
+		break;
+	case GSASL_AUTHID:
+		inf_sasl_context_session_set_property(
+			session, GSASL_AUTHID, username.c_str());
+		inf_sasl_context_session_continue(session, GSASL_OK);
+		break;
+	case GSASL_PASSWORD:
+		if(m_password_query)
+		{
+			m_password_query(session, xmpp);
+		}
+		else
+		{
+			inf_sasl_context_session_continue(
+				session, GSASL_NO_PASSWORD);
+		}
+
+		break;
+	case GSASL_VALIDATE_ANONYMOUS:
+		if(m_preferences.user.require_password)
+		{
+			inf_sasl_context_session_continue(
+				session,
+				GSASL_AUTHENTICATION_ERROR
+			);
+
+			set_sasl_error(xmpp, _("Password required"));
+		}
+		else
+		{
+			inf_sasl_context_session_continue(session, GSASL_OK);
+		}
+
+		break;
+	case GSASL_VALIDATE_SIMPLE:
+		password = inf_sasl_context_session_get_property(
+			session, GSASL_PASSWORD);
+
+		/* length-independent string compare */
+		cmp = 0;
+		password_len = strlen(password);
+		for(unsigned i = 0; i < correct_password.size(); ++i)
+		{
+			if(i < password_len)
+				cmp |= (password[i] ^ correct_password[i]);
+			else
+				cmp |= (0x00 ^ correct_password[i]);
+		}
+
+		if(password_len != correct_password.size())
+			cmp = 0xFF;
+
+		if(cmp != 0)
+		{
+			inf_sasl_context_session_continue(
+				session,
+				GSASL_AUTHENTICATION_ERROR
+			);
+
+			set_sasl_error(xmpp, _("Incorrect password"));
+		}
+		else
+		{
+			inf_sasl_context_session_continue(session, GSASL_OK);
+		}
+
+		break;
+	default:
+		inf_sasl_context_session_continue(session, GSASL_NO_CALLBACK);
+		break;
+	}
+}
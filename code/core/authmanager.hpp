@@ -0,0 +1,77 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_AUTHMANAGER_HPP_
+#define _GOBBY_AUTHMANAGER_HPP_
+
+#include "core/preferences.hpp"
+
+#include <libinfinity/common/inf-sasl-context.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+
+#include <sigc++/slot.h>
+
+namespace Gobby
+{
+
+// Owns the SASL context that is used both for our own connections to
+// remote servers and for clients connecting to the self-hosted directory.
+// Checking passwords of remote clients does not need any UI, so this is
+// done here. When we need a password ourselves, the password query slot
+// is asked for it, which is how AuthCommands hooks in its dialog.
+class AuthManager
+{
+public:
+	typedef sigc::slot<void, InfSaslContextSession*, InfXmppConnection*>
+		SlotPasswordQuery;
+
+	AuthManager(const Preferences& preferences);
+	~AuthManager();
+
+	InfSaslContext* get_sasl_context() { return m_sasl_context; }
+
+	// Without a password query slot, logging into password-protected
+	// servers fails with GSASL_NO_PASSWORD.
+	void set_password_query(const SlotPasswordQuery& slot);
+
+	static void set_sasl_error(InfXmppConnection* connection,
+	                           const gchar* message);
+
+protected:
+	static void sasl_callback_static(InfSaslContextSession* session,
+	                                 Gsasl_property prop,
+	                                 gpointer session_data,
+	                                 gpointer user_data)
+	{
+		AuthManager* auth = static_cast<AuthManager*>(user_data);
+
+		auth->sasl_callback(
+			session, INF_XMPP_CONNECTION(session_data), prop);
+	}
+
+	void sasl_callback(InfSaslContextSession* session,
+	                   InfXmppConnection* xmpp,
+	                   Gsasl_property prop);
+
+	const Preferences& m_preferences;
+	InfSaslContext* m_sasl_context;
+
+	SlotPasswordQuery m_password_query;
+};
+
+}
+
+#endif // _GOBBY_AUTHMANAGER_HPP_
@@ -0,0 +1,229 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/connectionmetrics.hpp"
+
+#include <glibmm/main.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	const char METRICS_DATA_KEY[] = "gobby-connection-metrics";
+
+	// Appends str to stream with the characters that are not allowed
+	// in a JSON string escaped, so that the result is a single line.
+	void append_json_string(std::ostream& stream, const char* str)
+	{
+		for(const char* c = str; *c != '\0'; ++c)
+		{
+			switch(*c)
+			{
+			case '"': stream << "\\\""; break;
+			case '\\': stream << "\\\\"; break;
+			case '\n': stream << "\\n"; break;
+			case '\r': stream << "\\r"; break;
+			case '\t': stream << "\\t"; break;
+			default:
+				if(static_cast<unsigned char>(*c) < 0x20)
+				{
+					char buf[8];
+					std::snprintf(buf, sizeof(buf),
+					              "\\u%04x", *c);
+					stream << buf;
+				}
+				else
+				{
+					stream << *c;
+				}
+
+				break;
+			}
+		}
+	}
+}
+
+Gobby::ConnectionMetrics::ConnectionMetrics(InfXmppConnection* connection):
+	m_connection(connection), m_tcp(NULL), m_watchers(0),
+	m_last_received(-1),
+	m_next_sample(0), m_n_samples(0)
+{
+	// The TCP connection is what counts the bytes on the wire, after
+	// TLS and compression.
+	g_object_get(G_OBJECT(connection), "tcp-connection", &m_tcp, NULL);
+
+	m_received_handler = g_signal_connect(
+		G_OBJECT(connection), "received",
+		G_CALLBACK(on_received_static), this);
+	m_sent_handler = g_signal_connect(
+		G_OBJECT(connection), "sent",
+		G_CALLBACK(on_sent_static), this);
+	m_tcp_received_handler = g_signal_connect(
+		G_OBJECT(m_tcp), "received",
+		G_CALLBACK(on_tcp_received_static), this);
+	m_tcp_sent_handler = g_signal_connect(
+		G_OBJECT(m_tcp), "sent",
+		G_CALLBACK(on_tcp_sent_static), this);
+
+	m_counters.time = 0;
+	m_counters.bytes_received = 0;
+	m_counters.bytes_sent = 0;
+	m_counters.messages_received = 0;
+	m_counters.messages_sent = 0;
+
+	on_sample();
+	m_sample_connection = Glib::signal_timeout().connect_seconds(
+		sigc::mem_fun(*this, &ConnectionMetrics::on_sample), 1);
+}
+
+Gobby::ConnectionMetrics::~ConnectionMetrics()
+{
+	m_sample_connection.disconnect();
+
+	// If this runs because the XMPP connection is finalized, its
+	// handlers are gone already. The TCP connection is kept alive by
+	// ourselves.
+	if(g_signal_handler_is_connected(m_connection, m_received_handler))
+	{
+		g_signal_handler_disconnect(m_connection, m_received_handler);
+		g_signal_handler_disconnect(m_connection, m_sent_handler);
+	}
+
+	g_signal_handler_disconnect(G_OBJECT(m_tcp), m_tcp_received_handler);
+	g_signal_handler_disconnect(G_OBJECT(m_tcp), m_tcp_sent_handler);
+	g_object_unref(m_tcp);
+}
+
+Gobby::ConnectionMetrics&
+Gobby::ConnectionMetrics::watch(InfXmppConnection* connection)
+{
+	ConnectionMetrics* metrics = get(connection);
+	if(metrics == NULL)
+	{
+		metrics = new ConnectionMetrics(connection);
+		g_object_set_data_full(G_OBJECT(connection), METRICS_DATA_KEY,
+		                       metrics, destroy_static);
+	}
+
+	++metrics->m_watchers;
+	return *metrics;
+}
+
+void Gobby::ConnectionMetrics::unwatch(InfXmppConnection* connection)
+{
+	ConnectionMetrics* metrics = get(connection);
+	g_assert(metrics != NULL && metrics->m_watchers > 0);
+
+	// Removing the data frees the metrics, which stops the sampling
+	// timer and disconnects from the connection.
+	if(--metrics->m_watchers == 0)
+		g_object_set_data(G_OBJECT(connection), METRICS_DATA_KEY, NULL);
+}
+
+Gobby::ConnectionMetrics*
+Gobby::ConnectionMetrics::get(InfXmppConnection* connection)
+{
+	return static_cast<ConnectionMetrics*>(
+		g_object_get_data(G_OBJECT(connection), METRICS_DATA_KEY));
+}
+
+bool Gobby::ConnectionMetrics::get_rates(unsigned int span,
+                                         Rates& rates) const
+{
+	if(m_n_samples < 2) return false;
+
+	span = std::min(std::max(span, 1u), m_n_samples - 1);
+
+	const Sample& newest =
+		m_samples[(m_next_sample + N_SAMPLES - 1) % N_SAMPLES];
+	const Sample& oldest =
+		m_samples[(m_next_sample + N_SAMPLES - 1 - span) % N_SAMPLES];
+
+	const double seconds = (newest.time - oldest.time) / 1e6;
+	if(seconds <= 0.0) return false;
+
+	rates.bytes_received =
+		(newest.bytes_received - oldest.bytes_received) / seconds;
+	rates.bytes_sent =
+		(newest.bytes_sent - oldest.bytes_sent) / seconds;
+	rates.messages_received =
+		(newest.messages_received - oldest.messages_received) /
+		seconds;
+	rates.messages_sent =
+		(newest.messages_sent - oldest.messages_sent) / seconds;
+	return true;
+}
+
+gint64 Gobby::ConnectionMetrics::get_time_since_received() const
+{
+	if(m_last_received < 0) return -1;
+	return g_get_monotonic_time() - m_last_received;
+}
+
+std::string Gobby::ConnectionMetrics::to_json(unsigned int span) const
+{
+	gchar* hostname;
+	g_object_get(G_OBJECT(m_connection),
+	             "remote-hostname", &hostname, NULL);
+
+	std::ostringstream stream;
+	stream << "{\"time\": " << g_get_real_time() / 1000
+	       << ", \"remote_hostname\": \"";
+	if(hostname != NULL)
+		append_json_string(stream, hostname);
+	stream << '"';
+	g_free(hostname);
+
+	const gint64 idle = get_time_since_received();
+	if(idle >= 0)
+		stream << ", \"idle_ms\": " << idle / 1000;
+
+	Rates rates;
+	if(get_rates(span, rates))
+	{
+		stream << std::fixed << std::setprecision(1)
+		       << ", \"bytes_received_per_s\": "
+		       << rates.bytes_received
+		       << ", \"bytes_sent_per_s\": " << rates.bytes_sent
+		       << ", \"messages_received_per_s\": "
+		       << rates.messages_received
+		       << ", \"messages_sent_per_s\": "
+		       << rates.messages_sent;
+	}
+
+	stream << "}";
+	return stream.str();
+}
+
+void Gobby::ConnectionMetrics::on_received()
+{
+	++m_counters.messages_received;
+	m_last_received = g_get_monotonic_time();
+}
+
+bool Gobby::ConnectionMetrics::on_sample()
+{
+	m_counters.time = g_get_monotonic_time();
+	m_samples[m_next_sample] = m_counters;
+	m_next_sample = (m_next_sample + 1) % N_SAMPLES;
+	if(m_n_samples < N_SAMPLES) ++m_n_samples;
+
+	m_signal_sampled.emit();
+	return true;
+}
@@ -0,0 +1,161 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_CONNECTIONMETRICS_HPP_
+#define _GOBBY_CONNECTIONMETRICS_HPP_
+
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+
+#include <sigc++/signal.h>
+#include <sigc++/connection.h>
+
+#include <string>
+
+namespace Gobby
+{
+
+// Counts the traffic on a connection, and takes a sample of the counters
+// once per second, keeping the most recent ones in a ring buffer. This is
+// used to show how busy a connection is, for example when somebody
+// complains about lag.
+//
+// The metrics are attached to the connection they measure. Measuring
+// starts with the first call to watch(), and stops again when the last
+// watcher calls unwatch(), or when the connection is freed.
+class ConnectionMetrics
+{
+public:
+	typedef sigc::signal<void> SignalSampled;
+
+	// Number of samples kept, and so the longest time span over which
+	// rates can be computed, in seconds.
+	static const unsigned int N_SAMPLES = 60;
+
+	struct Rates
+	{
+		// Per second, averaged over the sampled time span
+		double bytes_received;
+		double bytes_sent;
+		double messages_received;
+		double messages_sent;
+	};
+
+	// Returns the metrics attached to connection, attaching new ones
+	// if there are none yet. Each call needs to be matched by a call to
+	// unwatch().
+	static ConnectionMetrics& watch(InfXmppConnection* connection);
+
+	// Frees the metrics attached to connection once nobody watches them
+	// anymore.
+	static void unwatch(InfXmppConnection* connection);
+
+	// Returns the metrics attached to connection, or NULL.
+	static ConnectionMetrics* get(InfXmppConnection* connection);
+
+	// Computes the traffic rates over the last span seconds, or over
+	// the time since the first sample if that is shorter. Returns false
+	// if there are not yet enough samples.
+	bool get_rates(unsigned int span, Rates& rates) const;
+
+	// Returns the number of microseconds since the last message was
+	// received, or -1 if none was received since measuring started.
+	gint64 get_time_since_received() const;
+
+	// Returns a single line of JSON with the rates over span seconds.
+	std::string to_json(unsigned int span) const;
+
+	SignalSampled signal_sampled() const { return m_signal_sampled; }
+
+private:
+	ConnectionMetrics(InfXmppConnection* connection);
+	~ConnectionMetrics();
+
+	static void destroy_static(gpointer data)
+	{
+		delete static_cast<ConnectionMetrics*>(data);
+	}
+
+	static void on_received_static(InfXmlConnection* connection,
+	                               xmlNodePtr xml,
+	                               gpointer user_data)
+	{
+		static_cast<ConnectionMetrics*>(user_data)->on_received();
+	}
+
+	static void on_sent_static(InfXmlConnection* connection,
+	                           xmlNodePtr xml,
+	                           gpointer user_data)
+	{
+		++static_cast<ConnectionMetrics*>(user_data)->
+			m_counters.messages_sent;
+	}
+
+	static void on_tcp_received_static(InfTcpConnection* connection,
+	                                   gconstpointer data,
+	                                   guint len,
+	                                   gpointer user_data)
+	{
+		static_cast<ConnectionMetrics*>(user_data)->
+			m_counters.bytes_received += len;
+	}
+
+	static void on_tcp_sent_static(InfTcpConnection* connection,
+	                               gconstpointer data,
+	                               guint len,
+	                               gpointer user_data)
+	{
+		static_cast<ConnectionMetrics*>(user_data)->
+			m_counters.bytes_sent += len;
+	}
+
+	void on_received();
+	bool on_sample();
+
+	struct Sample
+	{
+		gint64 time;
+		guint64 bytes_received;
+		guint64 bytes_sent;
+		guint64 messages_received;
+		guint64 messages_sent;
+	};
+
+	InfXmppConnection* m_connection;
+	InfTcpConnection* m_tcp;
+	unsigned int m_watchers;
+
+	gulong m_received_handler;
+	gulong m_sent_handler;
+	gulong m_tcp_received_handler;
+	gulong m_tcp_sent_handler;
+
+	Sample m_counters;
+	gint64 m_last_received;
+
+	// m_samples[m_next_sample] is the oldest sample once all of them
+	// have been taken.
+	Sample m_samples[N_SAMPLES];
+	unsigned int m_next_sample;
+	unsigned int m_n_samples;
+
+	sigc::connection m_sample_connection;
+	SignalSampled m_signal_sampled;
+};
+
+}
+
+#endif // _GOBBY_CONNECTIONMETRICS_HPP_
@@ -0,0 +1,126 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/connectionmetricslog.hpp"
+#include "core/connectionmetrics.hpp"
+#include "util/i18n.hpp"
+
+#include <glibmm/main.h>
+#include <glibmm/fileutils.h>
+#include <glib/gstdio.h>
+
+#include <cerrno>
+
+Gobby::ConnectionMetricsLog::ConnectionMetricsLog(InfdDirectory* directory,
+                                                  const std::string& filename):
+	m_directory(directory), m_filename(filename),
+	m_file(g_fopen(filename.c_str(), "a"))
+{
+	if(m_file == NULL)
+	{
+		const int code = errno;
+		throw Glib::FileError(
+			static_cast<Glib::FileError::Code>(
+				g_file_error_from_errno(code)),
+			Glib::ustring::compose(
+				_("Could not open \"%1\" to log connection "
+				  "metrics: %2"),
+				filename, g_strerror(code)));
+	}
+
+	g_object_ref(m_directory);
+
+	infd_directory_foreach_connection(m_directory, add_connection_static,
+	                                  this);
+
+	m_connection_added_handler = g_signal_connect(
+		G_OBJECT(m_directory), "connection-added",
+		G_CALLBACK(on_connection_added_static), this);
+	m_connection_removed_handler = g_signal_connect(
+		G_OBJECT(m_directory), "connection-removed",
+		G_CALLBACK(on_connection_removed_static), this);
+
+	m_write_connection = Glib::signal_timeout().connect_seconds(
+		sigc::mem_fun(*this, &ConnectionMetricsLog::on_write),
+		INTERVAL);
+}
+
+Gobby::ConnectionMetricsLog::~ConnectionMetricsLog()
+{
+	m_write_connection.disconnect();
+
+	g_signal_handler_disconnect(m_directory, m_connection_added_handler);
+	g_signal_handler_disconnect(m_directory,
+	                            m_connection_removed_handler);
+	g_object_unref(m_directory);
+
+	for(ConnectionSet::const_iterator iter = m_connections.begin();
+	    iter != m_connections.end(); ++iter)
+	{
+		ConnectionMetrics::unwatch(*iter);
+		g_object_unref(*iter);
+	}
+
+	std::fclose(m_file);
+}
+
+void Gobby::ConnectionMetricsLog::on_connection_added(
+	InfXmlConnection* connection)
+{
+	if(!INF_IS_XMPP_CONNECTION(connection)) return;
+
+	InfXmppConnection* xmpp = INF_XMPP_CONNECTION(connection);
+	if(!m_connections.insert(xmpp).second) return;
+
+	g_object_ref(xmpp);
+	ConnectionMetrics::watch(xmpp);
+}
+
+void Gobby::ConnectionMetricsLog::on_connection_removed(
+	InfXmlConnection* connection)
+{
+	if(!INF_IS_XMPP_CONNECTION(connection)) return;
+
+	ConnectionSet::iterator iter =
+		m_connections.find(INF_XMPP_CONNECTION(connection));
+	if(iter == m_connections.end()) return;
+
+	ConnectionMetrics::unwatch(*iter);
+	g_object_unref(*iter);
+	m_connections.erase(iter);
+}
+
+bool Gobby::ConnectionMetricsLog::on_write()
+{
+	for(ConnectionSet::const_iterator iter = m_connections.begin();
+	    iter != m_connections.end(); ++iter)
+	{
+		const ConnectionMetrics* metrics =
+			ConnectionMetrics::get(*iter);
+		const std::string line = metrics->to_json(INTERVAL) + "\n";
+		std::fwrite(line.data(), 1, line.size(), m_file);
+	}
+
+	// Flush every time, so that the file can be followed while the
+	// server runs.
+	if(std::fflush(m_file) != 0)
+	{
+		g_warning("Failed to write connection metrics to \"%s\": %s",
+		          m_filename.c_str(), g_strerror(errno));
+	}
+
+	return true;
+}
@@ -0,0 +1,90 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_CONNECTIONMETRICSLOG_HPP_
+#define _GOBBY_CONNECTIONMETRICSLOG_HPP_
+
+#include <libinfinity/server/infd-directory.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+
+#include <sigc++/connection.h>
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+namespace Gobby
+{
+
+// Appends the traffic of every client of a directory to a file, as one
+// line of JSON per client and interval, so that it can be looked at when
+// people report lag. The clients are measured from when they connect until
+// they disconnect, or until the log is destroyed.
+class ConnectionMetricsLog
+{
+public:
+	// How often the log is written, in seconds. The connection metrics
+	// keep samples for this long.
+	static const unsigned int INTERVAL = 60;
+
+	// Throws Glib::FileError if the file cannot be opened for appending.
+	ConnectionMetricsLog(InfdDirectory* directory,
+	                     const std::string& filename);
+	~ConnectionMetricsLog();
+
+protected:
+	static void add_connection_static(InfXmlConnection* connection,
+	                                  gpointer user_data)
+	{
+		static_cast<ConnectionMetricsLog*>(user_data)->
+			on_connection_added(connection);
+	}
+
+	static void on_connection_added_static(InfdDirectory* directory,
+	                                       InfXmlConnection* connection,
+	                                       gpointer user_data)
+	{
+		static_cast<ConnectionMetricsLog*>(user_data)->
+			on_connection_added(connection);
+	}
+
+	static void on_connection_removed_static(InfdDirectory* directory,
+	                                         InfXmlConnection* connection,
+	                                         gpointer user_data)
+	{
+		static_cast<ConnectionMetricsLog*>(user_data)->
+			on_connection_removed(connection);
+	}
+
+	void on_connection_added(InfXmlConnection* connection);
+	void on_connection_removed(InfXmlConnection* connection);
+	bool on_write();
+
+	InfdDirectory* m_directory;
+	const std::string m_filename;
+	FILE* m_file;
+
+	typedef std::set<InfXmppConnection*> ConnectionSet;
+	ConnectionSet m_connections;
+
+	gulong m_connection_added_handler;
+	gulong m_connection_removed_handler;
+	sigc::connection m_write_connection;
+};
+
+}
+
+#endif // _GOBBY_CONNECTIONMETRICSLOG_HPP_
@@ -103,9 +103,9 @@ namespace
 
 Gobby::Folder::Folder(bool hide_single_tab,
                       Preferences& preferences,
-                      GtkSourceLanguageManager* lang_manager):
+                      const LanguageIndex& language_index):
 	m_hide_single_tab(hide_single_tab), m_preferences(preferences),
-	m_lang_manager(lang_manager),
+	m_language_index(language_index),
 	m_document_userlist_width(Gio::Settings::create(
 		"de.0x539.gobby.state.window"), "document-userlist-width"),
 	m_chat_userlist_width(Gio::Settings::create(
@@ -135,7 +135,7 @@ Gobby::Folder::add_text_session(InfTextSession* session,
 	TextSessionView* view = Gtk::manage(
 		new TextSessionView(session, title, path, hostname,
 		                    info_storage_key, m_preferences,
-		                    m_lang_manager));
+		                    m_language_index));
 	view->show();
 	m_signal_document_added.emit(*view);
 
@@ -42,10 +42,10 @@ public:
 		accumulated<default_accumulator<bool, true> >
 			SignalDocumentCloseRequest;
 
-	// TODO chat: Should not require langmgr
+	// TODO chat: Should not require language index
 	Folder(bool hide_single_tab,
 	       Preferences& preferences,
-	       GtkSourceLanguageManager* lang_manager);
+	       const LanguageIndex& language_index);
 	~Folder();
 
 	TextSessionView& add_text_session(InfTextSession* session,
@@ -92,7 +92,7 @@ protected:
 
 	const bool m_hide_single_tab;
 	Preferences& m_preferences;
-	GtkSourceLanguageManager* m_lang_manager;
+	const LanguageIndex& m_language_index;
 
 	// Persistent state
 	Preferences::Option<unsigned int> m_document_userlist_width;
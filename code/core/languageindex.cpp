@@ -0,0 +1,186 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "core/languageindex.hpp"
+
+#include <gio/gio.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	bool is_plain(const char* str)
+	{
+		return strpbrk(str, "*?[\\") == NULL;
+	}
+
+	bool language_sort_func(GtkSourceLanguage* lang1,
+	                        GtkSourceLanguage* lang2)
+	{
+		gchar* casefold1 = g_utf8_casefold(
+			gtk_source_language_get_name(lang1), -1);
+		gchar* casefold2 = g_utf8_casefold(
+			gtk_source_language_get_name(lang2), -1);
+
+		int ret = g_utf8_collate(casefold1, casefold2);
+
+		g_free(casefold1);
+		g_free(casefold2);
+
+		return ret < 0;
+	}
+}
+
+Gobby::LanguageIndex::LanguageIndex(GtkSourceLanguageManager* manager):
+	m_manager(manager)
+{
+	const gchar* const* ids =
+		gtk_source_language_manager_get_language_ids(manager);
+	if(ids == NULL)
+		return;
+
+	unsigned int rank = 0;
+	for(const gchar* const* id = ids; *id != NULL; ++id, ++rank)
+	{
+		GtkSourceLanguage* language =
+			gtk_source_language_manager_get_language(manager, *id);
+		if(language == NULL) continue;
+
+		const Entry entry = { rank, language };
+
+		gchar** globs = gtk_source_language_get_globs(language);
+		if(globs != NULL)
+		{
+			for(gchar** glob = globs; *glob != NULL; ++glob)
+			{
+				if(is_plain(*glob))
+				{
+					add_entry(m_filenames, *glob, entry);
+				}
+				else if((*glob)[0] == '*' &&
+				        (*glob)[1] == '.' &&
+				        is_plain(*glob + 1))
+				{
+					add_entry(m_extensions, *glob + 2,
+					          entry);
+				}
+				else
+				{
+					m_patterns.push_back(std::make_pair(
+						g_pattern_spec_new(*glob),
+						entry));
+				}
+			}
+
+			g_strfreev(globs);
+		}
+
+		if(!gtk_source_language_get_hidden(language))
+		{
+			m_sections[gtk_source_language_get_section(language)]
+				.push_back(language);
+		}
+	}
+
+	for(SectionMap::iterator iter = m_sections.begin();
+	    iter != m_sections.end(); ++iter)
+	{
+		std::sort(iter->second.begin(), iter->second.end(),
+		          language_sort_func);
+	}
+}
+
+Gobby::LanguageIndex::~LanguageIndex()
+{
+	for(PatternList::iterator iter = m_patterns.begin();
+	    iter != m_patterns.end(); ++iter)
+	{
+		g_pattern_spec_free(iter->first);
+	}
+}
+
+GtkSourceLanguage*
+Gobby::LanguageIndex::get_language(const std::string& id) const
+{
+	return gtk_source_language_manager_get_language(m_manager, id.c_str());
+}
+
+GtkSourceLanguage*
+Gobby::LanguageIndex::get_language_for_title(const std::string& title) const
+{
+	const Entry* best = NULL;
+	lookup(m_filenames, title, best);
+
+	// Try all suffixes starting with a dot, so that globs such as
+	// "*.tar.gz" are found as well as "*.gz".
+	for(std::string::size_type pos = title.find('.');
+	    pos != std::string::npos; pos = title.find('.', pos + 1))
+	{
+		lookup(m_extensions, title.substr(pos + 1), best);
+	}
+
+	for(PatternList::const_iterator iter = m_patterns.begin();
+	    iter != m_patterns.end(); ++iter)
+	{
+		if(best != NULL && best->rank < iter->second.rank)
+			continue;
+
+		if(g_pattern_match_string(iter->first, title.c_str()))
+			best = &iter->second;
+	}
+
+	if(best == NULL) return NULL;
+	return best->language;
+}
+
+GtkSourceLanguage*
+Gobby::LanguageIndex::get_language_for_content(const gchar* content,
+                                               gsize size) const
+{
+	gboolean uncertain;
+	gchar* content_type = g_content_type_guess(
+		NULL, reinterpret_cast<const guchar*>(content), size,
+		&uncertain);
+
+	GtkSourceLanguage* language = NULL;
+	if(!uncertain && !g_content_type_equals(content_type, "text/plain"))
+	{
+		language = gtk_source_language_manager_guess_language(
+			m_manager, NULL, content_type);
+	}
+
+	g_free(content_type);
+	return language;
+}
+
+void Gobby::LanguageIndex::add_entry(EntryMap& map, const std::string& key,
+                                     const Entry& entry)
+{
+	// The first language in the manager's order wins
+	map.insert(std::make_pair(key, entry));
+}
+
+void Gobby::LanguageIndex::lookup(const EntryMap& map, const std::string& key,
+                                  const Entry*& best)
+{
+	EntryMap::const_iterator iter = map.find(key);
+	if(iter == map.end()) return;
+
+	if(best == NULL || iter->second.rank < best->rank)
+		best = &iter->second;
+}
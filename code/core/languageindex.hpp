@@ -0,0 +1,91 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef _GOBBY_LANGUAGEINDEX_HPP_
+#define _GOBBY_LANGUAGEINDEX_HPP_
+
+#include <gtksourceview/gtksource.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Gobby
+{
+
+// Maps document titles to GtkSourceLanguages. The globs of all languages
+// are looked at once when the index is built: plain extensions such as
+// "*.cpp" and exact file names such as "Makefile" are put into maps, and
+// only the few remaining patterns are compiled and matched one by one. The
+// result is the same as matching the title against the globs of every
+// language, in the language manager's order.
+class LanguageIndex
+{
+public:
+	typedef std::vector<GtkSourceLanguage*> LanguageList;
+	typedef std::map<std::string, LanguageList> SectionMap;
+
+	LanguageIndex(GtkSourceLanguageManager* manager);
+	~LanguageIndex();
+
+	GtkSourceLanguageManager* get_manager() const { return m_manager; }
+
+	// Returns NULL if there is no language with the given ID
+	GtkSourceLanguage* get_language(const std::string& id) const;
+
+	// Returns NULL if no language matches the title
+	GtkSourceLanguage*
+	get_language_for_title(const std::string& title) const;
+
+	// Guesses the language from the beginning of a document's content,
+	// for documents whose title does not tell, such as scripts without
+	// an extension. Returns NULL if nothing sensible can be guessed.
+	GtkSourceLanguage* get_language_for_content(const gchar* content,
+	                                            gsize size) const;
+
+	// Languages that are not hidden, grouped by their section and
+	// sorted by name.
+	const SectionMap& get_sections() const { return m_sections; }
+
+protected:
+	struct Entry
+	{
+		// Position in the language manager's list, lower wins
+		unsigned int rank;
+		GtkSourceLanguage* language;
+	};
+
+	typedef std::map<std::string, Entry> EntryMap;
+	typedef std::vector<std::pair<GPatternSpec*, Entry> > PatternList;
+
+	static void add_entry(EntryMap& map, const std::string& key,
+	                      const Entry& entry);
+	static void lookup(const EntryMap& map, const std::string& key,
+	                   const Entry*& best);
+
+	GtkSourceLanguageManager* m_manager;
+
+	EntryMap m_extensions;
+	EntryMap m_filenames;
+	PatternList m_patterns;
+
+	SectionMap m_sections;
+};
+
+}
+
+#endif // _GOBBY_LANGUAGEINDEX_HPP_
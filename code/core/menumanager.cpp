@@ -20,28 +20,7 @@
 
 #include <gtksourceview/gtksource.h>
 
-namespace
-{
-	bool language_sort_func(GtkSourceLanguage* lang1,
-	                        GtkSourceLanguage* lang2)
-	{
-		// TODO: Speedup by using collation keys?
-		// We should profile first.
-		gchar* casefold1 = g_utf8_casefold(
-			gtk_source_language_get_name(lang1), -1);
-		gchar* casefold2 = g_utf8_casefold(
-			gtk_source_language_get_name(lang2), -1);
-
-		int ret = g_utf8_collate(casefold1, casefold2);
-
-		g_free(casefold1);
-		g_free(casefold2);
-
-		return ret < 0;
-	}
-} // anonymous namespace
-
-Gobby::MenuManager::MenuManager(GtkSourceLanguageManager* language_manager)
+Gobby::MenuManager::MenuManager(const LanguageIndex& language_index)
 {
 	Glib::RefPtr<Gtk::Builder> builder =
 		Gtk::Builder::create_from_resource(
@@ -54,57 +33,34 @@ Gobby::MenuManager::MenuManager(GtkSourceLanguageManager* language_manager)
 
 	Glib::RefPtr<Gio::Menu> highlight_mode_menu = get_highlight_mode_menu();
 
-	const gchar* const* language_ids =
-		gtk_source_language_manager_get_language_ids(
-			language_manager);
-	if(language_ids != NULL)
+	const LanguageIndex::SectionMap& sections =
+		language_index.get_sections();
+	for(LanguageIndex::SectionMap::const_iterator iter = sections.begin();
+	    iter != sections.end(); ++iter)
 	{
-		typedef std::list<GtkSourceLanguage*> LanguageList;
-		typedef std::map<std::string, LanguageList> LanguageMap;
-		LanguageMap languages;
+		Glib::RefPtr<Gio::Menu> submenu(Gio::Menu::create());
 
-		for(const gchar* const* id = language_ids; *id != NULL; ++id)
+		const LanguageIndex::LanguageList& list = iter->second;
+		for(LanguageIndex::LanguageList::const_iterator liter =
+			list.begin();
+		    liter != list.end(); ++liter)
 		{
-			GtkSourceLanguage* language =
-				gtk_source_language_manager_get_language(
-					language_manager, *id);
-			if(gtk_source_language_get_hidden(language)) continue;
-
-			const std::string section =
-				gtk_source_language_get_section(language);
-
-			languages[section].push_back(language);
+			GtkSourceLanguage* language = *liter;
+
+			const std::string id =
+				gtk_source_language_get_id(language);
+			const std::string name =
+				gtk_source_language_get_name(language);
+
+			Glib::RefPtr<Gio::MenuItem> item(
+				Gio::MenuItem::create(
+					name, Glib::ustring::compose(
+						"win.highlight-mode('%1')",
+						id)));
+			submenu->append_item(item);
 		}
 
-		for(LanguageMap::iterator iter = languages.begin();
-		    iter != languages.end(); ++iter)
-		{
-			Glib::RefPtr<Gio::Menu> submenu(Gio::Menu::create());
-
-			LanguageList& list = iter->second;
-			list.sort(language_sort_func);
-
-			for(LanguageList::const_iterator liter = list.begin();
-			    liter != list.end(); ++liter)
-			{
-				GtkSourceLanguage* language = *liter;
-
-				const std::string id =
-					gtk_source_language_get_id(language);
-				const std::string name =
-					gtk_source_language_get_name(language);
-
-				Glib::RefPtr<Gio::MenuItem> item(
-					Gio::MenuItem::create(
-						name, Glib::ustring::compose(
-							"win.highlight-mode"
-							"('%1')", id)));
-				submenu->append_item(item);
-			}
-
-			highlight_mode_menu->append_submenu(
-				iter->first, submenu);
-		}
+		highlight_mode_menu->append_submenu(iter->first, submenu);
 	}
 }
 
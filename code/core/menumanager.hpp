@@ -17,6 +17,8 @@
 #ifndef _GOBBY_MENUMANAGER_HPP_
 #define _GOBBY_MENUMANAGER_HPP_
 
+#include "core/languageindex.hpp"
+
 #include <giomm/menumodel.h>
 #include <giomm/menu.h>
 
@@ -28,7 +30,7 @@ namespace Gobby
 class MenuManager
 {
 public:
-	MenuManager(GtkSourceLanguageManager* language_manager);
+	MenuManager(const LanguageIndex& language_index);
 
 	Glib::RefPtr<Gio::MenuModel> get_app_menu() { return m_app_menu; }
 	Glib::RefPtr<Gio::MenuModel> get_menu() { return m_menu; }
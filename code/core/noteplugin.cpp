@@ -15,10 +15,12 @@
  */
 
 #include "core/noteplugin.hpp"
+#include "core/textjournal.hpp"
 
 #include <libinftextgtk/inf-text-gtk-buffer.h>
 #include <libinftext/inf-text-session.h>
 #include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-default-buffer.h>
 #include <libinftext/inf-text-filesystem-format.h>
 
 #include <libinfinity/server/infd-filesystem-storage.h>
@@ -30,11 +32,31 @@
 
 #include <gtksourceview/gtksource.h>
 
+#include <memory>
+
 namespace
 {
+	unsigned int undo_history_size = 2048;
+	bool journaling = false;
+
+	// Passed as user data to the plugins, to choose the buffer
+	// implementation. Sessions that can be shown in a view need a
+	// GtkSourceBuffer; a headless server gets by with the much smaller
+	// InfTextDefaultBuffer.
+	enum BufferType {
+		BUFFER_GTK,
+		BUFFER_DEFAULT
+	};
+
 	InfTextBuffer*
-	make_buffer(InfUserTable* user_table)
+	make_buffer(InfUserTable* user_table, gpointer user_data)
 	{
+		if(GPOINTER_TO_INT(user_data) == BUFFER_DEFAULT)
+		{
+			return INF_TEXT_BUFFER(
+				inf_text_default_buffer_new("UTF-8"));
+		}
+
 		GtkSourceBuffer* textbuffer = gtk_source_buffer_new(NULL);
 
 		InfTextGtkBuffer* buffer =
@@ -54,15 +76,11 @@ namespace
 	                 gpointer user_data)
 	{
 		InfUserTable* user_table = inf_user_table_new();
-		InfTextBuffer* buffer = make_buffer(user_table);
+		InfTextBuffer* buffer = make_buffer(user_table, user_data);
 
-		InfTextSession* session =
-			inf_text_session_new_with_user_table(
-				manager, INF_TEXT_BUFFER(buffer), io,
-				user_table,
-				status,
-				sync_group,
-				sync_connection);
+		InfTextSession* session = Gobby::Plugins::create_text_session(
+			manager, INF_TEXT_BUFFER(buffer), io, user_table,
+			status, sync_group, sync_connection);
 
 		g_object_unref(buffer);
 		g_object_unref(user_table);
@@ -79,18 +97,33 @@ namespace
 	                  GError** error)
 	{
 		InfUserTable* user_table = inf_user_table_new();
-		InfTextBuffer* buffer = make_buffer(user_table);
+		InfTextBuffer* buffer = make_buffer(user_table, user_data);
 
+		InfdFilesystemStorage* fs_storage =
+			INFD_FILESYSTEM_STORAGE(storage);
 		const gboolean result = inf_text_filesystem_format_read(
-			INFD_FILESYSTEM_STORAGE(storage),
-			path, user_table, buffer, error);
+			fs_storage, path, user_table, buffer, error);
 
 		InfTextSession* session = NULL;
 		if(result)
 		{
-			session = inf_text_session_new_with_user_table(
-				manager, buffer, io, user_table,
-				INF_SESSION_RUNNING, NULL, NULL);
+			// Replay the journal also if journaling has been
+			// turned off in the meantime, so that no changes
+			// are lost.
+			std::unique_ptr<Gobby::TextJournal> journal(
+				new Gobby::TextJournal(fs_storage, path));
+			if(journal->recover(user_table, buffer, error))
+			{
+				session = Gobby::Plugins::create_text_session(
+					manager, buffer, io, user_table,
+					INF_SESSION_RUNNING, NULL, NULL);
+
+				if(journaling)
+				{
+					journal.release()->attach(
+						INF_SESSION(session));
+				}
+			}
 		}
 
 		g_object_unref(buffer);
@@ -106,13 +139,34 @@ namespace
 	                   gpointer user_data,
 	                   GError** error)
 	{
-		return inf_text_filesystem_format_write(
-			INFD_FILESYSTEM_STORAGE(storage),
+		InfdFilesystemStorage* fs_storage =
+			INFD_FILESYSTEM_STORAGE(storage);
+
+		// Sessions keep the journaling mode they were loaded with.
+		Gobby::TextJournal* journal =
+			Gobby::TextJournal::get(session);
+		if(journal != NULL)
+			return journal->flush(error);
+
+		if(journaling)
+		{
+			journal = new Gobby::TextJournal(fs_storage, path);
+			journal->attach(session);
+			return journal->checkpoint(error);
+		}
+
+		const gboolean result = inf_text_filesystem_format_write(
+			fs_storage,
 			path,
 			inf_session_get_user_table(session),
 			INF_TEXT_BUFFER(inf_session_get_buffer(session)),
 			error
 		);
+
+		if(result)
+			Gobby::TextJournal::remove(fs_storage, path);
+
+		return result;
 	}
 
 	InfSession*
@@ -182,6 +236,13 @@ namespace
 		text_session_new
 	};
 
+	const InfcNotePlugin C_TEXT_HEADLESS_PLUGIN =
+	{
+		GINT_TO_POINTER(BUFFER_DEFAULT),
+		"InfText",
+		text_session_new
+	};
+
 	const InfcNotePlugin C_CHAT_PLUGIN =
 	{
 		NULL,
@@ -199,6 +260,16 @@ namespace
 		text_session_write
 	};
 
+	const InfdNotePlugin D_TEXT_HEADLESS_PLUGIN =
+	{
+		GINT_TO_POINTER(BUFFER_DEFAULT),
+		"InfdFilesystemStorage",
+		"InfText",
+		text_session_new,
+		text_session_read,
+		text_session_write
+	};
+
 	const InfdNotePlugin D_CHAT_PLUGIN =
 	{
 		NULL,
@@ -211,6 +282,42 @@ namespace
 }
 
 const InfcNotePlugin* Gobby::Plugins::C_TEXT = &C_TEXT_PLUGIN;
+const InfcNotePlugin* Gobby::Plugins::C_TEXT_HEADLESS =
+	&C_TEXT_HEADLESS_PLUGIN;
 const InfcNotePlugin* Gobby::Plugins::C_CHAT = &C_CHAT_PLUGIN;
 const InfdNotePlugin* Gobby::Plugins::D_TEXT = &D_TEXT_PLUGIN;
+const InfdNotePlugin* Gobby::Plugins::D_TEXT_HEADLESS =
+	&D_TEXT_HEADLESS_PLUGIN;
 const InfdNotePlugin* Gobby::Plugins::D_CHAT = &D_CHAT_PLUGIN;
+
+InfTextSession*
+Gobby::Plugins::create_text_session(InfCommunicationManager* manager,
+                                    InfTextBuffer* buffer,
+                                    InfIo* io,
+                                    InfUserTable* user_table,
+                                    InfSessionStatus status,
+                                    InfCommunicationGroup* sync_group,
+                                    InfXmlConnection* sync_connection)
+{
+	return INF_TEXT_SESSION(g_object_new(
+		INF_TEXT_TYPE_SESSION,
+		"communication-manager", manager,
+		"buffer", buffer,
+		"io", io,
+		"user-table", user_table,
+		"status", status,
+		"sync-group", sync_group,
+		"sync-connection", sync_connection,
+		"max-total-log-size", undo_history_size,
+		static_cast<void*>(NULL)));
+}
+
+void Gobby::Plugins::set_undo_history_size(unsigned int size)
+{
+	undo_history_size = size;
+}
+
+void Gobby::Plugins::set_journaling(bool enabled)
+{
+	journaling = enabled;
+}
@@ -17,6 +17,8 @@
 #ifndef _GOBBY_NOTEPLUGIN_HPP_
 #define _GOBBY_NOTEPLUGIN_HPP_
 
+#include <libinftext/inf-text-session.h>
+
 #include <libinfinity/client/infc-note-plugin.h>
 #include <libinfinity/server/infd-note-plugin.h>
 
@@ -25,9 +27,39 @@ namespace Gobby
 	namespace Plugins
 	{
 		extern const InfcNotePlugin* C_TEXT;
+		// Like C_TEXT, but for sessions that are never shown in a
+		// view. Does not need a display.
+		extern const InfcNotePlugin* C_TEXT_HEADLESS;
 		extern const InfcNotePlugin* C_CHAT;
 		extern const InfdNotePlugin* D_TEXT;
+		// Like D_TEXT, but for directories whose sessions are never
+		// shown in a view. Does not need a display.
+		extern const InfdNotePlugin* D_TEXT_HEADLESS;
 		extern const InfdNotePlugin* D_CHAT;
+
+		// Same as inf_text_session_new_with_user_table(), but with
+		// the request log bounded by set_undo_history_size(). Use
+		// this for all text sessions that gobby creates itself.
+		InfTextSession*
+		create_text_session(InfCommunicationManager* manager,
+		                    InfTextBuffer* buffer,
+		                    InfIo* io,
+		                    InfUserTable* user_table,
+		                    InfSessionStatus status,
+		                    InfCommunicationGroup* sync_group,
+		                    InfXmlConnection* sync_connection);
+
+		// Sets how many requests text sessions keep in their request
+		// logs, which bounds both their memory use and how far back
+		// changes can be undone. Applies to sessions created after
+		// the call.
+		void set_undo_history_size(unsigned int size);
+
+		// Whether text documents in a filesystem storage are saved
+		// by appending changes to a journal next to them, instead of
+		// rewriting them completely every time. Applies to sessions
+		// loaded or created after the call.
+		void set_journaling(bool enabled);
 	}
 }
 
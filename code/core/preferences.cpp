@@ -42,7 +42,8 @@ Gobby::Preferences::User::User(
 	password(settings, entry, "password"),
 	port(settings, entry, "port"),
 	keep_local_documents(settings, entry, "keep-local-documents"),
-	host_directory(settings, entry, "host-directory")
+	host_directory(settings, entry, "host-directory"),
+	journal_local_documents(settings, entry, "journal-local-documents")
 {
 	if(name.is_default())
 		name = Glib::get_user_name();
@@ -61,7 +62,10 @@ Gobby::Preferences::Editor::Editor(
 	indentation_auto(settings, entry, "auto-indentation"),
 	homeend_smart(settings, entry, "smart-homeend"),
 	autosave_enabled(settings, entry, "autosave-enabled"),
-	autosave_interval(settings, entry, "autosave-interval")
+	autosave_interval(settings, entry, "autosave-interval"),
+	parallel_file_operations(settings, entry,
+	                         "parallel-file-operations"),
+	undo_history_size(settings, entry, "undo-history-size")
 {
 }
 
@@ -75,7 +79,8 @@ Gobby::Preferences::View::View(
 	margin_display(settings, entry, "margin-display"),
 	margin_pos(settings, entry, "margin-position"),
 	bracket_highlight(settings, entry, "highlight-matching-brackets"),
-	whitespace_display(settings, entry, "display-whitespace")
+	whitespace_display(settings, entry, "display-whitespace"),
+	highlight_size_limit(settings, entry, "highlight-size-limit")
 {
 }
 
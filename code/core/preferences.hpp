@@ -612,6 +612,7 @@ public:
 		Option<unsigned int> port;
 		Option<bool> keep_local_documents;
 		Option<std::string> host_directory;
+		Option<bool> journal_local_documents;
 	};
 
 	class Editor
@@ -626,6 +627,8 @@ public:
 		Option<bool> homeend_smart;
 		Option<bool> autosave_enabled;
 		Option<unsigned int> autosave_interval;
+		Option<unsigned int> parallel_file_operations;
+		Option<unsigned int> undo_history_size;
 	};
 
 	class View
@@ -641,6 +644,7 @@ public:
 		Option<unsigned int> margin_pos;
 		Option<bool> bracket_highlight;
 		Option<GtkSourceDrawSpacesFlags> whitespace_display;
+		Option<unsigned int> highlight_size_limit;
 	};
 
 	class Appearance
@@ -15,24 +15,68 @@
  */
 
 #include "core/selfhoster.hpp"
+#include "core/sessionsize.hpp"
+#include "core/textjournal.hpp"
 #include "util/i18n.hpp"
 
+#include <libinftext/inf-text-session.h>
 #include <libinfinity/server/infd-filesystem-storage.h>
 
+namespace
+{
+	// Makes the journals of the loaded documents at or below iter stop
+	// writing, so that they are not created again after the journal
+	// files have been removed.
+	void discard_journals(InfBrowser* browser, const InfBrowserIter* iter)
+	{
+		if(inf_browser_is_subdirectory(browser, iter))
+		{
+			if(!inf_browser_get_explored(browser, iter))
+				return;
+
+			InfBrowserIter child = *iter;
+			if(!inf_browser_get_child(browser, &child))
+				return;
+
+			do
+			{
+				discard_journals(browser, &child);
+			} while(inf_browser_get_next(browser, &child));
+		}
+		else
+		{
+			InfSessionProxy* proxy =
+				inf_browser_get_session(browser, iter);
+			if(proxy == NULL) return;
+
+			InfSession* session;
+			g_object_get(G_OBJECT(proxy),
+			             "session", &session, NULL);
+
+			Gobby::TextJournal* journal =
+				Gobby::TextJournal::get(session);
+			if(journal != NULL)
+				journal->discard();
+
+			g_object_unref(session);
+		}
+	}
+}
+
 Gobby::SelfHoster::SelfHoster(InfIo* io,
                               InfCommunicationManager* communication_manager,
                               InfLocalPublisher* publisher,
                               InfSaslContext* sasl_context,
-                              StatusBar& status_bar,
+                              Reporter& reporter,
                               CertificateManager& cert_manager,
                               const Preferences& preferences):
 	m_sasl_context(sasl_context),
-	m_status_bar(status_bar),
+	m_reporter(reporter),
 	m_cert_manager(cert_manager),
 	m_preferences(preferences),
 	m_dh_params_loaded(false),
-	m_info_handle(status_bar.invalid_handle()),
-	m_dh_params_message_handle(status_bar.invalid_handle()),
+	m_info_id(Reporter::INVALID_MESSAGE),
+	m_dh_params_message_id(Reporter::INVALID_MESSAGE),
 	m_directory(infd_directory_new(io, NULL, communication_manager)),
 	m_server(io, publisher)
 {
@@ -48,6 +92,16 @@ Gobby::SelfHoster::SelfHoster(InfIo* io,
 		g_object_unref(storage);
 	}
 
+	m_subscribe_session_handler = g_signal_connect(
+		G_OBJECT(m_directory), "subscribe-session",
+		G_CALLBACK(on_subscribe_session_static), this);
+	m_unsubscribe_session_handler = g_signal_connect(
+		G_OBJECT(m_directory), "unsubscribe-session",
+		G_CALLBACK(on_unsubscribe_session_static), this);
+	m_node_removed_handler = g_signal_connect(
+		G_OBJECT(m_directory), "node-removed",
+		G_CALLBACK(on_node_removed_static), this);
+
 	InfdServerPool* pool = infd_server_pool_new(m_directory);
 	m_server.set_pool(pool);
 	g_object_unref(pool);
@@ -80,10 +134,43 @@ Gobby::SelfHoster::SelfHoster(InfIo* io,
 
 Gobby::SelfHoster::~SelfHoster()
 {
+	g_signal_handler_disconnect(m_directory, m_subscribe_session_handler);
+	g_signal_handler_disconnect(m_directory,
+	                            m_unsubscribe_session_handler);
+	g_signal_handler_disconnect(m_directory, m_node_removed_handler);
+
 	g_object_unref(m_directory);
 	inf_sasl_context_unref(m_sasl_context);
 }
 
+std::size_t Gobby::SelfHoster::get_resident_size() const
+{
+	std::size_t bytes = 0;
+	for(SessionSet::const_iterator iter = m_resident_sessions.begin();
+	    iter != m_resident_sessions.end(); ++iter)
+	{
+		InfSession* session;
+		g_object_get(G_OBJECT(*iter), "session", &session, NULL);
+
+		if(INF_TEXT_IS_SESSION(session) &&
+		   inf_session_get_status(session) == INF_SESSION_RUNNING)
+		{
+			unsigned int requests;
+			std::size_t history_bytes;
+			get_session_history_size(
+				session, requests, history_bytes);
+
+			bytes += history_bytes;
+			bytes += get_text_buffer_size(INF_TEXT_BUFFER(
+				inf_session_get_buffer(session)));
+		}
+
+		g_object_unref(session);
+	}
+
+	return bytes;
+}
+
 bool Gobby::SelfHoster::ensure_dh_params()
 {
 	// If they are loaded already: perfect. Note this does not mean we
@@ -101,7 +188,7 @@ bool Gobby::SelfHoster::ensure_dh_params()
 	// Otherwise go and create a new set of parameters
 	if(m_dh_params_handle.get() == NULL)
 	{
-		m_dh_params_message_handle = m_status_bar.add_info_message(
+		m_dh_params_message_id = m_reporter.add_info_message(
 			_("Generating 2048-bit Diffie-Hellman "
 			  "parameters..."));
 
@@ -117,8 +204,9 @@ void Gobby::SelfHoster::on_dh_params_done(const DHParamsGeneratorHandle* hndl,
                                           gnutls_dh_params_t dh_params,
                                           const GError* error)
 {
-	g_assert(m_dh_params_message_handle != m_status_bar.invalid_handle());
-	m_status_bar.remove_message(m_dh_params_message_handle);
+	g_assert(m_dh_params_message_id != Reporter::INVALID_MESSAGE);
+	m_reporter.remove_message(m_dh_params_message_id);
+	m_dh_params_message_id = Reporter::INVALID_MESSAGE;
 
 	// Set this flag also when an error occured, to prevent trying to
 	// re-generate the parameters all the time.
@@ -133,7 +221,7 @@ void Gobby::SelfHoster::on_dh_params_done(const DHParamsGeneratorHandle* hndl,
 	}
 	else
 	{
-		m_status_bar.add_error_message(
+		m_reporter.add_error_message(
 			_("Failed to generate Diffie-Hellman parameters"),
 			Glib::ustring::compose(
 				_("This means that Perfect Forward Secrecy "
@@ -233,11 +321,11 @@ void Gobby::SelfHoster::apply_preferences()
 		}
 	}
 
-	// Remove old statusbar message, if any
-	if(m_info_handle != m_status_bar.invalid_handle())
+	// Remove old info message, if any
+	if(m_info_id != Reporter::INVALID_MESSAGE)
 	{
-		m_status_bar.remove_message(m_info_handle);
-		m_info_handle = m_status_bar.invalid_handle();
+		m_reporter.remove_message(m_info_id);
+		m_info_id = Reporter::INVALID_MESSAGE;
 	}
 
 	// Close server and all connections if no access is required
@@ -261,7 +349,7 @@ void Gobby::SelfHoster::apply_preferences()
             m_cert_manager.get_private_key() == NULL ||
 	    m_cert_manager.get_certificates() == NULL))
 	{
-		m_info_handle = m_status_bar.add_info_message(
+		m_info_id = m_reporter.add_info_message(
 			_("In order to start sharing your documents, "
 			  "choose a private key and certificate or "
 			  "create a new pair in the preferences"));
@@ -284,9 +372,77 @@ void Gobby::SelfHoster::apply_preferences()
 	}
 	catch(const std::exception& ex)
 	{
-		m_status_bar.add_error_message(_("Failed to share documents"),
-		                               ex.what());
+		m_reporter.add_error_message(_("Failed to share documents"),
+		                             ex.what());
 
 		return;
 	}
 }
+
+void Gobby::SelfHoster::on_subscribe_session(InfSessionProxy* proxy)
+{
+	m_resident_sessions.insert(proxy);
+	m_signal_resident_sessions_changed.emit();
+}
+
+void Gobby::SelfHoster::on_unsubscribe_session(InfSessionProxy* proxy)
+{
+	m_resident_sessions.erase(proxy);
+	m_signal_resident_sessions_changed.emit();
+}
+
+void Gobby::SelfHoster::on_node_removed(const InfBrowserIter* iter)
+{
+	// Journals live outside the storage's root directory, so the
+	// storage does not remove them with the document. Otherwise a new
+	// document created at the same path could pick up the journal of
+	// the removed one.
+	InfdStorage* storage = infd_directory_get_storage(m_directory);
+	if(storage == NULL || !INFD_IS_FILESYSTEM_STORAGE(storage))
+		return;
+
+	InfBrowser* browser = INF_BROWSER(m_directory);
+	discard_journals(browser, iter);
+
+	gchar* path = inf_browser_get_path(browser, iter);
+	if(inf_browser_is_subdirectory(browser, iter))
+	{
+		TextJournal::remove_directory(
+			INFD_FILESYSTEM_STORAGE(storage), path);
+	}
+	else
+	{
+		TextJournal::remove(INFD_FILESYSTEM_STORAGE(storage), path);
+	}
+
+	g_free(path);
+}
+
+Gobby::StatusBarReporter::StatusBarReporter(StatusBar& status_bar):
+	m_status_bar(status_bar), m_next_id(INVALID_MESSAGE + 1)
+{
+}
+
+Gobby::SelfHoster::Reporter::MessageId
+Gobby::StatusBarReporter::add_info_message(const Glib::ustring& message)
+{
+	const MessageId id = m_next_id++;
+	m_messages[id] = m_status_bar.add_info_message(message);
+	return id;
+}
+
+void Gobby::StatusBarReporter::add_error_message(
+	const Glib::ustring& brief_desc,
+	const Glib::ustring& detailed_desc)
+{
+	m_status_bar.add_error_message(brief_desc, detailed_desc);
+}
+
+void Gobby::StatusBarReporter::remove_message(MessageId id)
+{
+	MessageMap::iterator iter = m_messages.find(id);
+	g_assert(iter != m_messages.end());
+
+	m_status_bar.remove_message(iter->second);
+	m_messages.erase(iter);
+}
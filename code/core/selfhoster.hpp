@@ -28,22 +28,89 @@
 #include <libinfinity/common/inf-local-publisher.h>
 #include <libinfinity/common/inf-io.h>
 
+#include <map>
+#include <set>
+
 namespace Gobby
 {
 
 class SelfHoster: public sigc::trackable
 {
 public:
+	// Receives the messages the self-hoster has for the user. In the
+	// GUI they end up in the status bar, in headless mode in the log.
+	class Reporter
+	{
+	public:
+		typedef unsigned int MessageId;
+		static const MessageId INVALID_MESSAGE = 0;
+
+		virtual ~Reporter() {}
+
+		// Shows message until it is removed with remove_message().
+		virtual MessageId add_info_message(
+			const Glib::ustring& message) = 0;
+		virtual void add_error_message(
+			const Glib::ustring& brief_desc,
+			const Glib::ustring& detailed_desc) = 0;
+		virtual void remove_message(MessageId id) = 0;
+	};
+
 	SelfHoster(InfIo* io, InfCommunicationManager* communication_manager,
 	           InfLocalPublisher* publisher,
 	           InfSaslContext* sasl_context,
-	           StatusBar& status_bar,
+	           Reporter& reporter,
 	           CertificateManager& cert_manager,
 	           const Preferences& preferences);
 	~SelfHoster();
 
+	typedef sigc::signal<void> SignalResidentSessionsChanged;
+
 	InfdDirectory* get_directory() { return m_directory; }
+
+	// Sessions that the directory currently keeps in memory. With a
+	// storage, libinfinity saves and unloads a session shortly after
+	// its last subscriber has left, and reads it back on the next
+	// subscription.
+	unsigned int get_n_resident_sessions() const
+		{ return m_resident_sessions.size(); }
+
+	// Estimates the memory used by the text and history of the resident
+	// sessions. This walks all of them, so call it only when needed.
+	std::size_t get_resident_size() const;
+
+	SignalResidentSessionsChanged
+	signal_resident_sessions_changed() const
+		{ return m_signal_resident_sessions_changed; }
 protected:
+	static void on_subscribe_session_static(InfBrowser* browser,
+	                                        const InfBrowserIter* iter,
+	                                        InfSessionProxy* proxy,
+	                                        InfRequest* request,
+	                                        gpointer user_data)
+	{
+		static_cast<SelfHoster*>(user_data)->
+			on_subscribe_session(proxy);
+	}
+
+	static void on_unsubscribe_session_static(InfBrowser* browser,
+	                                          const InfBrowserIter* iter,
+	                                          InfSessionProxy* proxy,
+	                                          InfRequest* request,
+	                                          gpointer user_data)
+	{
+		static_cast<SelfHoster*>(user_data)->
+			on_unsubscribe_session(proxy);
+	}
+
+	static void on_node_removed_static(InfBrowser* browser,
+	                                   const InfBrowserIter* iter,
+	                                   InfRequest* request,
+	                                   gpointer user_data)
+	{
+		static_cast<SelfHoster*>(user_data)->on_node_removed(iter);
+	}
+
 	static void directory_foreach_func_close_static(
 		InfXmlConnection* connection,
 		gpointer user_data);
@@ -61,21 +128,51 @@ protected:
 	void on_require_password_changed();
 	void apply_preferences();
 
+	void on_subscribe_session(InfSessionProxy* proxy);
+	void on_unsubscribe_session(InfSessionProxy* proxy);
+	void on_node_removed(const InfBrowserIter* iter);
+
 	InfSaslContext* m_sasl_context;
 
-	StatusBar& m_status_bar;
+	Reporter& m_reporter;
 	CertificateManager& m_cert_manager;
 	const Preferences& m_preferences;
 
 	bool m_dh_params_loaded;
 
-	StatusBar::MessageHandle m_info_handle;
-	StatusBar::MessageHandle m_dh_params_message_handle;
+	Reporter::MessageId m_info_id;
+	Reporter::MessageId m_dh_params_message_id;
 
 	InfdDirectory* m_directory;
 	Server m_server;
 
 	std::unique_ptr<DHParamsGeneratorHandle> m_dh_params_handle;
+
+	typedef std::set<InfSessionProxy*> SessionSet;
+	SessionSet m_resident_sessions;
+	gulong m_subscribe_session_handler;
+	gulong m_unsubscribe_session_handler;
+	gulong m_node_removed_handler;
+	SignalResidentSessionsChanged m_signal_resident_sessions_changed;
+};
+
+// Shows the self-hoster's messages in the status bar.
+class StatusBarReporter: public SelfHoster::Reporter
+{
+public:
+	StatusBarReporter(StatusBar& status_bar);
+
+	virtual MessageId add_info_message(const Glib::ustring& message);
+	virtual void add_error_message(const Glib::ustring& brief_desc,
+	                               const Glib::ustring& detailed_desc);
+	virtual void remove_message(MessageId id);
+
+protected:
+	typedef std::map<MessageId, StatusBar::MessageHandle> MessageMap;
+
+	StatusBar& m_status_bar;
+	MessageMap m_messages;
+	MessageId m_next_id;
 };
 
 }
@@ -0,0 +1,145 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/sessionsize.hpp"
+
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-default-delete-operation.h>
+#include <libinfinity/adopted/inf-adopted-split-operation.h>
+#include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/adopted/inf-adopted-user.h>
+
+namespace
+{
+	// Rough size of a request object including its state vector and
+	// its entry in the request log, not counting any text it carries.
+	const std::size_t REQUEST_OVERHEAD = 160;
+
+	std::size_t get_chunk_size(InfTextChunk* chunk)
+	{
+		std::size_t bytes = 0;
+
+		InfTextChunkIter iter;
+		if(inf_text_chunk_iter_init_begin(chunk, &iter))
+		{
+			do
+			{
+				bytes += inf_text_chunk_iter_get_bytes(&iter);
+			} while(inf_text_chunk_iter_next(&iter));
+		}
+
+		return bytes;
+	}
+
+	std::size_t get_operation_size(InfAdoptedOperation* operation)
+	{
+		if(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(operation))
+		{
+			return get_chunk_size(
+				inf_text_default_insert_operation_get_chunk(
+					INF_TEXT_DEFAULT_INSERT_OPERATION(
+						operation)));
+		}
+		else if(INF_TEXT_IS_DEFAULT_DELETE_OPERATION(operation))
+		{
+			return get_chunk_size(
+				inf_text_default_delete_operation_get_chunk(
+					INF_TEXT_DEFAULT_DELETE_OPERATION(
+						operation)));
+		}
+		else if(INF_ADOPTED_IS_SPLIT_OPERATION(operation))
+		{
+			std::size_t bytes = 0;
+			GSList* list = inf_adopted_split_operation_unsplit(
+				INF_ADOPTED_SPLIT_OPERATION(operation));
+			for(GSList* item = list; item != NULL;
+			    item = item->next)
+			{
+				bytes += get_operation_size(
+					INF_ADOPTED_OPERATION(item->data));
+			}
+
+			g_slist_free(list);
+			return bytes;
+		}
+
+		return 0;
+	}
+
+	struct HistorySize
+	{
+		unsigned int requests;
+		std::size_t bytes;
+	};
+
+	void add_user_history_size(InfUser* user, gpointer user_data)
+	{
+		HistorySize* size = static_cast<HistorySize*>(user_data);
+		InfAdoptedRequestLog* log =
+			inf_adopted_user_get_request_log(INF_ADOPTED_USER(user));
+
+		const guint end = inf_adopted_request_log_get_end(log);
+		for(guint n = inf_adopted_request_log_get_begin(log);
+		    n < end; ++n)
+		{
+			InfAdoptedRequest* request =
+				inf_adopted_request_log_get_request(log, n);
+
+			++size->requests;
+			size->bytes += REQUEST_OVERHEAD;
+
+			// Undo and redo requests refer to earlier requests
+			// and carry no operation of their own.
+			if(inf_adopted_request_get_request_type(request) ==
+			   INF_ADOPTED_REQUEST_DO)
+			{
+				size->bytes += get_operation_size(
+					inf_adopted_request_get_operation(
+						request));
+			}
+		}
+	}
+}
+
+void Gobby::get_session_history_size(InfSession* session,
+                                     unsigned int& requests,
+                                     std::size_t& bytes)
+{
+	HistorySize size = { 0, 0 };
+	inf_user_table_foreach_user(inf_session_get_user_table(session),
+	                            add_user_history_size, &size);
+
+	requests = size.requests;
+	bytes = size.bytes;
+}
+
+std::size_t Gobby::get_text_buffer_size(InfTextBuffer* buffer)
+{
+	std::size_t bytes = 0;
+
+	InfTextBufferIter* iter = inf_text_buffer_create_begin_iter(buffer);
+	if(iter != NULL)
+	{
+		do
+		{
+			bytes += inf_text_buffer_iter_get_bytes(buffer, iter);
+		} while(inf_text_buffer_iter_next(buffer, iter));
+
+		inf_text_buffer_destroy_iter(buffer, iter);
+	}
+
+	return bytes;
+}
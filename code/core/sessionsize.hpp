@@ -0,0 +1,39 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_SESSIONSIZE_HPP_
+#define _GOBBY_SESSIONSIZE_HPP_
+
+#include <libinftext/inf-text-buffer.h>
+#include <libinfinity/common/inf-session.h>
+
+#include <cstddef>
+
+namespace Gobby
+{
+
+// Returns the number of requests kept in the request logs of an adopted
+// session, and an estimate of the memory they use.
+void get_session_history_size(InfSession* session,
+                              unsigned int& requests,
+                              std::size_t& bytes);
+
+// Returns the number of bytes of text in buffer.
+std::size_t get_text_buffer_size(InfTextBuffer* buffer);
+
+}
+
+#endif // _GOBBY_SESSIONSIZE_HPP_
@@ -48,10 +48,11 @@ class Gobby::StatusBar::Message
 {
 public:
 	Message(Gtk::Widget* widget,
+	        Gtk::Label* label,
 	        const Glib::ustring& simple,
 	        const Glib::ustring& detail,
 		sigc::connection timeout_conn = sigc::connection()):
-		m_widget(widget), m_timeout_conn(timeout_conn),
+		m_widget(widget), m_label(label), m_timeout_conn(timeout_conn),
 		m_simple_desc(simple), m_detail_desc(detail)
 	{
 	}
@@ -94,10 +95,17 @@ public:
 	const Glib::ustring& get_simple_text() const { return m_simple_desc; }
 	const Glib::ustring& get_detail_text() const { return m_detail_desc; }
 
+	void set_simple_text(const Glib::ustring& simple)
+	{
+		m_simple_desc = simple;
+		m_label->set_text(simple);
+	}
+
 	Gtk::Widget* widget() const { return m_widget; }
 
 protected:
 	Gtk::Widget* m_widget;
+	Gtk::Label* m_label;
 	sigc::connection m_timeout_conn;
 	Glib::ustring m_simple_desc;
 	Glib::ustring m_detail_desc;
@@ -213,7 +221,8 @@ Gobby::StatusBar::add_message(Gobby::StatusBar::MessageType type,
 				iter),
 			timeout);
 	}
-	*iter = new Message(frame, message, dialog_message, timeout_conn);
+	*iter = new Message(frame, label, message, dialog_message,
+	                    timeout_conn);
 	++m_visible_messages;
 
 	if(dialog_message.empty())
@@ -290,6 +299,14 @@ Gobby::StatusBar::add_error_message(const Glib::ustring& brief_desc,
 	                              timeout);
 }
 
+void Gobby::StatusBar::update_info_message(const MessageHandle& handle,
+                                           const Glib::ustring& message)
+{
+	// The message might have been hidden in the meanwhile
+	if(*handle != 0)
+		(*handle)->set_simple_text(message);
+}
+
 void Gobby::StatusBar::remove_message(const MessageHandle& handle)
 {
 	hide_message(handle);
@@ -388,55 +405,58 @@ void Gobby::StatusBar::on_mark_set(GtkTextMark* mark)
 		m_current_view->get_text_buffer());
 
 	if(mark == gtk_text_buffer_get_insert(buffer))
-		update_pos_display();
+		queue_pos_display();
 }
 
 void Gobby::StatusBar::on_toggled_overwrite()
 {
-	update_pos_display();
+	queue_pos_display();
 }
 
 void Gobby::StatusBar::on_changed()
 {
-	update_pos_display();
+	queue_pos_display();
 }
 
-void Gobby::StatusBar::update_pos_display()
+void Gobby::StatusBar::queue_pos_display()
 {
-	if(m_current_view != NULL)
+	// Run after pending events have been processed but before the
+	// view is redrawn, which happens at G_PRIORITY_HIGH_IDLE + 20.
+	if(!m_pos_display_connection.connected())
 	{
-		GtkTextBuffer* buffer = GTK_TEXT_BUFFER(
-			m_current_view->get_text_buffer());
-		GtkTextIter iter;
+		m_pos_display_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(*this, &StatusBar::on_pos_display_idle),
+			Glib::PRIORITY_HIGH_IDLE + 15);
+	}
+}
 
-		// TODO: Use TextSessionView::get_cursor_position()?
-		gtk_text_buffer_get_iter_at_mark(
-			buffer, &iter, gtk_text_buffer_get_insert(buffer));
+bool Gobby::StatusBar::on_pos_display_idle()
+{
+	update_pos_display();
+	return false;
+}
 
-		gint offset = gtk_text_iter_get_line_offset(&iter);
+void Gobby::StatusBar::update_pos_display()
+{
+	m_pos_display_connection.disconnect();
 
-		unsigned int column = 0;
-		const unsigned int tab_width = m_preferences.editor.tab_width;
-		for(gtk_text_iter_set_line_offset(&iter, 0);
-		    gtk_text_iter_get_line_offset(&iter) < offset;
-		    gtk_text_iter_forward_char(&iter))
-		{
-			if(gtk_text_iter_get_char(&iter) == '\t')
-				column += (tab_width - column % tab_width);
-			else
-				++ column;
-		}
+	if(m_current_view != NULL)
+	{
+		unsigned int row, column;
+		m_current_view->get_cursor_position(row, column);
 
 		// TODO: We might want to have a separate widget for the
 		// OVR/INS display.
-		m_lbl_position.set_text(
-			Glib::ustring::compose(
-				_("Ln %1, Col %2\t%3"),
-				gtk_text_iter_get_line(&iter) + 1,
-				column + 1,
-				gtk_text_view_get_overwrite(GTK_TEXT_VIEW(m_current_view->get_text_view())) ? _("OVR") : _("INS")
-			)
-		);
+		const Glib::ustring text = Glib::ustring::compose(
+			_("Ln %1, Col %2\t%3"), row + 1, column + 1,
+			gtk_text_view_get_overwrite(
+				GTK_TEXT_VIEW(m_current_view->get_text_view()))
+					? _("OVR") : _("INS"));
+
+		// Remote edits usually don't move the cursor, so avoid
+		// relayouting the status bar if nothing changed.
+		if(m_lbl_position.get_text() != text)
+			m_lbl_position.set_text(text);
 	}
 	else
 	{
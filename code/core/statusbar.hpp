@@ -62,6 +62,11 @@ public:
 	                       const Glib::ustring& detailed_desc,
 	                       unsigned int timeout = 0);
 
+	// Changes the text of a message previously added with
+	// add_info_message(), for example to show progress.
+	void update_info_message(const MessageHandle& handle,
+	                         const Glib::ustring& message);
+
 	void remove_message(const MessageHandle& handle);
 	void hide_message(const MessageHandle& handle);
 
@@ -105,6 +110,11 @@ protected:
 	void on_toggled_overwrite();
 	void on_changed();
 
+	// Schedules update_pos_display() to be called before the next frame
+	// is drawn, so that a burst of changes, for example from remote
+	// users typing, only causes a single update.
+	void queue_pos_display();
+	bool on_pos_display_idle();
 	void update_pos_display();
 
 	const Folder& m_folder;
@@ -117,6 +127,7 @@ protected:
 	gulong m_mark_set_handler;
 	gulong m_changed_handler;
 	gulong m_toverwrite_handler;
+	sigc::connection m_pos_display_connection;
 };
 
 }
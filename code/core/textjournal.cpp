@@ -0,0 +1,681 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/textjournal.hpp"
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-user.h>
+
+#include <glibmm/main.h>
+#include <glib/gstdio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+// A journal starts with a header line naming the SHA-1 checksum of the
+// checkpoint text it applies to. It is followed by records of the form
+//
+//   u <id> <hue> <bytes>\n<name>\n          a user joined
+//   i <pos> <author> <len> <bytes>\n<text>\n text was inserted
+//   e <pos> <len>\n                          text was erased
+//
+// A record that was only partly written when the process died, and
+// everything after it, is dropped on recovery.
+namespace
+{
+	const char HEADER_MAGIC[] = "gobby-journal 1 ";
+
+	// Records are collected for this many seconds before they are
+	// written, so that a burst of typing results in a single write.
+	const unsigned int FLUSH_INTERVAL = 2;
+
+	// A checkpoint is written once the journal is larger than the
+	// document or this size, whichever is larger, so that replaying
+	// the journal never takes much longer than reading the document.
+	const std::size_t MIN_CHECKPOINT_SIZE = 1024 * 1024;
+
+	// ...or when the oldest journaled change is older than this.
+	const gint64 CHECKPOINT_INTERVAL = G_GINT64_CONSTANT(3600) *
+		G_USEC_PER_SEC;
+
+	const char JOURNAL_DATA_KEY[] = "gobby-text-journal";
+
+	std::string journal_root(InfdFilesystemStorage* storage)
+	{
+		gchar* root;
+		g_object_get(G_OBJECT(storage),
+		             "root-directory", &root, NULL);
+		std::string filename(root);
+		g_free(root);
+
+		// Keep the journals out of the root directory, so that the
+		// storage does not see them as documents.
+		while(filename.size() > 1 &&
+		      G_IS_DIR_SEPARATOR(filename[filename.size() - 1]))
+		{
+			filename.erase(filename.size() - 1);
+		}
+
+		return filename + ".journal";
+	}
+
+	std::string journal_filename(InfdFilesystemStorage* storage,
+	                             const gchar* path)
+	{
+		return journal_root(storage) + path + ".journal";
+	}
+
+	void remove_recursive(const std::string& filename)
+	{
+		GDir* dir = g_dir_open(filename.c_str(), 0, NULL);
+		if(dir != NULL)
+		{
+			const gchar* name;
+			while((name = g_dir_read_name(dir)) != NULL)
+			{
+				remove_recursive(
+					filename + G_DIR_SEPARATOR_S + name);
+			}
+
+			g_dir_close(dir);
+		}
+
+		g_remove(filename.c_str());
+	}
+
+	std::string checksum(InfTextBuffer* buffer)
+	{
+		GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA1);
+
+		InfTextBufferIter* iter =
+			inf_text_buffer_create_begin_iter(buffer);
+		if(iter != NULL)
+		{
+			do
+			{
+				gchar* text = inf_text_buffer_iter_get_text(
+					buffer, iter);
+				g_checksum_update(
+					checksum,
+					reinterpret_cast<const guchar*>(text),
+					inf_text_buffer_iter_get_bytes(
+						buffer, iter));
+				g_free(text);
+			} while(inf_text_buffer_iter_next(buffer, iter));
+
+			inf_text_buffer_destroy_iter(buffer, iter);
+		}
+
+		std::string result = g_checksum_get_string(checksum);
+		g_checksum_free(checksum);
+		return result;
+	}
+
+	// Size of the buffer's content in bytes. The buffer only knows
+	// its length in characters.
+	std::size_t byte_size(InfTextBuffer* buffer)
+	{
+		std::size_t bytes = 0;
+
+		InfTextBufferIter* iter =
+			inf_text_buffer_create_begin_iter(buffer);
+		if(iter != NULL)
+		{
+			do
+			{
+				bytes += inf_text_buffer_iter_get_bytes(
+					buffer, iter);
+			} while(inf_text_buffer_iter_next(buffer, iter));
+
+			inf_text_buffer_destroy_iter(buffer, iter);
+		}
+
+		return bytes;
+	}
+
+	std::size_t byte_size(InfTextChunk* chunk)
+	{
+		std::size_t bytes = 0;
+
+		InfTextChunkIter iter;
+		if(inf_text_chunk_iter_init_begin(chunk, &iter))
+		{
+			do
+			{
+				bytes += inf_text_chunk_iter_get_bytes(&iter);
+			} while(inf_text_chunk_iter_next(&iter));
+		}
+
+		return bytes;
+	}
+
+	std::string make_header(const std::string& base)
+	{
+		return HEADER_MAGIC + base + "\n";
+	}
+
+	void set_errno_error(GError** error, int code,
+	                     const std::string& filename)
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(code),
+		            "Failed to write journal \"%s\": %s",
+		            filename.c_str(), g_strerror(code));
+	}
+
+	// Splits the next line into space-separated fields.
+	bool read_fields(const gchar*& pos, const gchar* end,
+	                 std::vector<std::string>& fields)
+	{
+		const gchar* newline = static_cast<const gchar*>(
+			memchr(pos, '\n', end - pos));
+		if(newline == NULL) return false;
+
+		fields.clear();
+		while(pos < newline)
+		{
+			const gchar* space = std::find(pos, newline, ' ');
+			fields.push_back(std::string(pos, space));
+			pos = (space == newline) ? newline : space + 1;
+		}
+
+		pos = newline + 1;
+		return true;
+	}
+
+	// Reads bytes bytes of data, followed by a newline.
+	bool read_data(const gchar*& pos, const gchar* end,
+	               guint64 bytes, const gchar*& data)
+	{
+		if(static_cast<guint64>(end - pos) < bytes + 1) return false;
+		if(pos[bytes] != '\n') return false;
+
+		data = pos;
+		pos += bytes + 1;
+		return true;
+	}
+
+	bool parse_uint(const std::string& str, guint64& value)
+	{
+		if(str.empty() || !g_ascii_isdigit(str[0])) return false;
+
+		gchar* endptr;
+		value = g_ascii_strtoull(str.c_str(), &endptr, 10);
+		return *endptr == '\0';
+	}
+
+	// Applies the next record. Returns false if the record is
+	// incomplete or does not fit the buffer, in which case nothing is
+	// changed.
+	bool replay_record(const gchar*& pos, const gchar* end,
+	                   InfUserTable* user_table, InfTextBuffer* buffer)
+	{
+		std::vector<std::string> fields;
+		if(!read_fields(pos, end, fields) || fields.empty())
+			return false;
+
+		const guint length = inf_text_buffer_get_length(buffer);
+
+		if(fields[0] == "i" && fields.size() == 5)
+		{
+			guint64 offset, author, len, bytes;
+			const gchar* text;
+			if(!parse_uint(fields[1], offset) ||
+			   !parse_uint(fields[2], author) ||
+			   !parse_uint(fields[3], len) ||
+			   !parse_uint(fields[4], bytes) ||
+			   !read_data(pos, end, bytes, text))
+			{
+				return false;
+			}
+
+			if(offset > length) return false;
+			if(!g_utf8_validate(text, bytes, NULL)) return false;
+			if(g_utf8_strlen(text, bytes) !=
+			   static_cast<glong>(len))
+			{
+				return false;
+			}
+
+			InfUser* user = NULL;
+			if(author != 0)
+			{
+				user = inf_user_table_lookup_user_by_id(
+					user_table, author);
+			}
+
+			inf_text_buffer_insert_text(
+				buffer, offset, text, bytes, len, user);
+			return true;
+		}
+		else if(fields[0] == "e" && fields.size() == 3)
+		{
+			guint64 offset, len;
+			if(!parse_uint(fields[1], offset) ||
+			   !parse_uint(fields[2], len))
+			{
+				return false;
+			}
+
+			if(offset > length || len > length - offset)
+				return false;
+
+			inf_text_buffer_erase_text(buffer, offset, len, NULL);
+			return true;
+		}
+		else if(fields[0] == "u" && fields.size() == 4)
+		{
+			guint64 id, bytes;
+			const gchar* name;
+			if(!parse_uint(fields[1], id) ||
+			   !parse_uint(fields[3], bytes) ||
+			   !read_data(pos, end, bytes, name))
+			{
+				return false;
+			}
+
+			const gdouble hue =
+				g_ascii_strtod(fields[2].c_str(), NULL);
+
+			if(inf_user_table_lookup_user_by_id(
+				user_table, id) == NULL)
+			{
+				const std::string name_str(name, bytes);
+				InfUser* user = INF_USER(g_object_new(
+					INF_TEXT_TYPE_USER,
+					"id", static_cast<guint>(id),
+					"name", name_str.c_str(),
+					"hue", hue,
+					static_cast<void*>(NULL)));
+				inf_user_table_add_user(user_table, user);
+				g_object_unref(user);
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+}
+
+Gobby::TextJournal::TextJournal(InfdFilesystemStorage* storage,
+                                const gchar* path):
+	m_storage(storage), m_path(path),
+	m_filename(journal_filename(storage, path)),
+	m_user_table(NULL), m_buffer(NULL), m_buffer_size(0),
+	m_text_inserted_handler(0), m_text_erased_handler(0),
+	m_add_user_handler(0), m_file(NULL), m_size(0),
+	m_checkpoint_time(g_get_monotonic_time()), m_discarded(false)
+{
+	g_object_ref(m_storage);
+}
+
+Gobby::TextJournal::~TextJournal()
+{
+	m_flush_timeout.disconnect();
+
+	if(m_buffer != NULL)
+	{
+		// The session has been written by the directory already if
+		// it wanted to keep it, so only make sure that the last
+		// changes are not lost.
+		GError* error = NULL;
+		if(!write_pending(&error))
+		{
+			g_warning("%s", error->message);
+			g_error_free(error);
+		}
+
+		g_signal_handler_disconnect(m_buffer,
+		                            m_text_inserted_handler);
+		g_signal_handler_disconnect(m_buffer, m_text_erased_handler);
+		g_signal_handler_disconnect(m_user_table, m_add_user_handler);
+
+		g_object_unref(m_buffer);
+		g_object_unref(m_user_table);
+	}
+
+	close_file();
+	g_object_unref(m_storage);
+}
+
+bool Gobby::TextJournal::recover(InfUserTable* user_table,
+                                 InfTextBuffer* buffer,
+                                 GError** error)
+{
+	m_base = checksum(buffer);
+	m_size = 0;
+
+	gchar* content;
+	gsize length;
+	if(!g_file_get_contents(m_filename.c_str(), &content, &length, NULL))
+		return true;
+
+	const std::string header = make_header(m_base);
+	if(length < header.size() ||
+	   header.compare(0, header.size(), content, header.size()) != 0)
+	{
+		// The journal belongs to an older or newer version of the
+		// document; start over once there is something to record.
+		g_free(content);
+		return true;
+	}
+
+	const gchar* pos = content + header.size();
+	const gchar* end = content + length;
+	while(pos != end)
+	{
+		if(!replay_record(pos, end, user_table, buffer))
+			break;
+	}
+
+	m_size = pos - content;
+	if(pos != end)
+	{
+		g_warning("Discarding %lu bytes at the end of the "
+		          "journal \"%s\"",
+		          static_cast<unsigned long>(end - pos),
+		          m_filename.c_str());
+
+		// Cut off the damaged tail so that new records can be
+		// appended safely.
+		if(!g_file_set_contents(m_filename.c_str(), content, m_size,
+		                        error))
+		{
+			g_free(content);
+			return false;
+		}
+	}
+
+	g_free(content);
+	return true;
+}
+
+void Gobby::TextJournal::attach(InfSession* session)
+{
+	g_assert(m_buffer == NULL);
+
+	m_user_table = inf_session_get_user_table(session);
+	m_buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
+	g_object_ref(m_user_table);
+	g_object_ref(m_buffer);
+	m_buffer_size = byte_size(m_buffer);
+
+	m_text_inserted_handler = g_signal_connect_after(
+		G_OBJECT(m_buffer), "text-inserted",
+		G_CALLBACK(on_text_inserted_static), this);
+	m_text_erased_handler = g_signal_connect_after(
+		G_OBJECT(m_buffer), "text-erased",
+		G_CALLBACK(on_text_erased_static), this);
+	m_add_user_handler = g_signal_connect_after(
+		G_OBJECT(m_user_table), "add-user",
+		G_CALLBACK(on_add_user_static), this);
+
+	g_object_set_data_full(G_OBJECT(session), JOURNAL_DATA_KEY, this,
+	                       destroy_static);
+}
+
+Gobby::TextJournal* Gobby::TextJournal::get(InfSession* session)
+{
+	return static_cast<TextJournal*>(
+		g_object_get_data(G_OBJECT(session), JOURNAL_DATA_KEY));
+}
+
+bool Gobby::TextJournal::flush(GError** error)
+{
+	if(m_discarded)
+		return true;
+
+	if(!write_pending(error))
+		return false;
+
+	if(m_buffer == NULL)
+		return true;
+
+	const std::size_t header_size = make_header(m_base).size();
+	const std::size_t limit = std::max<std::size_t>(
+		MIN_CHECKPOINT_SIZE, m_buffer_size);
+
+	if(m_size > limit ||
+	   (m_size > header_size &&
+	    g_get_monotonic_time() - m_checkpoint_time > CHECKPOINT_INTERVAL))
+	{
+		return checkpoint(error);
+	}
+
+	return true;
+}
+
+bool Gobby::TextJournal::write_pending(GError** error)
+{
+	m_flush_timeout.disconnect();
+
+	if(!m_pending.empty())
+	{
+		if(m_file == NULL)
+		{
+			if(m_size == 0)
+			{
+				if(!write_header(error))
+					return false;
+			}
+			else
+			{
+				m_file = g_fopen(m_filename.c_str(), "ab");
+				if(m_file == NULL)
+				{
+					set_errno_error(error, errno,
+					                m_filename);
+					return false;
+				}
+			}
+		}
+
+		if(std::fwrite(m_pending.data(), 1, m_pending.size(),
+		               m_file) != m_pending.size() ||
+		   std::fflush(m_file) != 0)
+		{
+			set_errno_error(error, errno, m_filename);
+			close_file();
+			return false;
+		}
+
+		m_size += m_pending.size();
+		m_pending.clear();
+	}
+
+	return true;
+}
+
+bool Gobby::TextJournal::checkpoint(GError** error)
+{
+	g_assert(m_buffer != NULL);
+
+	m_flush_timeout.disconnect();
+
+	if(!inf_text_filesystem_format_write(m_storage, m_path.c_str(),
+	                                     m_user_table, m_buffer, error))
+	{
+		return false;
+	}
+
+	// The document now contains all changes, so the journal can start
+	// over. If we die before the new header is written, the checksum
+	// of the old journal no longer matches and it is ignored.
+	m_pending.clear();
+	close_file();
+
+	m_base = checksum(m_buffer);
+	m_checkpoint_time = g_get_monotonic_time();
+	m_size = 0;
+
+	return write_header(error);
+}
+
+void Gobby::TextJournal::discard()
+{
+	m_flush_timeout.disconnect();
+	m_pending.clear();
+	close_file();
+	m_discarded = true;
+}
+
+void Gobby::TextJournal::remove(InfdFilesystemStorage* storage,
+                                const gchar* path)
+{
+	g_unlink(journal_filename(storage, path).c_str());
+}
+
+void Gobby::TextJournal::remove_directory(InfdFilesystemStorage* storage,
+                                          const gchar* path)
+{
+	// The root directory itself cannot be removed
+	if(path[0] == '\0' || strcmp(path, "/") == 0)
+		return;
+
+	remove_recursive(journal_root(storage) + path);
+}
+
+void Gobby::TextJournal::on_text_inserted(guint pos, InfTextChunk* chunk)
+{
+	InfTextChunkIter iter;
+	if(!inf_text_chunk_iter_init_begin(chunk, &iter))
+		return;
+
+	do
+	{
+		const gsize bytes = inf_text_chunk_iter_get_bytes(&iter);
+		m_buffer_size += bytes;
+
+		const guint length = inf_text_chunk_iter_get_length(&iter);
+
+		gchar* head = g_strdup_printf(
+			"i %u %u %u %lu\n", pos,
+			inf_text_chunk_iter_get_author(&iter), length,
+			static_cast<unsigned long>(bytes));
+
+		std::string record(head);
+		g_free(head);
+
+		record.append(static_cast<const gchar*>(
+			inf_text_chunk_iter_get_text(&iter)), bytes);
+		record += '\n';
+		append(record);
+
+		pos += length;
+	} while(inf_text_chunk_iter_next(&iter));
+}
+
+void Gobby::TextJournal::on_text_erased(guint pos, InfTextChunk* chunk)
+{
+	m_buffer_size -= byte_size(chunk);
+
+	gchar* record = g_strdup_printf(
+		"e %u %u\n", pos, inf_text_chunk_get_length(chunk));
+	append(record);
+	g_free(record);
+}
+
+void Gobby::TextJournal::on_add_user(InfUser* user)
+{
+	if(!INF_TEXT_IS_USER(user))
+		return;
+
+	gchar hue[G_ASCII_DTOSTR_BUF_SIZE];
+	g_ascii_dtostr(hue, sizeof(hue),
+	               inf_text_user_get_hue(INF_TEXT_USER(user)));
+
+	const gchar* name = inf_user_get_name(user);
+	gchar* head = g_strdup_printf(
+		"u %u %s %lu\n", inf_user_get_id(user), hue,
+		static_cast<unsigned long>(strlen(name)));
+
+	std::string record(head);
+	g_free(head);
+
+	record += name;
+	record += '\n';
+	append(record);
+}
+
+void Gobby::TextJournal::append(const std::string& record)
+{
+	if(m_discarded) return;
+
+	m_pending += record;
+
+	if(!m_flush_timeout.connected())
+	{
+		m_flush_timeout = Glib::signal_timeout().connect_seconds(
+			sigc::mem_fun(*this, &TextJournal::on_flush_timeout),
+			FLUSH_INTERVAL);
+	}
+}
+
+bool Gobby::TextJournal::on_flush_timeout()
+{
+	GError* error = NULL;
+	if(!flush(&error))
+	{
+		g_warning("%s", error->message);
+		g_error_free(error);
+	}
+
+	return false;
+}
+
+bool Gobby::TextJournal::write_header(GError** error)
+{
+	gchar* dirname = g_path_get_dirname(m_filename.c_str());
+	const int result = g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+
+	if(result != 0)
+	{
+		set_errno_error(error, errno, m_filename);
+		return false;
+	}
+
+	close_file();
+	m_file = g_fopen(m_filename.c_str(), "wb");
+	if(m_file == NULL)
+	{
+		set_errno_error(error, errno, m_filename);
+		return false;
+	}
+
+	const std::string header = make_header(m_base);
+	if(std::fwrite(header.data(), 1, header.size(), m_file) !=
+	   header.size() || std::fflush(m_file) != 0)
+	{
+		set_errno_error(error, errno, m_filename);
+		close_file();
+		return false;
+	}
+
+	m_size = header.size();
+	return true;
+}
+
+void Gobby::TextJournal::close_file()
+{
+	if(m_file != NULL)
+	{
+		std::fclose(m_file);
+		m_file = NULL;
+	}
+}
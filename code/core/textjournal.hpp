@@ -0,0 +1,152 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_TEXTJOURNAL_HPP_
+#define _GOBBY_TEXTJOURNAL_HPP_
+
+#include <libinftext/inf-text-buffer.h>
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-session.h>
+
+#include <sigc++/connection.h>
+
+#include <cstdio>
+#include <string>
+
+namespace Gobby
+{
+
+// Keeps a journal of the changes made to a text document that is stored in
+// an InfdFilesystemStorage. Instead of rewriting the whole document on
+// every save, changes are appended to the journal, and the document itself
+// (the checkpoint) is only rewritten once the journal has grown large or
+// old. When the document is read again, the journal is replayed on top of
+// the checkpoint.
+//
+// Journals live in a directory next to the storage's root directory, so
+// the storage itself looks the same with and without journaling.
+class TextJournal
+{
+public:
+	TextJournal(InfdFilesystemStorage* storage, const gchar* path);
+	~TextJournal();
+
+	// Applies the journaled changes to the document at path, which has
+	// just been read into user_table and buffer. A journal that was
+	// written for a different version of the document is ignored.
+	bool recover(InfUserTable* user_table, InfTextBuffer* buffer,
+	             GError** error);
+
+	// Starts recording the changes made to session. The session owns the
+	// journal from then on.
+	void attach(InfSession* session);
+
+	// Returns the journal attached to session, or NULL.
+	static TextJournal* get(InfSession* session);
+
+	// Appends the changes recorded so far to the journal, and writes a
+	// checkpoint if the journal has grown too large or old.
+	bool flush(GError** error);
+
+	// Writes the whole document and starts a new, empty journal.
+	bool checkpoint(GError** error);
+
+	// Stops writing to the journal, and drops the changes that have not
+	// been written yet. For when the document is removed, so that the
+	// journal is not created again when the session goes away.
+	void discard();
+
+	// Removes the journal of the document at path. Must be called when
+	// the document is written without journaling, or removed.
+	static void remove(InfdFilesystemStorage* storage, const gchar* path);
+
+	// Removes the journals of all documents below the subdirectory at
+	// path. Must be called when the subdirectory is removed.
+	static void remove_directory(InfdFilesystemStorage* storage,
+	                             const gchar* path);
+
+protected:
+	static void on_text_inserted_static(InfTextBuffer* buffer,
+	                                    guint pos,
+	                                    InfTextChunk* chunk,
+	                                    InfUser* user,
+	                                    gpointer user_data)
+	{
+		static_cast<TextJournal*>(user_data)->on_text_inserted(
+			pos, chunk);
+	}
+
+	static void on_text_erased_static(InfTextBuffer* buffer,
+	                                  guint pos,
+	                                  InfTextChunk* chunk,
+	                                  InfUser* user,
+	                                  gpointer user_data)
+	{
+		static_cast<TextJournal*>(user_data)->on_text_erased(
+			pos, chunk);
+	}
+
+	static void on_add_user_static(InfUserTable* user_table,
+	                               InfUser* user,
+	                               gpointer user_data)
+	{
+		static_cast<TextJournal*>(user_data)->on_add_user(user);
+	}
+
+	static void destroy_static(gpointer data)
+	{
+		delete static_cast<TextJournal*>(data);
+	}
+
+	void on_text_inserted(guint pos, InfTextChunk* chunk);
+	void on_text_erased(guint pos, InfTextChunk* chunk);
+	void on_add_user(InfUser* user);
+
+	void append(const std::string& record);
+	bool write_pending(GError** error);
+	bool on_flush_timeout();
+
+	bool write_header(GError** error);
+	void close_file();
+
+	InfdFilesystemStorage* m_storage;
+	const std::string m_path;
+	const std::string m_filename;
+
+	InfUserTable* m_user_table;
+	InfTextBuffer* m_buffer;
+	// Size of m_buffer's content in bytes, to compare with m_size
+	std::size_t m_buffer_size;
+	gulong m_text_inserted_handler;
+	gulong m_text_erased_handler;
+	gulong m_add_user_handler;
+
+	// Checksum of the checkpoint that the journal applies to
+	std::string m_base;
+
+	std::FILE* m_file;
+	std::size_t m_size;
+	gint64 m_checkpoint_time;
+
+	std::string m_pending;
+	sigc::connection m_flush_timeout;
+	bool m_discarded;
+};
+
+}
+
+#endif // _GOBBY_TEXTJOURNAL_HPP_
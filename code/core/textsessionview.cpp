@@ -16,11 +16,12 @@
 
 #include "core/gobject/gobby-undo-manager.h"
 #include "core/textsessionview.hpp"
+#include "core/sessionsize.hpp"
 #include "util/i18n.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <glibmm/main.h>
 #include <glibmm/markup.h>
-#include <glibmm/pattern.h>
 #include <gtkmm/scrolledwindow.h>
 #include <gtkmm/textiter.h>
 
@@ -28,6 +29,9 @@
 
 #include <libinftextgtk/inf-text-gtk-buffer.h>
 
+#include <algorithm>
+#include <cstring>
+
 // TODO: Put all the preferences handling into an extra class
 namespace
 {
@@ -37,60 +41,10 @@ namespace
 			static_cast<Gtk::WrapMode>(pref.view.wrap_mode));
 	}
 
-	bool glob_matches(const gchar* const* globs, const std::string& str)
-	{
-		if(globs)
-		{
-			for(const gchar* const* glob = globs;
-			    *glob != NULL;
-			    ++ glob)
-			{
-				Glib::PatternSpec spec(*glob);
-				if(spec.match(str))
-					return true;
-			}
-		}
-
-		return false;
-	}
-
-	bool language_matches_title(GtkSourceLanguage* language,
-	                            const gchar* title)
-	{
-		bool result = false;
-		gchar** globs = gtk_source_language_get_globs(language);
-		if(glob_matches(globs, title))
-			result = true;
-		g_strfreev(globs);
-		return result;
-	}
-
-	GtkSourceLanguage*
-	get_language_for_title(GtkSourceLanguageManager* manager,
-	                       const gchar* title)
-	{
-		const gchar* const* ids =
-			gtk_source_language_manager_get_language_ids(manager);
-
-		if(ids)
-		{
-			for(const gchar* const* id = ids; *id != NULL; ++ id)
-			{
-				GtkSourceLanguage* l;
-				l = gtk_source_language_manager_get_language(
-					manager, *id);
-
-				if(l)
-					if(language_matches_title(l, title))
-						return l;
-			}
-		}
-
-		return NULL;
-	}
-
 	bool tags_priority_idle_func(Gobby::TextSessionView& view)
 	{
+		Gobby::StallProfiler::Scope profile("tags_priority_idle_func");
+
 		InfTextGtkBuffer* buffer = INF_TEXT_GTK_BUFFER(
 			inf_session_get_buffer(
 				INF_SESSION(view.get_session())));
@@ -124,10 +78,11 @@ Gobby::TextSessionView::TextSessionView(InfTextSession* session,
                                         const Glib::ustring& hostname,
                                         const std::string& info_storage_key,
                                         Preferences& preferences,
-                                        GtkSourceLanguageManager* manager):
+                                        const LanguageIndex& language_index):
 	SessionView(INF_SESSION(session), title, path, hostname),
 	m_info_storage_key(info_storage_key), m_preferences(preferences),
-	m_view(GTK_SOURCE_VIEW(gtk_source_view_new()))
+	m_language_index(language_index), m_detect_language(false),
+	m_view(GTK_SOURCE_VIEW(gtk_source_view_new())), m_highlighted(0)
 {
 	InfBuffer* buffer = inf_session_get_buffer(INF_SESSION(session));
 	InfUserTable* user_table =
@@ -170,7 +125,23 @@ Gobby::TextSessionView::TextSessionView(InfTextSession* session,
 	gtk_text_view_set_buffer(GTK_TEXT_VIEW(m_view),
 	                         GTK_TEXT_BUFFER(m_buffer));
 	gtk_text_view_set_editable(GTK_TEXT_VIEW(m_view), FALSE);
-	set_language(get_language_for_title(manager, title.c_str()));
+
+	m_insert_text_handler = g_signal_connect_after(
+		G_OBJECT(m_buffer), "insert-text",
+		G_CALLBACK(on_insert_text_static), this);
+	m_delete_range_handler = g_signal_connect_after(
+		G_OBJECT(m_buffer), "delete-range",
+		G_CALLBACK(on_delete_range_static), this);
+	m_notify_status_handler = g_signal_connect(
+		G_OBJECT(m_session), "notify::status",
+		G_CALLBACK(on_notify_status_static), this);
+
+	GtkSourceLanguage* language =
+		m_language_index.get_language_for_title(title);
+	set_language(language);
+	// Look at the content once it is available if the title does not
+	// tell which language the document is in.
+	m_detect_language = (language == NULL);
 
 	m_preferences.user.hue.signal_changed().connect(
 		sigc::mem_fun(
@@ -227,6 +198,10 @@ Gobby::TextSessionView::TextSessionView(InfTextSession* session,
 		sigc::mem_fun(
 			*this,
 			&TextSessionView::on_whitespace_display_changed));
+	m_preferences.view.highlight_size_limit.signal_changed().connect(
+		sigc::mem_fun(
+			*this,
+			&TextSessionView::on_highlight_size_limit_changed));
 	m_preferences.appearance.font.signal_changed().connect(
 		sigc::mem_fun(*this, &TextSessionView::on_font_changed));
 	m_preferences.appearance.scheme_id.signal_changed().connect(
@@ -290,10 +265,21 @@ Gobby::TextSessionView::TextSessionView(InfTextSession* session,
 
 	// Set initial font
 	on_font_changed();
+
+	if(inf_session_get_status(m_session) == INF_SESSION_RUNNING)
+		detect_language();
 }
 
 Gobby::TextSessionView::~TextSessionView()
 {
+	m_highlight_connection.disconnect();
+
+	// The buffer and the session outlive the view if the document
+	// is only closed but still subscribed to.
+	g_signal_handler_disconnect(m_buffer, m_insert_text_handler);
+	g_signal_handler_disconnect(m_buffer, m_delete_range_handler);
+	g_signal_handler_disconnect(m_session, m_notify_status_handler);
+
 	g_object_unref(m_infview);
 	g_object_unref(m_infviewport);
 }
@@ -311,25 +297,30 @@ void Gobby::TextSessionView::get_cursor_position(unsigned int& row,
 	row = gtk_text_iter_get_line(&iter);
 	col = 0;
 
-	int chars = gtk_text_iter_get_line_offset(&iter);
-	unsigned int tabs = m_preferences.editor.tab_width;
+	// Look at the text before the cursor in one go instead of stepping
+	// through it with the iterator, which is a lot slower for long
+	// lines. Tab characters expand to more than one column.
+	GtkTextIter line_start = iter;
+	gtk_text_iter_set_line_offset(&line_start, 0);
+	gchar* text = gtk_text_buffer_get_slice(
+		GTK_TEXT_BUFFER(m_buffer), &line_start, &iter, TRUE);
 
-	// Tab characters expand to more than one column
-	for(gtk_text_iter_set_line_offset(&iter, 0);
-	    gtk_text_iter_get_line_offset(&iter) < chars;
-	    gtk_text_iter_forward_char(&iter))
+	const unsigned int tabs = m_preferences.editor.tab_width;
+	for(const gchar* pos = text; *pos != '\0'; pos = g_utf8_next_char(pos))
 	{
-		unsigned int width = 1;
-		if(gtk_text_iter_get_char(&iter) == '\t')
-		{
-			unsigned int offset =
-				gtk_text_iter_get_line_offset(&iter);
-			width = (tabs - offset % tabs) % tabs;
-			if(width == 0) width = tabs;
-		}
-
-		col += width;
+		if(*pos == '\t')
+			col += tabs - col % tabs;
+		else
+			++col;
 	}
+
+	g_free(text);
+}
+
+void Gobby::TextSessionView::get_history_size(unsigned int& requests,
+                                              std::size_t& bytes) const
+{
+	get_session_history_size(INF_SESSION(m_session), requests, bytes);
 }
 
 void Gobby::TextSessionView::set_selection(const GtkTextIter* begin,
@@ -425,10 +416,155 @@ GtkSourceLanguage* Gobby::TextSessionView::get_language() const
 
 void Gobby::TextSessionView::set_language(GtkSourceLanguage* language)
 {
+	m_detect_language = false;
 	gtk_source_buffer_set_language(m_buffer, language);
+	update_highlighting(true);
 	m_signal_language_changed.emit(language);
 }
 
+double Gobby::TextSessionView::get_highlight_progress() const
+{
+	if(!m_highlight_connection.connected())
+		return 1.0;
+
+	const gint count =
+		gtk_text_buffer_get_char_count(GTK_TEXT_BUFFER(m_buffer));
+	if(count == 0)
+		return 1.0;
+
+	return std::min(1.0, static_cast<double>(m_highlighted) / count);
+}
+
+void Gobby::TextSessionView::on_insert_text(const GtkTextIter* location,
+                                            const gchar* text, gint len)
+{
+	if(m_highlight_connection.connected())
+	{
+		// location points behind the inserted text. Highlighting
+		// needs to be redone from where the text was inserted.
+		const gint offset = gtk_text_iter_get_offset(location) -
+			g_utf8_strlen(text, len);
+		m_highlighted = std::min(m_highlighted, offset);
+	}
+
+	update_highlighting(false);
+}
+
+void Gobby::TextSessionView::on_delete_range(const GtkTextIter* begin)
+{
+	if(m_highlight_connection.connected())
+	{
+		m_highlighted = std::min(m_highlighted,
+		                         gtk_text_iter_get_offset(begin));
+	}
+
+	update_highlighting(false);
+}
+
+void Gobby::TextSessionView::on_notify_status()
+{
+	if(inf_session_get_status(m_session) == INF_SESSION_RUNNING)
+	{
+		detect_language();
+		// Highlight the synchronized text in the background
+		update_highlighting(true);
+	}
+}
+
+void Gobby::TextSessionView::detect_language()
+{
+	if(!m_detect_language)
+		return;
+
+	m_detect_language = false;
+
+	GtkTextIter begin, end;
+	gtk_text_buffer_get_start_iter(GTK_TEXT_BUFFER(m_buffer), &begin);
+	gtk_text_buffer_get_iter_at_offset(
+		GTK_TEXT_BUFFER(m_buffer), &end, DETECT_LANGUAGE_CHARS);
+	if(gtk_text_iter_equal(&begin, &end))
+		return;
+
+	gchar* text = gtk_text_buffer_get_slice(
+		GTK_TEXT_BUFFER(m_buffer), &begin, &end, TRUE);
+	GtkSourceLanguage* language =
+		m_language_index.get_language_for_content(text, strlen(text));
+	g_free(text);
+
+	if(language != NULL)
+		set_language(language);
+}
+
+void Gobby::TextSessionView::update_highlighting(bool restart)
+{
+	const unsigned int limit = m_preferences.view.highlight_size_limit;
+	const unsigned int count =
+		gtk_text_buffer_get_char_count(GTK_TEXT_BUFFER(m_buffer));
+
+	const bool enable = (limit == 0 || count <= limit);
+	if(enable != static_cast<bool>(
+		gtk_source_buffer_get_highlight_syntax(m_buffer)))
+	{
+		gtk_source_buffer_set_highlight_syntax(m_buffer, enable);
+		restart = true;
+	}
+
+	if(!restart)
+		return;
+
+	// GtkSourceView highlights the visible part of the document by
+	// itself when it is drawn. Do the rest in the background, in short
+	// slices, so that scrolling through the document later does not
+	// stall, and so that the progress can be shown.
+	m_highlighted = 0;
+	if(enable && get_language() != NULL &&
+	   inf_session_get_status(m_session) == INF_SESSION_RUNNING)
+	{
+		if(!m_highlight_connection.connected())
+		{
+			m_highlight_connection = Glib::signal_idle().connect(
+				sigc::mem_fun(
+					*this,
+					&TextSessionView::on_highlight_idle),
+				Glib::PRIORITY_LOW);
+		}
+	}
+	else
+	{
+		m_highlight_connection.disconnect();
+	}
+
+	m_signal_highlight_progress.emit();
+}
+
+bool Gobby::TextSessionView::on_highlight_idle()
+{
+	StallProfiler::Scope profile("TextSessionView::on_highlight_idle");
+
+	const gint64 deadline = g_get_monotonic_time() + HIGHLIGHT_SLICE_TIME;
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(m_buffer);
+
+	GtkTextIter begin, end;
+	gtk_text_buffer_get_iter_at_offset(buffer, &begin, m_highlighted);
+
+	do
+	{
+		end = begin;
+		gtk_text_iter_forward_lines(&end, HIGHLIGHT_LINES);
+		gtk_source_buffer_ensure_highlight(m_buffer, &begin, &end);
+		begin = end;
+	} while(!gtk_text_iter_is_end(&begin) &&
+	        g_get_monotonic_time() < deadline);
+
+	m_highlighted = gtk_text_iter_get_offset(&begin);
+
+	const bool done = gtk_text_iter_is_end(&begin);
+	if(done) m_highlight_connection.disconnect();
+
+	m_signal_highlight_progress.emit();
+	return !done;
+}
+
 void Gobby::TextSessionView::on_user_color_changed()
 {
 	InfTextUser* user = INF_TEXT_USER(get_active_user());
@@ -559,6 +695,11 @@ void Gobby::TextSessionView::on_whitespace_display_changed()
 	gtk_source_space_drawer_set_enable_matrix(space_drawer, true);
 }
 
+void Gobby::TextSessionView::on_highlight_size_limit_changed()
+{
+	update_highlighting(false);
+}
+
 void Gobby::TextSessionView::on_font_changed()
 {
 	const Pango::FontDescription& desc = m_preferences.appearance.font;
@@ -19,6 +19,7 @@
 
 #include "core/sessionview.hpp"
 #include "core/textundogrouping.hpp"
+#include "core/languageindex.hpp"
 #include "core/preferences.hpp"
 
 #include <gtkmm/tooltip.h>
@@ -38,13 +39,14 @@ class TextSessionView: public SessionView
 {
 public:
 	typedef sigc::signal<void, GtkSourceLanguage*> SignalLanguageChanged;
+	typedef sigc::signal<void> SignalHighlightProgress;
 
 	TextSessionView(InfTextSession* session, const Glib::ustring& title,
 	                const Glib::ustring& path,
 	                const Glib::ustring& hostname,
 	                const std::string& info_storage_key,
 	                Preferences& preferences,
-	                GtkSourceLanguageManager* manager);
+	                const LanguageIndex& language_index);
 	~TextSessionView();
 
 	InfTextSession* get_session() { return INF_TEXT_SESSION(m_session); }
@@ -71,15 +73,77 @@ public:
 	// requires active user to be set:
 	TextUndoGrouping& get_undo_grouping() { return *m_undo_grouping; }
 
+	// Returns the number of requests kept in the session's history, and
+	// an estimate of the memory they use. Requires the session to be
+	// running.
+	void get_history_size(unsigned int& requests,
+	                      std::size_t& bytes) const;
+
 	GtkSourceView* get_text_view() { return m_view; }
 	GtkSourceBuffer* get_text_buffer() { return m_buffer; }
 
+	// Syntax highlighting is computed for the whole document in the
+	// background after it has been opened or its language has changed.
+	// This returns how much of that is done, between 0.0 and 1.0.
+	double get_highlight_progress() const;
+
 	SignalLanguageChanged signal_language_changed() const
 	{
 		return m_signal_language_changed;
 	}
 
+	SignalHighlightProgress signal_highlight_progress() const
+	{
+		return m_signal_highlight_progress;
+	}
+
 protected:
+	// Time to spend on syntax highlighting per main loop iteration
+	static const gint64 HIGHLIGHT_SLICE_TIME = 8000; // microseconds
+	// Number of lines to highlight at once within a slice
+	static const gint HIGHLIGHT_LINES = 500;
+	// How much of a document to look at to guess its language
+	static const gint DETECT_LANGUAGE_CHARS = 4096;
+
+	static void on_insert_text_static(GtkTextBuffer* buffer,
+	                                  GtkTextIter* location,
+	                                  gchar* text,
+	                                  gint len,
+	                                  gpointer user_data)
+	{
+		static_cast<TextSessionView*>(user_data)->on_insert_text(
+			location, text, len);
+	}
+
+	static void on_delete_range_static(GtkTextBuffer* buffer,
+	                                   GtkTextIter* begin,
+	                                   GtkTextIter* end,
+	                                   gpointer user_data)
+	{
+		static_cast<TextSessionView*>(user_data)->on_delete_range(
+			begin);
+	}
+
+	static void on_notify_status_static(GObject* object,
+	                                    GParamSpec* pspec,
+	                                    gpointer user_data)
+	{
+		static_cast<TextSessionView*>(user_data)->on_notify_status();
+	}
+
+	void on_insert_text(const GtkTextIter* location,
+	                    const gchar* text, gint len);
+	void on_delete_range(const GtkTextIter* begin);
+	void on_notify_status();
+	void detect_language();
+
+	// Turns syntax highlighting off if the document exceeds the size
+	// limit, and on again if it does not anymore. If restart is true, or
+	// highlighting has just been turned on, the background highlighting
+	// starts over from the beginning of the document.
+	void update_highlighting(bool restart);
+	bool on_highlight_idle();
+
 	void on_user_color_changed();
 	void on_alpha_changed();
 
@@ -100,6 +164,7 @@ protected:
 	void on_margin_pos_changed();
 	void on_bracket_highlight_changed();
 	void on_whitespace_display_changed();
+	void on_highlight_size_limit_changed();
 
 	void on_font_changed();
 	void on_scheme_changed();
@@ -128,6 +193,8 @@ protected:
 
 	std::string m_info_storage_key;
 	Preferences& m_preferences;
+	const LanguageIndex& m_language_index;
+	bool m_detect_language;
 	Glib::RefPtr<Gtk::CssProvider> m_font_provider;
 
 	GtkSourceView* m_view;
@@ -136,7 +203,17 @@ protected:
 	InfTextGtkView* m_infview;
 	InfTextGtkViewport* m_infviewport;
 
+	gulong m_insert_text_handler;
+	gulong m_delete_range_handler;
+	gulong m_notify_status_handler;
+
+	// Offset up to which the document has been highlighted in the
+	// background, while m_highlight_connection is connected.
+	sigc::connection m_highlight_connection;
+	gint m_highlighted;
+
 	SignalLanguageChanged m_signal_language_changed;
+	SignalHighlightProgress m_signal_highlight_progress;
 };
 
 }
@@ -0,0 +1,145 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "core/textsnapshot.hpp"
+#include "util/textsearch.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	struct BlockCharLess
+	{
+		template<typename Block>
+		bool operator()(std::size_t offset, const Block& block) const
+		{
+			return offset < block.char_offset;
+		}
+	};
+
+	struct BlockByteLess
+	{
+		template<typename Block>
+		bool operator()(std::size_t offset, const Block& block) const
+		{
+			return offset < block.byte_offset;
+		}
+	};
+}
+
+Gobby::TextSnapshot::TextSnapshot(GtkTextBuffer* buffer):
+	m_buffer(buffer), m_valid(false), m_chars(0)
+{
+	g_object_ref(m_buffer);
+
+	// Covers insertion and deletion of text as well as of pixbufs and
+	// child anchors.
+	m_changed_handler = g_signal_connect(
+		G_OBJECT(m_buffer), "changed",
+		G_CALLBACK(on_changed_static), this);
+}
+
+Gobby::TextSnapshot::~TextSnapshot()
+{
+	g_signal_handler_disconnect(m_buffer, m_changed_handler);
+	g_object_unref(m_buffer);
+}
+
+const std::string& Gobby::TextSnapshot::get_text() const
+{
+	update();
+	return m_text;
+}
+
+std::size_t Gobby::TextSnapshot::get_byte_offset(const GtkTextIter* iter) const
+{
+	return char_to_byte_offset(gtk_text_iter_get_offset(iter));
+}
+
+void Gobby::TextSnapshot::get_iter_at_byte_offset(GtkTextIter* iter,
+                                                  std::size_t offset) const
+{
+	gtk_text_buffer_get_iter_at_offset(
+		m_buffer, iter, byte_to_char_offset(offset));
+}
+
+std::size_t
+Gobby::TextSnapshot::char_to_byte_offset(std::size_t char_offset) const
+{
+	update();
+	if(char_offset >= m_chars) return m_text.size();
+
+	// The first block always starts at offset 0, and the text is not
+	// empty here, so there is at least one block before the one found.
+	BlockList::const_iterator iter = std::upper_bound(
+		m_blocks.begin(), m_blocks.end(), char_offset,
+		BlockCharLess());
+	--iter;
+
+	return iter->byte_offset + skip_utf8_chars(
+		m_text.data() + iter->byte_offset,
+		m_text.size() - iter->byte_offset,
+		char_offset - iter->char_offset);
+}
+
+std::size_t
+Gobby::TextSnapshot::byte_to_char_offset(std::size_t byte_offset) const
+{
+	update();
+	if(byte_offset >= m_text.size()) return m_chars;
+
+	BlockList::const_iterator iter = std::upper_bound(
+		m_blocks.begin(), m_blocks.end(), byte_offset,
+		BlockByteLess());
+	--iter;
+
+	return iter->char_offset + count_utf8_chars(
+		m_text.data() + iter->byte_offset,
+		byte_offset - iter->byte_offset);
+}
+
+void Gobby::TextSnapshot::update() const
+{
+	if(m_valid) return;
+
+	// Use a slice rather than the text, so that pixbufs and child
+	// anchors are included, and character offsets into the snapshot
+	// are the same as in the buffer.
+	GtkTextIter start, end;
+	gtk_text_buffer_get_bounds(m_buffer, &start, &end);
+	gchar* text = gtk_text_buffer_get_slice(m_buffer, &start, &end, TRUE);
+	m_text.assign(text);
+	g_free(text);
+
+	m_blocks.clear();
+	m_chars = 0;
+
+	std::size_t from = 0;
+	while(from < m_text.size())
+	{
+		std::size_t to = std::min(from + BLOCK_SIZE, m_text.size());
+		while(to < m_text.size() && (m_text[to] & 0xc0) == 0x80)
+			++to;
+
+		Block block = { m_chars, from };
+		m_blocks.push_back(block);
+
+		m_chars += count_utf8_chars(m_text.data() + from, to - from);
+		from = to;
+	}
+
+	m_valid = true;
+}
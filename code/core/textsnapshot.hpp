@@ -0,0 +1,87 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_TEXTSNAPSHOT_HPP_
+#define _GOBBY_TEXTSNAPSHOT_HPP_
+
+#include <gtk/gtk.h>
+
+#include <string>
+#include <vector>
+
+namespace Gobby
+{
+
+// Keeps a copy of the content of a GtkTextBuffer in a single contiguous
+// UTF-8 string, so that it can be searched without going through the
+// buffer's B-tree. The copy is only marked outdated when the buffer
+// changes, and taken again the next time it is accessed, so that typing
+// into a large document does not need to touch it. Byte offsets into the
+// copy can be mapped to buffer positions and vice versa.
+class TextSnapshot
+{
+public:
+	TextSnapshot(GtkTextBuffer* buffer);
+	~TextSnapshot();
+
+	GtkTextBuffer* get_buffer() const { return m_buffer; }
+
+	// The returned reference stays valid only until the buffer is
+	// changed and the snapshot is accessed again.
+	const std::string& get_text() const;
+
+	std::size_t get_byte_offset(const GtkTextIter* iter) const;
+	void get_iter_at_byte_offset(GtkTextIter* iter,
+	                             std::size_t byte_offset) const;
+
+	std::size_t char_to_byte_offset(std::size_t char_offset) const;
+	std::size_t byte_to_char_offset(std::size_t byte_offset) const;
+
+protected:
+	// The text is divided into blocks of roughly this many bytes, for
+	// which the character and byte offsets of their beginning are
+	// known, so that character and byte offsets can be mapped into
+	// each other quickly.
+	static const std::size_t BLOCK_SIZE = 64 * 1024;
+
+	struct Block
+	{
+		std::size_t char_offset;
+		std::size_t byte_offset;
+	};
+
+	typedef std::vector<Block> BlockList;
+
+	static void on_changed_static(GtkTextBuffer* buffer,
+	                              gpointer user_data)
+	{
+		static_cast<TextSnapshot*>(user_data)->m_valid = false;
+	}
+
+	void update() const;
+
+	GtkTextBuffer* m_buffer;
+	gulong m_changed_handler;
+
+	mutable bool m_valid;
+	mutable std::string m_text;
+	mutable BlockList m_blocks;
+	mutable std::size_t m_chars;
+};
+
+}
+
+#endif // _GOBBY_TEXTSNAPSHOT_HPP_
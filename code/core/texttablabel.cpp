@@ -16,6 +16,9 @@
 
 #include "core/texttablabel.hpp"
 #include "core/folder.hpp"
+#include "util/i18n.hpp"
+
+#include <gtkmm/tooltip.h>
 
 Gobby::TextTabLabel::UserWatcher::UserWatcher(TextTabLabel* label,
                                               InfTextUser* user):
@@ -79,11 +82,21 @@ Gobby::TextTabLabel::TextTabLabel(Folder& folder, TextSessionView& view):
 		G_OBJECT(buffer), "text-erased",
 		G_CALLBACK(on_text_erased_static), this);
 
+	// Shows how much history the session keeps. This is not shown in
+	// the document's info frame, since that holds a single message
+	// which is used for synchronization and user join problems.
+	set_has_tooltip(true);
+
+	view.signal_highlight_progress().connect(
+		sigc::mem_fun(*this, &TextTabLabel::on_highlight_progress));
+
 	insert_next_to(m_title, Gtk::POS_RIGHT);
 	attach_next_to(m_dots, m_title, Gtk::POS_RIGHT, 1, 1);
+	attach_next_to(m_highlight_progress, m_dots, Gtk::POS_RIGHT, 1, 1);
 
 	update_modified();
 	update_dot_char();
+	on_highlight_progress();
 }
 
 Gobby::TextTabLabel::~TextTabLabel()
@@ -108,6 +121,29 @@ void Gobby::TextTabLabel::on_style_updated()
 	update_dot_char();
 }
 
+bool Gobby::TextTabLabel::on_query_tooltip(
+	int x, int y, bool keyboard_tooltip,
+	const Glib::RefPtr<Gtk::Tooltip>& tooltip)
+{
+	InfSession* session = INF_SESSION(m_view.get_session());
+	if(inf_session_get_status(session) != INF_SESSION_RUNNING)
+		return false;
+
+	unsigned int requests;
+	std::size_t bytes;
+	static_cast<TextSessionView&>(m_view).get_history_size(
+		requests, bytes);
+
+	gchar* size = g_format_size(bytes);
+	tooltip->set_text(Glib::ustring::compose(
+		ngettext("%1\nHistory: %2 change, about %3",
+		         "%1\nHistory: %2 changes, about %3", requests),
+		m_view.get_path(), requests, size));
+	g_free(size);
+
+	return true;
+}
+
 void Gobby::TextTabLabel::on_notify_status()
 {
 	TabLabel::on_notify_status();
@@ -148,6 +184,25 @@ void Gobby::TextTabLabel::on_changed(InfTextUser* author)
 	}
 }
 
+void Gobby::TextTabLabel::on_highlight_progress()
+{
+	const double progress =
+		static_cast<TextSessionView&>(m_view).get_highlight_progress();
+
+	if(progress < 1.0)
+	{
+		const Glib::ustring text = Glib::ustring::compose(
+			_("%1%%"), static_cast<unsigned int>(progress * 100));
+		if(m_highlight_progress.get_text() != text)
+			m_highlight_progress.set_text(text);
+		m_highlight_progress.show();
+	}
+	else
+	{
+		m_highlight_progress.hide();
+	}
+}
+
 void Gobby::TextTabLabel::update_modified()
 {
 	InfSession* session = INF_SESSION(m_view.get_session());
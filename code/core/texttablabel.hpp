@@ -55,14 +55,18 @@ protected:
 	}
 
 	virtual void on_style_updated();
+	virtual bool on_query_tooltip(int x, int y, bool keyboard_tooltip,
+	                              const Glib::RefPtr<Gtk::Tooltip>& tooltip);
 
 	virtual void on_notify_status(); // override
 	virtual void on_activate();
 
 	void on_modified_changed();
 	void on_changed(InfTextUser* author);
+	void on_highlight_progress();
 
 	Gtk::Label m_dots;
+	Gtk::Label m_highlight_progress;
 
 private:
 	void update_modified();
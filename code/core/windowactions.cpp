@@ -37,6 +37,7 @@ Gobby::WindowActions::WindowActions(Gio::ActionMap& map,
 	find_next(map.add_action("find-next")),
 	find_prev(map.add_action("find-prev")),
 	find_replace(map.add_action("find-replace")),
+	find_in_documents(map.add_action("find-in-documents")),
 	goto_line(map.add_action("goto-line")),
 
 	hide_user_colors(map.add_action("hide-user-colors")),
@@ -48,6 +48,7 @@ public:
 	const Glib::RefPtr<Gio::SimpleAction> find_next;
 	const Glib::RefPtr<Gio::SimpleAction> find_prev;
 	const Glib::RefPtr<Gio::SimpleAction> find_replace;
+	const Glib::RefPtr<Gio::SimpleAction> find_in_documents;
 	const Glib::RefPtr<Gio::SimpleAction> goto_line;
 
 	const Glib::RefPtr<Gio::SimpleAction> hide_user_colors;
@@ -0,0 +1,257 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "features.hpp"
+#include "daemon.hpp"
+
+#include "core/noteplugin.hpp"
+
+#include "util/stallprofiler.hpp"
+
+#ifdef G_OS_UNIX
+# include <glib-unix.h>
+# include <signal.h>
+# include <sys/resource.h>
+#endif
+
+#include <iostream>
+
+Gobby::LogReporter::LogReporter():
+	m_next_id(INVALID_MESSAGE + 1)
+{
+}
+
+Gobby::SelfHoster::Reporter::MessageId
+Gobby::LogReporter::add_info_message(const Glib::ustring& message)
+{
+	g_message("%s", message.c_str());
+	return m_next_id++;
+}
+
+void Gobby::LogReporter::add_error_message(const Glib::ustring& brief_desc,
+                                           const Glib::ustring& detailed_desc)
+{
+	g_warning("%s: %s", brief_desc.c_str(), detailed_desc.c_str());
+}
+
+void Gobby::LogReporter::remove_message(MessageId id)
+{
+	// Log messages cannot be taken back.
+}
+
+Gobby::Daemon::Daemon(const std::string& config_file,
+                      const std::string& connection_metrics_file):
+	m_config(config_file),
+	m_preferences(m_config),
+	m_cert_manager(m_preferences),
+	m_auth_manager(m_preferences),
+	m_connection_manager(m_cert_manager, m_preferences),
+	m_self_hoster(m_connection_manager.get_io(),
+	              m_connection_manager.get_communication_manager(),
+	              m_connection_manager.get_publisher(),
+	              m_auth_manager.get_sasl_context(),
+	              m_reporter, m_cert_manager, m_preferences),
+	m_main_loop(Glib::MainLoop::create()),
+	m_subscribe_session_handler(0), m_unsubscribe_session_handler(0),
+	m_message_start(0)
+{
+	// Nobody is going to look at the documents locally, so there is no
+	// need for GtkSourceBuffers.
+	InfdDirectory* directory = m_self_hoster.get_directory();
+	infd_directory_add_plugin(directory, Plugins::D_TEXT_HEADLESS);
+	infd_directory_add_plugin(directory, Plugins::D_CHAT);
+
+	Plugins::set_undo_history_size(
+		m_preferences.editor.undo_history_size);
+	m_preferences.editor.undo_history_size.signal_changed().connect(
+		sigc::mem_fun(*this, &Daemon::on_undo_history_size_changed));
+
+	Plugins::set_journaling(m_preferences.user.journal_local_documents);
+	m_preferences.user.journal_local_documents.signal_changed().connect(
+		sigc::mem_fun(*this, &Daemon::on_journaling_changed));
+
+	if(StallProfiler::is_enabled())
+	{
+		m_subscribe_session_handler = g_signal_connect(
+			G_OBJECT(directory), "subscribe-session",
+			G_CALLBACK(on_subscribe_session_static), this);
+		m_unsubscribe_session_handler = g_signal_connect(
+			G_OBJECT(directory), "unsubscribe-session",
+			G_CALLBACK(on_unsubscribe_session_static), this);
+
+		m_log_usage_connection = Glib::signal_timeout().connect_seconds(
+			sigc::mem_fun(*this, &Daemon::on_log_usage),
+			USAGE_LOG_INTERVAL);
+	}
+
+	if(!connection_metrics_file.empty())
+	{
+		m_connection_metrics_log.reset(new ConnectionMetricsLog(
+			directory, connection_metrics_file));
+	}
+}
+
+Gobby::Daemon::~Daemon()
+{
+	m_log_usage_connection.disconnect();
+
+	for(SessionSet::const_iterator iter = m_profiled_sessions.begin();
+	    iter != m_profiled_sessions.end(); ++iter)
+	{
+		g_signal_handlers_disconnect_by_data(G_OBJECT(*iter), this);
+		g_object_unref(*iter);
+	}
+
+	if(m_subscribe_session_handler != 0)
+	{
+		InfdDirectory* directory = m_self_hoster.get_directory();
+		g_signal_handler_disconnect(directory,
+		                            m_subscribe_session_handler);
+		g_signal_handler_disconnect(directory,
+		                            m_unsubscribe_session_handler);
+	}
+}
+
+int Gobby::Daemon::run()
+{
+	if(!m_preferences.user.allow_remote_access)
+	{
+		std::cerr << "Remote access is disabled in the settings, "
+		             "so there is nothing to host" << std::endl;
+		return 1;
+	}
+
+	if(m_preferences.user.keep_local_documents)
+	{
+		const std::string directory =
+			m_preferences.user.host_directory;
+		g_message("Hosting documents from \"%s\" on port %u",
+		          directory.c_str(),
+		          static_cast<unsigned int>(m_preferences.user.port));
+	}
+	else
+	{
+		g_message("Hosting documents on port %u, without keeping "
+		          "them on disk",
+		          static_cast<unsigned int>(m_preferences.user.port));
+	}
+
+#ifdef G_OS_UNIX
+	const guint sigint_id =
+		g_unix_signal_add(SIGINT, on_quit_signal_static, this);
+	const guint sigterm_id =
+		g_unix_signal_add(SIGTERM, on_quit_signal_static, this);
+#endif
+
+	m_main_loop->run();
+
+#ifdef G_OS_UNIX
+	g_source_remove(sigint_id);
+	g_source_remove(sigterm_id);
+#endif
+
+	// The directory stores all open sessions when the self-hoster
+	// releases it in its destructor.
+	return 0;
+}
+
+void Gobby::Daemon::on_quit_signal()
+{
+	g_message("Shutting down");
+	m_main_loop->quit();
+}
+
+void Gobby::Daemon::on_undo_history_size_changed()
+{
+	Plugins::set_undo_history_size(
+		m_preferences.editor.undo_history_size);
+}
+
+void Gobby::Daemon::on_journaling_changed()
+{
+	Plugins::set_journaling(m_preferences.user.journal_local_documents);
+}
+
+void Gobby::Daemon::on_subscribe_session(InfSessionProxy* proxy)
+{
+	InfSession* session;
+	g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+
+	if(!m_profiled_sessions.insert(session).second)
+	{
+		g_object_unref(session);
+		return;
+	}
+
+	g_signal_connect(G_OBJECT(session), "receive-message",
+	                 G_CALLBACK(on_receive_message_static), this);
+	g_signal_connect_after(G_OBJECT(session), "receive-message",
+	                       G_CALLBACK(on_receive_message_after_static),
+	                       this);
+}
+
+void Gobby::Daemon::on_unsubscribe_session(InfSessionProxy* proxy)
+{
+	InfSession* session;
+	g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+
+	SessionSet::iterator iter = m_profiled_sessions.find(session);
+	if(iter != m_profiled_sessions.end())
+	{
+		g_signal_handlers_disconnect_by_data(G_OBJECT(session), this);
+		m_profiled_sessions.erase(iter);
+		g_object_unref(session);
+	}
+
+	g_object_unref(session);
+}
+
+void Gobby::Daemon::on_message_received()
+{
+	// Of nested emissions, only the innermost one is accounted.
+	if(m_message_start == 0) return;
+
+	StallProfiler::record("InfSession::receive-message", m_message_start);
+	m_message_start = 0;
+}
+
+bool Gobby::Daemon::on_log_usage()
+{
+	gchar* size = g_format_size(m_self_hoster.get_resident_size());
+
+#ifdef G_OS_UNIX
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		const double cpu_time =
+			usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+			(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+
+		// ru_maxrss is in kilobytes on Linux and the BSDs.
+		g_message("%u documents loaded (about %s), %.1f s CPU time "
+		          "used, at most %ld KiB resident",
+		          m_self_hoster.get_n_resident_sessions(), size,
+		          cpu_time, static_cast<long>(usage.ru_maxrss));
+		g_free(size);
+		return true;
+	}
+#endif
+
+	g_message("%u documents loaded (about %s)",
+	          m_self_hoster.get_n_resident_sessions(), size);
+	g_free(size);
+	return true;
+}
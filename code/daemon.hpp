@@ -0,0 +1,151 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_DAEMON_HPP_
+#define _GOBBY_DAEMON_HPP_
+
+#include "core/selfhoster.hpp"
+#include "core/connectionmetricslog.hpp"
+#include "core/connectionmanager.hpp"
+#include "core/authmanager.hpp"
+#include "core/certificatemanager.hpp"
+#include "core/preferences.hpp"
+
+#include "util/config.hpp"
+
+#include <glibmm/main.h>
+
+#include <memory>
+#include <set>
+
+namespace Gobby
+{
+
+// Writes the self-hoster's messages to the log.
+class LogReporter: public SelfHoster::Reporter
+{
+public:
+	LogReporter();
+
+	virtual MessageId add_info_message(const Glib::ustring& message);
+	virtual void add_error_message(const Glib::ustring& brief_desc,
+	                               const Glib::ustring& detailed_desc);
+	virtual void remove_message(MessageId id);
+
+protected:
+	MessageId m_next_id;
+};
+
+// Hosts documents without any user interface, so that a server can be run
+// on a machine without a display. Only the objects needed to keep the
+// self-hosted directory reachable are created; they are configured with
+// the same settings and config file as the GUI.
+class Daemon
+{
+public:
+	// How often resource usage is logged while profiling, in seconds.
+	static const unsigned int USAGE_LOG_INTERVAL = 60;
+
+	// If connection_metrics_file is not empty, the traffic of every
+	// client is appended to it periodically.
+	Daemon(const std::string& config_file,
+	       const std::string& connection_metrics_file);
+	~Daemon();
+
+	// Serves documents until SIGINT or SIGTERM is received. Returns the
+	// exit status for the process.
+	int run();
+
+protected:
+	static gboolean on_quit_signal_static(gpointer user_data)
+	{
+		static_cast<Daemon*>(user_data)->on_quit_signal();
+		return TRUE;
+	}
+
+	static void on_subscribe_session_static(InfBrowser* browser,
+	                                        const InfBrowserIter* iter,
+	                                        InfSessionProxy* proxy,
+	                                        InfRequest* request,
+	                                        gpointer user_data)
+	{
+		static_cast<Daemon*>(user_data)->on_subscribe_session(proxy);
+	}
+
+	static void on_unsubscribe_session_static(InfBrowser* browser,
+	                                          const InfBrowserIter* iter,
+	                                          InfSessionProxy* proxy,
+	                                          InfRequest* request,
+	                                          gpointer user_data)
+	{
+		static_cast<Daemon*>(user_data)->
+			on_unsubscribe_session(proxy);
+	}
+
+	static void on_receive_message_static(InfSession* session,
+	                                      InfXmlConnection* connection,
+	                                      xmlNodePtr xml,
+	                                      gpointer user_data)
+	{
+		static_cast<Daemon*>(user_data)->m_message_start =
+			g_get_monotonic_time();
+	}
+
+	static void on_receive_message_after_static(
+		InfSession* session,
+		InfXmlConnection* connection,
+		xmlNodePtr xml,
+		gpointer user_data)
+	{
+		static_cast<Daemon*>(user_data)->on_message_received();
+	}
+
+	void on_quit_signal();
+	void on_undo_history_size_changed();
+	void on_journaling_changed();
+
+	void on_subscribe_session(InfSessionProxy* proxy);
+	void on_unsubscribe_session(InfSessionProxy* proxy);
+	void on_message_received();
+	bool on_log_usage();
+
+	Config m_config;
+	Preferences m_preferences;
+	CertificateManager m_cert_manager;
+	AuthManager m_auth_manager;
+	ConnectionManager m_connection_manager;
+	LogReporter m_reporter;
+	SelfHoster m_self_hoster;
+
+	Glib::RefPtr<Glib::MainLoop> m_main_loop;
+
+	// When profiling, the hosted sessions report how long it takes to
+	// process each message that a client sends, which includes applying
+	// a request and forwarding it to the other subscribers. This is the
+	// server's share of the delay until an edit shows up for everybody.
+	typedef std::set<InfSession*> SessionSet;
+	SessionSet m_profiled_sessions;
+	gulong m_subscribe_session_handler;
+	gulong m_unsubscribe_session_handler;
+	gint64 m_message_start;
+	sigc::connection m_log_usage_connection;
+
+	std::unique_ptr<ConnectionMetricsLog> m_connection_metrics_log;
+};
+
+}
+
+#endif // _GOBBY_DAEMON_HPP_
@@ -18,6 +18,8 @@
 
 #include "util/i18n.hpp"
 
+#include <iomanip>
+
 #include <libinfinity/client/infc-browser.h>
 
 Gobby::ConnectionInfoDialog::ConnectionInfoDialog(
@@ -25,13 +27,14 @@ Gobby::ConnectionInfoDialog::ConnectionInfoDialog(
 :
 	Gtk::Dialog(cobject), m_browser(NULL),
 	m_connection_store(Gtk::ListStore::create(m_columns)),
-	m_connection_added_handler(0),
+	m_connection(NULL), m_connection_added_handler(0),
 	m_connection_removed_handler(0),
 	m_empty(true)
 {
 	builder->get_widget("image", m_image);
 	builder->get_widget("treeview", m_connection_tree_view);
 	builder->get_widget("scrolled-window", m_connection_scroll);
+	builder->get_widget("metrics", m_metrics_label);
 
 	m_connection_view = INF_GTK_CONNECTION_VIEW(
 		gtk_builder_get_object(builder->gobj(), "connection-info"));
@@ -70,6 +73,7 @@ Gobby::ConnectionInfoDialog::ConnectionInfoDialog(
 Gobby::ConnectionInfoDialog::~ConnectionInfoDialog()
 {
 	set_browser(NULL);
+	set_connection(NULL);
 }
 
 std::unique_ptr<Gobby::ConnectionInfoDialog>
@@ -127,11 +131,7 @@ void Gobby::ConnectionInfoDialog::set_browser(InfBrowser* browser)
 		InfXmlConnection* conn = infc_browser_get_connection(
 			INFC_BROWSER(browser));
 		if(INF_IS_XMPP_CONNECTION(conn))
-		{
-			inf_gtk_connection_view_set_connection(
-				m_connection_view,
-				INF_XMPP_CONNECTION(conn));
-		}
+			set_connection(INF_XMPP_CONNECTION(conn));
 
 		/* TODO: Show this corresponding to connection status, or
 		 * network-server if we are a server. */
@@ -266,14 +266,61 @@ void Gobby::ConnectionInfoDialog::on_selection_changed()
 		Gtk::TreeIter iter =
 			m_connection_tree_view->get_selection()->
 				get_selected();
-		inf_gtk_connection_view_set_connection(
-			m_connection_view, (*iter)[m_columns.connection]);
+		set_connection((*iter)[m_columns.connection]);
+	}
+	else
+	{
+		set_connection(NULL);
+	}
+}
+
+void Gobby::ConnectionInfoDialog::on_metrics_sampled()
+{
+	const ConnectionMetrics* metrics =
+		ConnectionMetrics::get(m_connection);
+	g_assert(metrics != NULL);
+
+	ConnectionMetrics::Rates rates;
+	if(!metrics->get_rates(RATE_SPAN, rates))
+	{
+		m_metrics_label->set_text(_("Measuring traffic..."));
+		return;
+	}
+
+	gchar* received = g_format_size(
+		static_cast<guint64>(rates.bytes_received));
+	gchar* sent = g_format_size(static_cast<guint64>(rates.bytes_sent));
+
+	Glib::ustring text = Glib::ustring::compose(
+		_("Received: %1/s, %2 messages/s"), received,
+		Glib::ustring::format(std::fixed, std::setprecision(1),
+		                      rates.messages_received));
+	text += "\n";
+	text += Glib::ustring::compose(
+		_("Sent: %1/s, %2 messages/s"), sent,
+		Glib::ustring::format(std::fixed, std::setprecision(1),
+		                      rates.messages_sent));
+	text += "\n";
+
+	g_free(received);
+	g_free(sent);
+
+	const gint64 idle = metrics->get_time_since_received();
+	if(idle < 0)
+	{
+		text += _("No message received yet");
 	}
 	else
 	{
-		inf_gtk_connection_view_set_connection(
-			m_connection_view, NULL);
+		const unsigned long seconds = idle / 1000000;
+		text += Glib::ustring::compose(
+			ngettext("Last message received %1 second ago",
+			         "Last message received %1 seconds ago",
+			         seconds),
+			seconds);
 	}
+
+	m_metrics_label->set_text(text);
 }
 
 void Gobby::ConnectionInfoDialog::icon_cell_data_func(
@@ -317,6 +364,43 @@ void Gobby::ConnectionInfoDialog::name_cell_data_func(
 	text_renderer->property_visible() = true;
 }
 
+void Gobby::ConnectionInfoDialog::set_connection(InfXmppConnection* conn)
+{
+	if(conn == m_connection) return;
+
+	inf_gtk_connection_view_set_connection(m_connection_view, conn);
+
+	if(m_connection != NULL)
+	{
+		m_metrics_connection.disconnect();
+		ConnectionMetrics::unwatch(m_connection);
+		g_object_unref(m_connection);
+	}
+
+	m_connection = conn;
+
+	if(m_connection != NULL)
+	{
+		g_object_ref(m_connection);
+
+		// Measuring only starts now if nobody did so before, so the
+		// rates only become available after a moment.
+		m_metrics_connection =
+			ConnectionMetrics::watch(m_connection).
+				signal_sampled().connect(sigc::mem_fun(
+					*this,
+					&ConnectionInfoDialog::
+						on_metrics_sampled));
+
+		on_metrics_sampled();
+		m_metrics_label->show();
+	}
+	else
+	{
+		m_metrics_label->hide();
+	}
+}
+
 Gtk::TreeIter Gobby::ConnectionInfoDialog::find_connection(
 	InfXmppConnection* conn)
 {
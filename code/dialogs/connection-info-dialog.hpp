@@ -17,7 +17,10 @@
 #ifndef _GOBBY_CONNECTIONINFODIALOG_HPP_
 #define _GOBBY_CONNECTIONINFODIALOG_HPP_
 
+#include "core/connectionmetrics.hpp"
+
 #include <gtkmm/dialog.h>
+#include <gtkmm/label.h>
 #include <gtkmm/treeview.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/scrolledwindow.h>
@@ -72,6 +75,7 @@ private:
 	void on_connection_removed(InfXmlConnection* conn);
 
 	void on_selection_changed();
+	void on_metrics_sampled();
 
 	void icon_cell_data_func(Gtk::CellRenderer* renderer,
 	                         const Gtk::TreeIter& iter);
@@ -79,7 +83,11 @@ private:
 	                         const Gtk::TreeIter& iter);
 
 protected:
+	// Traffic rates are averaged over this many seconds.
+	static const unsigned int RATE_SPAN = 5;
+
 	Gtk::TreeIter find_connection(InfXmppConnection* conn);
+	void set_connection(InfXmppConnection* conn);
 
 	class Columns: public Gtk::TreeModelColumnRecord
 	{
@@ -100,9 +108,14 @@ protected:
 	Gtk::Image* m_image;
 	Gtk::TreeView* m_connection_tree_view;
 	Gtk::ScrolledWindow* m_connection_scroll;
+	Gtk::Label* m_metrics_label;
 
 	InfGtkConnectionView* m_connection_view;
 
+	// The connection shown in the connection view
+	InfXmppConnection* m_connection;
+	sigc::connection m_metrics_connection;
+
 	gulong m_connection_added_handler;
 	gulong m_connection_removed_handler;
 
@@ -16,11 +16,16 @@
 
 #include "dialogs/find-dialog.hpp"
 #include "core/folder.hpp"
+#include "util/stallprofiler.hpp"
+#include "util/textsearch.hpp"
 #include "util/i18n.hpp"
 
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/textbuffer.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace
 {
 	typedef gboolean (*TextSearchFunc)(
@@ -35,11 +40,202 @@ namespace
 	const int RESPONSE_FIND = 1;
 	const int RESPONSE_REPLACE = 2;
 	const int RESPONSE_REPLACE_ALL = 3;
+
+	// How long to look for occurrences of a regular expression per main
+	// loop iteration during Replace All, in microseconds.
+	const gint64 SLICE_TIME = 8000;
+
+	// If the document is changed while looking for occurrences, we
+	// start again. After that many restarts, the rest is done in one go.
+	const unsigned int MAX_RESTARTS = 3;
+
+	bool is_utf8_continuation(char c)
+	{
+		return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+	}
+}
+
+// Collects all occurrences of a regular expression in a document in idle
+// handlers, and replaces them all at once when done.
+class Gobby::FindDialog::RegexReplaceAll
+{
+public:
+	RegexReplaceAll(FindDialog& dialog, TextSessionView& view,
+	                GRegex* regex, const Glib::ustring& replace_text);
+	~RegexReplaceAll();
+
+private:
+	static void on_changed_static(GtkTextBuffer* buffer,
+	                              gpointer user_data)
+	{
+		static_cast<RegexReplaceAll*>(user_data)->m_modified = true;
+	}
+
+	void restart();
+	bool on_idle();
+
+	FindDialog& m_dialog;
+	TextSessionView& m_view;
+	GRegex* m_regex;
+	const std::string m_replace_text;
+	const gint64 m_start_time;
+
+	// Has its own snapshot, so that the text that m_match_info refers
+	// to remains valid when the dialog drops or retakes its snapshot.
+	TextSnapshot m_snapshot;
+	gulong m_changed_handler;
+	bool m_modified;
+	unsigned int m_restarts;
+
+	GMatchInfo* m_match_info;
+	std::size_t m_last_byte;
+	gint m_last_char;
+	ReplaceEditList m_edits;
+	unsigned int m_replace_count;
+
+	sigc::connection m_idle_connection;
+	StatusBar::MessageHandle m_message_handle;
+};
+
+Gobby::FindDialog::RegexReplaceAll::RegexReplaceAll(
+	FindDialog& dialog, TextSessionView& view, GRegex* regex,
+	const Glib::ustring& replace_text):
+	m_dialog(dialog), m_view(view), m_regex(g_regex_ref(regex)),
+	m_replace_text(replace_text), m_start_time(g_get_monotonic_time()),
+	m_snapshot(GTK_TEXT_BUFFER(view.get_text_buffer())),
+	m_modified(false), m_restarts(0), m_match_info(NULL),
+	m_last_byte(0), m_last_char(0), m_replace_count(0)
+{
+	m_changed_handler = g_signal_connect(
+		G_OBJECT(view.get_text_buffer()), "changed",
+		G_CALLBACK(on_changed_static), this);
+
+	m_message_handle = m_dialog.m_status_bar->add_info_message(
+		Glib::ustring::compose(
+			_("Replacing occurrences of \"%1\"..."),
+			m_dialog.get_find_text()));
+
+	m_idle_connection = Glib::signal_idle().connect(
+		sigc::mem_fun(*this, &RegexReplaceAll::on_idle));
+}
+
+Gobby::FindDialog::RegexReplaceAll::~RegexReplaceAll()
+{
+	m_idle_connection.disconnect();
+	m_dialog.m_status_bar->remove_message(m_message_handle);
+
+	g_signal_handler_disconnect(
+		m_view.get_text_buffer(), m_changed_handler);
+
+	if(m_match_info != NULL)
+		g_match_info_free(m_match_info);
+	g_regex_unref(m_regex);
+}
+
+void Gobby::FindDialog::RegexReplaceAll::restart()
+{
+	if(m_match_info != NULL)
+	{
+		g_match_info_free(m_match_info);
+		m_match_info = NULL;
+	}
+
+	m_last_byte = 0;
+	m_last_char = 0;
+	m_edits.clear();
+	m_replace_count = 0;
+
+	m_modified = false;
+	++m_restarts;
+}
+
+bool Gobby::FindDialog::RegexReplaceAll::on_idle()
+{
+	StallProfiler::Scope profile("FindDialog::RegexReplaceAll::on_idle");
+
+	// The text that m_match_info refers to has changed
+	if(m_modified)
+		restart();
+
+	gint64 deadline = g_get_monotonic_time() + SLICE_TIME;
+	if(m_restarts > MAX_RESTARTS)
+		deadline = 0;
+
+	const std::string& text = m_snapshot.get_text();
+	GError* error = NULL;
+	gboolean matched;
+
+	do
+	{
+		if(m_match_info == NULL)
+		{
+			matched = g_regex_match_full(
+				m_regex, text.c_str(), text.size(), 0,
+				GRegexMatchFlags(0), &m_match_info, &error);
+		}
+		else
+		{
+			matched = g_match_info_next(m_match_info, &error);
+		}
+
+		if(!matched) break;
+
+		gint start, end;
+		g_match_info_fetch_pos(m_match_info, 0, &start, &end);
+
+		// Substitutes references to capture groups
+		gchar* replace_text = g_match_info_expand_references(
+			m_match_info, m_replace_text.c_str(), &error);
+		if(replace_text == NULL) break;
+
+		m_last_char += count_utf8_chars(text.data() + m_last_byte,
+		                                start - m_last_byte);
+		m_last_byte = start;
+
+		add_replace_edit(m_edits, text, start, end, m_last_char,
+		                 m_last_char + count_utf8_chars(
+		                 	text.data() + start, end - start),
+		                 replace_text);
+		g_free(replace_text);
+		++m_replace_count;
+	} while(deadline == 0 || g_get_monotonic_time() < deadline);
+
+	if(matched && error == NULL)
+		return true;
+
+	// Done. Note that this object is deleted by resetting
+	// m_regex_replace_all, so copy everything we need before.
+	FindDialog& dialog = m_dialog;
+	TextSessionView& view = m_view;
+	const unsigned int replace_count = m_replace_count;
+	const gint64 start_time = m_start_time;
+	ReplaceEditList edits;
+	edits.swap(m_edits);
+
+	dialog.m_regex_replace_all.reset(NULL);
+
+	if(error != NULL)
+	{
+		dialog.m_status_bar->add_error_message(
+			_("Failed to replace all occurrences"),
+			error->message);
+		g_error_free(error);
+	}
+	else
+	{
+		dialog.finish_replace_all(view, edits, replace_count,
+		                          start_time);
+	}
+
+	return false;
 }
 
 Gobby::FindDialog::FindDialog(GtkDialog* cobject,
                               const Glib::RefPtr<Gtk::Builder>& builder):
-	Gtk::Dialog(cobject), m_folder(NULL), m_status_bar(NULL)
+	Gtk::Dialog(cobject), m_folder(NULL), m_status_bar(NULL),
+	m_search_settings(gtk_source_search_settings_new()),
+	m_search_context(NULL), m_occurrences_count_handler(0),
+	m_mark_set_handler(0), m_regex(NULL)
 {
 	builder->get_widget("search-for", m_entry_find);
 	builder->get_widget("replace-with-label", m_label_replace);
@@ -49,6 +245,18 @@ Gobby::FindDialog::FindDialog(GtkDialog* cobject,
 	builder->get_widget("match-entire-word-only", m_check_whole_word);
 	builder->get_widget("search-backwards", m_check_backwards);
 	builder->get_widget("wrap-around", m_check_wrap_around);
+	builder->get_widget("regex", m_check_regex);
+	builder->get_widget("highlight-all", m_check_highlight_all);
+	builder->get_widget("match-count", m_label_match_count);
+
+	m_check_case->signal_toggled().connect(
+		sigc::mem_fun(*this, &FindDialog::on_search_option_toggled));
+	m_check_whole_word->signal_toggled().connect(
+		sigc::mem_fun(*this, &FindDialog::on_search_option_toggled));
+	m_check_regex->signal_toggled().connect(
+		sigc::mem_fun(*this, &FindDialog::on_search_option_toggled));
+	m_check_highlight_all->signal_toggled().connect(
+		sigc::mem_fun(*this, &FindDialog::on_search_option_toggled));
 
 	m_entry_find->signal_changed().connect(
 		sigc::mem_fun(*this, &FindDialog::on_find_text_changed));
@@ -92,6 +300,9 @@ Gobby::FindDialog::create(Gtk::Window& parent, const Folder& folder,
 Gobby::FindDialog::~FindDialog()
 {
 	on_document_changed(NULL);
+	set_search_context(NULL);
+	g_object_unref(m_search_settings);
+	reset_regex();
 }
 
 bool Gobby::FindDialog::get_search_only() const
@@ -129,8 +340,21 @@ Glib::ustring Gobby::FindDialog::get_replace_text() const
 	return m_entry_replace->get_text();
 }
 
+void Gobby::FindDialog::set_find_text(const Glib::ustring& text)
+{
+	m_entry_find->set_text(text);
+}
+
+void Gobby::FindDialog::set_replace_text(const Glib::ustring& text)
+{
+	m_entry_replace->set_text(text);
+}
+
 bool Gobby::FindDialog::find_next()
 {
+	if(m_check_regex->get_active() && get_regex() == NULL)
+		return false;
+
 	bool result = find_and_select(NULL, SEARCH_FORWARD);
 	if(!result)
 	{
@@ -147,6 +371,9 @@ bool Gobby::FindDialog::find_next()
 
 bool Gobby::FindDialog::find_previous()
 {
+	if(m_check_regex->get_active() && get_regex() == NULL)
+		return false;
+
 	bool result = find_and_select(NULL, SEARCH_BACKWARD);
 	if(!result)
 	{
@@ -165,6 +392,15 @@ void Gobby::FindDialog::on_show()
 {
 	Gtk::Dialog::on_show();
 	m_entry_find->grab_focus();
+	update_search_context(dynamic_cast<TextSessionView*>(
+		m_folder->get_current_document()));
+}
+
+void Gobby::FindDialog::on_hide()
+{
+	Gtk::Dialog::on_hide();
+	m_snapshot.reset(NULL);
+	set_search_context(NULL);
 }
 
 void Gobby::FindDialog::on_response(int id)
@@ -191,6 +427,9 @@ void Gobby::FindDialog::on_response(int id)
 void Gobby::FindDialog::on_document_changed(SessionView* view)
 {
 	m_active_user_changed_connection.disconnect();
+	m_regex_replace_all.reset(NULL);
+	m_snapshot.reset(NULL);
+
 	TextSessionView* text_view = dynamic_cast<TextSessionView*>(view);
 
 	if(text_view != NULL)
@@ -203,6 +442,7 @@ void Gobby::FindDialog::on_document_changed(SessionView* view)
 	}
 
 	update_sensitivity();
+	update_search_context(text_view);
 }
 
 void Gobby::FindDialog::on_active_user_changed(InfUser* user)
@@ -212,7 +452,10 @@ void Gobby::FindDialog::on_active_user_changed(InfUser* user)
 
 void Gobby::FindDialog::on_find_text_changed()
 {
+	reset_regex();
 	update_sensitivity();
+	update_search_context(dynamic_cast<TextSessionView*>(
+		m_folder->get_current_document()));
 	m_signal_find_text_changed.emit();
 }
 
@@ -221,6 +464,23 @@ void Gobby::FindDialog::on_replace_text_changed()
 	m_signal_replace_text_changed.emit();
 }
 
+void Gobby::FindDialog::on_search_option_toggled()
+{
+	reset_regex();
+	update_search_context(dynamic_cast<TextSessionView*>(
+		m_folder->get_current_document()));
+}
+
+void Gobby::FindDialog::on_mark_set(GtkTextMark* mark)
+{
+	GtkTextBuffer* buffer = gtk_text_mark_get_buffer(mark);
+	if(mark == gtk_text_buffer_get_insert(buffer) ||
+	   mark == gtk_text_buffer_get_selection_bound(buffer))
+	{
+		update_match_count();
+	}
+}
+
 Gobby::FindDialog::SearchDirection Gobby::FindDialog::get_direction() const
 {
 	if(m_check_backwards->get_active())
@@ -243,6 +503,9 @@ bool Gobby::FindDialog::replace()
 	TextSessionView* text_view = dynamic_cast<TextSessionView*>(view);
 	g_assert(text_view != NULL);
 
+	if(m_check_regex->get_active())
+		return replace_regex(*text_view);
+
 	// Get selected string
 	Glib::ustring sel_str = text_view->get_selected_text();
 	Glib::ustring find_str = get_find_text();
@@ -277,6 +540,63 @@ bool Gobby::FindDialog::replace()
 	}
 }
 
+bool Gobby::FindDialog::replace_regex(TextSessionView& view)
+{
+	GRegex* regex = get_regex();
+	if(regex == NULL) return false;
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
+	GtkTextIter sel_start, sel_end;
+	if(!gtk_text_buffer_get_selection_bounds(buffer, &sel_start, &sel_end))
+		return find();
+
+	// Check whether the selection is an occurrence of the pattern
+	const TextSnapshot& snapshot = get_snapshot(view);
+	const std::string& text = snapshot.get_text();
+	const std::size_t start_byte = snapshot.get_byte_offset(&sel_start);
+	const std::size_t end_byte = snapshot.get_byte_offset(&sel_end);
+
+	GMatchInfo* match_info;
+	GError* error = NULL;
+	gchar* replace_text = NULL;
+	gint match_start, match_end;
+
+	if(g_regex_match_full(regex, text.c_str(), text.size(), start_byte,
+	                      G_REGEX_MATCH_ANCHORED, &match_info, &error) &&
+	   g_match_info_fetch_pos(match_info, 0, &match_start, &match_end) &&
+	   static_cast<std::size_t>(match_end) == end_byte)
+	{
+		replace_text = g_match_info_expand_references(
+			match_info, get_replace_text().c_str(), &error);
+	}
+
+	g_match_info_free(match_info);
+
+	if(error != NULL)
+	{
+		m_status_bar->add_error_message(
+			_("Failed to replace the occurrence"),
+			error->message);
+		g_error_free(error);
+		return false;
+	}
+
+	if(replace_text == NULL)
+	{
+		// Search the first occurrence
+		return find();
+	}
+
+	gtk_text_buffer_begin_user_action(buffer);
+	gtk_text_buffer_delete_selection(buffer, TRUE, TRUE);
+	gtk_text_buffer_insert_at_cursor(buffer, replace_text, -1);
+	gtk_text_buffer_end_user_action(buffer);
+	g_free(replace_text);
+
+	find_and_select(NULL, get_direction());
+	return true;
+}
+
 bool Gobby::FindDialog::replace_all()
 {
 	// TODO: Add helper function to get textsessionview? Maybe even add
@@ -285,25 +605,177 @@ bool Gobby::FindDialog::replace_all()
 	TextSessionView* text_view = dynamic_cast<TextSessionView*>(view);
 	g_assert(text_view != NULL);
 
+	if(m_check_regex->get_active())
+	{
+		GRegex* regex = get_regex();
+		if(regex == NULL) return false;
+
+		// A pattern can take a long time to match, so collect the
+		// occurrences bit by bit in idle handlers.
+		m_regex_replace_all.reset(
+			new RegexReplaceAll(*this, *text_view, regex,
+			                    get_replace_text()));
+		return true;
+	}
+
 	GtkTextIter begin;
 	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(text_view->get_text_buffer());
 	gtk_text_buffer_get_start_iter(buffer, &begin);
 
+	const gint64 start_time = g_get_monotonic_time();
+	TextSnapshot& snapshot = get_snapshot(*text_view);
+	const std::string& text = snapshot.get_text();
+	const std::string replace_text = get_replace_text();
+
+	// Find all occurrences first, and turn them into a list of edits
+	ReplaceEditList edits;
 	unsigned int replace_count = 0;
+
 	GtkTextIter match_start, match_end;
 	while(find_range(&begin, NULL, SEARCH_FORWARD,
 	                 &match_start, &match_end))
 	{
-		Glib::ustring replace_text = get_replace_text();
-		gtk_text_buffer_delete(buffer, &match_start, &match_end);
-		gtk_text_buffer_insert(buffer, &match_start,
-		                       replace_text.c_str(),
-		                       replace_text.bytes());
+		++replace_count;
+		begin = match_end;
+
+		add_replace_edit(edits, text,
+		                 snapshot.get_byte_offset(&match_start),
+		                 snapshot.get_byte_offset(&match_end),
+		                 gtk_text_iter_get_offset(&match_start),
+		                 gtk_text_iter_get_offset(&match_end),
+		                 replace_text);
+	}
 
-		++ replace_count;
-		begin = match_start;
+	return finish_replace_all(*text_view, edits, replace_count,
+	                          start_time);
+}
+
+void Gobby::FindDialog::add_replace_edit(ReplaceEditList& edits,
+                                         const std::string& text,
+                                         std::size_t byte_begin,
+                                         std::size_t byte_end,
+                                         gint begin, gint end,
+                                         const std::string& replace_text)
+{
+	// Only the part of an occurrence that actually differs from the
+	// replacement text is replaced, and replacements that directly
+	// follow each other are combined into a single edit. Each edit
+	// results in a separate request that is sent to all other
+	// participants, so this keeps the network traffic and the request
+	// log small. Text in between two occurrences is never touched, so
+	// that it keeps its author. This means that separate occurrences
+	// still take up to two requests each, one to erase and one to
+	// insert text, since a request cannot change more than one range
+	// of the document.
+	const std::size_t replace_size = replace_text.size();
+	const std::size_t match_size = byte_end - byte_begin;
+	const char* match = text.data() + byte_begin;
+
+	std::size_t prefix = 0;
+	while(prefix < match_size && prefix < replace_size &&
+	      match[prefix] == replace_text[prefix])
+	{
+		++prefix;
 	}
 
+	while(prefix > 0 &&
+	      ((prefix < match_size &&
+	        is_utf8_continuation(match[prefix])) ||
+	       (prefix < replace_size &&
+	        is_utf8_continuation(replace_text[prefix]))))
+	{
+		--prefix;
+	}
+
+	const std::size_t max_suffix =
+		std::min(match_size, replace_size) - prefix;
+	std::size_t suffix = 0;
+	while(suffix < max_suffix &&
+	      match[match_size - suffix - 1] ==
+	      replace_text[replace_size - suffix - 1])
+	{
+		++suffix;
+	}
+
+	while(suffix > 0 &&
+	      is_utf8_continuation(match[match_size - suffix]))
+	{
+		--suffix;
+	}
+
+	ReplaceEdit edit;
+	edit.begin = begin + count_utf8_chars(match, prefix);
+	edit.end = end - count_utf8_chars(match + match_size - suffix, suffix);
+	edit.byte_begin = byte_begin + prefix;
+	edit.byte_end = byte_end - suffix;
+	edit.text.assign(replace_text, prefix,
+	                 replace_size - prefix - suffix);
+
+	// The occurrence is identical to the replacement text
+	if(edit.begin == edit.end && edit.text.empty())
+		return;
+
+	if(!edits.empty() && edits.back().end == edit.begin)
+	{
+		ReplaceEdit& prev = edits.back();
+		prev.text.append(edit.text);
+		prev.end = edit.end;
+		prev.byte_end = edit.byte_end;
+		return;
+	}
+
+	edits.push_back(edit);
+}
+
+bool Gobby::FindDialog::finish_replace_all(TextSessionView& view,
+                                           const ReplaceEditList& edits,
+                                           unsigned int replace_count,
+                                           gint64 start_time)
+{
+	// The snapshot is outdated once the edits are made, so release its
+	// memory right away. The highlighting does not need to be kept up
+	// to date while replacing.
+	m_snapshot.reset(NULL);
+	set_search_context(NULL);
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
+	GtkTextIter edit_start, edit_end;
+	unsigned int n_requests = 0;
+
+	// Replace from the back, so that the offsets of the remaining
+	// edits stay valid. All of it is a single user action, so that it
+	// can be undone in one step.
+	gtk_text_buffer_begin_user_action(buffer);
+	for(ReplaceEditList::const_reverse_iterator iter = edits.rbegin();
+	    iter != edits.rend(); ++iter)
+	{
+		gtk_text_buffer_get_iter_at_offset(
+			buffer, &edit_start, iter->begin);
+
+		if(iter->end > iter->begin)
+		{
+			gtk_text_buffer_get_iter_at_offset(
+				buffer, &edit_end, iter->end);
+			gtk_text_buffer_delete(
+				buffer, &edit_start, &edit_end);
+			++n_requests;
+		}
+
+		if(!iter->text.empty())
+		{
+			gtk_text_buffer_insert(buffer, &edit_start,
+			                       iter->text.c_str(),
+			                       iter->text.size());
+			++n_requests;
+		}
+	}
+	gtk_text_buffer_end_user_action(buffer);
+	update_search_context(&view);
+
+	g_debug("Replaced %u occurrences with %u requests in %.3f s",
+	        replace_count, n_requests,
+	        (g_get_monotonic_time() - start_time) / 1e6);
+
 	Glib::ustring message;
 	bool result;
 
@@ -410,7 +882,9 @@ bool Gobby::FindDialog::find_range(const GtkTextIter* from,
 	while(find_range_once(&start_pos, to, direction,
 	                      match_start, match_end))
 	{
-		if(m_check_whole_word->get_active() )
+		// For regular expressions, this is part of the pattern
+		if(m_check_whole_word->get_active() &&
+		   !m_check_regex->get_active())
 		{
 			if(!gtk_text_iter_starts_word(match_start) ||
 			   !gtk_text_iter_ends_word(match_end))
@@ -436,8 +910,59 @@ bool Gobby::FindDialog::find_range_once(const GtkTextIter* from,
                                         GtkTextIter* match_start,
                                         GtkTextIter* match_end)
 {
+	const bool case_sensitive = m_check_case->get_active();
+	const std::string find_text = m_entry_find->get_text();
+
+	if(m_check_regex->get_active())
+		return find_regex_once(from, to, direction,
+		                       match_start, match_end);
+
+	if(text_search_supported(find_text, case_sensitive))
+	{
+		// Search the snapshot instead of walking the buffer, and
+		// only map the result back to buffer positions.
+		SessionView* view = m_folder->get_current_document();
+		TextSessionView* text_view =
+			dynamic_cast<TextSessionView*>(view);
+		g_assert(text_view != NULL);
+
+		const TextSnapshot& snapshot = get_snapshot(*text_view);
+		const std::string& text = snapshot.get_text();
+
+		const std::size_t from_byte = snapshot.get_byte_offset(from);
+		std::size_t match_byte;
+		bool result;
+
+		if(direction == SEARCH_FORWARD)
+		{
+			const std::size_t to_byte = (to != NULL) ?
+				snapshot.get_byte_offset(to) : text.size();
+			result = text_search_forward(
+				text.data(), from_byte, to_byte, find_text,
+				case_sensitive, match_byte);
+		}
+		else
+		{
+			const std::size_t to_byte = (to != NULL) ?
+				snapshot.get_byte_offset(to) : 0;
+			result = text_search_backward(
+				text.data(), from_byte, to_byte, find_text,
+				case_sensitive, match_byte);
+		}
+
+		if(result)
+		{
+			snapshot.get_iter_at_byte_offset(
+				match_start, match_byte);
+			snapshot.get_iter_at_byte_offset(
+				match_end, match_byte + find_text.size());
+		}
+
+		return result;
+	}
+
 	GtkTextSearchFlags flags = GtkTextSearchFlags(0);
-	if(!m_check_case->get_active() )
+	if(!case_sensitive)
 		flags = GTK_TEXT_SEARCH_CASE_INSENSITIVE;
 
 	TextSearchFunc search_func = (direction == SEARCH_FORWARD ?
@@ -457,6 +982,244 @@ bool Gobby::FindDialog::find_range_once(const GtkTextIter* from,
 	return result;
 }
 
+bool Gobby::FindDialog::find_regex_once(const GtkTextIter* from,
+                                        const GtkTextIter* to,
+                                        SearchDirection direction,
+                                        GtkTextIter* match_start,
+                                        GtkTextIter* match_end)
+{
+	GRegex* regex = get_regex();
+	if(regex == NULL) return false;
+
+	SessionView* view = m_folder->get_current_document();
+	TextSessionView* text_view = dynamic_cast<TextSessionView*>(view);
+	g_assert(text_view != NULL);
+
+	// Match against the snapshot, so that the regex engine can run
+	// over the whole text in one go.
+	const TextSnapshot& snapshot = get_snapshot(*text_view);
+	const std::string& text = snapshot.get_text();
+	const std::size_t from_byte = snapshot.get_byte_offset(from);
+
+	GMatchInfo* match_info;
+	GError* error = NULL;
+	gint start = -1, end = -1;
+
+	if(direction == SEARCH_FORWARD)
+	{
+		const std::size_t to_byte = (to != NULL) ?
+			snapshot.get_byte_offset(to) : text.size();
+
+		// Empty matches are skipped, otherwise we would find the
+		// same one again and again.
+		if(g_regex_match_full(regex, text.c_str(), text.size(),
+		                      from_byte, G_REGEX_MATCH_NOTEMPTY,
+		                      &match_info, &error))
+		{
+			g_match_info_fetch_pos(match_info, 0, &start, &end);
+			if(static_cast<std::size_t>(end) > to_byte)
+				start = end = -1;
+		}
+	}
+	else
+	{
+		const std::size_t to_byte = (to != NULL) ?
+			snapshot.get_byte_offset(to) : 0;
+
+		// There is no way to run the pattern backwards, so find the
+		// last occurrence in the range. The text after from is cut
+		// off, so that no occurrence extends beyond it.
+		GRegexMatchFlags flags = G_REGEX_MATCH_NOTEMPTY;
+		if(from_byte < text.size())
+			flags = GRegexMatchFlags(flags | G_REGEX_MATCH_NOTEOL);
+
+		gboolean matched = g_regex_match_full(
+			regex, text.c_str(), from_byte, to_byte, flags,
+			&match_info, &error);
+		while(matched)
+		{
+			g_match_info_fetch_pos(match_info, 0, &start, &end);
+			matched = g_match_info_next(match_info, &error);
+		}
+	}
+
+	g_match_info_free(match_info);
+
+	if(error != NULL)
+	{
+		m_status_bar->add_error_message(
+			_("Failed to search for the regular expression"),
+			error->message);
+		g_error_free(error);
+		return false;
+	}
+
+	if(start < 0)
+		return false;
+
+	snapshot.get_iter_at_byte_offset(match_start, start);
+	snapshot.get_iter_at_byte_offset(match_end, end);
+	return true;
+}
+
+GRegex* Gobby::FindDialog::get_regex()
+{
+	if(m_regex != NULL)
+		return m_regex;
+
+	// Compiled once after the pattern or one of the options has
+	// been changed, and then reused for every search.
+	std::string pattern = m_entry_find->get_text();
+	if(m_check_whole_word->get_active())
+		pattern = "\\b(?:" + pattern + ")\\b";
+
+	int flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+	if(!m_check_case->get_active())
+		flags |= G_REGEX_CASELESS;
+
+	GError* error = NULL;
+	m_regex = g_regex_new(pattern.c_str(), GRegexCompileFlags(flags),
+	                      GRegexMatchFlags(0), &error);
+	if(error != NULL)
+	{
+		m_status_bar->add_error_message(
+			_("Invalid regular expression"), error->message, 5);
+		g_error_free(error);
+	}
+
+	return m_regex;
+}
+
+void Gobby::FindDialog::reset_regex()
+{
+	if(m_regex != NULL)
+	{
+		g_regex_unref(m_regex);
+		m_regex = NULL;
+	}
+}
+
+Gobby::TextSnapshot& Gobby::FindDialog::get_snapshot(TextSessionView& view)
+{
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
+	if(m_snapshot.get() == NULL || m_snapshot->get_buffer() != buffer)
+		m_snapshot.reset(new TextSnapshot(buffer));
+
+	return *m_snapshot;
+}
+
+void Gobby::FindDialog::update_search_context(TextSessionView* text_view)
+{
+	const Glib::ustring find_text = get_find_text();
+
+	if(!get_visible() || !m_check_highlight_all->get_active() ||
+	   text_view == NULL || find_text.empty())
+	{
+		set_search_context(NULL);
+		return;
+	}
+
+	// The search context rescans the document by itself when
+	// the settings change.
+	gtk_source_search_settings_set_search_text(
+		m_search_settings, find_text.c_str());
+	gtk_source_search_settings_set_case_sensitive(
+		m_search_settings, m_check_case->get_active());
+	gtk_source_search_settings_set_at_word_boundaries(
+		m_search_settings, m_check_whole_word->get_active());
+	gtk_source_search_settings_set_regex_enabled(
+		m_search_settings, m_check_regex->get_active());
+
+	set_search_context(text_view->get_text_buffer());
+}
+
+void Gobby::FindDialog::set_search_context(GtkSourceBuffer* buffer)
+{
+	if(m_search_context != NULL)
+	{
+		if(gtk_source_search_context_get_buffer(m_search_context) ==
+		   buffer)
+		{
+			return;
+		}
+
+		g_signal_handler_disconnect(
+			gtk_source_search_context_get_buffer(m_search_context),
+			m_mark_set_handler);
+		g_signal_handler_disconnect(
+			m_search_context, m_occurrences_count_handler);
+
+		// Removes the highlighting from the buffer
+		g_object_unref(m_search_context);
+		m_search_context = NULL;
+	}
+
+	if(buffer != NULL)
+	{
+		m_search_context =
+			gtk_source_search_context_new(buffer, m_search_settings);
+		gtk_source_search_context_set_highlight(
+			m_search_context, TRUE);
+
+		m_occurrences_count_handler = g_signal_connect(
+			G_OBJECT(m_search_context), "notify::occurrences-count",
+			G_CALLBACK(on_occurrences_count_changed_static), this);
+		m_mark_set_handler = g_signal_connect_after(
+			G_OBJECT(buffer), "mark-set",
+			G_CALLBACK(on_mark_set_static), this);
+	}
+
+	update_match_count();
+}
+
+void Gobby::FindDialog::update_match_count()
+{
+	if(m_search_context == NULL)
+	{
+		m_label_match_count->hide();
+		return;
+	}
+
+	// -1 while the document has not been scanned completely yet
+	const gint count =
+		gtk_source_search_context_get_occurrences_count(
+			m_search_context);
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(
+		gtk_source_search_context_get_buffer(m_search_context));
+	GtkTextIter sel_start, sel_end;
+	gint position = 0;
+	if(gtk_text_buffer_get_selection_bounds(buffer, &sel_start, &sel_end))
+	{
+		position = gtk_source_search_context_get_occurrence_position(
+			m_search_context, &sel_start, &sel_end);
+	}
+
+	if(count < 0)
+	{
+		m_label_match_count->set_text(_("Counting matches..."));
+	}
+	else if(count == 0)
+	{
+		m_label_match_count->set_text(_("No matches"));
+	}
+	else if(position > 0)
+	{
+		m_label_match_count->set_text(
+			Glib::ustring::compose(
+				_("Match %1 of %2"), position, count));
+	}
+	else
+	{
+		m_label_match_count->set_text(
+			Glib::ustring::compose(
+				ngettext("%1 match", "%1 matches", count),
+				count));
+	}
+
+	m_label_match_count->show();
+}
+
 void Gobby::FindDialog::update_sensitivity()
 {
 	SessionView* view = m_folder->get_current_document();
@@ -20,6 +20,7 @@
 #include "core/folder.hpp"
 #include "core/statusbar.hpp"
 #include "core/sessionview.hpp"
+#include "core/textsnapshot.hpp"
 
 #include <gtkmm/dialog.h>
 #include <gtkmm/label.h>
@@ -27,6 +28,10 @@
 #include <gtkmm/checkbutton.h>
 #include <gtkmm/builder.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace Gobby
 {
 
@@ -53,8 +58,12 @@ public:
 	Glib::ustring get_find_text() const;
 	Glib::ustring get_replace_text() const;
 
+	void set_find_text(const Glib::ustring& text);
+	void set_replace_text(const Glib::ustring& text);
+
 	bool find_next();
 	bool find_previous();
+	bool replace_all();
 
 	SignalFindTextChanged signal_find_text_changed() const
 	{
@@ -66,23 +75,69 @@ public:
 		return m_signal_replace_text_changed;
 	}
 protected:
+	class RegexReplaceAll;
+
+	// A single change to the document during Replace All
+	struct ReplaceEdit
+	{
+		gint begin;
+		gint end;
+		std::size_t byte_begin;
+		std::size_t byte_end;
+		std::string text;
+	};
+
+	typedef std::vector<ReplaceEdit> ReplaceEditList;
+
 	enum SearchDirection {
 		SEARCH_FORWARD,
 		SEARCH_BACKWARD
 	};
 
 	virtual void on_show();
+	virtual void on_hide();
 	virtual void on_response(int id);
 
 	void on_document_changed(SessionView* view);
 	void on_active_user_changed(InfUser* user);
 	void on_find_text_changed();
 	void on_replace_text_changed();
+	void on_search_option_toggled();
+
+	static void on_occurrences_count_changed_static(GObject* object,
+	                                                GParamSpec* pspec,
+	                                                gpointer user_data)
+	{
+		static_cast<FindDialog*>(user_data)->update_match_count();
+	}
+
+	static void on_mark_set_static(GtkTextBuffer* buffer,
+	                               GtkTextIter* location,
+	                               GtkTextMark* mark,
+	                               gpointer user_data)
+	{
+		static_cast<FindDialog*>(user_data)->on_mark_set(mark);
+	}
+
+	void on_mark_set(GtkTextMark* mark);
 
 	SearchDirection get_direction() const;
 	bool find();
 	bool replace();
-	bool replace_all();
+	bool replace_regex(TextSessionView& view);
+
+	// Adds an edit replacing the given occurrence with replace_text,
+	// merging it with the previous edit if they are adjacent.
+	static void add_replace_edit(ReplaceEditList& edits,
+	                             const std::string& text,
+	                             std::size_t byte_begin,
+	                             std::size_t byte_end,
+	                             gint begin, gint end,
+	                             const std::string& replace_text);
+	bool finish_replace_all(TextSessionView& view,
+	                        const ReplaceEditList& edits,
+	                        unsigned int replace_count,
+	                        gint64 start_time);
 
 	// Searches for an occurence with the provided options, selecting the
 	// result, if any.
@@ -110,6 +165,28 @@ protected:
 	                     GtkTextIter* match_start,
 	                     GtkTextIter* match_end);
 
+	bool find_regex_once(const GtkTextIter* from,
+	                     const GtkTextIter* to,
+	                     SearchDirection direction,
+	                     GtkTextIter* match_start,
+	                     GtkTextIter* match_end);
+
+	// Returns the compiled regular expression, or NULL if the pattern
+	// is invalid, in which case an error is shown in the status bar.
+	GRegex* get_regex();
+	void reset_regex();
+
+	// Returns the snapshot of the current document's content, creating
+	// it if there is none yet.
+	TextSnapshot& get_snapshot(TextSessionView& view);
+
+	// Creates or removes the search context that highlights all
+	// occurrences in the current document, depending on whether the
+	// dialog is shown and highlighting is enabled.
+	void update_search_context(TextSessionView* text_view);
+	void set_search_context(GtkSourceBuffer* buffer);
+	void update_match_count();
+
 	const Folder* m_folder;
 	StatusBar* m_status_bar;
 
@@ -123,10 +200,28 @@ protected:
 	Gtk::CheckButton* m_check_whole_word;
 	Gtk::CheckButton* m_check_backwards;
 	Gtk::CheckButton* m_check_wrap_around;
+	Gtk::CheckButton* m_check_regex;
+	Gtk::CheckButton* m_check_highlight_all;
+	Gtk::Label* m_label_match_count;
 
 	Gtk::Button* m_button_replace;
 	Gtk::Button* m_button_replace_all;
 
+	// Kept while the dialog is shown, so that subsequent searches in
+	// the same document do not need to copy its content again.
+	std::unique_ptr<TextSnapshot> m_snapshot;
+
+	// The search context scans the document in the background, starting
+	// with the visible part, and keeps the highlighted occurrences up to
+	// date when the document is changed.
+	GtkSourceSearchSettings* m_search_settings;
+	GtkSourceSearchContext* m_search_context;
+	gulong m_occurrences_count_handler;
+	gulong m_mark_set_handler;
+
+	GRegex* m_regex;
+	std::unique_ptr<RegexReplaceAll> m_regex_replace_all;
+
 	SignalFindTextChanged m_signal_find_text_changed;
 	SignalReplaceTextChanged m_signal_replace_text_changed;
 
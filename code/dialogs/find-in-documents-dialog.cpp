@@ -0,0 +1,1143 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "dialogs/find-in-documents-dialog.hpp"
+#include "operations/operation-subscribe-path.hpp"
+#include "core/textsessionview.hpp"
+#include "util/stallprofiler.hpp"
+#include "util/textsearch.hpp"
+#include "util/i18n.hpp"
+
+#include <libinftextgtk/inf-text-gtk-buffer.h>
+#include <libinfinity/client/infc-browser.h>
+
+#include <pango/pango.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace
+{
+	const int RESPONSE_FIND = 1;
+
+	// Number of documents that are subscribed to at the same time when
+	// searching a directory.
+	const unsigned int MAX_SUBSCRIPTIONS = 4;
+
+	// Only that many occurrences are listed per document, but all of
+	// them are counted.
+	const unsigned int MAX_RESULTS_PER_DOCUMENT = 1000;
+
+	// How much of the line to show before an occurrence, and how much
+	// of it to show at most, in bytes.
+	const std::size_t PREVIEW_CONTEXT = 60;
+	const std::size_t PREVIEW_LENGTH = 160;
+
+	const char ELLIPSIS[] = "\xe2\x80\xa6";
+
+	std::size_t align_utf8(const std::string& text, std::size_t pos)
+	{
+		while(pos > 0 && pos < text.size() &&
+		      (static_cast<unsigned char>(text[pos]) & 0xc0) == 0x80)
+		{
+			--pos;
+		}
+
+		return pos;
+	}
+
+	// Finds the end of the line starting at line_start, and where the
+	// next line starts. Lines end at CR, LF, CRLF and U+2029, the same
+	// as in GtkTextBuffer, so that line numbers match the document's.
+	void find_line_end(const std::string& text, std::size_t line_start,
+	                   std::size_t& line_end, std::size_t& next_line)
+	{
+		gint delimiter, next;
+		pango_find_paragraph_boundary(text.data() + line_start,
+		                              text.size() - line_start,
+		                              &delimiter, &next);
+
+		line_end = line_start + delimiter;
+		next_line = line_start + next;
+	}
+
+	std::string make_preview(const std::string& text,
+	                         std::size_t line_start,
+	                         std::size_t line_end,
+	                         std::size_t match_start)
+	{
+		std::size_t begin = line_start;
+		if(match_start - line_start > PREVIEW_CONTEXT)
+			begin = align_utf8(text, match_start - PREVIEW_CONTEXT);
+
+		std::size_t end = line_end;
+		if(end - begin > PREVIEW_LENGTH)
+			end = align_utf8(text, begin + PREVIEW_LENGTH);
+
+		std::string preview;
+		if(begin > line_start) preview += ELLIPSIS;
+		preview.append(text, begin, end - begin);
+		if(end < line_end) preview += ELLIPSIS;
+
+		std::replace(preview.begin(), preview.end(), '\t', ' ');
+		return preview;
+	}
+
+	std::string get_session_text(InfSession* session)
+	{
+		GtkTextBuffer* buffer = inf_text_gtk_buffer_get_text_buffer(
+			INF_TEXT_GTK_BUFFER(inf_session_get_buffer(session)));
+
+		// Use a slice, so that character offsets match the buffer's
+		// if it contains child anchors.
+		GtkTextIter begin, end;
+		gtk_text_buffer_get_bounds(buffer, &begin, &end);
+		gchar* text = gtk_text_buffer_get_slice(buffer, &begin, &end,
+		                                        TRUE);
+		std::string result(text);
+		g_free(text);
+
+		return result;
+	}
+}
+
+// State of a search that is shared with the worker threads. The threads
+// only read the pattern and the cancelled flag, the dialog pointer is only
+// accessed from the main thread.
+class Gobby::FindInDocumentsDialog::Search
+{
+public:
+	Search(FindInDocumentsDialog& dialog, const std::string& needle,
+	       bool case_sensitive, GRegex* regex):
+		dialog(&dialog), cancelled(false), needle(needle),
+		case_sensitive(case_sensitive), regex(regex)
+	{
+	}
+
+	~Search()
+	{
+		if(regex != NULL)
+			g_regex_unref(regex);
+	}
+
+	void cancel()
+	{
+		dialog = NULL;
+		cancelled = true;
+	}
+
+	FindInDocumentsDialog* dialog;
+	std::atomic<bool> cancelled;
+
+	// If regex is NULL, needle is searched for literally
+	const std::string needle;
+	const bool case_sensitive;
+	GRegex* const regex;
+};
+
+// The text of one document, and the occurrences found in it
+class Gobby::FindInDocumentsDialog::Job
+{
+public:
+	struct Result
+	{
+		int line;
+		int column;
+		int length;
+		std::string preview;
+	};
+
+	Job(const std::shared_ptr<Search>& search, unsigned int document,
+	    const std::string& text):
+		search(search), document(document), text(text), n_results(0)
+	{
+	}
+
+	void run();
+
+	const std::shared_ptr<Search> search;
+	const unsigned int document;
+	std::string text;
+
+	std::vector<Result> results;
+	unsigned int n_results;
+};
+
+void Gobby::FindInDocumentsDialog::Job::run()
+{
+	GMatchInfo* match_info = NULL;
+	std::size_t pos = 0;
+
+	std::size_t line_start = 0;
+	std::size_t line_end, next_line;
+	find_line_end(text, line_start, line_end, next_line);
+	int line = 0;
+
+	while(!search->cancelled)
+	{
+		std::size_t start, end;
+		if(search->regex == NULL)
+		{
+			if(!text_search_forward(text.data(), pos, text.size(),
+			                        search->needle,
+			                        search->case_sensitive, start))
+			{
+				break;
+			}
+
+			end = start + search->needle.size();
+			pos = end;
+		}
+		else
+		{
+			gboolean matched;
+			if(match_info == NULL)
+			{
+				matched = g_regex_match_full(
+					search->regex, text.c_str(),
+					text.size(), 0,
+					G_REGEX_MATCH_NOTEMPTY,
+					&match_info, NULL);
+			}
+			else
+			{
+				matched = g_match_info_next(match_info, NULL);
+			}
+
+			if(!matched) break;
+
+			gint match_start, match_end;
+			g_match_info_fetch_pos(
+				match_info, 0, &match_start, &match_end);
+			start = match_start;
+			end = match_end;
+		}
+
+		++n_results;
+		if(results.size() >= MAX_RESULTS_PER_DOCUMENT)
+			continue;
+
+		while(next_line <= start)
+		{
+			line_start = next_line;
+			find_line_end(text, line_start, line_end, next_line);
+			++line;
+		}
+
+		Result result;
+		result.line = line;
+		result.column = count_utf8_chars(
+			text.data() + line_start, start - line_start);
+		result.length = count_utf8_chars(
+			text.data() + start, end - start);
+		// A match of a regular expression can start within a
+		// line break, such as at the LF of a CRLF.
+		result.preview = make_preview(
+			text, line_start, std::max(line_end, start), start);
+		results.push_back(result);
+	}
+
+	if(match_info != NULL)
+		g_match_info_free(match_info);
+
+	// Not needed anymore, and we don't want to keep it around until
+	// the main loop gets to the result.
+	std::string().swap(text);
+}
+
+// Waits until the text of a document is available, subscribing to the
+// document first if necessary.
+class Gobby::FindInDocumentsDialog::Source
+{
+public:
+	// For documents that are open already
+	Source(FindInDocumentsDialog& dialog, unsigned int document,
+	       InfSession* session);
+	// For documents in the document browser
+	Source(FindInDocumentsDialog& dialog, unsigned int document,
+	       InfBrowser* browser, const InfBrowserIter* iter);
+	~Source();
+
+	unsigned int get_document() const { return m_document; }
+
+	void start();
+
+private:
+	static void on_subscribe_finished_static(InfRequest* request,
+	                                         const InfRequestResult* res,
+	                                         const GError* error,
+	                                         gpointer user_data)
+	{
+		static_cast<Source*>(user_data)->on_subscribe_finished(error);
+	}
+
+	static void on_notify_status_static(GObject* object,
+	                                    GParamSpec* pspec,
+	                                    gpointer user_data)
+	{
+		static_cast<Source*>(user_data)->check_status();
+	}
+
+	void on_subscribe_finished(const GError* error);
+	void set_session_from_browser();
+	void check_status();
+
+	FindInDocumentsDialog& m_dialog;
+	const unsigned int m_document;
+
+	InfBrowser* m_browser;
+	InfBrowserIter m_iter;
+	InfRequest* m_request;
+	gulong m_finished_handler;
+	// Whether the subscription has been made by us, so that we need
+	// to unsubscribe again.
+	bool m_subscribed;
+
+	InfSession* m_session;
+	gulong m_notify_status_handler;
+	bool m_done;
+};
+
+Gobby::FindInDocumentsDialog::Source::Source(FindInDocumentsDialog& dialog,
+                                             unsigned int document,
+                                             InfSession* session):
+	m_dialog(dialog), m_document(document), m_browser(NULL),
+	m_request(NULL), m_finished_handler(0), m_subscribed(false),
+	m_session(session), m_notify_status_handler(0), m_done(false)
+{
+	g_object_ref(m_session);
+}
+
+Gobby::FindInDocumentsDialog::Source::Source(FindInDocumentsDialog& dialog,
+                                             unsigned int document,
+                                             InfBrowser* browser,
+                                             const InfBrowserIter* iter):
+	m_dialog(dialog), m_document(document), m_browser(browser),
+	m_iter(*iter), m_request(NULL), m_finished_handler(0),
+	m_subscribed(false), m_session(NULL), m_notify_status_handler(0),
+	m_done(false)
+{
+	g_object_ref(m_browser);
+}
+
+Gobby::FindInDocumentsDialog::Source::~Source()
+{
+	if(m_request != NULL)
+	{
+		g_signal_handler_disconnect(m_request, m_finished_handler);
+		g_object_unref(m_request);
+	}
+
+	if(m_session != NULL)
+	{
+		if(m_notify_status_handler != 0)
+		{
+			g_signal_handler_disconnect(
+				m_session, m_notify_status_handler);
+		}
+
+		// Unsubscribe again, unless the user opened the document
+		// in the meanwhile. Sessions of the local server are kept
+		// by the directory anyway.
+		if(m_subscribed && INFC_IS_BROWSER(m_browser) &&
+		   m_dialog.m_folder_manager->lookup_document(
+				m_session) == NULL &&
+		   inf_session_get_status(m_session) != INF_SESSION_CLOSED)
+		{
+			inf_session_close(m_session);
+		}
+
+		g_object_unref(m_session);
+	}
+
+	if(m_browser != NULL)
+		g_object_unref(m_browser);
+}
+
+void Gobby::FindInDocumentsDialog::Source::start()
+{
+	if(m_session != NULL)
+	{
+		check_status();
+		return;
+	}
+
+	if(inf_browser_get_session(m_browser, &m_iter) != NULL)
+	{
+		set_session_from_browser();
+		return;
+	}
+
+	m_request = inf_browser_get_pending_request(
+		m_browser, &m_iter, "subscribe-session");
+	if(m_request == NULL)
+	{
+		m_request = INF_REQUEST(inf_browser_subscribe(
+			m_browser, &m_iter, NULL, NULL));
+		m_subscribed = true;
+	}
+
+	if(m_request != NULL)
+	{
+		g_object_ref(m_request);
+		m_finished_handler = g_signal_connect(
+			G_OBJECT(m_request), "finished",
+			G_CALLBACK(on_subscribe_finished_static), this);
+	}
+	else
+	{
+		// Finished synchronously
+		set_session_from_browser();
+	}
+}
+
+void Gobby::FindInDocumentsDialog::Source::on_subscribe_finished(
+	const GError* error)
+{
+	g_signal_handler_disconnect(m_request, m_finished_handler);
+	g_object_unref(m_request);
+	m_request = NULL;
+
+	if(error != NULL)
+	{
+		m_done = true;
+		m_dialog.on_source_done(*this, NULL);
+	}
+	else
+	{
+		set_session_from_browser();
+	}
+}
+
+void Gobby::FindInDocumentsDialog::Source::set_session_from_browser()
+{
+	InfSessionProxy* proxy = inf_browser_get_session(m_browser, &m_iter);
+	if(proxy == NULL)
+	{
+		m_done = true;
+		m_dialog.on_source_done(*this, NULL);
+		return;
+	}
+
+	g_object_get(G_OBJECT(proxy), "session", &m_session, NULL);
+	check_status();
+}
+
+void Gobby::FindInDocumentsDialog::Source::check_status()
+{
+	if(m_done) return;
+
+	switch(inf_session_get_status(m_session))
+	{
+	case INF_SESSION_PRESYNC:
+	case INF_SESSION_SYNCHRONIZING:
+		// Wait for the document to be synchronized
+		if(m_notify_status_handler == 0)
+		{
+			m_notify_status_handler = g_signal_connect(
+				G_OBJECT(m_session), "notify::status",
+				G_CALLBACK(on_notify_status_static), this);
+		}
+
+		break;
+	case INF_SESSION_RUNNING:
+		m_done = true;
+		m_dialog.on_source_done(*this, m_session);
+		break;
+	case INF_SESSION_CLOSED:
+		m_done = true;
+		m_dialog.on_source_done(*this, NULL);
+		break;
+	}
+}
+
+Gobby::FindInDocumentsDialog::FindInDocumentsDialog(
+	GtkDialog* cobject, const Glib::RefPtr<Gtk::Builder>& builder)
+:
+	Gtk::Dialog(cobject), m_folder_manager(NULL), m_browser(NULL),
+	m_operations(NULL), m_store(Gtk::TreeStore::create(m_columns)),
+	m_pool(g_thread_pool_new(search_thread_func, NULL,
+	                         g_get_num_processors(), FALSE, NULL)),
+	m_n_jobs(0), m_n_searched(0), m_n_failed(0), m_n_results(0),
+	m_walk_browser(NULL), m_explore_request(NULL), m_explore_handler(0),
+	m_jump_session(NULL), m_jump_status_handler(0), m_jump_line(-1),
+	m_jump_column(0), m_jump_length(0)
+{
+	builder->get_widget("search-for", m_entry_find);
+	builder->get_widget("match-case", m_check_case);
+	builder->get_widget("match-entire-word-only", m_check_whole_word);
+	builder->get_widget("regex", m_check_regex);
+	builder->get_widget("open-documents", m_radio_open_documents);
+	builder->get_widget("browser-directory", m_radio_browser_directory);
+	builder->get_widget("results", m_tree_view);
+	builder->get_widget("status", m_label_status);
+
+	m_tree_view->set_model(m_store);
+	m_tree_view->append_column(_("Occurrence"), m_columns.text);
+	m_tree_view->signal_row_activated().connect(
+		sigc::mem_fun(*this, &FindInDocumentsDialog::on_row_activated));
+
+	m_entry_find->signal_changed().connect(
+		sigc::mem_fun(
+			*this, &FindInDocumentsDialog::on_find_text_changed));
+
+	add_button(_("_Close"), Gtk::RESPONSE_CLOSE);
+	add_button(_("_Find"), RESPONSE_FIND);
+	set_default_response(RESPONSE_FIND);
+
+	on_find_text_changed();
+}
+
+std::unique_ptr<Gobby::FindInDocumentsDialog>
+Gobby::FindInDocumentsDialog::create(Gtk::Window& parent,
+                                     FolderManager& folder_manager,
+                                     Browser& browser,
+                                     Operations& operations)
+{
+	Glib::RefPtr<Gtk::Builder> builder =
+		Gtk::Builder::create_from_resource(
+			"/de/0x539/gobby/ui/find-in-documents-dialog.ui");
+
+	FindInDocumentsDialog* dialog_ptr;
+	builder->get_widget_derived("FindInDocumentsDialog", dialog_ptr);
+	std::unique_ptr<FindInDocumentsDialog> dialog(dialog_ptr);
+
+	dialog->set_transient_for(parent);
+	dialog->m_folder_manager = &folder_manager;
+	dialog->m_browser = &browser;
+	dialog->m_operations = &operations;
+	return dialog;
+}
+
+Gobby::FindInDocumentsDialog::~FindInDocumentsDialog()
+{
+	stop_search();
+	set_jump_session(NULL);
+
+	// The search has been cancelled, so the remaining jobs are
+	// finished quickly.
+	g_thread_pool_free(m_pool, FALSE, TRUE);
+
+	for(std::vector<Document>::iterator iter = m_documents.begin();
+	    iter != m_documents.end(); ++iter)
+	{
+		if(iter->browser != NULL) g_object_unref(iter->browser);
+		if(iter->session != NULL) g_object_unref(iter->session);
+	}
+}
+
+void Gobby::FindInDocumentsDialog::on_show()
+{
+	Gtk::Dialog::on_show();
+	m_entry_find->grab_focus();
+}
+
+void Gobby::FindInDocumentsDialog::on_response(int id)
+{
+	switch(id)
+	{
+	case Gtk::RESPONSE_CLOSE:
+		stop_search();
+		hide();
+		break;
+	case RESPONSE_FIND:
+		start_search();
+		break;
+	}
+
+	Gtk::Dialog::on_response(id);
+}
+
+void Gobby::FindInDocumentsDialog::on_find_text_changed()
+{
+	set_response_sensitive(RESPONSE_FIND,
+	                       !m_entry_find->get_text().empty());
+}
+
+void Gobby::FindInDocumentsDialog::start_search()
+{
+	stop_search();
+
+	m_store->clear();
+	for(std::vector<Document>::iterator iter = m_documents.begin();
+	    iter != m_documents.end(); ++iter)
+	{
+		if(iter->browser != NULL) g_object_unref(iter->browser);
+		if(iter->session != NULL) g_object_unref(iter->session);
+	}
+
+	m_documents.clear();
+	m_n_searched = 0;
+	m_n_failed = 0;
+	m_n_results = 0;
+
+	const std::string needle = m_entry_find->get_text();
+	const bool case_sensitive = m_check_case->get_active();
+	GRegex* regex = NULL;
+
+	// The literal search is used where possible, since it is a lot
+	// faster. Everything else is turned into a regular expression.
+	if(m_check_regex->get_active() || m_check_whole_word->get_active() ||
+	   !text_search_supported(needle, case_sensitive))
+	{
+		std::string pattern = needle;
+		if(!m_check_regex->get_active())
+		{
+			gchar* escaped = g_regex_escape_string(
+				needle.c_str(), needle.size());
+			pattern = escaped;
+			g_free(escaped);
+		}
+
+		if(m_check_whole_word->get_active())
+			pattern = "\\b(?:" + pattern + ")\\b";
+
+		int flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+		if(!case_sensitive)
+			flags |= G_REGEX_CASELESS;
+
+		GError* error = NULL;
+		regex = g_regex_new(pattern.c_str(),
+		                    GRegexCompileFlags(flags),
+		                    GRegexMatchFlags(0), &error);
+
+		if(error != NULL)
+		{
+			m_label_status->set_text(
+				Glib::ustring::compose(
+					_("Invalid regular expression: %1"),
+					error->message));
+			g_error_free(error);
+			return;
+		}
+	}
+
+	m_search.reset(new Search(*this, needle, case_sensitive, regex));
+
+	if(m_radio_open_documents->get_active())
+	{
+		const Folder& folder = m_folder_manager->get_text_folder();
+		for(int i = 0; i < folder.get_n_pages(); ++i)
+		{
+			SessionView& view = folder.get_document(i);
+
+			Document document;
+			document.title = view.get_title();
+			document.browser = NULL;
+			document.session = view.get_session();
+			g_object_ref(document.session);
+
+			Source* source = new Source(
+				*this, add_document(document),
+				document.session);
+			m_sources.push_back(source);
+		}
+
+		// Start them only now, since the text of documents that
+		// are synchronized already is read right away.
+		const std::list<Source*> sources(m_sources);
+		for(std::list<Source*>::const_iterator iter = sources.begin();
+		    iter != sources.end(); ++iter)
+		{
+			(*iter)->start();
+		}
+	}
+	else
+	{
+		InfBrowser* browser;
+		InfBrowserIter iter;
+
+		if(!m_browser->get_selected_browser(&browser) ||
+		   !m_browser->get_selected_iter(browser, &iter) ||
+		   inf_browser_get_status(browser) != INF_BROWSER_OPEN)
+		{
+			m_search->cancel();
+			m_search.reset();
+			m_label_status->set_text(
+				_("Please select a directory in the "
+				  "document browser first."));
+			return;
+		}
+
+		if(!inf_browser_is_subdirectory(browser, &iter))
+			inf_browser_get_parent(browser, &iter);
+
+		m_walk_browser = browser;
+		g_object_ref(m_walk_browser);
+		m_walk_directories.push_back(iter);
+		walk();
+	}
+
+	update_status();
+}
+
+void Gobby::FindInDocumentsDialog::stop_search()
+{
+	if(m_search.get() == NULL)
+		return;
+
+	m_search->cancel();
+	m_search.reset();
+	m_n_jobs = 0;
+
+	if(m_explore_request != NULL)
+	{
+		g_signal_handler_disconnect(m_explore_request,
+		                            m_explore_handler);
+		g_object_unref(m_explore_request);
+		m_explore_request = NULL;
+	}
+
+	m_walk_directories.clear();
+	m_queued_documents.clear();
+	if(m_walk_browser != NULL)
+	{
+		g_object_unref(m_walk_browser);
+		m_walk_browser = NULL;
+	}
+
+	for(std::list<Source*>::iterator iter = m_sources.begin();
+	    iter != m_sources.end(); ++iter)
+	{
+		delete *iter;
+	}
+
+	m_sources.clear();
+	on_cleanup_sources();
+
+	update_status();
+}
+
+bool Gobby::FindInDocumentsDialog::is_searching() const
+{
+	return m_search.get() != NULL &&
+		(m_n_jobs > 0 || !m_sources.empty() ||
+		 !m_queued_documents.empty() ||
+		 !m_walk_directories.empty());
+}
+
+void Gobby::FindInDocumentsDialog::update_status()
+{
+	if(m_search.get() == NULL && m_n_searched == 0)
+	{
+		m_label_status->set_text("");
+		return;
+	}
+
+	const Glib::ustring matches = Glib::ustring::compose(
+		ngettext("%1 match", "%1 matches", m_n_results),
+		m_n_results);
+	const Glib::ustring documents = Glib::ustring::compose(
+		ngettext("%1 document", "%1 documents", m_n_searched),
+		m_n_searched);
+
+	// Translators: %1 is the number of matches, such as "3 matches",
+	// and %2 the number of documents, such as "2 documents".
+	Glib::ustring status = Glib::ustring::compose(
+		_("%1 found in %2."), matches, documents);
+
+	if(m_n_failed > 0)
+	{
+		status += " ";
+		status += Glib::ustring::compose(
+			ngettext("%1 document could not be searched.",
+			         "%1 documents could not be searched.",
+			         m_n_failed),
+			m_n_failed);
+	}
+
+	if(is_searching())
+		status = Glib::ustring::compose(_("Searching... %1"), status);
+
+	m_label_status->set_text(status);
+}
+
+unsigned int
+Gobby::FindInDocumentsDialog::add_document(const Document& document)
+{
+	m_documents.push_back(document);
+	return m_documents.size() - 1;
+}
+
+void Gobby::FindInDocumentsDialog::walk()
+{
+	while(m_explore_request == NULL && !m_walk_directories.empty())
+	{
+		InfBrowserIter directory = m_walk_directories.front();
+
+		if(!inf_browser_get_explored(m_walk_browser, &directory))
+		{
+			InfRequest* request = inf_browser_get_pending_request(
+				m_walk_browser, &directory, "explore-node");
+			if(request == NULL)
+			{
+				request = INF_REQUEST(inf_browser_explore(
+					m_walk_browser, &directory,
+					NULL, NULL));
+			}
+
+			if(request != NULL)
+			{
+				m_explore_request = request;
+				g_object_ref(m_explore_request);
+				m_explore_handler = g_signal_connect(
+					G_OBJECT(m_explore_request),
+					"finished",
+					G_CALLBACK(
+						on_explore_finished_static),
+					this);
+				break;
+			}
+		}
+
+		m_walk_directories.pop_front();
+
+		InfBrowserIter child = directory;
+		if(!inf_browser_get_child(m_walk_browser, &child))
+			continue;
+
+		do
+		{
+			if(inf_browser_is_subdirectory(m_walk_browser, &child))
+			{
+				m_walk_directories.push_back(child);
+			}
+			else if(strcmp(inf_browser_get_node_type(
+					m_walk_browser, &child),
+			               "InfText") == 0)
+			{
+				gchar* path = inf_browser_get_path(
+					m_walk_browser, &child);
+
+				Document document;
+				document.title = inf_browser_get_node_name(
+					m_walk_browser, &child);
+				document.browser = m_walk_browser;
+				document.path = path;
+				document.session = NULL;
+				g_object_ref(document.browser);
+				g_free(path);
+
+				m_queued_documents.push_back(
+					QueuedDocument(
+						add_document(document),
+						child));
+			}
+		} while(inf_browser_get_next(m_walk_browser, &child));
+	}
+
+	start_sources();
+}
+
+void Gobby::FindInDocumentsDialog::on_explore_finished(const GError* error)
+{
+	g_signal_handler_disconnect(m_explore_request, m_explore_handler);
+	g_object_unref(m_explore_request);
+	m_explore_request = NULL;
+
+	if(error != NULL)
+	{
+		// Skip this directory
+		m_walk_directories.pop_front();
+		++m_n_failed;
+	}
+
+	walk();
+	update_status();
+}
+
+void Gobby::FindInDocumentsDialog::start_sources()
+{
+	while(m_sources.size() < MAX_SUBSCRIPTIONS &&
+	      !m_queued_documents.empty())
+	{
+		const QueuedDocument queued = m_queued_documents.front();
+		m_queued_documents.pop_front();
+
+		Source* source = new Source(*this, queued.first,
+		                            m_walk_browser, &queued.second);
+		m_sources.push_back(source);
+		source->start();
+	}
+}
+
+void Gobby::FindInDocumentsDialog::on_source_done(Source& source,
+                                                  InfSession* session)
+{
+	if(session != NULL)
+	{
+		// Reading the text is the only part that needs to be done
+		// in the main thread.
+		Job* job = new Job(m_search, source.get_document(),
+		                   get_session_text(session));
+		g_thread_pool_push(m_pool, job, NULL);
+		++m_n_jobs;
+	}
+	else
+	{
+		++m_n_failed;
+	}
+
+	// This is called from signal handlers of the source's session or
+	// request, so don't delete it right away.
+	m_sources.remove(&source);
+	m_done_sources.push_back(&source);
+	if(!m_cleanup_connection.connected())
+	{
+		m_cleanup_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(
+				*this,
+				&FindInDocumentsDialog::on_cleanup_sources));
+	}
+
+	update_status();
+}
+
+bool Gobby::FindInDocumentsDialog::on_cleanup_sources()
+{
+	m_cleanup_connection.disconnect();
+
+	// Deleting the sources unsubscribes from the documents that we
+	// subscribed to only for searching them.
+	for(std::vector<Source*>::iterator iter = m_done_sources.begin();
+	    iter != m_done_sources.end(); ++iter)
+	{
+		delete *iter;
+	}
+
+	m_done_sources.clear();
+
+	if(m_search.get() != NULL)
+		start_sources();
+
+	return false;
+}
+
+void Gobby::FindInDocumentsDialog::search_thread_func(gpointer data,
+                                                      gpointer user_data)
+{
+	Job* job = static_cast<Job*>(data);
+	if(!job->search->cancelled)
+		job->run();
+
+	g_idle_add(on_job_done_static, job);
+}
+
+gboolean Gobby::FindInDocumentsDialog::on_job_done_static(gpointer data)
+{
+	std::unique_ptr<Job> job(static_cast<Job*>(data));
+
+	FindInDocumentsDialog* dialog = job->search->dialog;
+	if(dialog != NULL)
+		dialog->on_job_done(*job);
+
+	return FALSE;
+}
+
+void Gobby::FindInDocumentsDialog::on_job_done(Job& job)
+{
+	StallProfiler::Scope profile("FindInDocumentsDialog::on_job_done");
+
+	--m_n_jobs;
+	++m_n_searched;
+	m_n_results += job.n_results;
+
+	if(job.n_results > 0)
+	{
+		const Document& document = m_documents[job.document];
+
+		Gtk::TreeIter parent = m_store->append();
+		(*parent)[m_columns.text] = Glib::ustring::compose(
+			ngettext("%1 (%2 match)", "%1 (%2 matches)",
+			         job.n_results),
+			document.title, job.n_results);
+		(*parent)[m_columns.document] = job.document;
+		(*parent)[m_columns.line] = -1;
+
+		for(std::vector<Job::Result>::const_iterator iter =
+			job.results.begin();
+		    iter != job.results.end(); ++iter)
+		{
+			Gtk::TreeIter row = m_store->append(parent->children());
+			(*row)[m_columns.text] = Glib::ustring::compose(
+				_("%1: %2"), iter->line + 1, iter->preview);
+			(*row)[m_columns.document] = job.document;
+			(*row)[m_columns.line] = iter->line;
+			(*row)[m_columns.column] = iter->column;
+			(*row)[m_columns.length] = iter->length;
+		}
+
+		if(job.results.size() < job.n_results)
+		{
+			const unsigned int n_more =
+				job.n_results - job.results.size();
+
+			Gtk::TreeIter row = m_store->append(parent->children());
+			(*row)[m_columns.text] = Glib::ustring::compose(
+				ngettext("%1 more match is not shown",
+				         "%1 more matches are not shown",
+				         n_more),
+				n_more);
+			(*row)[m_columns.document] = job.document;
+			(*row)[m_columns.line] = -1;
+		}
+
+		m_tree_view->expand_row(m_store->get_path(parent), false);
+	}
+
+	update_status();
+}
+
+void Gobby::FindInDocumentsDialog::on_row_activated(
+	const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn* column)
+{
+	Gtk::TreeIter row = m_store->get_iter(path);
+	const Document& document = m_documents[(*row)[m_columns.document]];
+
+	m_jump_line = (*row)[m_columns.line];
+	m_jump_column = (*row)[m_columns.column];
+	m_jump_length = (*row)[m_columns.length];
+	set_jump_session(NULL);
+
+	SessionView* view = NULL;
+	if(document.session != NULL)
+		view = m_folder_manager->lookup_document(document.session);
+
+	if(view != NULL)
+	{
+		m_folder_manager->switch_to_document(*view);
+		jump(static_cast<TextSessionView&>(*view), m_jump_line,
+		     m_jump_column, m_jump_length);
+	}
+	else if(document.browser != NULL)
+	{
+		// Subscribes to the document, or switches to it if it is
+		// open already.
+		m_jump_path = document.path;
+		OperationSubscribePath* operation =
+			m_operations->subscribe_path(
+				document.browser, document.path);
+
+		if(operation != NULL)
+		{
+			operation->signal_finished().connect(
+				sigc::mem_fun(
+					*this,
+					&FindInDocumentsDialog::
+						on_subscribe_finished));
+		}
+		else
+		{
+			on_subscribe_finished(true);
+		}
+	}
+	else
+	{
+		m_label_status->set_text(Glib::ustring::compose(
+			_("Document \"%1\" has been closed."),
+			document.title));
+	}
+}
+
+void Gobby::FindInDocumentsDialog::jump(TextSessionView& view, int line,
+                                        int column, int length)
+{
+	if(line < 0) return;
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
+
+	// The document might have changed since it was searched, so make
+	// sure not to go beyond the end of the line.
+	GtkTextIter begin, end;
+	gtk_text_buffer_get_iter_at_line(buffer, &begin, line);
+	GtkTextIter line_end = begin;
+	if(!gtk_text_iter_ends_line(&line_end))
+		gtk_text_iter_forward_to_line_end(&line_end);
+
+	gtk_text_iter_forward_chars(&begin, column);
+	if(gtk_text_iter_compare(&begin, &line_end) > 0)
+		begin = line_end;
+
+	end = begin;
+	gtk_text_iter_forward_chars(&end, length);
+
+	view.set_selection(&begin, &end);
+}
+
+void Gobby::FindInDocumentsDialog::on_subscribe_finished(bool success)
+{
+	if(!success) return;
+
+	// The operation switches to the document when it is done
+	TextSessionView* view = dynamic_cast<TextSessionView*>(
+		m_folder_manager->get_text_folder().get_current_document());
+	if(view == NULL || view->get_path().raw() != m_jump_path)
+		return;
+
+	if(inf_session_get_status(view->get_session()) == INF_SESSION_RUNNING)
+	{
+		jump(*view, m_jump_line, m_jump_column, m_jump_length);
+	}
+	else
+	{
+		// Wait for the document to be synchronized
+		set_jump_session(view->get_session());
+	}
+}
+
+void Gobby::FindInDocumentsDialog::on_jump_status_changed()
+{
+	const InfSessionStatus status =
+		inf_session_get_status(m_jump_session);
+	if(status == INF_SESSION_RUNNING)
+	{
+		SessionView* view =
+			m_folder_manager->lookup_document(m_jump_session);
+		if(view != NULL)
+		{
+			jump(static_cast<TextSessionView&>(*view),
+			     m_jump_line, m_jump_column, m_jump_length);
+		}
+
+		set_jump_session(NULL);
+	}
+	else if(status == INF_SESSION_CLOSED)
+	{
+		set_jump_session(NULL);
+	}
+}
+
+void Gobby::FindInDocumentsDialog::set_jump_session(InfSession* session)
+{
+	if(m_jump_session != NULL)
+	{
+		g_signal_handler_disconnect(m_jump_session,
+		                            m_jump_status_handler);
+		g_object_unref(m_jump_session);
+	}
+
+	m_jump_session = session;
+
+	if(m_jump_session != NULL)
+	{
+		g_object_ref(m_jump_session);
+		m_jump_status_handler = g_signal_connect(
+			G_OBJECT(m_jump_session), "notify::status",
+			G_CALLBACK(on_jump_status_changed_static), this);
+	}
+}
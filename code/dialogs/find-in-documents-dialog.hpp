@@ -0,0 +1,198 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef _GOBBY_FINDINDOCUMENTSDIALOG_HPP_
+#define _GOBBY_FINDINDOCUMENTSDIALOG_HPP_
+
+#include "operations/operations.hpp"
+#include "core/foldermanager.hpp"
+#include "core/browser.hpp"
+
+#include <gtkmm/dialog.h>
+#include <gtkmm/label.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/checkbutton.h>
+#include <gtkmm/radiobutton.h>
+#include <gtkmm/treeview.h>
+#include <gtkmm/treestore.h>
+#include <gtkmm/builder.h>
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Gobby
+{
+
+// Searches many documents at once: either all documents that are currently
+// open, or all documents below a directory in the document browser. For the
+// latter, documents that are not open are subscribed to in the background
+// and unsubscribed again after they have been searched. The text of the
+// documents is searched by a pool of worker threads, and the results are
+// shown grouped by document as they come in.
+class FindInDocumentsDialog: public Gtk::Dialog
+{
+private:
+	friend class Gtk::Builder;
+	FindInDocumentsDialog(GtkDialog* cobject,
+	                      const Glib::RefPtr<Gtk::Builder>& builder);
+
+public:
+	static std::unique_ptr<FindInDocumentsDialog>
+	create(Gtk::Window& parent, FolderManager& folder_manager,
+	       Browser& browser, Operations& operations);
+
+	~FindInDocumentsDialog();
+
+protected:
+	class Search;
+	class Job;
+	class Source;
+
+	struct Document
+	{
+		Glib::ustring title;
+
+		// For documents from the document browser, so that they can
+		// be subscribed to when a result is activated.
+		InfBrowser* browser;
+		std::string path;
+
+		// For documents that were open when they were searched
+		InfSession* session;
+	};
+
+	class Columns: public Gtk::TreeModelColumnRecord
+	{
+	public:
+		Gtk::TreeModelColumn<Glib::ustring> text;
+		Gtk::TreeModelColumn<unsigned int> document;
+		// -1 for rows that do not refer to a particular occurrence
+		Gtk::TreeModelColumn<int> line;
+		Gtk::TreeModelColumn<int> column;
+		Gtk::TreeModelColumn<int> length;
+
+		Columns()
+		{
+			add(text);
+			add(document);
+			add(line);
+			add(column);
+			add(length);
+		}
+	};
+
+	virtual void on_show();
+	virtual void on_response(int id);
+
+	void on_find_text_changed();
+	void on_row_activated(const Gtk::TreeModel::Path& path,
+	                      Gtk::TreeViewColumn* column);
+
+	static void search_thread_func(gpointer data, gpointer user_data);
+	static gboolean on_job_done_static(gpointer data);
+
+	static void on_explore_finished_static(InfRequest* request,
+	                                       const InfRequestResult* result,
+	                                       const GError* error,
+	                                       gpointer user_data)
+	{
+		static_cast<FindInDocumentsDialog*>(user_data)->
+			on_explore_finished(error);
+	}
+
+	static void on_jump_status_changed_static(GObject* object,
+	                                          GParamSpec* pspec,
+	                                          gpointer user_data)
+	{
+		static_cast<FindInDocumentsDialog*>(user_data)->
+			on_jump_status_changed();
+	}
+
+	void start_search();
+	void stop_search();
+	bool is_searching() const;
+	void update_status();
+
+	unsigned int add_document(const Document& document);
+
+	// Explores the directory to search, and queues the documents in it
+	void walk();
+	void on_explore_finished(const GError* error);
+
+	// Starts subscriptions for queued documents
+	void start_sources();
+	void on_source_done(Source& source, InfSession* session);
+	bool on_cleanup_sources();
+
+	void on_job_done(Job& job);
+
+	void jump(TextSessionView& view, int line, int column, int length);
+	void on_subscribe_finished(bool success);
+	void on_jump_status_changed();
+	void set_jump_session(InfSession* session);
+
+	FolderManager* m_folder_manager;
+	Browser* m_browser;
+	Operations* m_operations;
+
+	Gtk::Entry* m_entry_find;
+	Gtk::CheckButton* m_check_case;
+	Gtk::CheckButton* m_check_whole_word;
+	Gtk::CheckButton* m_check_regex;
+	Gtk::RadioButton* m_radio_open_documents;
+	Gtk::RadioButton* m_radio_browser_directory;
+	Gtk::TreeView* m_tree_view;
+	Gtk::Label* m_label_status;
+
+	Columns m_columns;
+	Glib::RefPtr<Gtk::TreeStore> m_store;
+
+	GThreadPool* m_pool;
+	std::shared_ptr<Search> m_search;
+	std::vector<Document> m_documents;
+	unsigned int m_n_jobs;
+	unsigned int m_n_searched;
+	unsigned int m_n_failed;
+	unsigned int m_n_results;
+
+	InfBrowser* m_walk_browser;
+	std::deque<InfBrowserIter> m_walk_directories;
+	InfRequest* m_explore_request;
+	gulong m_explore_handler;
+
+	typedef std::pair<unsigned int, InfBrowserIter> QueuedDocument;
+	std::deque<QueuedDocument> m_queued_documents;
+	std::list<Source*> m_sources;
+	std::vector<Source*> m_done_sources;
+	sigc::connection m_cleanup_connection;
+
+	// The occurrence to select once the document it is in has been
+	// subscribed to and synchronized.
+	std::string m_jump_path;
+	InfSession* m_jump_session;
+	gulong m_jump_status_handler;
+	int m_jump_line;
+	int m_jump_column;
+	int m_jump_length;
+};
+
+}
+
+#endif // _GOBBY_FINDINDOCUMENTSDIALOG_HPP_
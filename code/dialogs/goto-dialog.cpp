@@ -66,6 +66,10 @@ void Gobby::GotoDialog::on_show()
 
 	if(m_current_view != NULL)
 	{
+		// The range is not kept up to date while the dialog is
+		// hidden.
+		on_changed();
+
 		GtkTextBuffer* buffer = GTK_TEXT_BUFFER(
 			m_current_view->get_text_buffer());
 		GtkTextIter cursor;
@@ -135,6 +139,11 @@ void Gobby::GotoDialog::on_changed()
 		return;
 	}
 
+	// Don't bother the spin button with every remote edit while nobody
+	// looks at it.
+	if(!get_visible())
+		return;
+
 	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(
 		m_current_view->get_text_buffer());
 
@@ -17,6 +17,7 @@
 #include "dialogs/preferences-dialog.hpp"
 #include "util/i18n.hpp"
 
+#include <glibmm/main.h>
 #include <glibmm/markup.h>
 #include <gtkmm/messagedialog.h>
 #include <gtkmm/scrolledwindow.h>
@@ -158,7 +159,9 @@ namespace
 
 Gobby::PreferencesDialog::User::User(
 	const Glib::RefPtr<Gtk::Builder>& builder,
-	Preferences& preferences)
+	Preferences& preferences,
+	const SelfHoster* self_hoster):
+	m_self_hoster(self_hoster)
 {
 	builder->get_widget("user-name", m_ent_user_name);
 	builder->get_widget_derived("user-color", m_btn_user_color);
@@ -185,6 +188,10 @@ Gobby::PreferencesDialog::User::User(
 	                    m_grid_local_documents_directory);
 	builder->get_widget("local-documents-directory",
 	                    m_btn_local_documents_directory);
+	builder->get_widget("journal-local-documents",
+	                    m_btn_local_journal_documents);
+	builder->get_widget("local-documents-resident",
+	                    m_lbl_local_resident_sessions);
 
 	m_conn_local_documents_directory.reset(new PathConnection(
 		*m_btn_local_documents_directory,
@@ -261,12 +268,47 @@ Gobby::PreferencesDialog::User::User(
 	m_btn_local_documents_directory->set_filename(
 		static_cast<std::string>(preferences.user.host_directory));
 
+	m_btn_local_journal_documents->set_active(
+		preferences.user.journal_local_documents);
+	connect_option(*m_btn_local_journal_documents,
+	               preferences.user.journal_local_documents);
+
+	if(m_self_hoster != NULL)
+	{
+		// The size changes with every edit, so poll it while it is
+		// shown, in addition to updating when sessions come and go.
+		m_conn_resident_sessions =
+			m_self_hoster->signal_resident_sessions_changed()
+				.connect(sigc::mem_fun(
+					*this,
+					&User::on_resident_sessions_changed));
+		m_resident_sessions_timeout =
+			Glib::signal_timeout().connect_seconds(
+				sigc::mem_fun(
+					*this,
+					&User::on_resident_sessions_timeout),
+				5);
+		m_lbl_local_resident_sessions->signal_map().connect(
+			sigc::mem_fun(
+				*this, &User::update_resident_sessions));
+	}
+	else
+	{
+		m_lbl_local_resident_sessions->hide();
+	}
+
 	// Initial sensitivity
 	on_local_allow_connections_toggled();
 	on_local_require_password_toggled();
 	on_local_keep_documents_toggled();
 }
 
+Gobby::PreferencesDialog::User::~User()
+{
+	m_conn_resident_sessions.disconnect();
+	m_resident_sessions_timeout.disconnect();
+}
+
 void Gobby::PreferencesDialog::User::on_local_allow_connections_toggled()
 {
 	m_grid_local_connections->set_sensitive(
@@ -285,6 +327,33 @@ void Gobby::PreferencesDialog::User::on_local_keep_documents_toggled()
 		m_btn_local_keep_documents->get_active());
 }
 
+void Gobby::PreferencesDialog::User::on_resident_sessions_changed()
+{
+	if(m_lbl_local_resident_sessions->get_mapped())
+		update_resident_sessions();
+}
+
+bool Gobby::PreferencesDialog::User::on_resident_sessions_timeout()
+{
+	on_resident_sessions_changed();
+	return true;
+}
+
+void Gobby::PreferencesDialog::User::update_resident_sessions()
+{
+	const unsigned int n_sessions =
+		m_self_hoster->get_n_resident_sessions();
+	gchar* size = g_format_size(m_self_hoster->get_resident_size());
+
+	m_lbl_local_resident_sessions->set_text(Glib::ustring::compose(
+		ngettext("%1 hosted document is loaded, using about %2",
+		         "%1 hosted documents are loaded, using about %2",
+		         n_sessions),
+		n_sessions, size));
+
+	g_free(size);
+}
+
 Gobby::PreferencesDialog::Editor::Editor(
 	const Glib::RefPtr<Gtk::Builder>& builder,
 	Preferences& preferences)
@@ -297,6 +366,7 @@ Gobby::PreferencesDialog::Editor::Editor(
 	builder->get_widget("grid-autosave-interval",
 	                    m_grid_autosave_interval);
 	builder->get_widget("autosave-interval", m_ent_autosave_interval);
+	builder->get_widget("undo-history-size", m_ent_undo_history_size);
 
 	const unsigned int tab_width = preferences.editor.tab_width;
 	const bool tab_spaces = preferences.editor.tab_spaces;
@@ -306,6 +376,8 @@ Gobby::PreferencesDialog::Editor::Editor(
 		preferences.editor.autosave_enabled;
 	const unsigned int autosave_interval =
 		preferences.editor.autosave_interval;
+	const unsigned int undo_history_size =
+		preferences.editor.undo_history_size;
 
 	m_btn_autosave_enabled->signal_toggled().connect(
 		sigc::mem_fun(*this, &Editor::on_autosave_enabled_toggled));
@@ -336,6 +408,13 @@ Gobby::PreferencesDialog::Editor::Editor(
 	connect_option(*m_ent_autosave_interval,
 	               preferences.editor.autosave_interval);
 
+	// Same range as in the schema
+	m_ent_undo_history_size->set_range(64, 1048576);
+	m_ent_undo_history_size->set_value(undo_history_size);
+	m_ent_undo_history_size->set_increments(64, 1024);
+	connect_option(*m_ent_undo_history_size,
+	               preferences.editor.undo_history_size);
+
 	// Initial sensitivity
 	on_autosave_enabled_toggled();
 }
@@ -802,11 +881,12 @@ Gobby::PreferencesDialog::PreferencesDialog(
 	const Glib::RefPtr<Gtk::Builder>& builder,
 	FileChooser& file_chooser,
 	Preferences& preferences,
-	CertificateManager& cert_manager
+	CertificateManager& cert_manager,
+	const SelfHoster* self_hoster
 ):
 	Gtk::Dialog(GTK_DIALOG(gtk_builder_get_object(builder->gobj(),
 	                                              "PreferencesDialog"))),
-	m_page_user(builder, preferences),
+	m_page_user(builder, preferences, self_hoster),
 	m_page_editor(builder, preferences),
 	m_page_view(builder, preferences),
 	m_page_appearance(builder, preferences),
@@ -819,7 +899,8 @@ std::unique_ptr<Gobby::PreferencesDialog>
 Gobby::PreferencesDialog::create(Gtk::Window& parent,
                                  FileChooser& file_chooser,
                                  Preferences& preferences,
-	                         CertificateManager& cert_manager)
+	                         CertificateManager& cert_manager,
+                                 const SelfHoster* self_hoster)
 {
 	Glib::RefPtr<Gtk::Builder> builder =
 		Gtk::Builder::create_from_resource(
@@ -827,7 +908,8 @@ Gobby::PreferencesDialog::create(Gtk::Window& parent,
 
 	std::unique_ptr<PreferencesDialog> dialog(
 		new PreferencesDialog(builder, file_chooser,
-		                      preferences, cert_manager));
+		                      preferences, cert_manager,
+		                      self_hoster));
 
 	dialog->set_transient_for(parent);
 	return dialog;
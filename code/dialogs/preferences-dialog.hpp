@@ -22,6 +22,7 @@
 #include "core/certificatemanager.hpp"
 #include "core/credentialsgenerator.hpp"
 #include "core/huebutton.hpp"
+#include "core/selfhoster.hpp"
 
 #include <gtkmm/dialog.h>
 #include <gtkmm/grid.h>
@@ -101,12 +102,16 @@ private:
 	PreferencesDialog(const Glib::RefPtr<Gtk::Builder>& builder,
 	                  FileChooser& file_chooser,
 	                  Preferences& preferences,
-	                  CertificateManager& cert_manager);
+	                  CertificateManager& cert_manager,
+	                  const SelfHoster* self_hoster);
 
 public:
+	// self_hoster can be NULL, in which case no statistics about the
+	// hosted documents are shown.
 	static std::unique_ptr<PreferencesDialog> create(
 		Gtk::Window& parent, FileChooser& file_chooser,
-		Preferences& preferences, CertificateManager& cert_manager);
+		Preferences& preferences, CertificateManager& cert_manager,
+		const SelfHoster* self_hoster);
 
 	// An object which keeps two values in sync with each other, using
 	// notification signals of both objects.
@@ -270,13 +275,21 @@ public:
 	{
 	public:
 		User(const Glib::RefPtr<Gtk::Builder>& builder,
-		     Preferences& preferences);
+		     Preferences& preferences,
+		     const SelfHoster* self_hoster);
+		~User();
 
 	protected:
 		void on_local_allow_connections_toggled();
 		void on_local_require_password_toggled();
 		void on_local_keep_documents_toggled();
 
+		void on_resident_sessions_changed();
+		bool on_resident_sessions_timeout();
+		void update_resident_sessions();
+
+		const SelfHoster* m_self_hoster;
+
 		Gtk::Entry* m_ent_user_name;
 		HueButton* m_btn_user_color;
 
@@ -298,6 +311,11 @@ public:
 		Gtk::FileChooserButton* m_btn_local_documents_directory;
 		std::unique_ptr<PathConnection>
 			m_conn_local_documents_directory;
+		Gtk::CheckButton* m_btn_local_journal_documents;
+		Gtk::Label* m_lbl_local_resident_sessions;
+
+		sigc::connection m_conn_resident_sessions;
+		sigc::connection m_resident_sessions_timeout;
 	};
 
 	class Editor
@@ -319,6 +337,8 @@ public:
 		Gtk::CheckButton* m_btn_autosave_enabled;
 		Gtk::Grid* m_grid_autosave_interval;
 		Gtk::SpinButton* m_ent_autosave_interval;
+
+		Gtk::SpinButton* m_ent_undo_history_size;
 	};
 
 	class View
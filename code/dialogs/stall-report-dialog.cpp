@@ -0,0 +1,107 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "dialogs/stall-report-dialog.hpp"
+#include "util/stallprofiler.hpp"
+#include "util/i18n.hpp"
+
+namespace
+{
+	enum {
+		RESPONSE_REFRESH = 1
+	};
+}
+
+Gobby::StallReportDialog::StallReportDialog(
+	GtkDialog* cobject, const Glib::RefPtr<Gtk::Builder>& builder)
+:
+	Gtk::Dialog(cobject), m_store(Gtk::ListStore::create(m_columns))
+{
+	builder->get_widget("tree-view", m_tree_view);
+
+	m_tree_view->set_model(m_store);
+	m_tree_view->append_column(_("Callback"), m_columns.name);
+	m_tree_view->append_column(_("Dispatches"), m_columns.dispatches);
+	m_tree_view->append_column(_("Stalls"), m_columns.stalls);
+	m_tree_view->append_column(_("95th percentile"), m_columns.p95);
+	m_tree_view->append_numeric_column(_("Max (ms)"), m_columns.max,
+	                                   "%.1f");
+	m_tree_view->append_numeric_column(_("Total (ms)"), m_columns.total,
+	                                   "%.1f");
+
+	add_button(_("_Refresh"), RESPONSE_REFRESH);
+	add_button(_("_Close"), Gtk::RESPONSE_CLOSE);
+	set_default_response(Gtk::RESPONSE_CLOSE);
+
+	refresh();
+}
+
+std::unique_ptr<Gobby::StallReportDialog>
+Gobby::StallReportDialog::create(Gtk::Window& parent)
+{
+	Glib::RefPtr<Gtk::Builder> builder =
+		Gtk::Builder::create_from_resource(
+			"/de/0x539/gobby/ui/stall-report-dialog.ui");
+
+	StallReportDialog* dialog_ptr;
+	builder->get_widget_derived("StallReportDialog", dialog_ptr);
+	std::unique_ptr<StallReportDialog> dialog(dialog_ptr);
+
+	dialog->set_transient_for(parent);
+	return dialog;
+}
+
+void Gobby::StallReportDialog::refresh()
+{
+	m_store->clear();
+
+	const std::vector<StallProfiler::Site> sites =
+		StallProfiler::get_sites();
+	for(std::vector<StallProfiler::Site>::const_iterator iter =
+		sites.begin(); iter != sites.end(); ++iter)
+	{
+		Gtk::TreeIter row = m_store->append();
+		(*row)[m_columns.name] = iter->name;
+		(*row)[m_columns.dispatches] = iter->dispatches;
+		(*row)[m_columns.stalls] = iter->stalls;
+		(*row)[m_columns.max] = iter->max_time / 1000.0;
+		(*row)[m_columns.total] = iter->total_time / 1000.0;
+
+		const gint64 p95 = iter->get_percentile(0.95);
+		if(p95 < 0)
+		{
+			(*row)[m_columns.p95] = Glib::ustring::compose(
+				_("over %1 ms"),
+				static_cast<gint64>(1) <<
+					(StallProfiler::N_BUCKETS - 2));
+		}
+		else
+		{
+			(*row)[m_columns.p95] = Glib::ustring::compose(
+				_("below %1 ms"), p95);
+		}
+	}
+}
+
+void Gobby::StallReportDialog::on_response(int id)
+{
+	if(id == RESPONSE_REFRESH)
+		refresh();
+	else
+		hide();
+
+	Gtk::Dialog::on_response(id);
+}
@@ -0,0 +1,75 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_STALLREPORTDIALOG_HPP_
+#define _GOBBY_STALLREPORTDIALOG_HPP_
+
+#include <gtkmm/dialog.h>
+#include <gtkmm/treeview.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/builder.h>
+
+namespace Gobby
+{
+
+// Shows the data collected by the StallProfiler, one row per callback site.
+class StallReportDialog: public Gtk::Dialog
+{
+private:
+	friend class Gtk::Builder;
+
+	StallReportDialog(GtkDialog* cobject,
+	                  const Glib::RefPtr<Gtk::Builder>& builder);
+
+public:
+	static std::unique_ptr<StallReportDialog> create(Gtk::Window& parent);
+
+	// Reloads the data from the profiler.
+	void refresh();
+
+protected:
+	virtual void on_response(int id);
+
+	class Columns: public Gtk::TreeModelColumnRecord
+	{
+	public:
+		Gtk::TreeModelColumn<Glib::ustring> name;
+		Gtk::TreeModelColumn<guint64> dispatches;
+		Gtk::TreeModelColumn<guint64> stalls;
+		Gtk::TreeModelColumn<Glib::ustring> p95;
+		Gtk::TreeModelColumn<double> max;
+		Gtk::TreeModelColumn<double> total;
+
+		Columns()
+		{
+			add(name);
+			add(dispatches);
+			add(stalls);
+			add(p95);
+			add(max);
+			add(total);
+		}
+	};
+
+	Columns m_columns;
+	Glib::RefPtr<Gtk::ListStore> m_store;
+
+	Gtk::TreeView* m_tree_view;
+};
+
+}
+
+#endif // _GOBBY_STALLREPORTDIALOG_HPP_
@@ -14,20 +14,18 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-// Include this first because some of the other headers include X11.h which,
-// among others, #defines "None".
-#include <libxml++/libxml++.h>
-
 #include "operations/operation-export-html.hpp"
 
 #include "util/i18n.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <gtkmm/textbuffer.h>
 #include <gtksourceview/gtksource.h>
 
 #include <libinftextgtk/inf-text-gtk-buffer.h>
 
-#include <iomanip>
+#include <algorithm>
+#include <vector>
 #include <ctime>
 #include <cstring>
 #include <cmath>
@@ -47,8 +45,6 @@ namespace
 		}
 	};
 
-	typedef std::set<GtkTextTag*, TagComparator> priority_tag_set;
-
 	// We don't use Glib::ustring::compose for now because
 	// it's formatting support does not compile properly under
 	// Windows. See https://bugzilla.gnome.org/show_bug.cgi?id=599340
@@ -84,152 +80,204 @@ namespace
 		return (red << 16) | (green << 8) | blue;
 	}
 
-	Glib::ustring get_current_tags(priority_tag_set& tags,
-	                               GtkTextIter* iter)
+	// Append text to out, escaped the same way libxml2 serializes text
+	// nodes and, if attribute is set, attribute values.
+	void append_escaped(std::string& out, const char* text,
+	                    std::size_t len, bool attribute)
+	{
+		const char* last = text;
+		const char* end = text + len;
+		for(const char* cur = text; cur != end; ++cur)
+		{
+			const char* replacement;
+			switch(*cur)
+			{
+			case '<': replacement = "&lt;"; break;
+			case '>': replacement = "&gt;"; break;
+			case '&': replacement = "&amp;"; break;
+			case '\r': replacement = "&#13;"; break;
+			case '"':
+				replacement = attribute ? "&quot;" : NULL;
+				break;
+			case '\n':
+				replacement = attribute ? "&#10;" : NULL;
+				break;
+			case '\t':
+				replacement = attribute ? "&#9;" : NULL;
+				break;
+			default: replacement = NULL; break;
+			}
+
+			if(replacement != NULL)
+			{
+				out.append(last, cur - last);
+				out.append(replacement);
+				last = cur + 1;
+			}
+		}
+
+		out.append(last, end - last);
+	}
+
+	void append_text(std::string& out, const Glib::ustring& text)
+	{
+		append_escaped(out, text.data(), text.bytes(), false);
+	}
+
+	void append_attribute(std::string& out, const char* name,
+	                      const Glib::ustring& value)
+	{
+		out += ' ';
+		out += name;
+		out += "=\"";
+		append_escaped(out, value.data(), value.bytes(), true);
+		out += '"';
+	}
+
+	void append_line_no(std::string& out, unsigned int line)
+	{
+		out += "<span class=\"line_no\" id=\"";
+		out += uprintf("line_%d", line);
+		out += "\"/>";
+	}
+
+	// Append the CSS declarations for the properties that tag sets to
+	// out, either formatted for the style sheet in the head of the
+	// document or, if inline_style is set, for a style attribute.
+	void append_tag_declarations(std::string& out, GtkTextTag* tag,
+	                             bool inline_style)
+	{
+		GdkRGBA* fg, * bg;
+		gint weight;
+		gboolean underline;
+		PangoStyle style;
+		gboolean fg_set, bg_set, weight_set,
+			underline_set, style_set;
+		g_object_get(G_OBJECT(tag),
+			"background-rgba", &bg,
+			"foreground-rgba", &fg,
+			"weight",          &weight,
+			"underline",       &underline,
+			"style",           &style,
+			"background-set",  &bg_set,
+			"foreground-set",  &fg_set,
+			"weight-set",      &weight_set,
+			"underline-set",   &underline_set,
+			"style-set",       &style_set,
+			NULL);
+
+		unsigned int bg_rgb = 0, fg_rgb = 0;
+		if(fg_set) fg_rgb = rgba_to_rgb24(fg);
+		if(bg_set) bg_rgb = rgba_to_rgb24(bg);
+
+		gdk_rgba_free(fg);
+		gdk_rgba_free(bg);
+
+		const char* color;
+		const char* background_color;
+		const char* font_weight;
+		const char* text_decoration;
+		const char* font_style;
+		if(inline_style)
+		{
+			color = "color: #%06x; ";
+			background_color = "background-color: #%06x; ";
+			font_weight = "font-weight: %d; ";
+			text_decoration = "text-decoration: %s; ";
+			font_style = "font-style: %s; ";
+		}
+		else
+		{
+			color = "  color:                  #%06x;";
+			background_color = "  background-color:       #%06x;";
+			font_weight = "  font-weight:            %d;";
+			text_decoration = "  text-decoration:        %s;";
+			font_style = "  font-style:             %s;";
+		}
+
+		if(fg_set)
+			out += uprintf(color, fg_rgb);
+		if(bg_set)
+			out += uprintf(background_color, bg_rgb);
+		if(weight_set)
+			out += uprintf(font_weight, weight);
+		if(underline_set)
+			out += uprintf(text_decoration,
+			               underline ? "underline" : "none");
+		if(style_set)
+			out += uprintf(font_style,
+			               (style == PANGO_STYLE_ITALIC) ?
+			                       "italic" : "none");
+	}
+
+	// write the classes of the tags at iter into classes. Tags that
+	// have no class in the style sheet, because they were created only
+	// after the head of the document was written, are styled inline
+	// instead: then style receives the declarations of all tags at iter
+	// in order of their priority, so that they override each other in
+	// the same way as in the style sheet.
+	void get_current_tags(const std::set<GtkTextTag*>& tags,
+	                      GtkTextIter* iter,
+	                      Glib::ustring& classes,
+	                      std::string& style)
 	{
 		GSList* current_tags = gtk_text_iter_get_tags(iter);
 		// make sure to free current_tags in an exception-safe manner:
 		Glib::SListHandle<Glib::RefPtr<Gtk::TextTag> > handle(
 			current_tags, Glib::OWNERSHIP_SHALLOW);
-		Glib::ustring classes;
+		classes.clear();
+		style.clear();
+
+		bool styled = true;
 		for(GSList* tag = current_tags;
 		    tag != 0;
 		    tag = tag->next)
 		{
+			if(tags.find(GTK_TEXT_TAG(tag->data)) == tags.end())
+			{
+				styled = false;
+				continue;
+			}
+
 			if(!classes.empty())
 				classes += ' ';
 			classes += uprintf(
 				"tag_%p",
 				static_cast<void*>(tag->data));
-			tags.insert(GTK_TEXT_TAG(tag->data));
-		}
-
-		return classes;
-	}
-
-	// write the Gtk::TextBuffer from document into content, inserting
-	// <span/>s for line breaks and authorship of chunks of text, also
-	// save all users and tags encountered and the total number of
-	// lines dumped
-	void dump_buffer(Gobby::TextSessionView& view,
-		         xmlpp::Element* content,
-		         std::set<InfTextUser*>& users,
-		         priority_tag_set& tags,
-		         unsigned int& line_counter)
-	{
-		using namespace Gobby;
-		users.clear();
-		tags.clear();
-		line_counter = 1;
-		xmlpp::Element* last_node = content;
-		xmlpp::Element* line_no = last_node->add_child("span");
-		line_no->set_attribute("class", "line_no");
-		line_no->set_attribute("id", "line_1");
-
-		GtkTextBuffer* buffer = GTK_TEXT_BUFFER(
-			view.get_text_buffer());
-		InfTextGtkBuffer* inf_buffer
-			= INF_TEXT_GTK_BUFFER(
-				inf_session_get_buffer(
-					INF_SESSION(view.get_session())));
-
-		GtkTextIter begin;
-		gtk_text_buffer_get_start_iter(buffer, &begin);
-		{
-			GtkTextIter end;
-			gtk_text_buffer_get_end_iter(buffer, &end);
-			gtk_source_buffer_ensure_highlight(
-				GTK_SOURCE_BUFFER(buffer),
-				&begin,
-				&end);
 		}
 
-		// iterate through chunks of text during which the currently
-		// set tags do not change, write each as a <span/>
-		while(!gtk_text_iter_is_end(&begin))
+		// gtk_text_iter_get_tags() returns the tags in ascending
+		// order of priority
+		if(!styled)
 		{
-			// add current tags as classes for CSS formatting
-			// (both for author of text and syntax highlighting)
-			Glib::ustring classes = get_current_tags(tags, &begin);
-			if(!classes.empty())
-			{
-				last_node = last_node->add_child("span");
-				last_node->set_attribute("class", classes);
-
-				// add mouseover "written by" popup
-				// this only needs to happen when there are tags,
-				// because the presence of an author implies a tag
-				InfTextUser* user
-					= inf_text_gtk_buffer_get_author(
-						inf_buffer,
-						&begin);
-				if(user)
-				{
-					char const* user_name =
-						inf_user_get_name(
-							INF_USER(user));
-					last_node->set_attribute(
-						"title",
-						uprintf(_("written by: %s"),
-							user_name));
-					users.insert(user);
-				}
-			}
-
-			GtkTextIter next = begin;
-			gtk_text_iter_forward_to_tag_toggle(&next, 0);
-
-			// split text by newlines so we can
-			// insert line number elements
-			gchar* text = gtk_text_iter_get_text(&begin, &next);
-			try
+			for(GSList* tag = current_tags;
+			    tag != 0;
+			    tag = tag->next)
 			{
-				gchar const* last_pos = text;
-				for(gchar const* i = last_pos; *i; ++i)
-				{
-					if(*i != '\n')
-						continue;
-
-					++line_counter;
-
-					gchar const* next_pos = i;
-					++next_pos;
-					last_node->add_child_text(
-						Glib::ustring(last_pos,
-						              next_pos));
-					last_pos = next_pos;
-
-					line_no = last_node->add_child("span");
-					line_no->set_attribute("class",
-					                       "line_no");
-					line_no->set_attribute(
-						"id",
-						uprintf("line_%d",
-						        line_counter));
-				}
-
-				last_node->add_child_text(
-					Glib::ustring(last_pos));
+				append_tag_declarations(
+					style, GTK_TEXT_TAG(tag->data), true);
 			}
-			catch(...)
-			{
-				g_free(text);
-				throw;
-			}
-			g_free(text);
+		}
+	}
 
-			// if we do not have any tags, we did not add classes
-			// and consequently did not go into a new span
-			if(!classes.empty())
-				last_node = last_node->get_parent();
+	void collect_tag(GtkTextTag* tag, gpointer user_data)
+	{
+		static_cast<std::vector<GtkTextTag*>*>(user_data)->
+			push_back(tag);
+	}
 
-			begin = next;
+	void collect_text_user(InfUser* user, gpointer user_data)
+	{
+		if(INF_TEXT_IS_USER(user))
+		{
+			static_cast<std::vector<InfTextUser*>*>(user_data)->
+				push_back(INF_TEXT_USER(user));
 		}
 	}
 
 	// some random interesting information/advertisement to be put at
 	// the end of the html output
-	void dump_info(xmlpp::Element* node, Gobby::TextSessionView& view)
+	void dump_info(std::string& out, Gobby::TextSessionView& view)
 	{
 		using namespace Gobby;
 		// put current time
@@ -259,24 +307,24 @@ namespace
 			_("Document generated from %1$s:%2$s at %3$s by %4$s");
 		char const* p = std::strstr(translated, "%4$s");
 		g_assert(p);
-		node->add_child_text(
+		append_text(out,
 			uprintf(Glib::ustring(translated, p).c_str(),
 			        hostname, path, time_str));
 
-		xmlpp::Element* link = node->add_child("a");
-		link->set_attribute("href", "http://gobby.github.io/");
-		link->add_child_text(PACKAGE_STRING);
+		out += "<a href=\"http://gobby.github.io/\">";
+		append_text(out, PACKAGE_STRING);
+		out += "</a>";
 
 		if(*p != '\0')
-			node->add_child_text(
+			append_text(out,
 			  uprintf(p+4 , hostname, path, time_str));
 	}
 
-	// list each author before the actual text
-	void dump_user_list(xmlpp::Element* list,
-		            const std::set<InfTextUser*>& users)
+	// list each participant before the actual text
+	void dump_user_list(std::string& out,
+		            const std::vector<InfTextUser*>& users)
 	{
-		for(std::set<InfTextUser*>::const_iterator i = users.begin();
+		for(std::vector<InfTextUser*>::const_iterator i = users.begin();
 		    i != users.end();
 		    ++i)
 		{
@@ -294,134 +342,53 @@ namespace
 			const char* name = inf_user_get_name(INF_USER(*i));
 			const unsigned int rgb = rgba_to_rgb24(rgba.gobj());
 
-			xmlpp::Element* item = list->add_child("li");
-			item->add_child_text(name);
-			item->set_attribute(
-				"style",
+			out += "<li";
+			append_attribute(out, "style",
 				uprintf("background-color: #%06x;", rgb));
+			out += '>';
+			append_text(out, name);
+			out += "</li>";
 		}
 	}
 
-	void dump_tags_style(xmlpp::Element* css,
-		             const priority_tag_set& tags)
+	void dump_tags_style(std::string& out,
+		             const std::vector<GtkTextTag*>& tags)
 	{
-		for(priority_tag_set::const_iterator i = tags.begin();
+		for(std::vector<GtkTextTag*>::const_iterator i = tags.begin();
 		    i != tags.end();
 		    ++i)
 		{
-			GdkRGBA* fg, * bg;
-			gint weight;
-			gboolean underline;
-			PangoStyle style;
-			gboolean fg_set, bg_set, weight_set,
-				underline_set, style_set;
-			g_object_get(G_OBJECT(*i),
-				"background-rgba", &bg,
-				"foreground-rgba", &fg,
-				"weight",          &weight,
-				"underline",       &underline,
-				"style",           &style,
-				"background-set",  &bg_set,
-				"foreground-set",  &fg_set,
-				"weight-set",      &weight_set,
-				"underline-set",   &underline_set,
-				"style-set",       &style_set,
-				NULL);
-
-			unsigned int bg_rgb = 0, fg_rgb = 0;
-			if(fg_set) fg_rgb = rgba_to_rgb24(fg);
-			if(bg_set) bg_rgb = rgba_to_rgb24(bg);
-
-			gdk_rgba_free(fg);
-			gdk_rgba_free(bg);
-			css->add_child_text(
+			std::string declarations;
+			append_tag_declarations(declarations, *i, false);
+
+			append_text(out,
 				uprintf(".tag_%p {\n",
 				        static_cast<void*>(*i)));
-			if(fg_set)
-				css->add_child_text(uprintf(
-					"  color:                  #%06x;",
-					fg_rgb));
-			if(bg_set)
-				css->add_child_text(uprintf(
-					"  background-color:       #%06x;",
-					bg_rgb));
-			if(weight_set)
-				css->add_child_text(uprintf(
-					"  font-weight:            %d;",
-					weight));
-			if(underline_set)
-				css->add_child_text(uprintf(
-					"  text-decoration:        %s;",
-					underline ? "underline" : "none"));
-			if(style_set)
-				css->add_child_text(uprintf(
-					"  font-style:             %s;",
-					(style == PANGO_STYLE_ITALIC) ?
-						"italic" : "none"));
-			css->add_child_text("}\n");
+			append_text(out, declarations);
+			out += "}\n";
 		}
 	}
 
-	// generate xhtml representation of the document and write it to the
-	// specified location in the filesystem
-	std::string export_html(Gobby::TextSessionView& view)
+	// generate everything of the xhtml document that comes before the
+	// document content
+	std::string dump_head(const Glib::ustring& document_name,
+	                      const std::vector<InfTextUser*>& users,
+	                      const std::vector<GtkTextTag*>& tags,
+	                      unsigned int line_count)
 	{
-		using namespace Gobby;
-		xmlpp::Document output;
-
-		output.set_internal_subset("html",
-			"-//W3C//DTD XHTML 1.1//EN",
-			"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd");
-
-		xmlpp::Element
-			* root      = output.create_root_node(
-					"html",
-					"http://www.w3.org/1999/xhtml"),
-			* head      = root->add_child("head"),
-			* body      = root->add_child("body"),
-			* title     = head->add_child("title"),
-			* style     = head->add_child("style"),
-			* h1        = body->add_child("h1"),
-			* h2        = body->add_child("h2"),
-			* user_list = body->add_child("ul"),
-			* content   = body->add_child("pre"),
-			* info      = body->add_child("p"),
-			* icon      = h1->add_child("img");
-
-		icon->set_attribute("src",    gobby_icon);
-		icon->set_attribute("width",  "48");
-		icon->set_attribute("height", "48");
-		icon->set_attribute("alt",    "a gobby document:");
-		icon->set_attribute("class",  "icon");
-
-		const Glib::ustring& document_name = view.get_title();
-		title->add_child_text(document_name + " - infinote document");
-
-		h1->add_child_text(document_name);
-
-		content->set_attribute("class", "document");
-
-		std::set<InfTextUser*> users;
-		priority_tag_set tags;
-		unsigned int line_counter;
-		dump_buffer(view, content, users, tags, line_counter);
-
-		h2->add_child_text(_("Participants"));
-
-		info->set_attribute("class", "info");
-		dump_info(info, view);
-
-		style->set_attribute("type", "text/css");
-		dump_user_list(user_list, users);
-		dump_tags_style(style, tags);
-		if(!user_list->cobj()->children)
-		{
-			body->remove_child(h2);
-			body->remove_child(user_list);
-		}
+		std::string out;
+
+		out += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+		       "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\" "
+		       "\"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n"
+		       "<html xmlns=\"http://www.w3.org/1999/xhtml\">"
+		       "<head><title>";
+		append_text(out, document_name + " - infinote document");
+		out += "</title><style type=\"text/css\">";
+
+		dump_tags_style(out, tags);
 
-		style->add_child_text(
-			".document {\n"
+		out +=  ".document {\n"
 			"  border-top:             1px solid gray;\n"
 			"  border-bottom:          1px solid black;\n"
 			"  padding-bottom:         1.2em;\n"
@@ -433,9 +400,9 @@ namespace
 			"}\n"
 			".info {\n"
 			"  font-size:              small;\n"
-			"}\n");
+			"}\n";
 
-		style->add_child_text(
+		append_text(out,
 			uprintf(
 				".line_no {\n"
 				"  position:               absolute;\n"
@@ -448,10 +415,27 @@ namespace
 				"  padding-left:            %1$uem\n"
 				"}\n",
 				static_cast<unsigned int>(
-					std::log(line_counter)
+					std::log(line_count)
 					/ std::log(10))+1));
 
-		return output.write_to_string("utf-8");
+		out += "</style></head><body><h1><img";
+		append_attribute(out, "src", gobby_icon);
+		out += " width=\"48\" height=\"48\" alt=\"a gobby document:\""
+		       " class=\"icon\"/>";
+		append_text(out, document_name);
+		out += "</h1>";
+
+		if(!users.empty())
+		{
+			out += "<h2>";
+			append_text(out, _("Participants"));
+			out += "</h2><ul>";
+			dump_user_list(out, users);
+			out += "</ul>";
+		}
+
+		out += "<pre class=\"document\">";
+		return out;
 	}
 } // anonymous namespace
 
@@ -460,43 +444,346 @@ Gobby::OperationExportHtml::OperationExportHtml(
 	const Glib::RefPtr<Gio::File>& file)
 :
 	Operation(operations), m_title(view.get_title()), m_file(file),
-	m_xml(export_html(view)), m_index(0)
+	m_view(&view), m_changed_handler(0), m_position(NULL),
+	m_highlighted(0), m_line_counter(1), m_walk_done(false),
+	m_index(0), m_writing(false), m_written(0), m_start_time(0),
+	m_progress_time(0),
+	m_message_handle(get_status_bar().invalid_handle())
 {
+	const Folder& folder = get_folder_manager().get_text_folder();
+	folder.signal_document_removed().connect(
+		sigc::mem_fun(*this,
+			&OperationExportHtml::on_document_removed));
 }
 
 Gobby::OperationExportHtml::~OperationExportHtml()
 {
-	if(m_file)
+	// TODO: Cancel outstanding async operations?
+	m_idle_connection.disconnect();
+
+	if(m_changed_handler != 0)
 	{
-		// TODO: Cancel outstanding async operations?
-		get_status_bar().remove_message(m_message_handle);
+		g_signal_handler_disconnect(
+			m_view->get_text_buffer(), m_changed_handler);
+		gtk_text_buffer_delete_mark(
+			GTK_TEXT_BUFFER(m_view->get_text_buffer()),
+			m_position);
 	}
+
+	release_tags();
+
+	if(m_message_handle != get_status_bar().invalid_handle())
+		get_status_bar().remove_message(m_message_handle);
 }
 
 void Gobby::OperationExportHtml::start()
 {
-	m_file->replace_async(
-		sigc::mem_fun(*this, &OperationExportHtml::on_file_replace));
+	m_start_time = g_get_monotonic_time();
 
 	m_message_handle = get_status_bar().add_info_message(
 		Glib::ustring::compose(
 			_("Exporting document \"%1\" to \"%2\" in HTML..."),
 			m_title, m_file->get_uri()));
+
+	// Generate the HTML bit by bit in idle handlers, while the file
+	// is being opened.
+	if(!m_walk_done)
+	{
+		begin_walk();
+		m_progress_time = g_get_monotonic_time();
+		schedule_walk();
+	}
+
+	m_file->replace_async(
+		sigc::mem_fun(*this, &OperationExportHtml::on_file_replace));
+}
+
+void Gobby::OperationExportHtml::on_changed()
+{
+	// The text after the current position might not be highlighted
+	// anymore.
+	m_highlighted = 0;
+}
+
+void Gobby::OperationExportHtml::on_document_removed(SessionView& view)
+{
+	// If the document goes away before we are done with it, then export
+	// the rest of it right now, so that the export still succeeds.
+	if(m_view == &view)
+	{
+		if(!m_walk_done)
+		{
+			if(m_changed_handler == 0)
+				begin_walk();
+
+			m_idle_connection.disconnect();
+			walk(0);
+			end_walk();
+		}
+
+		m_view = NULL;
+	}
+}
+
+bool Gobby::OperationExportHtml::on_idle()
+{
+	StallProfiler::Scope profile("OperationExportHtml::on_idle");
+
+	// Do not get too far ahead of the file, so that the generated HTML
+	// does not pile up in memory. The walk is scheduled again once
+	// enough of it has been written.
+	if(m_chunks.size() >= MAX_PENDING_CHUNKS)
+		return false;
+
+	if(!walk(g_get_monotonic_time() + SLICE_TIME))
+	{
+		const gint64 now = g_get_monotonic_time();
+		if(now - m_progress_time >= PROGRESS_INTERVAL)
+		{
+			GtkTextBuffer* buffer =
+				GTK_TEXT_BUFFER(m_view->get_text_buffer());
+
+			get_status_bar().update_info_message(
+				m_message_handle,
+				Glib::ustring::compose(
+					_("Exporting document \"%1\" to "
+					  "\"%2\" in HTML (line %3 of %4)..."),
+					m_title, m_file->get_uri(),
+					m_line_counter,
+					gtk_text_buffer_get_line_count(
+						buffer)));
+
+			m_progress_time = now;
+		}
+
+		return true;
+	}
+
+	end_walk();
+	return false;
+}
+
+void Gobby::OperationExportHtml::schedule_walk()
+{
+	if(!m_walk_done && !m_idle_connection.connected())
+	{
+		m_idle_connection = Glib::signal_idle().connect(
+			sigc::mem_fun(*this, &OperationExportHtml::on_idle));
+	}
+}
+
+// Write the head of the document, with a style for each tag that exists in
+// the buffer and the list of participants, and start walking the buffer
+// from its beginning.
+void Gobby::OperationExportHtml::begin_walk()
+{
+	g_assert(m_changed_handler == 0);
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(m_view->get_text_buffer());
+
+	std::vector<GtkTextTag*> tags;
+	gtk_text_tag_table_foreach(
+		gtk_text_buffer_get_tag_table(buffer), collect_tag, &tags);
+	std::stable_sort(tags.begin(), tags.end(), TagComparator());
+
+	for(std::vector<GtkTextTag*>::iterator iter = tags.begin();
+	    iter != tags.end(); ++iter)
+	{
+		g_object_ref(*iter);
+		m_tags.insert(*iter);
+	}
+
+	std::vector<InfTextUser*> users;
+	inf_user_table_foreach_user(
+		inf_session_get_user_table(
+			INF_SESSION(m_view->get_session())),
+		collect_text_user, &users);
+
+	m_content = dump_head(m_title, users, tags,
+	                      gtk_text_buffer_get_line_count(buffer));
+	append_line_no(m_content, m_line_counter);
+
+	// The position is kept in a mark, so that changes to the buffer
+	// during the export move it along with the text around it. What
+	// has been exported already stays as it is, and the rest of the
+	// text is exported as it is when the walk gets to it.
+	GtkTextIter begin;
+	gtk_text_buffer_get_start_iter(buffer, &begin);
+	m_position = gtk_text_buffer_create_mark(buffer, NULL, &begin, TRUE);
+
+	m_changed_handler = g_signal_connect_after(
+		G_OBJECT(buffer), "changed",
+		G_CALLBACK(on_changed_static), this);
+}
+
+void Gobby::OperationExportHtml::release_tags()
+{
+	for(std::set<GtkTextTag*>::iterator iter = m_tags.begin();
+	    iter != m_tags.end(); ++iter)
+	{
+		g_object_unref(*iter);
+	}
+
+	m_tags.clear();
+}
+
+// Go through the buffer from one tag toggle to the next, writing each chunk
+// of text during which the set of tags does not change as a <span/>. Returns
+// true when the end of the buffer has been reached. If deadline is nonzero,
+// then returns false when the deadline has passed before that.
+bool Gobby::OperationExportHtml::walk(gint64 deadline)
+{
+	g_assert(m_view != NULL);
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(m_view->get_text_buffer());
+	InfTextGtkBuffer* inf_buffer = INF_TEXT_GTK_BUFFER(
+		inf_session_get_buffer(INF_SESSION(m_view->get_session())));
+
+	GtkTextIter begin;
+	gtk_text_buffer_get_iter_at_mark(buffer, &begin, m_position);
+
+	Glib::ustring classes;
+	std::string style;
+	while(!gtk_text_iter_is_end(&begin))
+	{
+		// Highlight the buffer ahead of the export as we go, instead
+		// of all at once before starting, so that this does not
+		// block the UI for large documents.
+		GtkTextIter next;
+		for(;;)
+		{
+			next = begin;
+			gtk_text_iter_forward_to_tag_toggle(&next, NULL);
+			if(gtk_text_iter_get_offset(&next) <= m_highlighted)
+				break;
+
+			GtkTextIter highlight_end;
+			gtk_text_buffer_get_iter_at_offset(
+				buffer, &highlight_end,
+				std::max(gtk_text_iter_get_offset(&begin),
+				         m_highlighted));
+			gtk_text_iter_forward_lines(
+				&highlight_end, HIGHLIGHT_LINES);
+			gtk_source_buffer_ensure_highlight(
+				GTK_SOURCE_BUFFER(buffer),
+				&begin, &highlight_end);
+			m_highlighted = gtk_text_iter_get_offset(
+				&highlight_end);
+		}
+
+		// add current tags as classes for CSS formatting
+		// (both for author of text and syntax highlighting)
+		get_current_tags(m_tags, &begin, classes, style);
+		if(!classes.empty() || !style.empty())
+		{
+			m_content += "<span";
+			if(!classes.empty())
+				append_attribute(m_content, "class", classes);
+			if(!style.empty())
+				append_attribute(m_content, "style", style);
+
+			// add mouseover "written by" popup
+			// this only needs to happen when there are tags,
+			// because the presence of an author implies a tag
+			InfTextUser* user = inf_text_gtk_buffer_get_author(
+				inf_buffer, &begin);
+			if(user)
+			{
+				char const* user_name =
+					inf_user_get_name(INF_USER(user));
+				append_attribute(m_content, "title",
+					uprintf(_("written by: %s"),
+					        user_name));
+			}
+
+			m_content += '>';
+		}
+
+		// split text by newlines so we can
+		// insert line number elements
+		gchar* text = gtk_text_iter_get_text(&begin, &next);
+		gchar const* last_pos = text;
+		gchar const* i = last_pos;
+		for(; *i; ++i)
+		{
+			if(*i != '\n')
+				continue;
+
+			++m_line_counter;
+
+			gchar const* next_pos = i;
+			++next_pos;
+			append_escaped(m_content, last_pos,
+			               next_pos - last_pos, false);
+			last_pos = next_pos;
+
+			append_line_no(m_content, m_line_counter);
+		}
+
+		append_escaped(m_content, last_pos, i - last_pos, false);
+		g_free(text);
+
+		if(!classes.empty() || !style.empty())
+			m_content += "</span>";
+
+		if(m_content.size() >= CHUNK_SIZE)
+			flush_content();
+
+		begin = next;
+		if(deadline != 0 && g_get_monotonic_time() >= deadline)
+		{
+			gtk_text_buffer_move_mark(buffer, m_position, &begin);
+			return gtk_text_iter_is_end(&begin);
+		}
+	}
+
+	return true;
+}
+
+void Gobby::OperationExportHtml::end_walk()
+{
+	g_assert(m_view != NULL);
+	g_assert(!m_walk_done);
+
+	m_content += "</pre><p class=\"info\">";
+	dump_info(m_content, *m_view);
+	m_content += "</p></body></html>\n";
+
+	g_signal_handler_disconnect(
+		m_view->get_text_buffer(), m_changed_handler);
+	m_changed_handler = 0;
+
+	gtk_text_buffer_delete_mark(
+		GTK_TEXT_BUFFER(m_view->get_text_buffer()), m_position);
+	m_position = NULL;
+
+	release_tags();
+
+	m_walk_done = true;
+	flush_content();
+}
+
+// Hand the content generated so far to the file
+void Gobby::OperationExportHtml::flush_content()
+{
+	if(!m_content.empty())
+	{
+		m_chunks.push_back(std::string());
+		m_chunks.back().swap(m_content);
+	}
+
+	write_next();
 }
 
 void Gobby::OperationExportHtml::on_file_replace(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationExportHtml::on_file_replace");
+
 	try
 	{
 		m_stream = m_file->replace_finish(result);
-
-		m_stream->write_async(
-			m_xml.c_str(),
-			m_xml.length(),
-			sigc::mem_fun(
-				*this,
-				&OperationExportHtml::on_stream_write));
+		write_next();
 	}
 	catch(const Glib::Exception& ex)
 	{
@@ -507,6 +794,10 @@ void Gobby::OperationExportHtml::on_file_replace(
 void Gobby::OperationExportHtml::on_stream_write(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationExportHtml::on_stream_write");
+
+	m_writing = false;
+
 	try
 	{
 		gssize size = m_stream->write_finish(result);
@@ -514,20 +805,54 @@ void Gobby::OperationExportHtml::on_stream_write(
 		g_assert(size >= 0);
 
 		m_index += size;
-		if(m_index < m_xml.length())
+		m_written += size;
+		if(m_index == m_chunks.front().size())
+		{
+			m_chunks.pop_front();
+			m_index = 0;
+
+			if(m_changed_handler != 0 &&
+			   m_chunks.size() < MAX_PENDING_CHUNKS)
+			{
+				schedule_walk();
+			}
+		}
+
+		write_next();
+	}
+	catch(const Glib::Exception& ex)
+	{
+		error(ex.what());
+	}
+}
+
+// Write the next chunk, as soon as the file is open and the previous write
+// has finished. Once everything has been written, close the file.
+void Gobby::OperationExportHtml::write_next()
+{
+	if(!m_stream || m_writing)
+		return;
+
+	try
+	{
+		if(!m_chunks.empty())
 		{
-			// Write next chunk
+			const std::string& chunk = m_chunks.front();
 			m_stream->write_async(
-				m_xml.c_str() + m_index,
-				m_xml.length() - m_index,
+				chunk.data() + m_index,
+				chunk.size() - m_index,
 				sigc::mem_fun(
 					*this,
 					&OperationExportHtml::
 						on_stream_write));
+			m_writing = true;
 		}
-		else
+		else if(m_walk_done)
 		{
 			m_stream->close();
+
+			debug_throughput("Exported", m_title, m_written,
+			                 m_start_time);
 			finish();
 		}
 	}
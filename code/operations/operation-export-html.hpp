@@ -23,7 +23,13 @@
 #include <giomm/file.h>
 #include <giomm/outputstream.h>
 
-#include <ctime>
+#include <libinftext/inf-text-user.h>
+
+#include <gtk/gtk.h>
+
+#include <deque>
+#include <set>
+#include <string>
 
 namespace Gobby
 {
@@ -39,16 +45,73 @@ public:
 	virtual void start();
 
 protected:
+	// Time spent generating HTML per main loop iteration
+	static const gint64 SLICE_TIME = 8000; // microseconds
+	// Size of the chunks the generated HTML is written in
+	static const std::string::size_type CHUNK_SIZE = 64 * 1024;
+	// Number of lines highlighted at once ahead of the export
+	static const gint HIGHLIGHT_LINES = 500;
+	// Number of chunks that may wait to be written before generating
+	// more HTML is paused
+	static const std::size_t MAX_PENDING_CHUNKS = 16;
+	// Interval in which the progress shown in the status bar is updated
+	static const gint64 PROGRESS_INTERVAL = 500000; // microseconds
+
+	static void on_changed_static(GtkTextBuffer* buffer,
+	                              gpointer user_data)
+	{
+		static_cast<OperationExportHtml*>(user_data)->on_changed();
+	}
+
+	void on_changed();
+	void on_document_removed(SessionView& view);
+	bool on_idle();
+
+	void schedule_walk();
+	void begin_walk();
+	void release_tags();
+	bool walk(gint64 deadline);
+	void end_walk();
+	void flush_content();
+
 	void on_file_replace(const Glib::RefPtr<Gio::AsyncResult>& result);
 	void on_stream_write(const Glib::RefPtr<Gio::AsyncResult>& result);
 
+	void write_next();
 	void error(const Glib::ustring& message);
 
 protected:
-	const std::string m_title;
+	const Glib::ustring m_title;
 	const Glib::RefPtr<Gio::File> m_file;
-	const std::string m_xml;
+
+	TextSessionView* m_view;
+	gulong m_changed_handler;
+	sigc::connection m_idle_connection;
+
+	// Walk state. The walk goes through the buffer from one tag toggle
+	// to the next, starting at m_position. Text that is inserted or
+	// removed during the walk moves the mark along with it.
+	GtkTextMark* m_position;
+	gint m_highlighted;
+	unsigned int m_line_counter;
+	bool m_walk_done;
+
+	// Tags that have a style in the head of the document, which is
+	// written before the walk starts. We hold a reference on each of
+	// them until the walk is done.
+	std::set<GtkTextTag*> m_tags;
+
+	// Generated HTML is collected in m_content and handed to the file
+	// in chunks of about CHUNK_SIZE bytes. Chunks are written in the
+	// order they are produced and dropped as soon as they are written.
+	std::string m_content;
+	std::deque<std::string> m_chunks;
 	std::string::size_type m_index;
+	bool m_writing;
+	std::size_t m_written;
+
+	gint64 m_start_time;
+	gint64 m_progress_time;
 
 	Glib::RefPtr<Gio::OutputStream> m_stream;
 
@@ -28,7 +28,7 @@ Gobby::OperationOpenMultiple::OperationOpenMultiple(
 		const InfBrowserIter* parent,
 		const file_list& files):
 	Operation(operations), m_preferences(prefs),
-	m_parent(browser, parent), m_current(NULL)
+	m_parent(browser, parent), m_num_loading(0)
 {
 	m_parent.signal_node_removed().connect(
 		sigc::mem_fun(*this,
@@ -43,15 +43,25 @@ Gobby::OperationOpenMultiple::OperationOpenMultiple(
 
 		info.file = *iter;
 		info.encoding = NULL; /* auto-detect... */
+		info.operation = NULL;
 	}
 }
 
 void Gobby::OperationOpenMultiple::start()
 {
-	for(info_list::iterator iter = m_infos.begin();
-	    iter != m_infos.end(); ++iter)
+	info_list::iterator iter = m_infos.begin();
+	while(iter != m_infos.end())
 	{
+		info_list::iterator next = iter;
+		++next;
+
+		// query() might finish the operation if it fails for the
+		// last remaining file, so do not touch anything afterwards.
+		const bool last = (next == m_infos.end());
 		query(iter);
+		if(last) break;
+
+		iter = next;
 	}
 }
 
@@ -78,8 +88,7 @@ void Gobby::OperationOpenMultiple::query(const info_list::iterator& info)
 	}
 	else
 	{
-		if(!m_current)
-			load_info(info);
+		load_next();
 	}
 }
 
@@ -98,7 +107,7 @@ void Gobby::OperationOpenMultiple::on_query_info(
 			info->file->query_info_finish(result);
 
 		info->name = file_info->get_display_name();
-		if(!m_current) load_info(info);
+		load_next();
 	}
 	catch(const Gio::Error& ex)
 	{
@@ -110,38 +119,60 @@ void Gobby::OperationOpenMultiple::on_finished(
 		bool success,
 		const info_list::iterator& info)
 {
+	--m_num_loading;
 	m_infos.erase(info);
-	m_current = NULL;
 
+	load_next();
+}
+
+void Gobby::OperationOpenMultiple::load_next()
+{
 	if(m_infos.empty())
 	{
 		// All documents loaded
 		finish();
+		return;
 	}
-	else
+
+	// Start loading as many files as we are allowed to. Files are
+	// only started in list order, so if the name of a file is not yet
+	// known, wait for it before starting any of the files after it.
+	info_list::iterator iter = m_infos.begin();
+	while(iter != m_infos.end() &&
+	      m_num_loading <
+	      m_preferences.editor.parallel_file_operations)
 	{
-		// Find the next info with name set
-		for(info_list::iterator iter = m_infos.begin();
-		    iter != m_infos.end(); ++iter)
-		{
-			if(!iter->name.empty())
-			{
-				load_info(iter);
-				break;
-			}
-		}
+		if(iter->name.empty()) break;
+
+		info_list::iterator next = iter;
+		++next;
 
-		// If no info was found, then wait for names to become
-		// available, by query info results
+		if(iter->operation == NULL)
+			load_info(iter);
+
+		iter = next;
+	}
+
+	if(m_infos.empty())
+	{
+		finish();
+		return;
 	}
+
+	// The first file in the list can be added to the directory as soon
+	// as it has been read. This might finish the operation
+	// synchronously, so it needs to be the last thing we do here.
+	OperationOpen* front = m_infos.front().operation;
+	if(front != NULL)
+		front->release();
 }
 
 void Gobby::OperationOpenMultiple::load_info(const info_list::iterator& iter)
 {
-	g_assert(m_current == NULL);
+	g_assert(iter->operation == NULL);
 	g_assert(!iter->name.empty());
 
-	m_current = m_operations.create_document(
+	OperationOpen* operation = m_operations.create_document(
 		m_parent.get_browser(), m_parent.get_browser_iter(),
 		iter->name, m_preferences, iter->file, iter->encoding);
 
@@ -152,18 +183,26 @@ void Gobby::OperationOpenMultiple::load_info(const info_list::iterator& iter)
 	// so it does not matter at this point. But in principle we should
 	// change the API so that we can find it out here. Note also that
 	// currently, OperationOpen can never finish synchrounously.
-	if(m_current == NULL)
+	if(operation == NULL)
 	{
-		on_finished(true, iter);
+		m_infos.erase(iter);
 	}
 	else
 	{
-		m_current->signal_finished().connect(
-			sigc::bind(
+		// Read and convert the file right away, but wait with
+		// adding the document until the ones before it are added.
+		// load_next() releases the first operation in the list.
+		operation->hold();
+
+		iter->operation = operation;
+		iter->finished_connection =
+			operation->signal_finished().connect(sigc::bind(
 				sigc::mem_fun(
 					*this,
 					&OperationOpenMultiple::on_finished),
 				iter));
+
+		++m_num_loading;
 	}
 }
 
@@ -178,13 +217,16 @@ void Gobby::OperationOpenMultiple::single_error(
 
 	m_infos.erase(iter);
 
-	// Finish operation if there are no more files to load
-	if(m_infos.empty())
-		finish();
+	// Files after this one might have been waiting for its name.
+	// Finishes the operation if there are no more files to load.
+	load_next();
 }
 
 void Gobby::OperationOpenMultiple::fatal_error(const Glib::ustring& message)
 {
+	// The operations for the files that are still being loaded are left
+	// alone. They watch the same parent node, and fail on their own
+	// when it is removed, whether they are held or not.
 	get_status_bar().add_error_message(
 		_("Failed to open multiple documents"),
 		message);
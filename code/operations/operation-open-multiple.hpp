@@ -47,6 +47,16 @@ protected:
 		Glib::RefPtr<Gio::File> file;
 		std::string name;
 		const char* encoding;
+
+		// Set while the file is being loaded. All operations but the
+		// one for the first file in the list are held, so that
+		// documents are added in the order the files were given.
+		// Each of them is owned by Operations like any other
+		// operation, and reports back via finished_connection,
+		// which is disconnected automatically when we go away, so
+		// it is never accessed from our destructor.
+		OperationOpen* operation;
+		sigc::connection finished_connection;
 	};
 
 	typedef std::list<Info> info_list;
@@ -58,6 +68,7 @@ protected:
 	                   const info_list::iterator& info);
 	void on_finished(bool success, const info_list::iterator& info);
 
+	void load_next();
 	void load_info(const info_list::iterator& iter);
 	void single_error(const info_list::iterator& iter,
 	                  const Glib::ustring& message);
@@ -68,7 +79,7 @@ protected:
 	unsigned int m_num_uris;
 
 	info_list m_infos;
-	OperationOpen* m_current;
+	unsigned int m_num_loading;
 };
 
 }
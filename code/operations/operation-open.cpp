@@ -17,43 +17,336 @@
 #include "operations/operation-open.hpp"
 
 #include "core/noteplugin.hpp"
+#include "util/encoding.hpp"
 #include "util/i18n.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <glibmm/main.h>
 
 #include <libinftextgtk/inf-text-gtk-buffer.h>
 #include <gtksourceview/gtksource.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
-#include <cstring> // memmove. Is there some C++ replacement for this?
 
 namespace
 {
-	// These are the charsets that we try to convert a file from when
-	// autodetecting the encoding.
-	const char* get_autodetect_encoding(unsigned int index)
+	// This is the encoding that is assumed for files that are neither
+	// valid UTF-8 nor UTF-16 or UTF-32 when autodetecting the encoding.
+	const char* get_default_8bit_encoding()
 	{
 		// Translators: This is the 8 bit encoding that is tried when
 		// autodetecting a file's encoding.
-		static const char* DEFAULT_8BIT_ENCODING = N_("ISO-8859-1");
-
-		static const char* ENCODINGS[] = {
-			"UTF-8",
-			DEFAULT_8BIT_ENCODING,
-			"UTF-16",
-			"UCS-2",
-			"UCS-4"
-		};
-
-		static const unsigned int N_ENCODINGS =
-			sizeof(ENCODINGS)/sizeof(ENCODINGS[0]);
-
-		if(index == 1) return Gobby::_(ENCODINGS[index]);
-		if(index < N_ENCODINGS) return ENCODINGS[index];
-		return NULL;
+		return Gobby::_("ISO-8859-1");
 	}
+
+	bool is_utf8(const std::string& encoding)
+	{
+		return g_ascii_strcasecmp(encoding.c_str(), "UTF-8") == 0 ||
+		       g_ascii_strcasecmp(encoding.c_str(), "UTF8") == 0;
+	}
+
+	// Size of the blocks of UTF-8 text that the conversion thread hands
+	// back. Each of them is inserted into the buffer with a single call.
+	const std::size_t CONVERT_BLOCK_SIZE = 1024 * 1024;
+
+	// Number of bytes converted with one call to g_iconv().
+	const std::size_t CONVERT_CHUNK_SIZE = 64 * 1024;
+
+	// Interval in which the status bar message is updated, in
+	// milliseconds.
+	const unsigned int PROGRESS_INTERVAL = 500;
 }
 
+struct Gobby::OperationOpen::ConvertProgress
+{
+	ConvertProgress(): bytes(0) {}
+
+	// Number of bytes of the raw file content that have been converted
+	// so far. Written by the conversion thread, read by the main thread.
+	std::atomic<std::size_t> bytes;
+};
+
+class Gobby::OperationOpen::Converter: public AsyncOperation
+{
+public:
+	enum Result {
+		SUCCESS,
+		ENCODING_ERROR,
+		UNSUPPORTED_ENCODING
+	};
+
+	typedef sigc::slot<void, Converter&> SlotDone;
+
+	// An empty encoding means to auto-detect it.
+	Converter(GMappedFile* mapped_file,
+	          std::vector<char>& raw_content,
+	          const std::string& encoding,
+	          const std::string& eight_bit_encoding,
+	          DocumentInfoStorage::EolStyle eol_style,
+	          const std::shared_ptr<ConvertProgress>& progress,
+	          const SlotDone& slot_done):
+		m_mapped_file(mapped_file),
+		m_eight_bit_encoding(eight_bit_encoding),
+		m_progress(progress), m_slot_done(slot_done),
+		m_result(ENCODING_ERROR), m_encoding(encoding),
+		m_eol_style(eol_style), m_after_cr(false)
+	{
+		if(m_mapped_file != NULL)
+			g_mapped_file_ref(m_mapped_file);
+		m_raw_content.swap(raw_content);
+	}
+
+	~Converter()
+	{
+		if(m_mapped_file != NULL)
+			g_mapped_file_unref(m_mapped_file);
+	}
+
+	Result get_result() const { return m_result; }
+	const std::string& get_encoding() const { return m_encoding; }
+
+	DocumentInfoStorage::EolStyle get_eol_style() const
+	{
+		return m_eol_style;
+	}
+
+	std::deque<std::string>& get_blocks() { return m_blocks; }
+
+protected:
+	virtual void run()
+	{
+		const char* data;
+		std::size_t size;
+
+		if(m_mapped_file != NULL)
+		{
+			data = g_mapped_file_get_contents(m_mapped_file);
+			size = g_mapped_file_get_length(m_mapped_file);
+		}
+		else
+		{
+			data = m_raw_content.empty() ? NULL : &m_raw_content[0];
+			size = m_raw_content.size();
+		}
+
+		m_result = convert(data, size);
+		if(m_result != SUCCESS)
+			m_blocks.clear();
+
+		// Release the raw content as early as possible.
+		if(m_mapped_file != NULL)
+		{
+			g_mapped_file_unref(m_mapped_file);
+			m_mapped_file = NULL;
+		}
+
+		std::vector<char>().swap(m_raw_content);
+	}
+
+	virtual void finish()
+	{
+		m_slot_done(*this);
+	}
+
+	Result convert(const char* data, std::size_t size)
+	{
+		m_blocks.push_back(std::string());
+
+		// Decide on the encoding up front, so that we need to
+		// convert the content only once.
+		bool validated = false;
+		if(m_encoding.empty())
+		{
+			const char* encoding = detect_encoding(
+				data, size, m_eight_bit_encoding.c_str());
+			if(encoding == NULL)
+				return ENCODING_ERROR;
+
+			m_encoding = encoding;
+			validated = is_utf8(m_encoding);
+		}
+
+		if(is_utf8(m_encoding))
+		{
+			// No need to run iconv for UTF-8 content, we only
+			// need to make sure it is valid.
+			if(!validated && !is_valid_utf8(data, size))
+				return ENCODING_ERROR;
+			if(!convert_utf8(data, size))
+				return ENCODING_ERROR;
+		}
+		else
+		{
+			GIConv cd = g_iconv_open("UTF-8", m_encoding.c_str());
+			if(cd == reinterpret_cast<GIConv>(-1))
+				return UNSUPPORTED_ENCODING;
+
+			const bool result = convert_iconv(cd, data, size);
+			g_iconv_close(cd);
+
+			if(!result)
+				return ENCODING_ERROR;
+		}
+
+		// If the last character is a newline character, remove it.
+		if(m_blocks.back().empty())
+			m_blocks.pop_back();
+
+		if(!m_blocks.empty() && *m_blocks.back().rbegin() == '\n')
+		{
+			std::string& last = m_blocks.back();
+			last.erase(last.size() - 1);
+			if(last.empty())
+				m_blocks.pop_back();
+		}
+
+		return SUCCESS;
+	}
+
+	bool convert_utf8(const char* data, std::size_t size)
+	{
+		std::size_t pos = 0;
+		while(pos < size)
+		{
+			// Make sure not to split a multibyte sequence, so
+			// that blocks end at character boundaries.
+			std::size_t end = std::min(pos + CONVERT_CHUNK_SIZE,
+			                           size);
+			while(end < size && (data[end] & 0xc0) == 0x80)
+				++end;
+
+			if(!append(data + pos, data + end))
+				return false;
+
+			pos = end;
+			m_progress->bytes = pos;
+		}
+
+		return true;
+	}
+
+	bool convert_iconv(GIConv cd, const char* data, std::size_t size)
+	{
+		char outbuffer[CONVERT_CHUNK_SIZE];
+		gchar* inbuf = const_cast<gchar*>(data);
+		gsize inbytes = size;
+
+		while(inbytes > 0)
+		{
+			gchar* outbuf = outbuffer;
+			gsize outbytes = CONVERT_CHUNK_SIZE;
+
+			/* iconv is defined as libiconv on Windows, or at least
+			 * when using the binary packages from ftp.gnome.org.
+			 * Therefore we can't propely call Glib::IConv::iconv.
+			 * Therefore, we use the C API here. */
+			const std::size_t result = g_iconv(
+				cd, &inbuf, &inbytes, &outbuf, &outbytes);
+
+			// E2BIG only means that the output buffer is full.
+			// EILSEQ means invalid text for the current encoding,
+			// and EINVAL an incomplete multibyte sequence at the
+			// end of the file, which we consider an error as
+			// well.
+			if(result == static_cast<std::size_t>(-1) &&
+			   errno != E2BIG)
+			{
+				return false;
+			}
+
+			if(!append(outbuffer, outbuf))
+				return false;
+
+			m_progress->bytes = size - inbytes;
+		}
+
+		return true;
+	}
+
+	// Appends converted text to the current block, converting all line
+	// breaks to '\n' on the way. We remember the style of the last line
+	// break seen to correctly save the document back to disk.
+	bool append(const char* begin, const char* end)
+	{
+		static const char TO_FIND[] = { '\r', '\n', '\0' };
+
+		std::string& block = m_blocks.back();
+		const char* pos = begin;
+
+		while(pos != end)
+		{
+			if(m_after_cr)
+			{
+				// The previous character was a CR. Note that
+				// it might have been in the previous chunk.
+				m_after_cr = false;
+				if(*pos == '\n')
+				{
+					// CRLF style line break
+					m_eol_style =
+						DocumentInfoStorage::EOL_CRLF;
+					++pos;
+					continue;
+				}
+			}
+
+			const char* next = std::find_first_of(
+				pos, end, TO_FIND, TO_FIND + sizeof(TO_FIND));
+
+			block.append(pos, next);
+			if(next == end) break;
+
+			if(*next == '\0')
+			{
+				// There is a nullbyte in the conversion. As
+				// normal text files don't contain nullbytes,
+				// this only occurs when converting for example
+				// a UTF-16 from ISO-8859-1 to UTF-8 (note that
+				// the UTF-16 file is valid ISO-8859-1, it just
+				// contains lots of nullbytes). We therefore
+				// produce an error here.
+				return false;
+			}
+
+			block += '\n';
+			if(*next == '\r')
+			{
+				m_eol_style = DocumentInfoStorage::EOL_CR;
+				m_after_cr = true;
+			}
+			else
+			{
+				m_eol_style = DocumentInfoStorage::EOL_LF;
+			}
+
+			pos = next + 1;
+		}
+
+		// Start a new block if this one is full. Since we only
+		// append complete output of g_iconv(), blocks always end at
+		// character boundaries.
+		if(block.size() >= CONVERT_BLOCK_SIZE)
+			m_blocks.push_back(std::string());
+
+		return true;
+	}
+
+private:
+	GMappedFile* m_mapped_file;
+	std::vector<char> m_raw_content;
+	const std::string m_eight_bit_encoding;
+	const std::shared_ptr<ConvertProgress> m_progress;
+	const SlotDone m_slot_done;
+
+	Result m_result;
+	std::string m_encoding;
+	std::deque<std::string> m_blocks;
+	DocumentInfoStorage::EolStyle m_eol_style;
+	bool m_after_cr;
+};
+
 Gobby::OperationOpen::OperationOpen(Operations& operations,
                                     const Preferences& preferences,
                                     InfBrowser* browser,
@@ -63,20 +356,14 @@ Gobby::OperationOpen::OperationOpen(Operations& operations,
                                     const char* encoding):
 	Operation(operations), m_preferences(preferences),
 	m_name(name), m_file(file), m_parent(browser, parent),
-	m_encoding_auto_detect_index(-1),
+	m_encoding_auto_detect(encoding == NULL),
 	m_eol_style(DocumentInfoStorage::EOL_CR), m_request(NULL),
-	m_raw_pos(0), m_content(NULL),
+	m_held(false), m_read(false), m_inserted_bytes(0), m_content(NULL),
+	m_progress_bytes(0), m_progress_time(0), m_start_time(0),
 	m_message_handle(get_status_bar().invalid_handle())
 {
 	if(encoding != NULL)
-	{
 		m_encoding = encoding;
-	}
-	else
-	{
-		m_encoding_auto_detect_index = 0;
-		m_encoding = get_autodetect_encoding(0);
-	}
 }
 
 Gobby::OperationOpen::~OperationOpen()
@@ -95,19 +382,18 @@ Gobby::OperationOpen::~OperationOpen()
 	if(m_content != NULL)
 		g_object_unref(m_content);
 
+	m_progress_connection.disconnect();
+
 	if(m_message_handle != get_status_bar().invalid_handle())
 		get_status_bar().remove_message(m_message_handle);
 }
 
 void Gobby::OperationOpen::start()
 {
-	m_iconv.reset(new Glib::IConv("UTF-8", m_encoding));
+	m_start_time = g_get_monotonic_time();
 
 	try
 	{
-		m_file->read_async(sigc::mem_fun(
-			*this, &OperationOpen::on_file_read));
-
 		m_message_handle = get_status_bar().add_info_message(
 			Glib::ustring::compose(
 				_("Opening document \"%1\"..."), m_file->get_uri()));
@@ -117,6 +403,36 @@ void Gobby::OperationOpen::start()
 				*this, &OperationOpen::on_node_removed));
 
 		m_content = GTK_TEXT_BUFFER(gtk_source_buffer_new(NULL));
+
+		m_progress_time = g_get_monotonic_time();
+		m_progress_connection = Glib::signal_timeout().connect(
+			sigc::mem_fun(
+				*this, &OperationOpen::on_progress_timeout),
+			PROGRESS_INTERVAL);
+
+		// Map local files into memory, so that we do not need to
+		// keep a second copy of the file content around while
+		// converting it. If that fails, for example because the
+		// file is not a regular file, fall back to reading it via
+		// a stream, which also reports proper errors.
+		GMappedFile* mapped_file = NULL;
+		if(m_file->is_native())
+		{
+			const std::string path = m_file->get_path();
+			mapped_file = g_mapped_file_new(
+				path.c_str(), FALSE, NULL);
+		}
+
+		if(mapped_file != NULL)
+		{
+			start_convert(mapped_file);
+			g_mapped_file_unref(mapped_file);
+		}
+		else
+		{
+			m_file->read_async(sigc::mem_fun(
+				*this, &OperationOpen::on_file_read));
+		}
 	}
 	catch(const Gio::Error& err)
 	{
@@ -124,6 +440,22 @@ void Gobby::OperationOpen::start()
 	}
 }
 
+void Gobby::OperationOpen::hold()
+{
+	g_assert(!m_read);
+	m_held = true;
+}
+
+void Gobby::OperationOpen::release()
+{
+	if(m_held)
+	{
+		m_held = false;
+		if(m_read)
+			add_document();
+	}
+}
+
 void Gobby::OperationOpen::on_node_removed()
 {
 	error(_("The directory into which the new document "
@@ -133,6 +465,8 @@ void Gobby::OperationOpen::on_node_removed()
 void Gobby::OperationOpen::on_file_read(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationOpen::on_file_read");
+
 	try
 	{
 		m_stream = m_file->read_finish(result);
@@ -151,22 +485,20 @@ void Gobby::OperationOpen::on_file_read(
 void Gobby::OperationOpen::on_stream_read(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationOpen::on_stream_read");
+
 	try
 	{
 		gssize size = m_stream->read_finish(result);
 
-		// Close stream after reading, this signals the idle handler
-		// that all data has been read from the file.
 		if(size <= 0)
 		{
+			// All data has been read from the file, so convert it.
 			m_stream->close();
 			m_stream.reset();
 			m_buffer.reset(NULL);
 
-			// If the idle handler is not connected, then we have
-			// already processed all the data.
-			if(!m_idle_connection.connected())
-				read_finish();
+			start_convert(NULL);
 		}
 		else
 		{
@@ -174,16 +506,6 @@ void Gobby::OperationOpen::on_stream_read(
 			                     m_buffer->buf,
 			                     m_buffer->buf + size);
 
-			// Process read data in an idle handler
-			if(!m_idle_connection.connected())
-			{
-				m_idle_connection =
-					Glib::signal_idle().connect(
-						sigc::mem_fun(*this,
-							&OperationOpen::
-								on_idle));
-			}
-
 			m_stream->read_async(
 				m_buffer->buf, buffer::SIZE,
 			        sigc::mem_fun(
@@ -197,177 +519,142 @@ void Gobby::OperationOpen::on_stream_read(
 	}
 }
 
-bool Gobby::OperationOpen::on_idle()
+void Gobby::OperationOpen::start_convert(GMappedFile* mapped_file)
 {
-	static const unsigned int CONVERT_BUFFER_SIZE = 1024;
-
-	const char* inbuffer = &m_raw_content[m_raw_pos];
-	char* inbuf = const_cast<char*>(inbuffer);
-	gsize inbytes = m_raw_content.size() - m_raw_pos;
-	char outbuffer[CONVERT_BUFFER_SIZE];
-	gchar* outbuf = outbuffer;
-	gsize outbytes = CONVERT_BUFFER_SIZE;
-
-	/* iconv is defined as libiconv on Windows, or at least when using the
-	 * binary packages from ftp.gnome.org. Therefore we can't propely
-	 * call Glib::IConv::iconv. Therefore, we use the C API here. */
-	const std::size_t result = g_iconv(m_iconv->gobj(),
-		&inbuf, &inbytes, &outbuf, &outbytes);
-	bool more_to_process = (inbytes != 0);
-
-	if(result == static_cast<std::size_t>(-1))
-	{
-		if(errno == EILSEQ)
-		{
-			// Invalid text for the current encoding
-			encoding_error();
-			return false;
-		}
-
-		if(errno == EINVAL)
-		{
-			// If EINVAL is set, this means that an incomplete
-			// multibyte sequence was at the end of the input.
-			// We might have some more bytes, but those do not
-			// make up a whole character, so we need to wait for
-			// more input.
-			if(!m_stream)
-			{
-				// However, if we already read all input, then
-				// there is no more input to come. We
-				// consider this an error since the file
-				// should not end with an incomplete multibyte
-				// sequence.
-				encoding_error();
-				return false;
-			}
-			else
-			{
-				// Otherwise, we need to wait for more data
-				// to process.
-				more_to_process = false;
-			}
-		}
-	}
+	m_convert_progress.reset(new ConvertProgress);
+
+	std::unique_ptr<AsyncOperation> converter(
+		new Converter(mapped_file, m_raw_content,
+		              m_encoding_auto_detect ? "" : m_encoding,
+		              get_default_8bit_encoding(),
+		              m_eol_style, m_convert_progress,
+		              sigc::mem_fun(*this,
+		                            &OperationOpen::on_converted)));
+
+	m_progress_bytes = 0;
+	m_progress_time = g_get_monotonic_time();
+	m_convert_handle = AsyncOperation::start(std::move(converter));
+}
 
-	m_raw_pos += (inbuf - inbuffer);
+void Gobby::OperationOpen::on_converted(Converter& converter)
+{
+	StallProfiler::Scope profile("OperationOpen::on_converted");
 
-	// We now have outbuf - outbuffer bytes of valid UTF-8 in outbuffer.
-	char* prev = outbuffer;
-	char* pos;
-	const char to_find[] = { '\r', '\n', '\0' };
+	m_convert_handle.reset(NULL);
 
-	/* TODO: Write directly into the buffer here,
-	 * instead of memmoving stuff. */
-	while( (pos = std::find_first_of<char*>(prev, outbuf,
-		to_find, to_find + sizeof(to_find))) != outbuf)
+	switch(converter.get_result())
 	{
-		if(*pos == '\0')
+	case Converter::SUCCESS:
+		break;
+	case Converter::ENCODING_ERROR:
+		if(m_encoding_auto_detect)
 		{
-			// There is a nullbyte in the conversion. As normal
-			// text files don't contain nullbytes, this only
-			// occurs when converting for example a UTF-16 from
-			// ISO-8859-1 to UTF-8 (note that the UTF-16 file is
-			// valid ISO-8859-1, it just contains lots of
-			// nullbytes). We therefore produce an error here.
-			encoding_error();
-			return false;
+			error(_("The file either contains data in an unknown "
+			        "encoding, or it contains binary data."));
 		}
 		else
 		{
-			// We convert everything to '\n' as line separator,
-			// but remember the current eol-style to correctly
-			// save the document back to disk.
-			prev = pos + 1;
-			if(*pos == '\r' && prev != outbuf && *prev == '\n')
-			{
-				// CRLF style line break
-				std::memmove(prev, prev + 1,
-				             outbuf - prev - 1);
-				m_eol_style = DocumentInfoStorage::EOL_CRLF;
-				--outbuf;
-			}
-			else if(*pos == '\r')
-			{
-				*pos = '\n';
-				m_eol_style = DocumentInfoStorage::EOL_CR;
-			}
-			else
-			{
-				m_eol_style = DocumentInfoStorage::EOL_LF;
-			}
+			error(_("The file contains data not in the "
+			        "specified encoding"));
 		}
+		return;
+	case Converter::UNSUPPORTED_ENCODING:
+		error(Glib::ustring::compose(
+			_("The encoding \"%1\" is not supported"),
+			m_encoding));
+		return;
 	}
 
-	GtkTextIter insert_iter;
-	gtk_text_buffer_get_end_iter(m_content, &insert_iter);
-	gtk_text_buffer_insert(m_content, &insert_iter, outbuffer,
-	                       outbuf - outbuffer);
+	m_encoding = converter.get_encoding();
+	m_eol_style = converter.get_eol_style();
+	m_blocks.swap(converter.get_blocks());
 
-	// Done reading and converting the whole file
-	if(!more_to_process && !m_stream)
-		read_finish();
+	m_progress_bytes = 0;
+	m_progress_time = g_get_monotonic_time();
 
-	return more_to_process;
+	m_idle_connection = Glib::signal_idle().connect(
+		sigc::mem_fun(*this, &OperationOpen::on_idle));
 }
 
-void Gobby::OperationOpen::encoding_error()
+bool Gobby::OperationOpen::on_idle()
 {
-	if(m_encoding_auto_detect_index == -1)
+	StallProfiler::Scope profile("OperationOpen::on_idle");
+
+	if(!m_blocks.empty())
 	{
-		error(_("The file contains data not in the "
-		        "specified encoding"));
+		const std::string& block = m_blocks.front();
+
+		GtkTextIter insert_iter;
+		gtk_text_buffer_get_end_iter(m_content, &insert_iter);
+		gtk_text_buffer_insert(m_content, &insert_iter,
+		                       block.data(), block.size());
+
+		m_inserted_bytes += block.size();
+		m_blocks.pop_front();
+	}
+
+	// Done inserting the whole file
+	if(m_blocks.empty())
+	{
+		read_finish();
+		return false;
 	}
+
+	return true;
+}
+
+bool Gobby::OperationOpen::on_progress_timeout()
+{
+	StallProfiler::Scope profile("OperationOpen::on_progress_timeout");
+
+	// Report the rate at which we currently make progress: While the
+	// file is being read from a stream, this is the number of bytes
+	// read, while converting it is the number of bytes converted, and
+	// afterwards it is the number of bytes inserted into the buffer.
+	std::size_t bytes;
+	if(m_stream)
+		bytes = m_raw_content.size();
+	else if(m_convert_handle.get() != NULL)
+		bytes = m_convert_progress->bytes;
 	else
+		bytes = m_inserted_bytes;
+
+	const gint64 now = g_get_monotonic_time();
+	if(now > m_progress_time && bytes > m_progress_bytes)
 	{
-		++ m_encoding_auto_detect_index;
-		const char* next_encoding = get_autodetect_encoding(
-			m_encoding_auto_detect_index);
+		const guint64 rate =
+			static_cast<guint64>(bytes - m_progress_bytes) *
+			G_USEC_PER_SEC / (now - m_progress_time);
 
-		if(next_encoding == NULL)
-		{
-			error(_("The file either contains data in an unknown "
-			        "encoding, or it contains binary data."));
-		}
-		else
-		{
-			// Delete current content:
-			GtkTextIter start_iter, end_iter;
-			gtk_text_buffer_get_start_iter(m_content,
-			                               &start_iter);
-			gtk_text_buffer_get_end_iter(m_content,
-			                             &end_iter);
-			gtk_text_buffer_delete(m_content, &start_iter,
-			                       &end_iter);
-			
-			m_raw_pos = 0;
-
-			m_encoding = next_encoding;
-			m_iconv.reset(new Glib::IConv("UTf-8", m_encoding));
-
-			// Read again, try with next encoding.
-			m_idle_connection = Glib::signal_idle().connect(
-				sigc::mem_fun(*this,
-				              &OperationOpen::on_idle));
-		}
+		gchar* rate_str = g_format_size(rate);
+
+		get_status_bar().update_info_message(
+			m_message_handle,
+			Glib::ustring::compose(
+				_("Opening document \"%1\" (%2/s)..."),
+				m_file->get_uri(), rate_str));
+
+		g_free(rate_str);
 	}
+
+	m_progress_bytes = bytes;
+	m_progress_time = now;
+	return true;
 }
 
 void Gobby::OperationOpen::read_finish()
 {
-	// If the last character is a newline character, remove it.
-	GtkTextIter end_iter, test_iter;
-	gtk_text_buffer_get_end_iter(m_content, &end_iter);
-	test_iter = end_iter;
-	if(gtk_text_iter_backward_char(&test_iter))
-	{
-		if(gtk_text_iter_get_char(&test_iter) == '\n')
-		{
-			gtk_text_buffer_delete(
-				m_content, &test_iter, &end_iter);
-		}
-	}
+	m_progress_connection.disconnect();
+	m_read = true;
+
+	debug_throughput("Read", m_name, m_inserted_bytes, m_start_time);
 
+	if(!m_held)
+		add_document();
+}
+
+void Gobby::OperationOpen::add_document()
+{
 	gtk_text_buffer_set_modified(m_content, FALSE);
 
 	GtkTextIter insert_iter;
@@ -404,7 +691,7 @@ void Gobby::OperationOpen::read_finish()
 	InfIo* io;
 	g_object_get(G_OBJECT(browser), "io", &io, NULL);
 
-	InfTextSession* session = inf_text_session_new_with_user_table(
+	InfTextSession* session = Plugins::create_text_session(
 		communication_manager, INF_TEXT_BUFFER(text_gtk_buffer), io,
 		user_table, INF_SESSION_RUNNING, NULL, NULL);
 
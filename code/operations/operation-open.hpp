@@ -20,13 +20,16 @@
 #include "operations/operations.hpp"
 #include "core/documentinfostorage.hpp"
 #include "core/nodewatch.hpp"
+#include "util/asyncoperation.hpp"
 
 #include <giomm/file.h>
 #include <giomm/inputstream.h>
-#include <glibmm/convert.h>
 
 #include <libinfinity/common/inf-request-result.h>
 
+#include <deque>
+#include <memory>
+
 namespace Gobby
 {
 
@@ -42,7 +45,21 @@ public:
 
 	virtual void start();
 
+	// While held, the file is read and converted, but the document is
+	// not added to the directory until release() is called. This is
+	// used to load several files in parallel while still adding them
+	// one after the other. hold() needs to be called before the file
+	// has been read. Operations::create_document() might already have
+	// started the operation, but reading always completes
+	// asynchronously, so calling hold() right after it returned is
+	// fine. release() can finish the operation.
+	void hold();
+	void release();
+
 protected:
+	class Converter;
+	struct ConvertProgress;
+
 	static void
 	on_request_finished_static(InfRequest* request,
 	                           const InfRequestResult* result,
@@ -60,10 +77,14 @@ protected:
 
 	void on_file_read(const Glib::RefPtr<Gio::AsyncResult>& result);
 	void on_stream_read(const Glib::RefPtr<Gio::AsyncResult>& result);
+
+	void start_convert(GMappedFile* mapped_file);
+	void on_converted(Converter& converter);
 	bool on_idle();
+	bool on_progress_timeout();
 
-	void encoding_error();
 	void read_finish();
+	void add_document();
 
 	void on_request_finished(const InfBrowserIter* iter,
 	                         const GError* error);
@@ -75,14 +96,13 @@ protected:
 	const Glib::RefPtr<Gio::File> m_file;
 	NodeWatch m_parent;
 
-	int m_encoding_auto_detect_index;
-	std::unique_ptr<Glib::IConv> m_iconv;
+	bool m_encoding_auto_detect;
 	std::string m_encoding;
 	DocumentInfoStorage::EolStyle m_eol_style;
 
 	struct buffer
 	{
-		static const unsigned int SIZE = 1024;
+		static const unsigned int SIZE = 64 * 1024;
 		char buf[SIZE];
 	};
 
@@ -91,11 +111,28 @@ protected:
 	sigc::connection m_idle_connection;
 
 	InfRequest* m_request;
+	bool m_held;
+	bool m_read;
 
+	// Only used when the file is read via a stream, such as for remote
+	// files. Local files are mapped into memory instead, and the
+	// mapping is handed to the conversion thread directly.
 	std::vector<char> m_raw_content;
-	std::vector<char>::size_type m_raw_pos;
+
+	// Conversion to UTF-8 and line break normalization happen in a
+	// separate thread. It hands back the text in large blocks, which
+	// are then inserted into m_content from an idle handler.
+	std::unique_ptr<AsyncOperation::Handle> m_convert_handle;
+	std::shared_ptr<ConvertProgress> m_convert_progress;
+	std::deque<std::string> m_blocks;
+	std::size_t m_inserted_bytes;
 	GtkTextBuffer* m_content;
 
+	sigc::connection m_progress_connection;
+	std::size_t m_progress_bytes;
+	gint64 m_progress_time;
+	gint64 m_start_time;
+
 	StatusBar::MessageHandle m_message_handle;
 };
 
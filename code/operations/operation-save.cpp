@@ -17,9 +17,91 @@
 #include "operations/operation-save.hpp"
 
 #include "util/i18n.hpp"
+#include "util/stallprofiler.hpp"
 
-#include <cassert>
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+
+namespace
+{
+	// The maximum number of bytes one line break can take in any
+	// encoding: Two characters, each at most four bytes, plus a byte
+	// order mark that some encoders emit at the very beginning.
+	const std::size_t MAX_NEWLINE_SIZE = 12;
+
+	bool is_utf8(const std::string& encoding)
+	{
+		return g_ascii_strcasecmp(encoding.c_str(), "UTF-8") == 0 ||
+		       g_ascii_strcasecmp(encoding.c_str(), "UTF8") == 0;
+	}
+
+	void get_newline(Gobby::DocumentInfoStorage::EolStyle eol_style,
+	                 const gchar*& newline, std::size_t& len)
+	{
+		switch(eol_style)
+		{
+		case Gobby::DocumentInfoStorage::EOL_CR:
+			newline = "\r";
+			len = 1;
+			break;
+		case Gobby::DocumentInfoStorage::EOL_LF:
+			newline = "\n";
+			len = 1;
+			break;
+		case Gobby::DocumentInfoStorage::EOL_CRLF:
+			newline = "\r\n";
+			len = 2;
+			break;
+		default:
+			g_assert_not_reached();
+			break;
+		}
+	}
+
+	// Returns the end of the line starting at pos, and the length of the
+	// line break following it in delim_len. Line breaks are the same as
+	// in GtkTextBuffer: CR, LF, CRLF and the Unicode paragraph separator.
+	std::size_t find_line_end(const gchar* text,
+	                          std::size_t size,
+	                          std::size_t pos,
+	                          std::size_t& delim_len)
+	{
+		static const char TO_FIND[] = { '\r', '\n', '\xe2' };
+		const gchar* end = text + size;
+
+		for(const gchar* cur = text + pos; cur != end; ++cur)
+		{
+			cur = std::find_first_of(
+				cur, end, TO_FIND, TO_FIND + sizeof(TO_FIND));
+			if(cur == end) break;
+
+			if(*cur == '\r')
+			{
+				if(cur + 1 != end && cur[1] == '\n')
+					delim_len = 2;
+				else
+					delim_len = 1;
+				return cur - text;
+			}
+			else if(*cur == '\n')
+			{
+				delim_len = 1;
+				return cur - text;
+			}
+			else if(end - cur >= 3 &&
+			        std::memcmp(cur, "\xe2\x80\xa9", 3) == 0)
+			{
+				// U+2029 PARAGRAPH SEPARATOR
+				delim_len = 3;
+				return cur - text;
+			}
+		}
+
+		delim_len = 0;
+		return size;
+	}
+}
 
 Gobby::OperationSave::OperationSave(Operations& operations,
                                     TextSessionView& view,
@@ -27,86 +109,91 @@ Gobby::OperationSave::OperationSave(Operations& operations,
                                     const std::string& encoding,
                                     DocumentInfoStorage::EolStyle eol_style):
 	Operation(operations), m_file(file), m_view(&view),
-	m_start_time(std::time(NULL)), m_current_line_index(0),
+	m_title(view.get_title()),
+	m_start_time(std::time(NULL)), m_io_start_time(0),
+	m_text(NULL), m_text_size(0),
+	m_text_pos(0), m_line_start(0), m_line_end(0), m_next_line(0),
 	m_encoding(encoding), m_eol_style(eol_style),
 	m_storage_key(view.get_info_storage_key()),
-	m_iconv(encoding.c_str(), "UTF-8"),
-	m_buffer_size(0), m_buffer_index(0)
+	m_iconv(encoding.c_str(), "UTF-8"), m_utf8(is_utf8(encoding)),
+	m_buffer_size(0),
+	m_write_data(NULL), m_write_size(0), m_write_index(0),
+	m_message_handle(get_status_bar().invalid_handle())
 {
 	const Folder& folder = get_folder_manager().get_text_folder();
 	folder.signal_document_removed().connect(
 		sigc::mem_fun(*this, &OperationSave::on_document_removed));
-
-	// Load content so that the session can go on while saving
-	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
-	GtkTextIter prev;
-	GtkTextIter pos;
-	GtkTextIter old_pos;
-
-	gtk_text_buffer_get_start_iter(buffer, &prev);
-	pos = prev;
-
-	if(!gtk_text_iter_ends_line(&pos))
-		gtk_text_iter_forward_to_line_end(&pos);
-
-	do
-	{
-		Line line;
-		line.first =
-			gtk_text_buffer_get_text(buffer, &prev, &pos, TRUE);
-		line.second = gtk_text_iter_get_line_index(&pos);
-		m_lines.push_back(line);
-
-		//if(gtk_text_iter_is_end(&prev))
-		//	break;
-
-		old_pos = pos;
-		gtk_text_iter_forward_line(&prev);
-		gtk_text_iter_forward_to_line_end(&pos);
-	} while(!gtk_text_iter_equal(&pos, &old_pos));
-
-	m_current_line = m_lines.begin();
 }
 
 Gobby::OperationSave::~OperationSave()
 {
 	// TODO: Cancel outstanding async operations?
 
-	for(std::list<Line>::iterator iter = m_lines.begin();
-	    iter != m_lines.end(); ++ iter)
-	{
-		g_free(iter->first);
-	}
+	g_free(m_text);
 
-	get_status_bar().remove_message(m_message_handle);
+	if(m_message_handle != get_status_bar().invalid_handle())
+		get_status_bar().remove_message(m_message_handle);
 }
 
 void Gobby::OperationSave::start()
 {
+	m_io_start_time = g_get_monotonic_time();
+
+	if(m_text == NULL)
+	{
+		g_assert(m_view != NULL);
+		take_snapshot(*m_view);
+	}
+
 	m_file->replace_async(sigc::mem_fun(*this,
 	                                   &OperationSave::on_file_replace));
 
 	m_message_handle = get_status_bar().add_info_message(
 		Glib::ustring::compose(
 			_("Saving document \"%1\" to \"%2\"..."),
-			m_view->get_title(), m_file->get_uri()));
+			m_title, m_file->get_uri()));
 }
 
 void Gobby::OperationSave::on_document_removed(SessionView& view)
 {
 	// We keep the document to unset the modified flag when the operation
 	// is complete, however, if the document is removed in the meanwhile,
-	// then we don't need to care anymore.
+	// then we don't need to care anymore. If we did not start yet, then
+	// copy the content now, so that it is still saved.
 	if(m_view == &view)
+	{
+		if(m_text == NULL)
+			take_snapshot(*m_view);
+
 		m_view = NULL;
+	}
+}
+
+void Gobby::OperationSave::take_snapshot(TextSessionView& view)
+{
+	// Copy content so that the session can go on while saving. This is
+	// a single allocation for the whole document, as opposed to one
+	// per line.
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view.get_text_buffer());
+	GtkTextIter start;
+	GtkTextIter end;
+
+	gtk_text_buffer_get_bounds(buffer, &start, &end);
+	m_text = gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+	m_text_size = std::strlen(m_text);
+
+	begin_line(0);
 }
 
 void Gobby::OperationSave::on_file_replace(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationSave::on_file_replace");
+
 	try
 	{
 		m_stream = m_file->replace_finish(result);
+		m_buffer.resize(BUFFER_SIZE);
 		attempt_next();
 	}
 	catch(const Glib::Exception& ex)
@@ -115,29 +202,30 @@ void Gobby::OperationSave::on_file_replace(
 	}
 }
 
-void Gobby::OperationSave::attempt_next()
+void Gobby::OperationSave::begin_line(std::size_t pos)
 {
-	bool done;
+	std::size_t delim_len;
 
-	if(m_current_line == m_lines.end())
-	{
-		done = true;
-	}
+	m_line_start = pos;
+	m_text_pos = pos;
+	if(is_done()) return;
+
+	m_line_end = find_line_end(m_text, m_text_size, pos, delim_len);
+
+	// The last line has no line break in the document, but one is
+	// written after it anyway, since opening a file strips one from the
+	// end. Saving stops once the next line would start beyond the end.
+	if(delim_len > 0)
+		m_next_line = m_line_end + delim_len;
 	else
-	{
-		// Always save a newline at the end, except the document
-		// is empty.
-		assert(!m_lines.empty());
-		std::list<Line>::const_iterator iter = m_lines.begin();
-		++iter;
-
-		if(iter == m_lines.end() && m_lines.front().first[0] == '\0')
-			done = true;
-		else
-			done = false;
-	}
+		m_next_line = m_text_size + 1;
+}
 
-	if(done)
+void Gobby::OperationSave::attempt_next()
+{
+	// Always save a newline at the end of each line, including the
+	// last one, unless the document is empty.
+	if(is_done())
 	{
 		DocumentInfoStorage::Info info;
 		info.uri = m_file->get_uri();
@@ -157,6 +245,8 @@ void Gobby::OperationSave::attempt_next()
 				FALSE);
 		}
 
+		debug_throughput("Saved", m_title, m_text_size,
+		                 m_io_start_time);
 		finish();
 	}
 	else
@@ -167,105 +257,179 @@ void Gobby::OperationSave::attempt_next()
 
 void Gobby::OperationSave::write_next()
 {
-	gchar* inbuf;
-	gsize inlen;
-	char newlinebuf[2] = { '\r', '\n' };
+	m_write_index = 0;
 
-	if(m_current_line_index < m_current_line->second)
+	// If nothing needs to be converted, write as much as possible
+	// directly from our copy of the document.
+	const std::size_t direct_begin = m_text_pos;
+	const std::size_t direct_size = collect_direct();
+
+	if(direct_size > 0)
 	{
-		inbuf = m_current_line->first + m_current_line_index;
-		inlen = m_current_line->second - m_current_line_index;
+		m_write_data = m_text + direct_begin;
+		m_write_size = direct_size;
 	}
 	else
 	{
-		// Write newline
-		switch(m_eol_style)
-		{
-		case DocumentInfoStorage::EOL_CR:
-			inbuf = newlinebuf + 0;
-			inlen = 1;
-			break;
-		case DocumentInfoStorage::EOL_LF:
-			inbuf = newlinebuf + 1;
-			inlen = 1;
-			break;
-		case DocumentInfoStorage::EOL_CRLF:
-			inbuf = newlinebuf + 0;
-			inlen = 2;
-			break;
-		default:
-			g_assert_not_reached();
-			break;
-		}
+		if(!fill_buffer())
+			return;
+
+		m_write_data = &m_buffer[0];
+		m_write_size = m_buffer_size;
 	}
 
-	gchar* outbuf = m_buffer;
-	gsize outlen = BUFFER_SIZE;
+	g_assert(m_write_size > 0);
 
-	gchar* preserve_inbuf = inbuf;
+	m_stream->write_async(m_write_data, m_write_size,
+	                      sigc::mem_fun(*this,
+			                    &OperationSave::on_stream_write));
+}
 
-	/* iconv is defined as libiconv on Windows, or at least when using the
-	 * binary packages from ftp.gnome.org. Therefore we can't properly
-	 * call Glib::IConv::iconv. Therefore, we use the C API here. */
-	std::size_t retval = g_iconv(
-		m_iconv.gobj(), &inbuf, &inlen, &outbuf, &outlen);
+std::size_t Gobby::OperationSave::collect_direct()
+{
+	// This is only possible when the output is UTF-8 with LF line
+	// breaks, and then only for text up to the first line break that
+	// is not a plain LF in the document.
+	if(!m_utf8 || m_eol_style != DocumentInfoStorage::EOL_LF)
+		return 0;
 
-	if(retval == static_cast<std::size_t>(-1))
-	{
-		g_assert(errno != EILSEQ);
-		// E2BIG and EINVAL are fully OK here.
-	}
-	else if(retval > 0)
+	const std::size_t begin = m_text_pos;
+	std::size_t end = begin;
+
+	while(!is_done())
 	{
-		error(_("The document contains one or more characters that "
-		        "cannot be encoded in the specified character "
-		        "coding."));
-		return;
+		if(m_text_pos < m_line_end)
+		{
+			m_text_pos = m_line_end;
+			end = m_text_pos;
+		}
+		else if(m_next_line == m_line_end + 1 &&
+		        m_text[m_line_end] == '\n')
+		{
+			begin_line(m_next_line);
+			end = m_text_pos;
+		}
+		else
+		{
+			break;
+		}
 	}
 
-	// Advance bytes read.
-	m_current_line_index += inbuf - preserve_inbuf;
-	m_buffer_size = BUFFER_SIZE - outlen;
-	m_buffer_index = 0;
+	return end - begin;
+}
 
-	g_assert(m_buffer_size > 0);
+bool Gobby::OperationSave::fill_buffer()
+{
+	m_buffer_size = 0;
 
-	if(m_current_line_index > m_current_line->second)
+	while(!is_done() && m_buffer_size < BUFFER_SIZE)
 	{
-		// Converted whole line:
-		g_free(m_current_line->first);
-		m_current_line = m_lines.erase(m_current_line);
-		m_current_line_index = 0;
+		gchar* outbuf = &m_buffer[m_buffer_size];
+		gsize outlen = BUFFER_SIZE - m_buffer_size;
+
+		const bool write_newline = (m_text_pos == m_line_end);
+
+		// Don't split line breaks across buffers.
+		if(write_newline && outlen < MAX_NEWLINE_SIZE)
+			break;
+
+		const gchar* newline;
+		gchar* inbuf;
+		gsize inlen;
+
+		if(!write_newline)
+		{
+			inbuf = m_text + m_text_pos;
+			inlen = m_line_end - m_text_pos;
+		}
+		else
+		{
+			std::size_t newline_len;
+			get_newline(m_eol_style, newline, newline_len);
+			inbuf = const_cast<gchar*>(newline);
+			inlen = newline_len;
+		}
+
+		gchar* preserve_inbuf = inbuf;
+
+		if(m_utf8)
+		{
+			const std::size_t len = std::min(inlen, outlen);
+			std::memcpy(outbuf, inbuf, len);
+			inbuf += len;
+			outbuf += len;
+		}
+		else
+		{
+			/* iconv is defined as libiconv on Windows, or at
+			 * least when using the binary packages from
+			 * ftp.gnome.org. Therefore we can't properly call
+			 * Glib::IConv::iconv. Therefore, we use the C API
+			 * here. */
+			std::size_t retval = g_iconv(
+				m_iconv.gobj(), &inbuf, &inlen,
+				&outbuf, &outlen);
+
+			if(retval == static_cast<std::size_t>(-1))
+			{
+				g_assert(errno != EILSEQ);
+				// E2BIG and EINVAL are fully OK here.
+			}
+			else if(retval > 0)
+			{
+				error(_("The document contains one or more "
+				        "characters that cannot be encoded in "
+				        "the specified character coding."));
+				return false;
+			}
+		}
+
+		// Buffer is full
+		if(inbuf == preserve_inbuf)
+			break;
+
+		m_buffer_size = outbuf - &m_buffer[0];
+
+		if(write_newline)
+		{
+			// Converted whole line, go on with the next one
+			begin_line(m_next_line);
+		}
+		else
+		{
+			// Advance bytes read.
+			m_text_pos += inbuf - preserve_inbuf;
+		}
 	}
 
-	m_stream->write_async(m_buffer, m_buffer_size,
-	                      sigc::mem_fun(*this,
-			                    &OperationSave::on_stream_write));
+	return true;
 }
 
 void Gobby::OperationSave::on_stream_write(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("OperationSave::on_stream_write");
+
 	try
 	{
 		gssize size = m_stream->write_finish(result);
 		// On size < 0 an exception should have been thrown.
 		g_assert(size >= 0);
 
-		m_buffer_index += size;
-		if(m_buffer_index < m_buffer_size)
+		m_write_index += size;
+		if(m_write_index < m_write_size)
 		{
 			// Write next chunk
 			m_stream->write_async(
-				m_buffer + m_buffer_index,
-				m_buffer_size - m_buffer_index,
+				m_write_data + m_write_index,
+				m_write_size - m_write_index,
 				sigc::mem_fun(
 					*this,
 					&OperationSave::on_stream_write));
 		}
 		else
 		{
-			// Go on with next part of line and/or next line
+			// Go on with the next part of the document
 			attempt_next();
 		}
 	}
@@ -55,28 +55,53 @@ protected:
 	void on_file_replace(const Glib::RefPtr<Gio::AsyncResult>& result);
 	void on_stream_write(const Glib::RefPtr<Gio::AsyncResult>& result);
 
+	void take_snapshot(TextSessionView& view);
+	void begin_line(std::size_t pos);
+	bool is_done() const
+		{ return m_text_size == 0 || m_line_start > m_text_size; }
+
 	void attempt_next();
 	void write_next();
+	std::size_t collect_direct();
+	bool fill_buffer();
 	void error(const Glib::ustring& message);
 protected:
 	const Glib::RefPtr<Gio::File> m_file;
 	TextSessionView* m_view;
+	const Glib::ustring m_title;
 	std::time_t m_start_time;
-
-	typedef std::pair<gchar*, std::size_t> Line;
-	std::list<Line> m_lines;
-	std::list<Line>::iterator m_current_line;
-	std::size_t m_current_line_index;
+	gint64 m_io_start_time;
+
+	// Copy of the whole document, taken when the operation starts so
+	// that the session can go on while saving. If the document is
+	// closed while the operation is still queued, it is taken at that
+	// point instead. Lines are written one after
+	// the other, with their line breaks replaced according to
+	// m_eol_style.
+	gchar* m_text;
+	std::size_t m_text_size;
+	std::size_t m_text_pos;
+	std::size_t m_line_start;
+	std::size_t m_line_end;
+	std::size_t m_next_line;
 
 	std::string m_encoding;
 	DocumentInfoStorage::EolStyle m_eol_style;
 	std::string m_storage_key;
 	Glib::IConv m_iconv;
-
-	static const std::size_t BUFFER_SIZE = 1024;
-	char m_buffer[BUFFER_SIZE];
+	// If the target encoding is UTF-8, no conversion is necessary.
+	bool m_utf8;
+
+	// Converted text is collected in m_buffer across many lines before
+	// it is written. If nothing needs to be converted, text is written
+	// directly from m_text instead. m_write_data points to the data
+	// currently being written.
+	static const std::size_t BUFFER_SIZE = 256 * 1024;
+	std::vector<char> m_buffer;
 	std::size_t m_buffer_size;
-	std::size_t m_buffer_index;
+	const char* m_write_data;
+	std::size_t m_write_size;
+	std::size_t m_write_index;
 
 	Glib::RefPtr<Gio::OutputStream> m_stream;
 
@@ -29,17 +29,41 @@
 
 Gobby::Operations::Operation::~Operation() {}
 
+void Gobby::Operations::Operation::debug_throughput(const char* action,
+                                                    const Glib::ustring& title,
+                                                    std::size_t size,
+                                                    gint64 start_time) const
+{
+	const gint64 elapsed = g_get_monotonic_time() - start_time;
+	const double seconds = elapsed / 1000000.0;
+
+	gchar* size_str = g_format_size(size);
+	g_debug("%s \"%s\": %s in %.3f s (%.1f MB/s)",
+	        action, title.c_str(), size_str, seconds,
+	        elapsed > 0 ? size / (double)elapsed : 0.0);
+	g_free(size_str);
+}
+
 Gobby::Operations::Operations(DocumentInfoStorage& info_storage,
                               Browser& browser,
                               FolderManager& folder_manager,
-                              StatusBar& status_bar):
+                              StatusBar& status_bar,
+                              const Preferences& preferences):
 	m_info_storage(info_storage), m_browser(browser),
-	m_folder_manager(folder_manager), m_status_bar(status_bar)
+	m_folder_manager(folder_manager), m_status_bar(status_bar),
+	m_preferences(preferences), m_processing_io_queue(false),
+	m_io_message_handle(status_bar.invalid_handle())
 {
+	// If more operations are allowed to run, start them right away.
+	m_preferences.editor.parallel_file_operations.signal_changed().connect(
+		sigc::mem_fun(*this, &Operations::process_io_queue));
 }
 
 Gobby::Operations::~Operations()
 {
+	if(m_io_message_handle != m_status_bar.invalid_handle())
+		m_status_bar.remove_message(m_io_message_handle);
+
 	for(OperationSet::iterator iter = m_operations.begin();
 	    iter != m_operations.end(); ++ iter)
 	{
@@ -82,7 +106,7 @@ Gobby::Operations::create_document(InfBrowser* browser,
 	OperationOpen* op = new OperationOpen(*this, preferences, browser,
 	                                      parent, name, file, encoding);
 	m_operations.insert(op);
-	op->start();
+	queue_io_operation(op, IO_PRIORITY_USER);
 	return check_operation(op);
 }
 
@@ -104,7 +128,8 @@ Gobby::OperationSave*
 Gobby::Operations::save_document(TextSessionView& view,
                                  const Glib::RefPtr<Gio::File>& file,
                                  const std::string& encoding,
-                                 DocumentInfoStorage::EolStyle eol_style)
+                                 DocumentInfoStorage::EolStyle eol_style,
+                                 IoPriority priority)
 {
 	OperationSave* prev_op = get_save_operation_for_document(view);
 
@@ -117,7 +142,7 @@ Gobby::Operations::save_document(TextSessionView& view,
 
 	m_operations.insert(op);
 	m_signal_begin_save_operation.emit(op);
-	op->start();
+	queue_io_operation(op, priority);
 	return check_operation(op);
 }
 
@@ -160,8 +185,8 @@ Gobby::Operations::export_html(TextSessionView& view,
 	OperationExportHtml* op =
 		new OperationExportHtml(*this, view, file);
 	m_operations.insert(op);
-	op->start();
-	return op;
+	queue_io_operation(op, IO_PRIORITY_EXPORT);
+	return check_operation(op);
 }
 
 Gobby::OperationSave*
@@ -186,12 +211,101 @@ void Gobby::Operations::finish_operation(Operation* operation)
 {
 	m_operations.erase(operation);
 	operation->signal_finished().emit(true);
+	remove_io_operation(operation);
 	delete operation;
+
+	process_io_queue();
 }
 
 void Gobby::Operations::fail_operation(Operation* operation)
 {
 	m_operations.erase(operation);
 	operation->signal_finished().emit(false);
+	remove_io_operation(operation);
 	delete operation;
+
+	process_io_queue();
+}
+
+void Gobby::Operations::queue_io_operation(Operation* operation,
+                                           IoPriority priority)
+{
+	// Insert after all operations with the same or a higher priority,
+	// so that operations with the same priority run in the order in
+	// which they were requested.
+	IoQueue::iterator iter = m_io_queue.begin();
+	while(iter != m_io_queue.end() && iter->first <= priority)
+		++iter;
+
+	m_io_queue.insert(iter, std::make_pair(priority, operation));
+	process_io_queue();
+}
+
+void Gobby::Operations::remove_io_operation(Operation* operation)
+{
+	m_io_running.erase(operation);
+
+	for(IoQueue::iterator iter = m_io_queue.begin();
+	    iter != m_io_queue.end(); ++iter)
+	{
+		if(iter->second == operation)
+		{
+			m_io_queue.erase(iter);
+			break;
+		}
+	}
+}
+
+void Gobby::Operations::process_io_queue()
+{
+	// Starting an operation can finish or fail it synchronously, which
+	// calls back into this function. The outermost call takes care of
+	// starting all operations in that case.
+	if(m_processing_io_queue) return;
+	m_processing_io_queue = true;
+
+	while(!m_io_queue.empty() &&
+	      m_io_running.size() <
+	      m_preferences.editor.parallel_file_operations)
+	{
+		Operation* operation = m_io_queue.front().second;
+		m_io_queue.pop_front();
+
+		m_io_running.insert(operation);
+		operation->start();
+	}
+
+	m_processing_io_queue = false;
+	update_io_status();
+}
+
+void Gobby::Operations::update_io_status()
+{
+	if(m_io_queue.empty())
+	{
+		if(m_io_message_handle != m_status_bar.invalid_handle())
+		{
+			m_status_bar.remove_message(m_io_message_handle);
+			m_io_message_handle = m_status_bar.invalid_handle();
+		}
+	}
+	else
+	{
+		const Glib::ustring message = Glib::ustring::compose(
+			ngettext("%1 file operation queued, %2 running...",
+			         "%1 file operations queued, %2 running...",
+			         m_io_queue.size()),
+			m_io_queue.size(), m_io_running.size());
+
+		if(m_io_message_handle == m_status_bar.invalid_handle())
+		{
+			m_io_message_handle =
+				m_status_bar.add_info_message(message);
+		}
+		else
+		{
+			m_status_bar.update_info_message(
+				m_io_message_handle, message);
+		}
+	}
 }
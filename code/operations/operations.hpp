@@ -17,6 +17,7 @@
 #ifndef _GOBBY_OPERATIONS_OPERATIONS_HPP_
 #define _GOBBY_OPERATIONS_OPERATIONS_HPP_
 
+#include "core/preferences.hpp"
 #include "core/browser.hpp"
 #include "core/statusbar.hpp"
 #include "core/documentinfostorage.hpp"
@@ -28,6 +29,7 @@
 #include <gtkmm/window.h>
 #include <sigc++/trackable.h>
 
+#include <list>
 #include <set>
 
 namespace Gobby
@@ -86,6 +88,15 @@ public:
 			m_operations.fail_operation(this);
 		}
 
+		// Reports how fast size bytes of the document with the given
+		// title were processed since start_time, as obtained from
+		// g_get_monotonic_time(), as a debug message. Run gobby with
+		// G_MESSAGES_DEBUG=all to see them.
+		void debug_throughput(const char* action,
+		                      const Glib::ustring& title,
+		                      std::size_t size,
+		                      gint64 start_time) const;
+
 		void finish()
 		{
 			m_operations.finish_operation(this);
@@ -97,13 +108,24 @@ public:
 		SignalFinished m_signal_finished;
 	};
 
+	// Operations that read or write files are queued, and only as many
+	// of them as the parallel-file-operations preference allows run at
+	// the same time. Among the queued ones, those with higher priority,
+	// i.e. lower value, are started first.
+	enum IoPriority {
+		IO_PRIORITY_USER,
+		IO_PRIORITY_AUTOSAVE,
+		IO_PRIORITY_EXPORT
+	};
+
 	typedef sigc::signal<void, OperationSave*> SignalBeginSaveOperation;
 	typedef std::vector<Glib::RefPtr<Gio::File> > file_list;
 
 	Operations(DocumentInfoStorage& info_storage,
 	           Browser& browser,
 	           FolderManager& folder_manager,
-	           StatusBar& status_bar);
+	           StatusBar& status_bar,
+	           const Preferences& preferences);
 	~Operations();
 
 	OperationNew* create_directory(InfBrowser* browser,
@@ -129,7 +151,8 @@ public:
 	OperationSave* save_document(TextSessionView& view,
 	                             const Glib::RefPtr<Gio::File>& file,
 	                             const std::string& encoding,
-	                             DocumentInfoStorage::EolStyle eol_style);
+	                             DocumentInfoStorage::EolStyle eol_style,
+	                             IoPriority priority = IO_PRIORITY_USER);
 
 	OperationDelete* delete_node(InfBrowser* browser,
 	                             const InfBrowserIter* iter);
@@ -153,14 +176,26 @@ protected:
 	void fail_operation(Operation* operation);
 	void finish_operation(Operation* operation);
 
+	void queue_io_operation(Operation* operation, IoPriority priority);
+	void remove_io_operation(Operation* operation);
+	void process_io_queue();
+	void update_io_status();
+
 	DocumentInfoStorage& m_info_storage;
 	Browser& m_browser;
 	FolderManager& m_folder_manager;
 	StatusBar& m_status_bar;
+	const Preferences& m_preferences;
 
 	typedef std::set<Operation*> OperationSet;
 	OperationSet m_operations;
 
+	typedef std::list<std::pair<IoPriority, Operation*> > IoQueue;
+	IoQueue m_io_queue;
+	OperationSet m_io_running;
+	bool m_processing_io_queue;
+	StatusBar::MessageHandle m_io_message_handle;
+
 	SignalBeginSaveOperation m_signal_begin_save_operation;
 private:
 	template<typename OperationType>
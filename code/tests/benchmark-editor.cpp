@@ -0,0 +1,172 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "tests/benchmark-editor.hpp"
+
+#include <iostream>
+
+namespace
+{
+	// Generous upper bound for any single operation, in seconds
+	const unsigned int OPERATION_TIMEOUT = 600;
+
+	// How long to wait for the local user to join a document that has
+	// been opened, in seconds
+	const unsigned int USER_JOIN_TIMEOUT = 60;
+}
+
+Gobby::Benchmark::Editor::Editor(const Environment& env):
+	m_config(env.get_path("config.xml")),
+	m_preferences(m_config),
+	m_language_index(gtk_source_language_manager_get_default()),
+	m_cert_manager(m_preferences),
+	m_auth_manager(m_preferences),
+	m_connection_manager(m_cert_manager, m_preferences),
+	m_text_folder(false, m_preferences, m_language_index),
+	m_chat_folder(true, m_preferences, m_language_index),
+	m_statusbar(m_text_folder, m_preferences),
+	m_browser(m_window, m_statusbar, m_connection_manager),
+	m_info_storage(INF_GTK_BROWSER_MODEL(m_browser.get_store())),
+	m_folder_manager(m_browser, m_info_storage,
+	                 m_text_folder, m_chat_folder),
+	m_operations(m_info_storage, m_browser,
+	             m_folder_manager, m_statusbar, m_preferences),
+	m_reporter(m_statusbar),
+	m_self_hoster(m_connection_manager.get_io(),
+	              m_connection_manager.get_communication_manager(),
+	              m_connection_manager.get_publisher(),
+	              m_auth_manager.get_sasl_context(),
+	              m_reporter, m_cert_manager, m_preferences),
+	m_user_join_commands(m_folder_manager, m_preferences),
+	m_success(false), m_view(NULL)
+{
+	// Only measure the editor itself, without sharing documents or
+	// storing them in the directory.
+	m_preferences.user.allow_remote_access = false;
+	m_preferences.user.keep_local_documents = false;
+
+	// Adding the directory to the browser installs the note plugins.
+	m_browser.add_browser(INF_BROWSER(m_self_hoster.get_directory()),
+	                      "This Computer");
+
+	m_folder_manager.signal_document_added().connect(
+		sigc::mem_fun(*this, &Editor::on_document_added));
+}
+
+Gobby::TextSessionView*
+Gobby::Benchmark::Editor::open_document(const std::string& name,
+                                        const std::string& path,
+                                        gint64& elapsed)
+{
+	InfBrowser* browser = INF_BROWSER(m_self_hoster.get_directory());
+	InfBrowserIter root;
+	inf_browser_get_root(browser, &root);
+
+	m_view = NULL;
+	elapsed = wait(m_operations.create_document(
+			browser, &root, name, m_preferences,
+			Gio::File::create_for_path(path), NULL),
+	               name + ": open");
+	if(elapsed < 0) return NULL;
+
+	if(m_view == NULL)
+	{
+		std::cerr << name << ": no document was added" << std::endl;
+		return NULL;
+	}
+
+	TextSessionView* view = m_view;
+	if(view->get_active_user() == NULL)
+	{
+		sigc::connection connection =
+			view->signal_active_user_changed().connect(
+				sigc::mem_fun(
+					*this,
+					&Editor::on_active_user_changed));
+		const bool joined = m_waiter.wait(USER_JOIN_TIMEOUT);
+		connection.disconnect();
+
+		if(!joined)
+		{
+			std::cerr << name << ": user join timed out"
+			          << std::endl;
+			close_document(*view);
+			return NULL;
+		}
+	}
+
+	m_text_folder.switch_to_document(*view);
+	return view;
+}
+
+void Gobby::Benchmark::Editor::close_document(TextSessionView& view)
+{
+	m_folder_manager.remove_document(view);
+}
+
+gint64 Gobby::Benchmark::Editor::wait(Operations::Operation* op,
+                                      const std::string& what)
+{
+	// The operation is NULL if it finished synchronously, which only
+	// happens if it failed right away.
+	if(op == NULL)
+	{
+		std::cerr << what << " failed" << std::endl;
+		return -1;
+	}
+
+	m_success = false;
+	const gint64 start_time = g_get_monotonic_time();
+	op->signal_finished().connect(
+		sigc::mem_fun(*this, &Editor::on_finished));
+
+	if(!m_waiter.wait(OPERATION_TIMEOUT))
+	{
+		std::cerr << what << " timed out" << std::endl;
+		return -1;
+	}
+
+	const gint64 elapsed = g_get_monotonic_time() - start_time;
+	if(!m_success)
+	{
+		std::cerr << what << " failed" << std::endl;
+		return -1;
+	}
+
+	return elapsed;
+}
+
+void Gobby::Benchmark::Editor::on_document_added(
+	InfBrowser* browser, const InfBrowserIter* iter,
+	InfSessionProxy* proxy, Folder& folder, SessionView& view,
+	FolderManager::UserJoinRef userjoin)
+{
+	TextSessionView* text_view = dynamic_cast<TextSessionView*>(&view);
+	if(text_view != NULL)
+		m_view = text_view;
+}
+
+void Gobby::Benchmark::Editor::on_active_user_changed(InfUser* user)
+{
+	if(user != NULL)
+		m_waiter.done();
+}
+
+void Gobby::Benchmark::Editor::on_finished(bool success)
+{
+	m_success = success;
+	m_waiter.done();
+}
@@ -0,0 +1,117 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_TESTS_BENCHMARK_EDITOR_HPP_
+#define _GOBBY_TESTS_BENCHMARK_EDITOR_HPP_
+
+#include "tests/benchmark-util.hpp"
+
+#include "operations/operations.hpp"
+#include "commands/user-join-commands.hpp"
+
+#include "core/selfhoster.hpp"
+#include "core/foldermanager.hpp"
+#include "core/documentinfostorage.hpp"
+#include "core/browser.hpp"
+#include "core/statusbar.hpp"
+#include "core/folder.hpp"
+#include "core/textsessionview.hpp"
+#include "core/connectionmanager.hpp"
+#include "core/authmanager.hpp"
+#include "core/certificatemanager.hpp"
+#include "core/languageindex.hpp"
+#include "core/preferences.hpp"
+
+#include "util/config.hpp"
+
+#include <gtkmm/window.h>
+
+#include <string>
+
+namespace Gobby
+{
+
+namespace Benchmark
+{
+
+// Sets up the objects the application window is made of, with a local
+// directory that documents can be opened in. Documents are neither shared
+// nor kept in the directory. This needs a display, and GTK+, gtkmm, the
+// resources and libinfinity need to be initialized before it is created.
+class Editor
+{
+public:
+	Editor(const Environment& env);
+
+	Preferences& get_preferences() { return m_preferences; }
+	Gtk::Window& get_window() { return m_window; }
+	Folder& get_text_folder() { return m_text_folder; }
+	StatusBar& get_status_bar() { return m_statusbar; }
+	Operations& get_operations() { return m_operations; }
+
+	// Opens the file at path as a new document called name, and waits
+	// until the local user has joined it, so that it can be edited.
+	// Returns NULL if that fails. The time it took to open the file
+	// is stored in elapsed, in microseconds.
+	TextSessionView* open_document(const std::string& name,
+	                               const std::string& path,
+	                               gint64& elapsed);
+	void close_document(TextSessionView& view);
+
+	// Waits for op to finish. Returns how long it took, in
+	// microseconds, or -1 if it failed, in which case an error
+	// mentioning what is printed.
+	gint64 wait(Operations::Operation* op, const std::string& what);
+
+protected:
+	void on_document_added(InfBrowser* browser,
+	                       const InfBrowserIter* iter,
+	                       InfSessionProxy* proxy,
+	                       Folder& folder,
+	                       SessionView& view,
+	                       FolderManager::UserJoinRef userjoin);
+	void on_active_user_changed(InfUser* user);
+	void on_finished(bool success);
+
+	Config m_config;
+	Preferences m_preferences;
+	LanguageIndex m_language_index;
+	CertificateManager m_cert_manager;
+	AuthManager m_auth_manager;
+	ConnectionManager m_connection_manager;
+
+	Gtk::Window m_window;
+	Folder m_text_folder;
+	Folder m_chat_folder;
+	StatusBar m_statusbar;
+	Browser m_browser;
+	DocumentInfoStorage m_info_storage;
+	FolderManager m_folder_manager;
+	Operations m_operations;
+	StatusBarReporter m_reporter;
+	SelfHoster m_self_hoster;
+	UserJoinCommands m_user_join_commands;
+
+	Waiter m_waiter;
+	bool m_success;
+	TextSessionView* m_view;
+};
+
+}
+
+}
+
+#endif // _GOBBY_TESTS_BENCHMARK_EDITOR_HPP_
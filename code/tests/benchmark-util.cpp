@@ -0,0 +1,140 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "tests/benchmark-util.hpp"
+
+#include <glib/gstdio.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	void remove_recursive(const std::string& path)
+	{
+		if(Glib::file_test(path, Glib::FILE_TEST_IS_DIR) &&
+		   !Glib::file_test(path, Glib::FILE_TEST_IS_SYMLINK))
+		{
+			Glib::Dir dir(path);
+			for(Glib::DirIterator iter = dir.begin();
+			    iter != dir.end(); ++iter)
+			{
+				remove_recursive(
+					Glib::build_filename(path, *iter));
+			}
+		}
+
+		g_remove(path.c_str());
+	}
+}
+
+Gobby::Benchmark::Environment::Environment(const char* name)
+{
+	const std::string tmpl = std::string("gobby-") + name + "-XXXXXX";
+	gchar* directory = g_dir_make_tmp(tmpl.c_str(), NULL);
+	if(directory == NULL)
+		throw std::runtime_error("Failed to create temporary directory");
+
+	m_directory = directory;
+	g_free(directory);
+
+	g_setenv("XDG_CONFIG_HOME", get_path("config").c_str(), TRUE);
+	g_setenv("GSETTINGS_BACKEND", "memory", TRUE);
+}
+
+Gobby::Benchmark::Environment::~Environment()
+{
+	remove_recursive(m_directory);
+}
+
+std::string
+Gobby::Benchmark::Environment::get_path(const std::string& name) const
+{
+	return Glib::build_filename(m_directory, name);
+}
+
+Gobby::Benchmark::Waiter::Waiter():
+	m_main_loop(Glib::MainLoop::create()), m_done(false),
+	m_timed_out(false)
+{
+}
+
+bool Gobby::Benchmark::Waiter::wait(unsigned int timeout)
+{
+	m_timed_out = false;
+
+	if(!m_done)
+	{
+		sigc::connection timeout_connection =
+			Glib::signal_timeout().connect_seconds(
+				sigc::mem_fun(*this, &Waiter::on_timeout),
+				timeout);
+		m_main_loop->run();
+		timeout_connection.disconnect();
+	}
+
+	m_done = false;
+	return !m_timed_out;
+}
+
+void Gobby::Benchmark::Waiter::done()
+{
+	m_done = true;
+	if(m_main_loop->is_running())
+		m_main_loop->quit();
+}
+
+bool Gobby::Benchmark::Waiter::on_timeout()
+{
+	m_timed_out = true;
+	m_main_loop->quit();
+	return false;
+}
+
+bool Gobby::Benchmark::parse_option(const char* arg, const char* name,
+                                    unsigned int& value)
+{
+	const std::size_t name_len = std::strlen(name);
+	if(std::strncmp(arg, "--", 2) != 0 ||
+	   std::strncmp(arg + 2, name, name_len) != 0 ||
+	   arg[2 + name_len] != '=')
+	{
+		return false;
+	}
+
+	value = std::strtoul(arg + 3 + name_len, NULL, 10);
+	return true;
+}
+
+std::string Gobby::Benchmark::format_rate(std::size_t bytes,
+                                          gint64 microseconds)
+{
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.1f MB/s",
+	              microseconds > 0 ?
+	              static_cast<double>(bytes) / microseconds : 0.0);
+	return buf;
+}
+
+unsigned int Gobby::Benchmark::random(unsigned int n)
+{
+	static GRand* rand = g_rand_new_with_seed(0x539);
+	return g_rand_int_range(rand, 0, n);
+}
@@ -0,0 +1,85 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_TESTS_BENCHMARK_UTIL_HPP_
+#define _GOBBY_TESTS_BENCHMARK_UTIL_HPP_
+
+#include <glibmm/main.h>
+
+#include <cstddef>
+#include <string>
+
+namespace Gobby
+{
+
+namespace Benchmark
+{
+
+// Exit status that tells meson that a benchmark was skipped
+const int EXIT_SKIPPED = 77;
+
+// Creates a temporary directory for the files a benchmark produces, and
+// points the user's configuration directory and GSettings there, so that
+// the real configuration is neither used nor modified. The directory is
+// removed again when the environment is destroyed. Create this before
+// anything else, since GLib caches the configuration directory.
+class Environment
+{
+public:
+	Environment(const char* name);
+	~Environment();
+
+	const std::string& get_directory() const { return m_directory; }
+	std::string get_path(const std::string& name) const;
+
+protected:
+	std::string m_directory;
+};
+
+// Runs the main loop until done() is called, or until the timeout, in
+// seconds, expires. Returns false on timeout.
+class Waiter
+{
+public:
+	Waiter();
+
+	bool wait(unsigned int timeout);
+	void done();
+
+protected:
+	bool on_timeout();
+
+	Glib::RefPtr<Glib::MainLoop> m_main_loop;
+	bool m_done;
+	bool m_timed_out;
+};
+
+// Parses a "--name=value" command line argument. Returns false if arg
+// is a different option.
+bool parse_option(const char* arg, const char* name, unsigned int& value);
+
+// Formats a throughput like "123.4 MB/s".
+std::string format_rate(std::size_t bytes, gint64 microseconds);
+
+// Returns a pseudo-random number in [0, n), from a fixed seed, so that
+// generated content is the same on every run.
+unsigned int random(unsigned int n);
+
+}
+
+}
+
+#endif // _GOBBY_TESTS_BENCHMARK_UTIL_HPP_
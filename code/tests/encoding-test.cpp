@@ -0,0 +1,134 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Checks the encoding detection against a set of sample files, and
+// is_valid_utf8() against some sequences that are easy to get wrong.
+
+#include "util/encoding.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+	const char EIGHT_BIT_ENCODING[] = "ISO-8859-1";
+
+	struct Sample
+	{
+		const char* filename;
+		const char* expected; // NULL means binary
+	};
+
+	const Sample SAMPLES[] = {
+		{ "ascii.txt", "UTF-8" },
+		{ "utf-8.txt", "UTF-8" },
+		{ "utf-8-bom.txt", "UTF-8" },
+		{ "iso-8859-1.txt", "ISO-8859-1" },
+		{ "utf-16le-bom.txt", "UTF-16" },
+		{ "utf-16be-bom.txt", "UTF-16" },
+		{ "utf-16le.txt", "UTF-16LE" },
+		{ "utf-16be.txt", "UTF-16BE" },
+		{ "utf-32le.txt", "UTF-32LE" },
+		{ "utf-32be-bom.txt", "UTF-32" },
+		{ "iso-8859-1-stray-nul.txt", NULL },
+		{ "utf-8-stray-nul.txt", NULL },
+		{ "binary.bin", NULL }
+	};
+
+	struct Utf8Case
+	{
+		const char* data;
+		bool valid;
+	};
+
+	const Utf8Case UTF8_CASES[] = {
+		{ "", true },
+		{ "plain ASCII that is longer than one machine word", true },
+		{ "\xc3\xa4\xc3\xb6\xc3\xbc", true },
+		{ "\xe2\x82\xac and \xf0\x9f\x98\x80", true },
+		{ "\xc3", false },                 // truncated
+		{ "\xc0\xaf", false },             // overlong
+		{ "\xed\xa0\x80", false },         // surrogate
+		{ "\xf4\x90\x80\x80", false },     // beyond U+10FFFF
+		{ "eight bytes\xff then more", false }
+	};
+
+	const char* describe(const char* encoding)
+	{
+		return encoding != NULL ? encoding : "binary";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc != 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " SAMPLE-DIRECTORY"
+		          << std::endl;
+		return 2;
+	}
+
+	unsigned int failures = 0;
+
+	for(const Sample& sample: SAMPLES)
+	{
+		const std::string path =
+			std::string(argv[1]) + "/" + sample.filename;
+		std::ifstream stream(path.c_str(), std::ios::binary);
+		if(!stream)
+		{
+			std::cerr << path << ": cannot be read" << std::endl;
+			++failures;
+			continue;
+		}
+
+		const std::string content(
+			(std::istreambuf_iterator<char>(stream)),
+			std::istreambuf_iterator<char>());
+
+		const char* detected = Gobby::detect_encoding(
+			content.data(), content.size(), EIGHT_BIT_ENCODING);
+
+		const bool match = (detected == NULL || sample.expected == NULL)
+			? detected == sample.expected
+			: std::strcmp(detected, sample.expected) == 0;
+
+		if(!match)
+		{
+			std::cerr << sample.filename << ": detected "
+			          << describe(detected) << ", expected "
+			          << describe(sample.expected) << std::endl;
+			++failures;
+		}
+	}
+
+	for(const Utf8Case& test: UTF8_CASES)
+	{
+		const bool valid = Gobby::is_valid_utf8(
+			test.data, std::strlen(test.data));
+		if(valid != test.valid)
+		{
+			std::cerr << "is_valid_utf8(\"" << test.data
+			          << "\") returned " << valid << std::endl;
+			++failures;
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
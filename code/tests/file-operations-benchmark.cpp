@@ -0,0 +1,480 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Measures how fast documents are opened, saved and exported to HTML, for
+// synthetic files of different encodings, line lengths and line break
+// styles, from 1 KB up to 500 MB. This drives the same Operations that the
+// user interface uses, so it needs a display; without one, the benchmark is
+// skipped. For each stage, the main loop dispatches recorded by the stall
+// profiler during it are summarized as percentiles, and the peak resident
+// set size of the process so far is shown.
+//
+// Usage: file-operations-benchmark [--max-size=MEGABYTES]
+
+#include "tests/benchmark-editor.hpp"
+
+#include "operations/operation-open.hpp"
+#include "operations/operation-save.hpp"
+#include "operations/operation-export-html.hpp"
+
+#include "util/stallprofiler.hpp"
+
+#include "gobby-resources.h"
+
+#include <libinfinity/common/inf-init.h>
+
+#include <gtkmm/main.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/convert.h>
+
+#ifndef G_OS_WIN32
+# include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+	const char* const ASCII_WORDS[] = {
+		"the", "quick", "brown", "fox", "jumps", "over", "lazy",
+		"dog", "collaborative", "editing", "with", "gobby", "and",
+		"infinote", "document", "session", "request", "{", "}",
+		"(x)", "return", "0;", NULL
+	};
+
+	const char* const LATIN1_WORDS[] = {
+		"Grüße", "aus", "Köln", "naïve", "café", "déjà", "vu",
+		"Straße", "über", "Ärger", "ökonomisch", "façade", "und",
+		"der", "die", "das", NULL
+	};
+
+	const char* const UNICODE_WORDS[] = {
+		"Grüße", "Ελληνικά", "日本語", "中文", "русский", "עברית",
+		"emoji", "\xf0\x9f\x98\x80", "text", "with", "many", "scripts",
+		NULL
+	};
+
+	struct Corpus
+	{
+		const char* name;
+		// Encoding the file is written in
+		const char* encoding;
+		// Byte order mark the file starts with. Saving does not
+		// write one, so it is not part of what a saved file is
+		// compared with.
+		const char* bom;
+		const char* eol;
+		Gobby::DocumentInfoStorage::EolStyle eol_style;
+		const char* const* words;
+		unsigned int min_words_per_line;
+		unsigned int max_words_per_line;
+	};
+
+	const Corpus CORPORA[] = {
+		{ "ascii-short-lines", "UTF-8", "", "\n",
+		  Gobby::DocumentInfoStorage::EOL_LF,
+		  ASCII_WORDS, 1, 12 },
+		{ "ascii-cr", "UTF-8", "", "\r",
+		  Gobby::DocumentInfoStorage::EOL_CR,
+		  ASCII_WORDS, 4, 16 },
+		{ "utf8-long-lines", "UTF-8", "", "\n",
+		  Gobby::DocumentInfoStorage::EOL_LF,
+		  UNICODE_WORDS, 200, 400 },
+		{ "latin1-crlf", "ISO-8859-1", "", "\r\n",
+		  Gobby::DocumentInfoStorage::EOL_CRLF,
+		  LATIN1_WORDS, 4, 16 },
+		{ "utf16le", "UTF-16LE", "\xff\xfe", "\n",
+		  Gobby::DocumentInfoStorage::EOL_LF,
+		  UNICODE_WORDS, 4, 16 }
+	};
+
+	const std::size_t KB = 1024;
+	const std::size_t MB = 1024 * 1024;
+	const std::size_t SIZES[] = {
+		1 * KB, 64 * KB, 1 * MB, 16 * MB, 128 * MB, 500 * MB
+	};
+
+	std::string format_size(std::size_t size)
+	{
+		char buf[32];
+		if(size >= MB)
+			std::snprintf(buf, sizeof(buf), "%u MB",
+			              static_cast<unsigned int>(size / MB));
+		else
+			std::snprintf(buf, sizeof(buf), "%u KB",
+			              static_cast<unsigned int>(size / KB));
+		return buf;
+	}
+
+	// Returns UTF-8 text of at least size bytes, with LF line breaks
+	// and a line break at the end.
+	std::string generate_text(const Corpus& corpus, std::size_t size)
+	{
+		unsigned int n_words = 0;
+		while(corpus.words[n_words] != NULL)
+			++n_words;
+
+		std::string text;
+		text.reserve(size + 4096);
+
+		while(text.size() < size)
+		{
+			const unsigned int words =
+				corpus.min_words_per_line +
+				Gobby::Benchmark::random(
+					corpus.max_words_per_line -
+					corpus.min_words_per_line + 1);
+
+			for(unsigned int i = 0; i < words; ++i)
+			{
+				if(i > 0) text += ' ';
+				text += corpus.words[
+					Gobby::Benchmark::random(n_words)];
+			}
+
+			text += '\n';
+		}
+
+		return text;
+	}
+
+	// Converts text as produced by generate_text() into the file
+	// content for the given corpus, without the byte order mark.
+	std::string encode_text(const Corpus& corpus, const std::string& text)
+	{
+		std::string content;
+		content.reserve(text.size() * 2);
+
+		for(std::string::const_iterator iter = text.begin();
+		    iter != text.end(); ++iter)
+		{
+			if(*iter == '\n')
+				content += corpus.eol;
+			else
+				content += *iter;
+		}
+
+		if(std::string(corpus.encoding) == "UTF-8")
+			return content;
+
+		return Glib::convert(content, corpus.encoding, "UTF-8");
+	}
+
+	// Sums up what the stall profiler recorded for all sites
+	Gobby::StallProfiler::Site get_total_dispatches()
+	{
+		Gobby::StallProfiler::Site total;
+		total.name = "total";
+		total.dispatches = 0;
+		total.stalls = 0;
+		total.total_time = 0;
+		total.max_time = 0;
+		std::fill(total.buckets,
+		          total.buckets + Gobby::StallProfiler::N_BUCKETS, 0);
+
+		const std::vector<Gobby::StallProfiler::Site> sites =
+			Gobby::StallProfiler::get_sites();
+		for(std::vector<Gobby::StallProfiler::Site>::const_iterator
+			iter = sites.begin(); iter != sites.end(); ++iter)
+		{
+			total.dispatches += iter->dispatches;
+			total.stalls += iter->stalls;
+			total.total_time += iter->total_time;
+			total.max_time = std::max(total.max_time,
+			                          iter->max_time);
+			for(unsigned int i = 0;
+			    i < Gobby::StallProfiler::N_BUCKETS; ++i)
+			{
+				total.buckets[i] += iter->buckets[i];
+			}
+		}
+
+		return total;
+	}
+
+	// Formats the upper bound of a percentile of the dispatch time,
+	// in milliseconds.
+	std::string format_percentile(const Gobby::StallProfiler::Site& site,
+	                              double percentile)
+	{
+		if(site.dispatches == 0)
+			return "-";
+
+		char buf[32];
+		const gint64 value = site.get_percentile(percentile);
+		if(value < 0)
+		{
+			std::snprintf(buf, sizeof(buf), ">%ld",
+			              static_cast<long>(1) <<
+			              (Gobby::StallProfiler::N_BUCKETS - 2));
+		}
+		else
+		{
+			std::snprintf(buf, sizeof(buf), "%ld",
+			              static_cast<long>(value));
+		}
+
+		return buf;
+	}
+
+	// Returns the peak resident set size of the process so far, in
+	// kilobytes, or -1 if it is not known.
+	long get_max_rss()
+	{
+#ifdef G_OS_WIN32
+		return -1;
+#else
+		struct rusage usage;
+		if(getrusage(RUSAGE_SELF, &usage) != 0)
+			return -1;
+# ifdef __APPLE__
+		// In bytes instead of kilobytes
+		return usage.ru_maxrss / 1024;
+# else
+		return usage.ru_maxrss;
+# endif
+#endif
+	}
+}
+
+class FileOperationsBenchmark
+{
+public:
+	FileOperationsBenchmark(const Gobby::Benchmark::Environment& env);
+
+	// Returns false if anything failed.
+	bool run(const Corpus& corpus, std::size_t size);
+
+protected:
+	// Waits for op to finish, and reports how long it took. Returns
+	// false if it failed.
+	bool wait(Gobby::Operations::Operation* op, const char* corpus,
+	          const char* stage, std::size_t size);
+
+	// report() covers the main loop dispatches since the last call to
+	// begin_stage().
+	void begin_stage();
+	void report(const char* corpus, const char* stage,
+	            std::size_t size, gint64 elapsed);
+
+	const Gobby::Benchmark::Environment& m_env;
+	Gobby::Benchmark::Editor m_editor;
+
+	// What the stall profiler had recorded when the current stage
+	// began
+	Gobby::StallProfiler::Site m_stage_start;
+};
+
+FileOperationsBenchmark::FileOperationsBenchmark(
+	const Gobby::Benchmark::Environment& env):
+	m_env(env), m_editor(env), m_stage_start(get_total_dispatches())
+{
+}
+
+bool FileOperationsBenchmark::run(const Corpus& corpus, std::size_t size)
+{
+	const std::string text = generate_text(corpus, size);
+	const std::string input = m_env.get_path(
+		std::string(corpus.name) + ".txt");
+	Glib::file_set_contents(input,
+		std::string(corpus.bom) + encode_text(corpus, text));
+
+	gint64 elapsed;
+	begin_stage();
+	Gobby::TextSessionView* view =
+		m_editor.open_document(corpus.name, input, elapsed);
+	if(view == NULL) return false;
+
+	report(corpus.name, "open", text.size(), elapsed);
+
+	Gobby::Operations& operations = m_editor.get_operations();
+	bool result = true;
+
+	// Saving as UTF-8 with LF line breaks needs to reproduce the
+	// generated text exactly.
+	const std::string utf8_output = m_env.get_path(
+		std::string(corpus.name) + ".utf8.txt");
+	if(wait(operations.save_document(
+			*view, Gio::File::create_for_path(utf8_output),
+			"UTF-8", Gobby::DocumentInfoStorage::EOL_LF),
+	        corpus.name, "save utf-8", text.size()))
+	{
+		if(Glib::file_get_contents(utf8_output) != text)
+		{
+			std::cerr << corpus.name << ": saved document "
+			          << "differs from the original" << std::endl;
+			result = false;
+		}
+	}
+	else
+	{
+		result = false;
+	}
+
+	// Saving with the original encoding and line breaks needs to
+	// reproduce the original file.
+	if(std::string(corpus.encoding) != "UTF-8" ||
+	   corpus.eol_style != Gobby::DocumentInfoStorage::EOL_LF)
+	{
+		const std::string output = m_env.get_path(
+			std::string(corpus.name) + ".saved.txt");
+		if(wait(operations.save_document(
+				*view, Gio::File::create_for_path(output),
+				corpus.encoding, corpus.eol_style),
+		        corpus.name, "save original", text.size()))
+		{
+			if(Glib::file_get_contents(output) !=
+			   encode_text(corpus, text))
+			{
+				std::cerr << corpus.name << ": document "
+				          << "saved in the original encoding "
+				          << "differs from the original"
+				          << std::endl;
+				result = false;
+			}
+		}
+		else
+		{
+			result = false;
+		}
+	}
+
+	const std::string html_output = m_env.get_path(
+		std::string(corpus.name) + ".html");
+	if(!wait(operations.export_html(
+			*view, Gio::File::create_for_path(html_output)),
+	         corpus.name, "export html", text.size()))
+	{
+		result = false;
+	}
+
+	m_editor.close_document(*view);
+
+	// Make room for the next, possibly larger, run
+	std::remove(input.c_str());
+	std::remove(utf8_output.c_str());
+	std::remove(m_env.get_path(
+		std::string(corpus.name) + ".saved.txt").c_str());
+	std::remove(html_output.c_str());
+	return result;
+}
+
+bool FileOperationsBenchmark::wait(Gobby::Operations::Operation* op,
+                                   const char* corpus, const char* stage,
+                                   std::size_t size)
+{
+	begin_stage();
+	const gint64 elapsed = m_editor.wait(
+		op, std::string(corpus) + ": " + stage);
+	if(elapsed < 0) return false;
+
+	report(corpus, stage, size, elapsed);
+	return true;
+}
+
+void FileOperationsBenchmark::begin_stage()
+{
+	m_stage_start = get_total_dispatches();
+}
+
+void FileOperationsBenchmark::report(const char* corpus, const char* stage,
+                                     std::size_t size, gint64 elapsed)
+{
+	Gobby::StallProfiler::Site dispatches = get_total_dispatches();
+	dispatches.dispatches -= m_stage_start.dispatches;
+	for(unsigned int i = 0; i < Gobby::StallProfiler::N_BUCKETS; ++i)
+		dispatches.buckets[i] -= m_stage_start.buckets[i];
+
+	std::printf("%-18s %7s %-14s %9.3f s %14s %6s %6s %6s %9ld\n",
+	            corpus, format_size(size).c_str(), stage,
+	            elapsed / 1e6,
+	            Gobby::Benchmark::format_rate(size, elapsed).c_str(),
+	            format_percentile(dispatches, 0.50).c_str(),
+	            format_percentile(dispatches, 0.90).c_str(),
+	            format_percentile(dispatches, 0.99).c_str(),
+	            get_max_rss());
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int max_megabytes = 500;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!Gobby::Benchmark::parse_option(argv[i], "max-size",
+		                                   max_megabytes))
+		{
+			std::cerr << "Usage: " << argv[0]
+			          << " [--max-size=MEGABYTES]" << std::endl;
+			return 2;
+		}
+	}
+
+	try
+	{
+		Gobby::Benchmark::Environment env("file-operations");
+
+		if(!gtk_init_check(&argc, &argv))
+		{
+			std::cerr << "No display available, skipping"
+			          << std::endl;
+			return Gobby::Benchmark::EXIT_SKIPPED;
+		}
+
+		Gtk::Main::init_gtkmm_internals();
+		_gobby_get_resource();
+
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		Gobby::StallProfiler::enable();
+		FileOperationsBenchmark benchmark(env);
+
+		// Dispatch times are in milliseconds, the peak resident set
+		// size in kilobytes.
+		std::printf("%-18s %7s %-14s %11s %14s %6s %6s %6s %9s\n",
+		            "corpus", "size", "stage", "time", "throughput",
+		            "p50", "p90", "p99", "max rss");
+
+		bool result = true;
+		for(const std::size_t size: SIZES)
+		{
+			if(size > max_megabytes * MB)
+				break;
+
+			for(const Corpus& corpus: CORPORA)
+			{
+				if(!benchmark.run(corpus, size))
+					result = false;
+			}
+		}
+
+		return result ? 0 : 1;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
@@ -0,0 +1,476 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Compares how many bytes are written to disk for a locally hosted document
+// that is edited and saved periodically, with and without journaling. The
+// same edits are made in both modes. With journaling, the document is read
+// back from the checkpoint and the journal at the end, and compared with
+// the edited text. This does not need a display.
+//
+// Usage: journal-benchmark [--size=KILOBYTES] [--edits=N]
+//                          [--save-interval=N]
+
+#include "tests/benchmark-util.hpp"
+
+#include "core/noteplugin.hpp"
+#include "core/textjournal.hpp"
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glibmm/init.h>
+#include <glib/gstdio.h>
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	const char* const WORDS[] = {
+		"the", "quick", "brown", "fox", "jumps", "over", "lazy",
+		"dog", "collaborative", "editing", "with", "gobby", "and",
+		"infinote", "document", "session", "request", NULL
+	};
+
+	const char DOCUMENT_PATH[] = "/document";
+
+	// A single keystroke. Most of the time, typing continues where
+	// the previous keystroke left off.
+	struct Edit
+	{
+		// Move the cursor to position % (length + 1) first
+		bool jump;
+		unsigned int position;
+		// Erase the character before the cursor, instead of
+		// inserting character
+		bool erase;
+		char character;
+	};
+
+	typedef std::vector<Edit> EditList;
+
+	std::string generate_text(std::size_t size)
+	{
+		unsigned int n_words = 0;
+		while(WORDS[n_words] != NULL)
+			++n_words;
+
+		std::string text;
+		while(text.size() < size)
+		{
+			const unsigned int words =
+				1 + Gobby::Benchmark::random(12);
+			for(unsigned int i = 0; i < words; ++i)
+			{
+				if(i > 0) text += ' ';
+				text += WORDS[Gobby::Benchmark::random(n_words)];
+			}
+
+			text += '\n';
+		}
+
+		return text;
+	}
+
+	EditList generate_edits(unsigned int n_edits)
+	{
+		const char characters[] = "abcdefghijklmnopqrstuvwxyz \n";
+
+		EditList edits(n_edits);
+		for(EditList::iterator iter = edits.begin();
+		    iter != edits.end(); ++iter)
+		{
+			iter->jump = Gobby::Benchmark::random(50) == 0;
+			iter->position = Gobby::Benchmark::random(G_MAXINT);
+			iter->erase = Gobby::Benchmark::random(10) == 0;
+			iter->character = characters[Gobby::Benchmark::random(
+				sizeof(characters) - 1)];
+		}
+
+		return edits;
+	}
+
+	std::string get_text(InfTextBuffer* buffer)
+	{
+		InfTextChunk* chunk = inf_text_buffer_get_slice(
+			buffer, 0, inf_text_buffer_get_length(buffer));
+
+		gsize bytes;
+		gchar* text = static_cast<gchar*>(
+			inf_text_chunk_get_text(chunk, &bytes));
+		const std::string result(text, bytes);
+
+		g_free(text);
+		inf_text_chunk_free(chunk);
+		return result;
+	}
+
+	std::size_t get_file_size(const std::string& filename)
+	{
+		GStatBuf buf;
+		if(g_stat(filename.c_str(), &buf) != 0)
+			return 0;
+		return buf.st_size;
+	}
+
+	void fail(const char* mode, GError* error)
+	{
+		std::cerr << mode << ": " << error->message << std::endl;
+		g_error_free(error);
+	}
+}
+
+class JournalBenchmark
+{
+public:
+	JournalBenchmark(const Gobby::Benchmark::Environment& env,
+	                 const std::string& text, const EditList& edits,
+	                 unsigned int save_interval);
+	~JournalBenchmark();
+
+	// Each returns false if anything failed.
+	bool run_rewrite();
+	bool run_journal();
+
+protected:
+	// Creates the document with the initial text, and writes it.
+	bool setup(const char* mode);
+	void teardown();
+
+	// Makes the edits, calling save every save_interval edits and at
+	// the end.
+	template<typename SaveFunc>
+	bool edit(SaveFunc save);
+
+	void report(const char* mode, unsigned int saves,
+	            std::size_t bytes, gint64 elapsed);
+
+	const Gobby::Benchmark::Environment& m_env;
+	const std::string& m_text;
+	const EditList& m_edits;
+	const unsigned int m_save_interval;
+
+	InfdFilesystemStorage* m_storage;
+	std::string m_document_filename;
+	std::string m_journal_filename;
+
+	InfUserTable* m_user_table;
+	InfTextBuffer* m_buffer;
+	InfUser* m_user;
+	gint64 m_save_time;
+};
+
+JournalBenchmark::JournalBenchmark(const Gobby::Benchmark::Environment& env,
+                                   const std::string& text,
+                                   const EditList& edits,
+                                   unsigned int save_interval):
+	m_env(env), m_text(text), m_edits(edits),
+	m_save_interval(save_interval),
+	m_storage(infd_filesystem_storage_new(
+		env.get_path("documents").c_str())),
+	m_document_filename(env.get_path("documents") + DOCUMENT_PATH),
+	m_journal_filename(env.get_path("documents.journal") +
+	                   DOCUMENT_PATH + ".journal"),
+	m_user_table(NULL), m_buffer(NULL), m_user(NULL), m_save_time(0)
+{
+	g_mkdir_with_parents(env.get_path("documents").c_str(), 0700);
+}
+
+JournalBenchmark::~JournalBenchmark()
+{
+	teardown();
+	g_object_unref(m_storage);
+}
+
+bool JournalBenchmark::setup(const char* mode)
+{
+	teardown();
+
+	m_user_table = inf_user_table_new();
+	m_buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+	m_user = INF_USER(g_object_new(
+		INF_TEXT_TYPE_USER,
+		"id", 1u,
+		"name", "benchmark",
+		"hue", 0.5,
+		static_cast<void*>(NULL)));
+	inf_user_table_add_user(m_user_table, m_user);
+
+	inf_text_buffer_insert_text(m_buffer, 0, m_text.data(),
+	                            m_text.size(),
+	                            g_utf8_strlen(m_text.data(),
+	                                          m_text.size()),
+	                            m_user);
+
+	Gobby::TextJournal::remove(m_storage, DOCUMENT_PATH);
+
+	GError* error = NULL;
+	if(!inf_text_filesystem_format_write(m_storage, DOCUMENT_PATH,
+	                                     m_user_table, m_buffer,
+	                                     &error))
+	{
+		fail(mode, error);
+		return false;
+	}
+
+	return true;
+}
+
+void JournalBenchmark::teardown()
+{
+	if(m_buffer != NULL)
+	{
+		g_object_unref(m_user);
+		g_object_unref(m_buffer);
+		g_object_unref(m_user_table);
+		m_buffer = NULL;
+	}
+}
+
+template<typename SaveFunc>
+bool JournalBenchmark::edit(SaveFunc save)
+{
+	guint cursor = 0;
+	m_save_time = 0;
+
+	for(EditList::size_type i = 0; i < m_edits.size(); ++i)
+	{
+		const Edit& keystroke = m_edits[i];
+		const guint length = inf_text_buffer_get_length(m_buffer);
+
+		if(keystroke.jump || cursor > length)
+			cursor = keystroke.position % (length + 1);
+
+		if(keystroke.erase)
+		{
+			if(cursor > 0)
+			{
+				--cursor;
+				inf_text_buffer_erase_text(
+					m_buffer, cursor, 1, m_user);
+			}
+		}
+		else
+		{
+			inf_text_buffer_insert_text(
+				m_buffer, cursor, &keystroke.character, 1, 1,
+				m_user);
+			++cursor;
+		}
+
+		if((i + 1) % m_save_interval == 0 || i + 1 == m_edits.size())
+		{
+			const gint64 start_time = g_get_monotonic_time();
+			const bool result = save();
+			m_save_time += g_get_monotonic_time() - start_time;
+			if(!result) return false;
+		}
+	}
+
+	return true;
+}
+
+bool JournalBenchmark::run_rewrite()
+{
+	if(!setup("rewrite")) return false;
+
+	unsigned int saves = 0;
+	std::size_t bytes = 0;
+	GError* error = NULL;
+
+	const bool result = edit([&]() -> bool {
+		if(!inf_text_filesystem_format_write(
+			m_storage, DOCUMENT_PATH, m_user_table, m_buffer,
+			&error))
+		{
+			return false;
+		}
+
+		++saves;
+		bytes += get_file_size(m_document_filename);
+		return true;
+	});
+
+	if(!result)
+	{
+		fail("rewrite", error);
+		return false;
+	}
+
+	report("rewrite", saves, bytes, m_save_time);
+	return true;
+}
+
+bool JournalBenchmark::run_journal()
+{
+	if(!setup("journal")) return false;
+
+	InfCommunicationManager* manager = inf_communication_manager_new();
+	InfStandaloneIo* io = inf_standalone_io_new();
+	InfTextSession* session = Gobby::Plugins::create_text_session(
+		manager, m_buffer, INF_IO(io), m_user_table,
+		INF_SESSION_RUNNING, NULL, NULL);
+	g_object_unref(io);
+	g_object_unref(manager);
+
+	// As if journaling had been enabled for an existing document
+	Gobby::TextJournal* journal =
+		new Gobby::TextJournal(m_storage, DOCUMENT_PATH);
+	journal->attach(INF_SESSION(session));
+
+	GError* error = NULL;
+	if(!journal->checkpoint(&error))
+	{
+		g_object_unref(session);
+		fail("journal", error);
+		return false;
+	}
+
+	unsigned int saves = 0;
+	std::size_t bytes = 0;
+	std::size_t journal_size = get_file_size(m_journal_filename);
+
+	const bool result = edit([&]() -> bool {
+		if(!journal->flush(&error))
+			return false;
+
+		// The journal starts over after a checkpoint, for which
+		// the whole document has been written as well.
+		const std::size_t size = get_file_size(m_journal_filename);
+		if(size < journal_size)
+			bytes += get_file_size(m_document_filename) + size;
+		else
+			bytes += size - journal_size;
+
+		journal_size = size;
+		++saves;
+		return true;
+	});
+
+	const std::string expected = get_text(m_buffer);
+	g_object_unref(session);
+
+	if(!result)
+	{
+		fail("journal", error);
+		return false;
+	}
+
+	report("journal", saves, bytes, m_save_time);
+
+	// Read the document back, as the directory does when the session
+	// is loaded again.
+	InfUserTable* user_table = inf_user_table_new();
+	InfTextBuffer* buffer =
+		INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+	bool recovered = inf_text_filesystem_format_read(
+		m_storage, DOCUMENT_PATH, user_table, buffer, &error);
+	if(recovered)
+	{
+		Gobby::TextJournal recovery(m_storage, DOCUMENT_PATH);
+		recovered = recovery.recover(user_table, buffer, &error);
+	}
+
+	bool matches = false;
+	if(recovered)
+		matches = get_text(buffer) == expected;
+	else
+		fail("journal", error);
+
+	g_object_unref(buffer);
+	g_object_unref(user_table);
+
+	if(recovered && !matches)
+	{
+		std::cerr << "journal: recovered document differs from the "
+		          << "edited one" << std::endl;
+	}
+
+	return matches;
+}
+
+void JournalBenchmark::report(const char* mode, unsigned int saves,
+                              std::size_t bytes, gint64 elapsed)
+{
+	gchar* size = g_format_size(bytes);
+	std::printf("%-10s %8u %14s %9.3f s\n", mode, saves, size,
+	            elapsed / 1e6);
+	g_free(size);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int kilobytes = 1024;
+	unsigned int n_edits = 20000;
+	unsigned int save_interval = 10;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!Gobby::Benchmark::parse_option(argv[i], "size",
+		                                   kilobytes) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "edits",
+		                                   n_edits) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "save-interval",
+		                                   save_interval))
+		{
+			std::cerr << "Usage: " << argv[0]
+			          << " [--size=KILOBYTES] [--edits=N]"
+			          << " [--save-interval=N]" << std::endl;
+			return 2;
+		}
+	}
+
+	if(save_interval == 0)
+		save_interval = 1;
+
+	try
+	{
+		Gobby::Benchmark::Environment env("journal");
+
+		Glib::init();
+
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		const std::string text = generate_text(kilobytes * 1024);
+		const EditList edits = generate_edits(n_edits);
+
+		std::printf("%-10s %8s %14s %11s\n",
+		            "mode", "saves", "written", "save time");
+
+		JournalBenchmark benchmark(env, text, edits, save_interval);
+		const bool rewrite_result = benchmark.run_rewrite();
+		const bool journal_result = benchmark.run_journal();
+
+		return rewrite_result && journal_result ? 0 : 1;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
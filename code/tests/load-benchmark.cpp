@@ -0,0 +1,1339 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Measures how long it takes until an edit that one client makes shows up
+// at all other clients of a self-hosted server, as the number of clients
+// grows. For each run, the benchmark starts itself again as a server
+// process that hosts the documents with a SelfHoster on the loopback
+// interface, so that the CPU time and memory used by the server can be
+// told apart from the clients'. The clients run in this process. Each has
+// its own ConnectionManager and InfcBrowser, subscribes to one of the
+// documents and joins it as a user, and then replays one of the workloads
+// below. Afterwards, the benchmark waits until every client has executed
+// every request, and checks that all copies of a document are the same.
+// This does not need a display.
+//
+// All clients share a single thread, so with many clients, the benchmark
+// itself can become the bottleneck. Its CPU time is reported next to the
+// server's; lower the typing rate if it comes close to the run time.
+//
+// Usage: load-benchmark [--max-clients=N] [--documents=N]
+//                       [--duration=SECONDS] [--rate=KEYSTROKES]
+//                       [--port=PORT]
+
+#include "tests/benchmark-util.hpp"
+
+#include "core/selfhoster.hpp"
+#include "core/connectionmanager.hpp"
+#include "core/authmanager.hpp"
+#include "core/certificatemanager.hpp"
+#include "core/preferences.hpp"
+#include "core/noteplugin.hpp"
+#include "core/userjoin.hpp"
+
+#include "util/config.hpp"
+#include "util/file.hpp"
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinfinity/client/infc-browser.h>
+#include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <giomm/init.h>
+#include <glib-unix.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	enum WorkloadType
+	{
+		// Bursts of keystrokes at random places, with pauses in
+		// between, and the occasional backspace
+		WORKLOAD_TYPING,
+		// Like typing, but now and then a larger block of text is
+		// pasted
+		WORKLOAD_PASTE,
+		// All clients type at the start of the document at the same
+		// time, so that every request is concurrent to the others
+		WORKLOAD_SAME_OFFSET
+	};
+
+	struct Workload
+	{
+		const char* name;
+		WorkloadType type;
+	};
+
+	const Workload WORKLOADS[] = {
+		{ "typing", WORKLOAD_TYPING },
+		{ "paste", WORKLOAD_PASTE },
+		{ "same-offset", WORKLOAD_SAME_OFFSET }
+	};
+
+	const unsigned int CLIENT_COUNTS[] = { 2, 5, 10, 20, 50, 100, 200 };
+
+	// How often the clients are given a chance to type, in milliseconds
+	const unsigned int TICK_INTERVAL = 10;
+	// How often conditions are checked while waiting, in milliseconds
+	const unsigned int POLL_INTERVAL = 10;
+	// How long connecting, subscribing, joining and converging may take
+	// at most, in seconds
+	const unsigned int TIMEOUT = 120;
+
+	const std::size_t PASTE_SIZE = 2048;
+
+	// CPU time and peak resident size of a process
+	struct Usage
+	{
+		double cpu_time;
+		long max_resident; // in kilobytes
+	};
+
+	Usage get_usage()
+	{
+		Usage result = { 0.0, 0 };
+
+		struct rusage usage;
+		if(getrusage(RUSAGE_SELF, &usage) == 0)
+		{
+			result.cpu_time =
+				usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+				(usage.ru_utime.tv_usec +
+				 usage.ru_stime.tv_usec) / 1e6;
+			// ru_maxrss is in kilobytes on Linux and the BSDs.
+			result.max_resident = usage.ru_maxrss;
+		}
+
+		return result;
+	}
+
+	std::string get_text(InfTextBuffer* buffer)
+	{
+		InfTextChunk* chunk = inf_text_buffer_get_slice(
+			buffer, 0, inf_text_buffer_get_length(buffer));
+
+		gsize bytes;
+		gchar* text = static_cast<gchar*>(
+			inf_text_chunk_get_text(chunk, &bytes));
+		const std::string result(text, bytes);
+
+		g_free(text);
+		inf_text_chunk_free(chunk);
+		return result;
+	}
+
+	std::string generate_paste()
+	{
+		const char characters[] = "abcdefghijklmnopqrstuvwxyz  \n";
+
+		std::string text(PASTE_SIZE, ' ');
+		for(std::string::iterator iter = text.begin();
+		    iter != text.end(); ++iter)
+		{
+			*iter = characters[Gobby::Benchmark::random(
+				sizeof(characters) - 1)];
+		}
+
+		return text;
+	}
+
+	// Runs the main loop until predicate returns true, or until the
+	// timeout, in seconds, expires. Returns false on timeout.
+	template<typename Predicate>
+	bool wait_until(Predicate predicate, unsigned int timeout)
+	{
+		if(predicate()) return true;
+
+		Gobby::Benchmark::Waiter waiter;
+		sigc::connection poll_connection =
+			Glib::signal_timeout().connect([&]() -> bool {
+				if(!predicate()) return true;
+				waiter.done();
+				return false;
+			}, POLL_INTERVAL);
+
+		const bool result = waiter.wait(timeout);
+		poll_connection.disconnect();
+		return result;
+	}
+
+	double percentile(const std::vector<gint64>& sorted, double fraction)
+	{
+		if(sorted.empty()) return 0.0;
+
+		std::vector<gint64>::size_type index =
+			static_cast<std::vector<gint64>::size_type>(
+				fraction * sorted.size());
+		if(index >= sorted.size())
+			index = sorted.size() - 1;
+
+		return sorted[index] / 1e3;
+	}
+}
+
+// The server process. It hosts documents without keeping them on disk,
+// and writes a line to its standard output when it is ready to accept
+// connections, and its resource usage whenever it receives SIGUSR1 or
+// SIGTERM. It exits after SIGTERM.
+class LoadServer: public Gobby::SelfHoster::Reporter
+{
+public:
+	LoadServer(unsigned int port);
+
+	int run();
+
+	virtual MessageId add_info_message(const Glib::ustring& message);
+	virtual void add_error_message(const Glib::ustring& brief_desc,
+	                               const Glib::ustring& detailed_desc);
+	virtual void remove_message(MessageId id);
+
+protected:
+	static gboolean on_usage_signal_static(gpointer user_data)
+	{
+		static_cast<LoadServer*>(user_data)->write_usage();
+		return TRUE;
+	}
+
+	static gboolean on_quit_signal_static(gpointer user_data)
+	{
+		static_cast<LoadServer*>(user_data)->m_main_loop->quit();
+		return TRUE;
+	}
+
+	void on_credentials_changed();
+	void write_usage();
+
+	Gobby::Config m_config;
+	Gobby::Preferences m_preferences;
+	Gobby::CertificateManager m_cert_manager;
+	Gobby::AuthManager m_auth_manager;
+	Gobby::ConnectionManager m_connection_manager;
+	std::unique_ptr<Gobby::SelfHoster> m_self_hoster;
+
+	Glib::RefPtr<Glib::MainLoop> m_main_loop;
+	MessageId m_next_id;
+	bool m_ready;
+	bool m_failed;
+};
+
+LoadServer::LoadServer(unsigned int port):
+	m_config(Gobby::config_filename("load-benchmark-server.xml")),
+	m_preferences(m_config),
+	m_cert_manager(m_preferences),
+	m_auth_manager(m_preferences),
+	m_connection_manager(m_cert_manager, m_preferences),
+	m_main_loop(Glib::MainLoop::create()),
+	m_next_id(INVALID_MESSAGE + 1), m_ready(false), m_failed(false)
+{
+	// The certificate manager stores the Diffie-Hellman parameters in
+	// the configuration directory, so that they only need to be
+	// generated for the first run.
+	g_mkdir_with_parents(Gobby::config_filename("").c_str(), 0700);
+
+	m_preferences.user.allow_remote_access = true;
+	m_preferences.user.require_password = false;
+	m_preferences.user.port = port;
+	m_preferences.user.keep_local_documents = false;
+	m_preferences.security.policy =
+		INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED;
+
+	m_self_hoster.reset(new Gobby::SelfHoster(
+		m_connection_manager.get_io(),
+		m_connection_manager.get_communication_manager(),
+		m_connection_manager.get_publisher(),
+		m_auth_manager.get_sasl_context(),
+		*this, m_cert_manager, m_preferences));
+
+	InfdDirectory* directory = m_self_hoster->get_directory();
+	infd_directory_add_plugin(directory, Gobby::Plugins::D_TEXT_HEADLESS);
+	infd_directory_add_plugin(directory, Gobby::Plugins::D_CHAT);
+
+	// Connected after the self-hoster, so that the server has been
+	// opened by the time this is called.
+	m_cert_manager.signal_credentials_changed().connect(
+		sigc::mem_fun(*this, &LoadServer::on_credentials_changed));
+	on_credentials_changed();
+}
+
+int LoadServer::run()
+{
+	if(m_failed) return 1;
+
+	const guint sigusr1_id =
+		g_unix_signal_add(SIGUSR1, on_usage_signal_static, this);
+	const guint sigterm_id =
+		g_unix_signal_add(SIGTERM, on_quit_signal_static, this);
+
+	m_main_loop->run();
+
+	g_source_remove(sigusr1_id);
+	g_source_remove(sigterm_id);
+
+	if(m_failed) return 1;
+
+	write_usage();
+	return 0;
+}
+
+LoadServer::MessageId
+LoadServer::add_info_message(const Glib::ustring& message)
+{
+	return m_next_id++;
+}
+
+void LoadServer::add_error_message(const Glib::ustring& brief_desc,
+                                   const Glib::ustring& detailed_desc)
+{
+	std::cerr << "server: " << brief_desc << ": " << detailed_desc
+	          << std::endl;
+
+	m_failed = true;
+	m_main_loop->quit();
+}
+
+void LoadServer::remove_message(MessageId id)
+{
+}
+
+void LoadServer::on_credentials_changed()
+{
+	if(m_ready || m_failed || m_cert_manager.get_dh_params() == NULL)
+		return;
+
+	m_ready = true;
+	std::printf("ready\n");
+	std::fflush(stdout);
+}
+
+void LoadServer::write_usage()
+{
+	const Usage usage = get_usage();
+	std::printf("%f %ld\n", usage.cpu_time, usage.max_resident);
+	std::fflush(stdout);
+}
+
+// Starts a LoadServer in a child process, and reads what it writes.
+class ServerProcess
+{
+public:
+	ServerProcess(const char* program, unsigned int port);
+	~ServerProcess();
+
+	// Asks the server how much CPU time and memory it has used so far.
+	bool get_usage(Usage& usage);
+	// Stops the server, and reads its final resource usage.
+	bool stop(Usage& usage);
+
+protected:
+	bool read_usage(Usage& usage);
+
+	GPid m_pid;
+	FILE* m_output;
+};
+
+ServerProcess::ServerProcess(const char* program, unsigned int port):
+	m_pid(0), m_output(NULL)
+{
+	const std::string port_arg =
+		Glib::ustring::compose("--port=%1", port);
+	gchar* argv[] = {
+		const_cast<gchar*>(program),
+		const_cast<gchar*>("--server"),
+		const_cast<gchar*>(port_arg.c_str()),
+		NULL
+	};
+
+	gint output_fd;
+	GError* error = NULL;
+	if(!g_spawn_async_with_pipes(NULL, argv, NULL,
+	                             G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL,
+	                             &m_pid, NULL, &output_fd, NULL, &error))
+	{
+		throw Glib::Error(error);
+	}
+
+	m_output = fdopen(output_fd, "r");
+
+	// Generating Diffie-Hellman parameters before the first run can
+	// take a while, so there is no timeout for this.
+	char line[64];
+	if(std::fgets(line, sizeof(line), m_output) == NULL ||
+	   std::strcmp(line, "ready\n") != 0)
+	{
+		kill(m_pid, SIGKILL);
+		waitpid(m_pid, NULL, 0);
+		g_spawn_close_pid(m_pid);
+		std::fclose(m_output);
+		throw std::runtime_error("The server failed to start");
+	}
+}
+
+ServerProcess::~ServerProcess()
+{
+	if(m_output != NULL)
+	{
+		kill(m_pid, SIGKILL);
+		waitpid(m_pid, NULL, 0);
+		g_spawn_close_pid(m_pid);
+		std::fclose(m_output);
+	}
+}
+
+bool ServerProcess::get_usage(Usage& usage)
+{
+	kill(m_pid, SIGUSR1);
+	return read_usage(usage);
+}
+
+bool ServerProcess::stop(Usage& usage)
+{
+	kill(m_pid, SIGTERM);
+	const bool result = read_usage(usage);
+
+	int status;
+	waitpid(m_pid, &status, 0);
+	g_spawn_close_pid(m_pid);
+	std::fclose(m_output);
+	m_output = NULL;
+
+	return result && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool ServerProcess::read_usage(Usage& usage)
+{
+	char line[64];
+	if(std::fgets(line, sizeof(line), m_output) == NULL)
+		return false;
+
+	return std::sscanf(line, "%lf %ld", &usage.cpu_time,
+	                   &usage.max_resident) == 2;
+}
+
+// A document that a group of clients edits together
+struct Document
+{
+	Document(const std::string& name): name(name), generated(0) {}
+
+	std::string name;
+
+	// Requests that the clients made since the workload started
+	unsigned int generated;
+
+	// When the requests were made, by the ID of the user who made them
+	// and the number of requests that user had made before
+	std::map<guint, std::vector<gint64> > send_times;
+};
+
+// State that all clients share
+struct ClientContext
+{
+	const Gobby::CertificateManager& cert_manager;
+	const Gobby::Preferences& preferences;
+	Gobby::AuthManager& auth_manager;
+	const std::string& paste;
+
+	// How long it took for requests to be executed by the clients that
+	// did not make them, in microseconds
+	std::vector<gint64> latencies;
+};
+
+class ClientParameterProvider: public Gobby::UserJoin::ParameterProvider
+{
+public:
+	ClientParameterProvider(const std::string& name, double hue,
+	                        InfSessionProxy* proxy):
+		m_name(name), m_hue(hue), m_proxy(proxy)
+	{
+	}
+
+	virtual std::vector<GParameter> get_user_join_parameters();
+
+protected:
+	const std::string m_name;
+	const double m_hue;
+	InfSessionProxy* m_proxy;
+};
+
+std::vector<GParameter> ClientParameterProvider::get_user_join_parameters()
+{
+	InfSession* session;
+	g_object_get(G_OBJECT(m_proxy), "session", &session, NULL);
+
+	std::vector<GParameter> params;
+	const GParameter name_param = { "name", { 0 } };
+	params.push_back(name_param);
+	const GParameter status_param = { "status", { 0 } };
+	params.push_back(status_param);
+	const GParameter hue_param = { "hue", { 0 } };
+	params.push_back(hue_param);
+	const GParameter vector_param = { "vector", { 0 } };
+	params.push_back(vector_param);
+	const GParameter caret_param = { "caret-position", { 0 } };
+	params.push_back(caret_param);
+
+	g_value_init(&params[0].value, G_TYPE_STRING);
+	g_value_set_string(&params[0].value, m_name.c_str());
+
+	g_value_init(&params[1].value, INF_TYPE_USER_STATUS);
+	g_value_set_enum(&params[1].value, INF_USER_ACTIVE);
+
+	g_value_init(&params[2].value, G_TYPE_DOUBLE);
+	g_value_set_double(&params[2].value, m_hue);
+
+	g_value_init(&params[3].value, INF_ADOPTED_TYPE_STATE_VECTOR);
+	g_value_take_boxed(&params[3].value,
+		inf_adopted_state_vector_copy(
+			inf_adopted_algorithm_get_current(
+				inf_adopted_session_get_algorithm(
+					INF_ADOPTED_SESSION(session)))));
+
+	g_value_init(&params[4].value, G_TYPE_UINT);
+	g_value_set_uint(&params[4].value, 0);
+
+	g_object_unref(session);
+	return params;
+}
+
+// A simulated user, with its own connection to the server
+class Client: public sigc::trackable
+{
+public:
+	Client(ClientContext& context, Document& document,
+	       unsigned int index, unsigned int n_clients,
+	       const InfIpAddress* address, unsigned int port);
+	~Client();
+
+	const std::string& get_error() const { return m_error; }
+	bool is_open() const;
+
+	void explore();
+	bool is_explored() const;
+
+	void add_document();
+	bool has_document() const;
+
+	void subscribe();
+	bool is_subscribed() const;
+
+	void join();
+	bool has_joined() const { return m_user != NULL; }
+
+	// Starts over with the workload, at the given time.
+	void start(const Workload& workload, unsigned int rate, gint64 now);
+	// Types whatever the workload calls for until now.
+	void tick(gint64 now);
+
+	unsigned int get_executed() const { return m_executed; }
+	gint64 get_last_executed() const { return m_last_executed; }
+	Document& get_document() { return m_document; }
+	std::string get_text() const { return ::get_text(m_buffer); }
+
+protected:
+	static void on_error_static(InfBrowser* browser,
+	                            const GError* error,
+	                            gpointer user_data)
+	{
+		static_cast<Client*>(user_data)->m_error = error->message;
+	}
+
+	static void on_request_finished_static(InfRequest* request,
+	                                       const InfRequestResult* res,
+	                                       const GError* error,
+	                                       gpointer user_data)
+	{
+		if(error != NULL)
+			static_cast<Client*>(user_data)->m_error =
+				error->message;
+	}
+
+	static void on_end_execute_request_static(
+		InfAdoptedAlgorithm* algorithm,
+		InfAdoptedUser* user,
+		InfAdoptedRequest* request,
+		InfAdoptedRequest* translated,
+		const GError* error,
+		gpointer user_data)
+	{
+		static_cast<Client*>(user_data)->on_execute_request(
+			user, request);
+	}
+
+	bool find_document(InfBrowserIter& iter) const;
+
+	void on_user_join_finished(InfUser* user, const GError* error);
+	void on_execute_request(InfAdoptedUser* user,
+	                        InfAdoptedRequest* request);
+
+	void insert(guint pos, const char* text, gsize bytes);
+
+	ClientContext& m_context;
+	Document& m_document;
+	const std::string m_name;
+	const double m_hue;
+
+	Gobby::ConnectionManager m_connection_manager;
+	InfXmppConnection* m_connection;
+	InfcBrowser* m_browser;
+	gulong m_error_handler;
+
+	std::unique_ptr<Gobby::UserJoin> m_user_join;
+	InfUser* m_user;
+	InfTextBuffer* m_buffer;
+	InfAdoptedAlgorithm* m_algorithm;
+	gulong m_execute_request_handler;
+
+	std::string m_error;
+	unsigned int m_executed;
+	gint64 m_last_executed;
+
+	WorkloadType m_workload;
+	gint64 m_keystroke_interval;
+	gint64 m_next_keystroke;
+	unsigned int m_burst;
+	guint m_cursor;
+};
+
+Client::Client(ClientContext& context, Document& document,
+               unsigned int index, unsigned int n_clients,
+               const InfIpAddress* address, unsigned int port):
+	m_context(context), m_document(document),
+	m_name(Glib::ustring::compose("client-%1", index)),
+	m_hue(static_cast<double>(index) / n_clients),
+	m_connection_manager(context.cert_manager, context.preferences),
+	m_connection(NULL), m_browser(NULL), m_error_handler(0),
+	m_user(NULL), m_buffer(NULL), m_algorithm(NULL),
+	m_execute_request_handler(0), m_executed(0), m_last_executed(0),
+	m_workload(WORKLOAD_TYPING), m_keystroke_interval(0),
+	m_next_keystroke(0), m_burst(0), m_cursor(0)
+{
+	m_connection_manager.set_sasl_context(
+		context.auth_manager.get_sasl_context(), "ANONYMOUS");
+
+	m_connection = m_connection_manager.make_connection(
+		address, port, 0, "localhost", true);
+	g_object_ref(m_connection);
+
+	m_browser = infc_browser_new(
+		m_connection_manager.get_io(),
+		m_connection_manager.get_communication_manager(),
+		INF_XML_CONNECTION(m_connection));
+	infc_browser_add_plugin(m_browser, Gobby::Plugins::C_TEXT_HEADLESS);
+
+	m_error_handler = g_signal_connect(
+		G_OBJECT(m_browser), "error",
+		G_CALLBACK(on_error_static), this);
+}
+
+Client::~Client()
+{
+	if(m_algorithm != NULL)
+	{
+		g_signal_handler_disconnect(m_algorithm,
+		                            m_execute_request_handler);
+	}
+
+	m_user_join.reset();
+
+	InfXmlConnectionStatus status;
+	g_object_get(G_OBJECT(m_connection), "status", &status, NULL);
+	if(status != INF_XML_CONNECTION_CLOSED &&
+	   status != INF_XML_CONNECTION_CLOSING)
+	{
+		inf_xml_connection_close(INF_XML_CONNECTION(m_connection));
+	}
+
+	g_signal_handler_disconnect(m_browser, m_error_handler);
+	g_object_unref(m_browser);
+	g_object_unref(m_connection);
+}
+
+bool Client::is_open() const
+{
+	InfBrowserStatus status;
+	g_object_get(G_OBJECT(m_browser), "status", &status, NULL);
+	return status == INF_BROWSER_OPEN;
+}
+
+void Client::explore()
+{
+	InfBrowserIter root;
+	inf_browser_get_root(INF_BROWSER(m_browser), &root);
+	if(!inf_browser_get_explored(INF_BROWSER(m_browser), &root))
+	{
+		inf_browser_explore(INF_BROWSER(m_browser), &root,
+		                    on_request_finished_static, this);
+	}
+}
+
+bool Client::is_explored() const
+{
+	InfBrowserIter root;
+	inf_browser_get_root(INF_BROWSER(m_browser), &root);
+	return inf_browser_get_explored(INF_BROWSER(m_browser), &root);
+}
+
+void Client::add_document()
+{
+	InfBrowserIter root;
+	inf_browser_get_root(INF_BROWSER(m_browser), &root);
+	inf_browser_add_note(INF_BROWSER(m_browser), &root,
+	                     m_document.name.c_str(), "InfText", NULL, NULL,
+	                     FALSE, on_request_finished_static, this);
+}
+
+bool Client::has_document() const
+{
+	InfBrowserIter iter;
+	return find_document(iter);
+}
+
+void Client::subscribe()
+{
+	InfBrowserIter iter;
+	if(find_document(iter))
+	{
+		inf_browser_subscribe(INF_BROWSER(m_browser), &iter,
+		                      on_request_finished_static, this);
+	}
+}
+
+bool Client::is_subscribed() const
+{
+	InfBrowserIter iter;
+	return find_document(iter) &&
+	       inf_browser_get_session(INF_BROWSER(m_browser), &iter) != NULL;
+}
+
+void Client::join()
+{
+	InfBrowserIter iter;
+	if(!find_document(iter)) return;
+
+	InfSessionProxy* proxy =
+		inf_browser_get_session(INF_BROWSER(m_browser), &iter);
+	if(proxy == NULL) return;
+
+	std::unique_ptr<Gobby::UserJoin::ParameterProvider> provider(
+		new ClientParameterProvider(m_name, m_hue, proxy));
+	m_user_join.reset(new Gobby::UserJoin(
+		INF_BROWSER(m_browser), &iter, proxy, std::move(provider)));
+	m_user_join->signal_finished().connect(
+		sigc::mem_fun(*this, &Client::on_user_join_finished));
+}
+
+void Client::start(const Workload& workload, unsigned int rate,
+                   gint64 now)
+{
+	m_executed = 0;
+	m_last_executed = now;
+
+	m_workload = workload.type;
+	m_keystroke_interval = 1000000 / rate;
+	m_burst = 0;
+	m_cursor = 0;
+
+	// Everybody types at the same time for the same-offset workload,
+	// but otherwise the clients start one after the other.
+	m_next_keystroke = now;
+	if(m_workload != WORKLOAD_SAME_OFFSET)
+	{
+		m_next_keystroke +=
+			Gobby::Benchmark::random(m_keystroke_interval);
+	}
+}
+
+void Client::tick(gint64 now)
+{
+	while(m_next_keystroke <= now)
+	{
+		const guint length = inf_text_buffer_get_length(m_buffer);
+
+		if(m_workload == WORKLOAD_SAME_OFFSET)
+		{
+			insert(0, "x", 1);
+			m_next_keystroke += m_keystroke_interval;
+			continue;
+		}
+
+		if(m_workload == WORKLOAD_PASTE &&
+		   Gobby::Benchmark::random(50) == 0)
+		{
+			m_cursor = Gobby::Benchmark::random(length + 1);
+			insert(m_cursor, m_context.paste.data(),
+			       m_context.paste.size());
+			m_cursor += m_context.paste.size();
+			m_burst = 0;
+			m_next_keystroke = now + 1000000 +
+				Gobby::Benchmark::random(2000000);
+			continue;
+		}
+
+		// Start typing somewhere else after a pause
+		if(m_burst == 0)
+		{
+			m_cursor = Gobby::Benchmark::random(length + 1);
+			m_burst = 5 + Gobby::Benchmark::random(40);
+		}
+
+		// Remote insertions before the cursor are not accounted
+		// for, but it should stay within the document.
+		if(m_cursor > length)
+			m_cursor = length;
+
+		if(m_cursor > 0 && Gobby::Benchmark::random(10) == 0)
+		{
+			--m_cursor;
+			inf_text_buffer_erase_text(m_buffer, m_cursor, 1,
+			                           m_user);
+		}
+		else
+		{
+			const char character = 'a' +
+				Gobby::Benchmark::random(26);
+			insert(m_cursor, &character, 1);
+			++m_cursor;
+		}
+
+		if(--m_burst == 0)
+		{
+			m_next_keystroke = now + 500000 +
+				Gobby::Benchmark::random(1500000);
+		}
+		else
+		{
+			m_next_keystroke += m_keystroke_interval;
+		}
+	}
+}
+
+bool Client::find_document(InfBrowserIter& iter) const
+{
+	InfBrowser* browser = INF_BROWSER(m_browser);
+
+	inf_browser_get_root(browser, &iter);
+	if(!inf_browser_get_explored(browser, &iter)) return false;
+	if(!inf_browser_get_child(browser, &iter)) return false;
+
+	do
+	{
+		if(m_document.name == inf_browser_get_node_name(browser, &iter))
+			return true;
+	} while(inf_browser_get_next(browser, &iter));
+
+	return false;
+}
+
+void Client::on_user_join_finished(InfUser* user, const GError* error)
+{
+	if(error != NULL)
+	{
+		m_error = error->message;
+		return;
+	}
+
+	InfSession* session;
+	g_object_get(G_OBJECT(m_user_join->get_proxy()),
+	             "session", &session, NULL);
+
+	m_buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
+	m_algorithm = inf_adopted_session_get_algorithm(
+		INF_ADOPTED_SESSION(session));
+	m_execute_request_handler = g_signal_connect(
+		G_OBJECT(m_algorithm), "end-execute-request",
+		G_CALLBACK(on_end_execute_request_static), this);
+
+	// The browser keeps the session alive as long as we are
+	// subscribed.
+	g_object_unref(session);
+
+	m_user = user;
+}
+
+void Client::on_execute_request(InfAdoptedUser* user,
+                                InfAdoptedRequest* request)
+{
+	const gint64 now = g_get_monotonic_time();
+	++m_executed;
+	m_last_executed = now;
+
+	const guint id = inf_user_get_id(INF_USER(user));
+	const guint n = inf_adopted_state_vector_get(
+		inf_adopted_request_get_vector(request), id);
+	std::vector<gint64>& times = m_document.send_times[id];
+
+	if(INF_USER(user) == m_user)
+	{
+		++m_document.generated;
+		if(times.size() <= n)
+			times.resize(n + 1, 0);
+		times[n] = now;
+	}
+	else if(n < times.size() && times[n] != 0)
+	{
+		m_context.latencies.push_back(now - times[n]);
+	}
+}
+
+void Client::insert(guint pos, const char* text, gsize bytes)
+{
+	inf_text_buffer_insert_text(m_buffer, pos, text, bytes,
+	                            g_utf8_strlen(text, bytes), m_user);
+}
+
+class LoadBenchmark
+{
+public:
+	LoadBenchmark(const Gobby::Benchmark::Environment& env,
+	              const char* program, unsigned int n_documents,
+	              unsigned int duration, unsigned int rate,
+	              unsigned int port);
+
+	// Returns false if anything failed.
+	bool run(const Workload& workload, unsigned int n_clients);
+
+protected:
+	typedef std::vector<std::unique_ptr<Client> > ClientList;
+
+	// Waits until condition holds for all clients. Returns false and
+	// reports why if it does not in time.
+	template<typename Condition>
+	bool wait_for_clients(const ClientList& clients, const char* what,
+	                      Condition condition);
+
+	// Whether every client has executed every request made to its
+	// document.
+	bool is_converged(const ClientList& clients) const;
+	// Whether all copies of each document are the same.
+	bool verify(const ClientList& clients) const;
+
+	const char* m_program;
+	const unsigned int m_n_documents;
+	const unsigned int m_duration;
+	const unsigned int m_rate;
+	unsigned int m_port;
+
+	Gobby::Config m_config;
+	Gobby::Preferences m_preferences;
+	Gobby::CertificateManager m_cert_manager;
+	Gobby::AuthManager m_auth_manager;
+	const std::string m_paste;
+	ClientContext m_context;
+};
+
+LoadBenchmark::LoadBenchmark(const Gobby::Benchmark::Environment& env,
+                             const char* program, unsigned int n_documents,
+                             unsigned int duration, unsigned int rate,
+                             unsigned int port):
+	m_program(program), m_n_documents(n_documents),
+	m_duration(duration), m_rate(rate), m_port(port),
+	m_config(env.get_path("client.xml")),
+	m_preferences(m_config),
+	m_cert_manager(m_preferences),
+	m_auth_manager(m_preferences),
+	m_paste(generate_paste()),
+	m_context{ m_cert_manager, m_preferences, m_auth_manager, m_paste,
+	           std::vector<gint64>() }
+{
+	m_preferences.security.policy =
+		INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED;
+}
+
+bool LoadBenchmark::run(const Workload& workload, unsigned int n_clients)
+{
+	// A fresh server for every run, so that its resource usage is not
+	// affected by the previous ones. The port changes as well, in case
+	// the previous one is not available again yet.
+	const unsigned int port = m_port++;
+	ServerProcess server(m_program, port);
+
+	InfIpAddress* address = inf_ip_address_new_loopback4();
+
+	std::vector<std::unique_ptr<Document> > documents;
+	for(unsigned int i = 0; i < std::min(m_n_documents, n_clients); ++i)
+	{
+		documents.emplace_back(new Document(
+			Glib::ustring::compose("document-%1", i)));
+	}
+
+	ClientList clients;
+	for(unsigned int i = 0; i < n_clients; ++i)
+	{
+		clients.emplace_back(new Client(
+			m_context, *documents[i % documents.size()], i,
+			n_clients, address, port));
+	}
+
+	inf_ip_address_free(address);
+
+	if(!wait_for_clients(clients, "connect",
+	                     [](Client& c) { return c.is_open(); }))
+	{
+		return false;
+	}
+
+	for(ClientList::iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		(*iter)->explore();
+	}
+
+	if(!wait_for_clients(clients, "explore",
+	                     [](Client& c) { return c.is_explored(); }))
+	{
+		return false;
+	}
+
+	// The first client of every document creates it
+	for(unsigned int i = 0; i < documents.size(); ++i)
+		clients[i]->add_document();
+
+	if(!wait_for_clients(clients, "create documents",
+	                     [](Client& c) { return c.has_document(); }))
+	{
+		return false;
+	}
+
+	for(ClientList::iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		(*iter)->subscribe();
+	}
+
+	if(!wait_for_clients(clients, "subscribe",
+	                     [](Client& c) { return c.is_subscribed(); }))
+	{
+		return false;
+	}
+
+	for(ClientList::iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		(*iter)->join();
+	}
+
+	if(!wait_for_clients(clients, "join",
+	                     [](Client& c) { return c.has_joined(); }))
+	{
+		return false;
+	}
+
+	// Measure only what happens while the clients type
+	Usage server_start;
+	if(!server.get_usage(server_start))
+	{
+		std::cerr << workload.name << ": lost the server" << std::endl;
+		return false;
+	}
+
+	const Usage client_start = get_usage();
+	m_context.latencies.clear();
+
+	const gint64 start_time = g_get_monotonic_time();
+	const gint64 end_time = start_time + m_duration * G_USEC_PER_SEC;
+	for(ClientList::iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		(*iter)->start(workload, m_rate, start_time);
+	}
+
+	Gobby::Benchmark::Waiter waiter;
+	sigc::connection tick_connection =
+		Glib::signal_timeout().connect([&]() -> bool {
+			const gint64 now = std::min(g_get_monotonic_time(),
+			                            end_time);
+			for(ClientList::iterator iter = clients.begin();
+			    iter != clients.end(); ++iter)
+			{
+				(*iter)->tick(now);
+			}
+
+			if(now < end_time) return true;
+			waiter.done();
+			return false;
+		}, TICK_INTERVAL);
+
+	waiter.wait(m_duration + TIMEOUT);
+	tick_connection.disconnect();
+
+	// Now that nobody types anymore, wait until everybody has seen
+	// everything.
+	const bool converged = wait_until(
+		[&]() { return is_converged(clients); }, TIMEOUT);
+	const bool matches = converged && verify(clients);
+
+	const Usage client_end = get_usage();
+	gint64 convergence_time = 0;
+	unsigned int generated = 0;
+	for(ClientList::iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		convergence_time = std::max(
+			convergence_time,
+			(*iter)->get_last_executed() - end_time);
+	}
+
+	for(unsigned int i = 0; i < documents.size(); ++i)
+		generated += documents[i]->generated;
+
+	clients.clear();
+
+	Usage server_end;
+	if(!server.stop(server_end))
+	{
+		std::cerr << workload.name << ": lost the server" << std::endl;
+		return false;
+	}
+
+	std::vector<gint64>& latencies = m_context.latencies;
+	std::sort(latencies.begin(), latencies.end());
+
+	gchar* server_memory = g_format_size(
+		static_cast<guint64>(server_end.max_resident) * 1024);
+	std::printf("%-12s %7u %9u %8.1f %8.1f %8.1f %8.1f %9.3f s "
+	            "%8.2f s %10s %8.2f s\n",
+	            workload.name, n_clients, generated,
+	            percentile(latencies, 0.5),
+	            percentile(latencies, 0.9),
+	            percentile(latencies, 0.99),
+	            percentile(latencies, 1.0),
+	            convergence_time / 1e6,
+	            server_end.cpu_time - server_start.cpu_time,
+	            server_memory,
+	            client_end.cpu_time - client_start.cpu_time);
+	std::fflush(stdout);
+	g_free(server_memory);
+
+	if(!converged)
+	{
+		std::cerr << workload.name << " with " << n_clients
+		          << " clients: did not converge" << std::endl;
+		return false;
+	}
+
+	return matches;
+}
+
+template<typename Condition>
+bool LoadBenchmark::wait_for_clients(const ClientList& clients,
+                                     const char* what, Condition condition)
+{
+	const Client* failed = NULL;
+	const bool result = wait_until([&]() -> bool {
+		for(ClientList::const_iterator iter = clients.begin();
+		    iter != clients.end(); ++iter)
+		{
+			if(!(*iter)->get_error().empty())
+			{
+				failed = iter->get();
+				return true;
+			}
+
+			if(!condition(**iter))
+				return false;
+		}
+
+		return true;
+	}, TIMEOUT);
+
+	if(failed != NULL)
+	{
+		std::cerr << "Failed to " << what << ": "
+		          << failed->get_error() << std::endl;
+		return false;
+	}
+
+	if(!result)
+	{
+		std::cerr << "Timed out waiting for clients to " << what
+		          << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool LoadBenchmark::is_converged(const ClientList& clients) const
+{
+	for(ClientList::const_iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		if((*iter)->get_executed() < (*iter)->get_document().generated)
+			return false;
+	}
+
+	return true;
+}
+
+bool LoadBenchmark::verify(const ClientList& clients) const
+{
+	// Compare every copy with the first one of the same document
+	std::map<const Document*, std::string> texts;
+	for(ClientList::const_iterator iter = clients.begin();
+	    iter != clients.end(); ++iter)
+	{
+		const Document& document = (*iter)->get_document();
+		const std::string text = (*iter)->get_text();
+
+		std::map<const Document*, std::string>::const_iterator
+			text_iter = texts.find(&document);
+		if(text_iter == texts.end())
+		{
+			texts[&document] = text;
+		}
+		else if(text_iter->second != text)
+		{
+			std::cerr << "The copies of " << document.name
+			          << " differ" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int max_clients = 200;
+	unsigned int n_documents = 1;
+	unsigned int duration = 10;
+	unsigned int rate = 5;
+	unsigned int port = 6524;
+
+	if(argc > 1 && std::strcmp(argv[1], "--server") == 0)
+	{
+		if(argc != 3 ||
+		   !Gobby::Benchmark::parse_option(argv[2], "port", port))
+		{
+			std::cerr << "Usage: " << argv[0]
+			          << " --server --port=PORT" << std::endl;
+			return 2;
+		}
+
+		try
+		{
+			Gio::init();
+
+			GError* error = NULL;
+			if(inf_init(&error) != TRUE)
+				throw Glib::Error(error);
+
+			LoadServer server(port);
+			return server.run();
+		}
+		catch(const Glib::Exception& ex)
+		{
+			std::cerr << "server: " << ex.what() << std::endl;
+		}
+		catch(const std::exception& ex)
+		{
+			std::cerr << "server: " << ex.what() << std::endl;
+		}
+
+		return 1;
+	}
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!Gobby::Benchmark::parse_option(argv[i], "max-clients",
+		                                   max_clients) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "documents",
+		                                   n_documents) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "duration",
+		                                   duration) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "rate", rate) &&
+		   !Gobby::Benchmark::parse_option(argv[i], "port", port))
+		{
+			std::cerr << "Usage: " << argv[0]
+			          << " [--max-clients=N] [--documents=N]"
+			          << " [--duration=SECONDS]"
+			          << " [--rate=KEYSTROKES] [--port=PORT]"
+			          << std::endl;
+			return 2;
+		}
+	}
+
+	if(max_clients < 2) max_clients = 2;
+	if(n_documents == 0) n_documents = 1;
+	if(rate == 0) rate = 1;
+
+	std::vector<unsigned int> client_counts;
+	for(unsigned int i = 0; i < G_N_ELEMENTS(CLIENT_COUNTS); ++i)
+		if(CLIENT_COUNTS[i] < max_clients)
+			client_counts.push_back(CLIENT_COUNTS[i]);
+	client_counts.push_back(max_clients);
+
+	try
+	{
+		// The server processes inherit the environment, and with it
+		// the temporary configuration directory.
+		Gobby::Benchmark::Environment env("load");
+
+		Gio::init();
+
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		std::printf("%-12s %7s %9s %8s %8s %8s %8s %11s %10s %10s "
+		            "%10s\n",
+		            "workload", "clients", "requests", "p50 ms",
+		            "p90 ms", "p99 ms", "max ms", "converged",
+		            "server cpu", "server mem", "client cpu");
+
+		LoadBenchmark benchmark(env, argv[0], n_documents, duration,
+		                        rate, port);
+
+		bool result = true;
+		for(unsigned int i = 0; i < G_N_ELEMENTS(WORKLOADS); ++i)
+		{
+			for(std::vector<unsigned int>::const_iterator iter =
+				client_counts.begin();
+			    iter != client_counts.end(); ++iter)
+			{
+				if(!benchmark.run(WORKLOADS[i], *iter))
+					result = false;
+			}
+		}
+
+		return result ? 0 : 1;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
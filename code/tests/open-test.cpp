@@ -0,0 +1,152 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+// Opens sample files through the same operation the user interface uses,
+// and checks that encoding detection and conversion agree with each other:
+// text is opened with the expected content, and files that are detected as
+// binary, including text with a few stray nullbytes, are rejected. This
+// needs a display; without one, the test is skipped.
+//
+// Usage: open-test SAMPLE-DIRECTORY
+
+#include "tests/benchmark-editor.hpp"
+
+#include "gobby-resources.h"
+
+#include <libinfinity/common/inf-init.h>
+
+#include <gtkmm/main.h>
+
+#include <iostream>
+
+namespace
+{
+	struct Sample
+	{
+		const char* filename;
+		const char* text; // NULL means that opening must fail
+	};
+
+	const Sample SAMPLES[] = {
+		{ "ascii.txt",
+		  "Hello, world.\nThis is plain ASCII text." },
+		{ "utf-8.txt",
+		  "Gr\xc3\xbc\xc3\x9f" "e aus K\xc3\xb6ln, "
+		  "na\xc3\xafve caf\xc3\xa9. "
+		  "\xce\x95\xce\xbb\xce\xbb\xce\xb7\xce\xbd\xce\xb9"
+		  "\xce\xba\xce\xac und \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e "
+		  "stehen hier auch.\nZweite Zeile." },
+		{ "iso-8859-1.txt",
+		  "Gr\xc3\xbc\xc3\x9f" "e aus K\xc3\xb6ln, "
+		  "na\xc3\xafve caf\xc3\xa9.\nZweite Zeile." },
+		{ "utf-16le.txt",
+		  "Gr\xc3\xbc\xc3\x9f" "e aus K\xc3\xb6ln, "
+		  "na\xc3\xafve caf\xc3\xa9.\nZweite Zeile." },
+		{ "utf-8-stray-nul.txt", NULL },
+		{ "iso-8859-1-stray-nul.txt", NULL },
+		{ "binary.bin", NULL }
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc != 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " SAMPLE-DIRECTORY"
+		          << std::endl;
+		return 2;
+	}
+
+	try
+	{
+		Gobby::Benchmark::Environment env("open");
+
+		if(!gtk_init_check(&argc, &argv))
+		{
+			std::cerr << "No display available, skipping"
+			          << std::endl;
+			return Gobby::Benchmark::EXIT_SKIPPED;
+		}
+
+		Gtk::Main::init_gtkmm_internals();
+		_gobby_get_resource();
+
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		Gobby::Benchmark::Editor editor(env);
+		unsigned int failures = 0;
+
+		for(const Sample& sample: SAMPLES)
+		{
+			gint64 elapsed;
+			Gobby::TextSessionView* view = editor.open_document(
+				sample.filename,
+				std::string(argv[1]) + "/" + sample.filename,
+				elapsed);
+
+			if(view == NULL)
+			{
+				if(sample.text != NULL)
+					++failures;
+				else
+					std::cerr << sample.filename
+					          << ": rejected as expected"
+					          << std::endl;
+				continue;
+			}
+
+			GtkTextBuffer* buffer =
+				GTK_TEXT_BUFFER(view->get_text_buffer());
+			GtkTextIter start, end;
+			gtk_text_buffer_get_bounds(buffer, &start, &end);
+			gchar* text = gtk_text_buffer_get_text(
+				buffer, &start, &end, TRUE);
+
+			if(sample.text == NULL)
+			{
+				std::cerr << sample.filename << ": opened, "
+				          << "but should have been rejected"
+				          << std::endl;
+				++failures;
+			}
+			else if(std::string(text) != sample.text)
+			{
+				std::cerr << sample.filename << ": opened as \""
+				          << text << "\", expected \""
+				          << sample.text << "\"" << std::endl;
+				++failures;
+			}
+
+			g_free(text);
+			editor.close_document(*view);
+		}
+
+		return failures == 0 ? 0 : 1;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
@@ -0,0 +1,301 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Measures how long Replace All in the find dialog takes for documents with
+// many occurrences, and how many requests it generates, since each of them
+// is sent to every other participant of the session. The number of
+// requests is compared with the baseline of replacing every occurrence on
+// its own, with one request to erase it and one to insert the replacement,
+// and the result is compared with the expected text. This needs a display;
+// without one, the benchmark is skipped.
+//
+// Usage: replace-all-benchmark [--occurrences=N]
+
+#include "tests/benchmark-editor.hpp"
+
+#include "dialogs/find-dialog.hpp"
+
+#include "gobby-resources.h"
+
+#include <libinfinity/adopted/inf-adopted-session.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <gtkmm/main.h>
+#include <glibmm/fileutils.h>
+
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+	// None of these contain any of the texts searched for below
+	const char* const FILLER_WORDS[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet", "sed", "do",
+		"tempor", "ut", "et", "magna", "{", "}", "(i)", "return",
+		"0;", NULL
+	};
+
+	struct Workload
+	{
+		const char* name;
+		const char* find_text;
+		const char* replace_text;
+		// How many occurrences follow each other directly
+		unsigned int run_length;
+		// Whether fewer requests than the baseline are expected.
+		// Otherwise the benchmark fails.
+		bool below_baseline;
+	};
+
+	const Workload WORKLOADS[] = {
+		// Only the differing suffix needs to be replaced, which
+		// still takes two requests per occurrence
+		{ "rename", "request_count", "request_total", 1, false },
+		// Only the common suffix is kept, so nothing is inserted
+		{ "shorten", "inf_session_proxy", "proxy", 1, true },
+		// Adjacent occurrences are replaced in a single edit
+		{ "adjacent", "ab", "xy", 4, true }
+	};
+
+	// Returns a document with the given number of occurrences of the
+	// workload's find text, and stores the text it should turn into
+	// after Replace All in expected.
+	std::string generate_text(const Workload& workload,
+	                          unsigned int occurrences,
+	                          std::string& expected)
+	{
+		unsigned int n_words = 0;
+		while(FILLER_WORDS[n_words] != NULL)
+			++n_words;
+
+		std::string text;
+		expected.clear();
+
+		unsigned int remaining = occurrences;
+		while(remaining > 0)
+		{
+			const unsigned int words =
+				4 + Gobby::Benchmark::random(9);
+			for(unsigned int i = 0; i < words; ++i)
+			{
+				if(i > 0)
+				{
+					text += ' ';
+					expected += ' ';
+				}
+
+				if(remaining > 0 &&
+				   Gobby::Benchmark::random(4) == 0)
+				{
+					for(unsigned int j = 0;
+					    j < workload.run_length &&
+					    remaining > 0; ++j)
+					{
+						text += workload.find_text;
+						expected +=
+							workload.replace_text;
+						--remaining;
+					}
+				}
+				else
+				{
+					const char* word = FILLER_WORDS[
+						Gobby::Benchmark::random(
+							n_words)];
+					text += word;
+					expected += word;
+				}
+			}
+
+			text += '\n';
+			expected += '\n';
+		}
+
+		return text;
+	}
+}
+
+class ReplaceAllBenchmark
+{
+public:
+	ReplaceAllBenchmark(const Gobby::Benchmark::Environment& env);
+
+	// Returns false if anything failed.
+	bool run(const Workload& workload, unsigned int occurrences);
+
+protected:
+	static void on_end_execute_request_static(
+		InfAdoptedAlgorithm* algorithm,
+		InfAdoptedUser* user,
+		InfAdoptedRequest* request,
+		InfAdoptedRequest* translated,
+		const GError* error,
+		gpointer user_data)
+	{
+		++static_cast<ReplaceAllBenchmark*>(user_data)->m_requests;
+	}
+
+	const Gobby::Benchmark::Environment& m_env;
+	Gobby::Benchmark::Editor m_editor;
+	std::unique_ptr<Gobby::FindDialog> m_find_dialog;
+
+	unsigned int m_requests;
+};
+
+ReplaceAllBenchmark::ReplaceAllBenchmark(
+	const Gobby::Benchmark::Environment& env):
+	m_env(env), m_editor(env),
+	m_find_dialog(Gobby::FindDialog::create(
+		m_editor.get_window(), m_editor.get_text_folder(),
+		m_editor.get_status_bar())),
+	m_requests(0)
+{
+	m_find_dialog->set_search_only(false);
+}
+
+bool ReplaceAllBenchmark::run(const Workload& workload,
+                              unsigned int occurrences)
+{
+	std::string expected;
+	const std::string text =
+		generate_text(workload, occurrences, expected);
+	const std::string input = m_env.get_path(
+		std::string(workload.name) + ".txt");
+	Glib::file_set_contents(input, text);
+
+	gint64 elapsed;
+	Gobby::TextSessionView* view =
+		m_editor.open_document(workload.name, input, elapsed);
+	if(view == NULL) return false;
+
+	InfAdoptedAlgorithm* algorithm = inf_adopted_session_get_algorithm(
+		INF_ADOPTED_SESSION(view->get_session()));
+	const gulong execute_request_handler = g_signal_connect_after(
+		G_OBJECT(algorithm), "end-execute-request",
+		G_CALLBACK(on_end_execute_request_static), this);
+
+	m_find_dialog->set_find_text(workload.find_text);
+	m_find_dialog->set_replace_text(workload.replace_text);
+
+	m_requests = 0;
+	const gint64 start_time = g_get_monotonic_time();
+	const bool replaced = m_find_dialog->replace_all();
+	elapsed = g_get_monotonic_time() - start_time;
+
+	g_signal_handler_disconnect(algorithm, execute_request_handler);
+
+	GtkTextBuffer* buffer = GTK_TEXT_BUFFER(view->get_text_buffer());
+	GtkTextIter start, end;
+	gtk_text_buffer_get_bounds(buffer, &start, &end);
+	gchar* result_text =
+		gtk_text_buffer_get_text(buffer, &start, &end, TRUE);
+	const bool matches = expected == result_text;
+	g_free(result_text);
+
+	m_editor.close_document(*view);
+
+	if(!replaced)
+	{
+		std::cerr << workload.name << ": nothing was replaced"
+		          << std::endl;
+		return false;
+	}
+
+	if(!matches)
+	{
+		std::cerr << workload.name << ": document differs from "
+		          << "the expected result" << std::endl;
+		return false;
+	}
+
+	// Replacing each occurrence on its own erases it and inserts the
+	// replacement text.
+	const unsigned int baseline = occurrences *
+		(workload.replace_text[0] != '\0' ? 2 : 1);
+
+	std::printf("%-10s %12u %10u %10u %9.3f s\n", workload.name,
+	            occurrences, m_requests, baseline, elapsed / 1e6);
+
+	if(workload.below_baseline && m_requests >= baseline)
+	{
+		std::cerr << workload.name << ": " << m_requests
+		          << " requests are not fewer than the " << baseline
+		          << " of replacing each occurrence on its own"
+		          << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int occurrences = 20000;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!Gobby::Benchmark::parse_option(argv[i], "occurrences",
+		                                   occurrences))
+		{
+			std::cerr << "Usage: " << argv[0]
+			          << " [--occurrences=N]" << std::endl;
+			return 2;
+		}
+	}
+
+	try
+	{
+		Gobby::Benchmark::Environment env("replace-all");
+
+		if(!gtk_init_check(&argc, &argv))
+		{
+			std::cerr << "No display available, skipping"
+			          << std::endl;
+			return Gobby::Benchmark::EXIT_SKIPPED;
+		}
+
+		Gtk::Main::init_gtkmm_internals();
+		_gobby_get_resource();
+
+		GError* error = NULL;
+		if(inf_init(&error) != TRUE)
+			throw Glib::Error(error);
+
+		ReplaceAllBenchmark benchmark(env);
+
+		std::printf("%-10s %12s %10s %10s %11s\n",
+		            "workload", "occurrences", "requests", "baseline",
+		            "time");
+
+		bool result = true;
+		for(const Workload& workload: WORKLOADS)
+		{
+			if(!benchmark.run(workload, occurrences))
+				result = false;
+		}
+
+		return result ? 0 : 1;
+	}
+	catch(const Glib::Exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+	catch(const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+	}
+
+	return 1;
+}
@@ -15,6 +15,7 @@
  */
 
 #include "util/asyncoperation.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <glibmm/main.h>
 
@@ -84,6 +85,8 @@ void Gobby::AsyncOperation::thread_run()
 
 bool Gobby::AsyncOperation::done()
 {
+	StallProfiler::Scope profile("AsyncOperation::done");
+
 	if(!m_finished)
 	{
 		// m_handle DTOR cancels the operation
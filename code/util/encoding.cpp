@@ -0,0 +1,189 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "util/encoding.hpp"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Number of bytes at the beginning of the content that are looked
+	// at to determine the distribution of nullbytes.
+	const std::size_t SAMPLE_SIZE = 64 * 1024;
+
+	bool has_prefix(const unsigned char* data, std::size_t size,
+	                const char* prefix, std::size_t prefix_size)
+	{
+		return size >= prefix_size &&
+			std::memcmp(data, prefix, prefix_size) == 0;
+	}
+}
+
+namespace Gobby
+{
+	bool is_valid_utf8(const char* data, std::size_t size)
+	{
+		const guint64 HIGH_BITS =
+			G_GUINT64_CONSTANT(0x8080808080808080);
+
+		const unsigned char* pos =
+			reinterpret_cast<const unsigned char*>(data);
+		const unsigned char* end = pos + size;
+
+		while(pos != end)
+		{
+			// Skip ASCII characters eight at a time.
+			while(end - pos >= 8)
+			{
+				guint64 word;
+				std::memcpy(&word, pos, sizeof(word));
+				if(word & HIGH_BITS) break;
+				pos += 8;
+			}
+
+			if(pos == end) break;
+
+			const unsigned char c = *pos;
+			if(c < 0x80)
+			{
+				++pos;
+				continue;
+			}
+
+			std::size_t len;
+			gunichar min;
+			gunichar cp;
+
+			if((c & 0xe0) == 0xc0)
+				{ len = 2; min = 0x80; cp = c & 0x1f; }
+			else if((c & 0xf0) == 0xe0)
+				{ len = 3; min = 0x800; cp = c & 0x0f; }
+			else if((c & 0xf8) == 0xf0)
+				{ len = 4; min = 0x10000; cp = c & 0x07; }
+			else
+				return false;
+
+			if(static_cast<std::size_t>(end - pos) < len)
+				return false;
+
+			for(std::size_t i = 1; i < len; ++i)
+			{
+				if((pos[i] & 0xc0) != 0x80)
+					return false;
+				cp = (cp << 6) | (pos[i] & 0x3f);
+			}
+
+			// Reject overlong sequences, surrogates and code
+			// points beyond the Unicode range.
+			if(cp < min || cp > 0x10ffff ||
+			   (cp >= 0xd800 && cp <= 0xdfff))
+			{
+				return false;
+			}
+
+			pos += len;
+		}
+
+		return true;
+	}
+
+	const char* detect_encoding(const char* data, std::size_t size,
+	                            const char* eight_bit_encoding)
+	{
+		const unsigned char* udata =
+			reinterpret_cast<const unsigned char*>(data);
+
+		// Byte order marks. Note the UTF-32 ones need to be checked
+		// first, since the little endian UTF-16 BOM is a prefix of
+		// the little endian UTF-32 one.
+		if(has_prefix(udata, size, "\xff\xfe\x00\x00", 4) ||
+		   has_prefix(udata, size, "\x00\x00\xfe\xff", 4))
+		{
+			return "UTF-32";
+		}
+
+		if(has_prefix(udata, size, "\xff\xfe", 2) ||
+		   has_prefix(udata, size, "\xfe\xff", 2))
+		{
+			return "UTF-16";
+		}
+
+		if(has_prefix(udata, size, "\xef\xbb\xbf", 3))
+			return "UTF-8";
+
+		// Count nullbytes in the sample, by position modulo four.
+		const std::size_t sample = std::min(size, SAMPLE_SIZE);
+		std::size_t zeros[4] = { 0, 0, 0, 0 };
+		for(std::size_t i = 0; i < sample; ++i)
+			if(udata[i] == 0)
+				++zeros[i % 4];
+
+		const std::size_t total = zeros[0] + zeros[1] +
+			zeros[2] + zeros[3];
+
+		if(total == 0)
+		{
+			// Text files don't contain nullbytes, and neither the
+			// text buffer nor the infinote protocol can hold one.
+			// So a nullbyte beyond the sample makes it binary, too.
+			if(std::memchr(data + sample, '\0', size - sample) != NULL)
+				return NULL;
+
+			// Otherwise, the content is in an eight bit encoding,
+			// or UTF-8.
+			if(is_valid_utf8(data, size))
+				return "UTF-8";
+			return eight_bit_encoding;
+		}
+
+		// In UTF-32, every code point has a zero high byte, and,
+		// except for the few beyond the BMP, a zero second byte.
+		const std::size_t units = sample / 4;
+		if(size % 4 == 0)
+		{
+			if(zeros[3] == units && zeros[2] >= units * 9 / 10)
+				return "UTF-32LE";
+			if(zeros[0] == units && zeros[1] >= units * 9 / 10)
+				return "UTF-32BE";
+		}
+
+		// In UTF-16, text from the Latin scripts has a zero high
+		// byte for most characters, so nearly all nullbytes are at
+		// either even or odd positions. A few nullbytes on their own
+		// do not make UTF-16, though: at least a quarter of the code
+		// units need to have one.
+		const std::size_t min_utf16_zeros =
+			std::max<std::size_t>(sample / 2 / 4, 1);
+		if(size % 2 == 0)
+		{
+			const std::size_t even = zeros[0] + zeros[2];
+			const std::size_t odd = zeros[1] + zeros[3];
+
+			if(odd >= min_utf16_zeros && odd >= total * 9 / 10)
+				return "UTF-16LE";
+			if(even >= min_utf16_zeros && even >= total * 9 / 10)
+				return "UTF-16BE";
+		}
+
+		// Nullbytes in content that is neither UTF-16 nor UTF-32
+		// mean binary data. This includes text with only a few
+		// stray nullbytes, since they cannot be converted.
+		return NULL;
+	}
+}
@@ -0,0 +1,42 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_ENCODING_HPP_
+#define _GOBBY_ENCODING_HPP_
+
+#include <cstddef>
+
+namespace Gobby
+{
+	// Returns whether the given data is valid UTF-8. Runs of ASCII
+	// characters are checked a machine word at a time.
+	bool is_valid_utf8(const char* data, std::size_t size);
+
+	// Detects the character encoding of the given file content, so that
+	// it can be converted in a single pass without trying one candidate
+	// encoding after the other. A byte order mark, if present, decides
+	// the encoding. Otherwise, the distribution of nullbytes is used to
+	// recognize UTF-16 and UTF-32, and content without nullbytes is
+	// either UTF-8 or, if it is not valid UTF-8, eight_bit_encoding.
+	// Returns an encoding name as understood by g_iconv_open(), or NULL
+	// if the content seems to be binary data. Content with nullbytes
+	// that is not UTF-16 or UTF-32 counts as binary, even if there are
+	// only a few of them, since the text could not hold them.
+	const char* detect_encoding(const char* data, std::size_t size,
+	                            const char* eight_bit_encoding);
+}
+
+#endif // _GOBBY_ENCODING_HPP_
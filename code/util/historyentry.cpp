@@ -15,6 +15,7 @@
  */
 
 #include "util/historyentry.hpp"
+#include "util/stallprofiler.hpp"
 
 #include <giomm/file.h>
 #include <giomm/asyncresult.h>
@@ -131,6 +132,8 @@ void Gobby::History::Loader::process(unsigned int size)
 void Gobby::History::Loader::on_read(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("History::Loader::on_read");
+
 	try
 	{
 		m_stream = m_file->read_finish(result);
@@ -148,6 +151,8 @@ void Gobby::History::Loader::on_read(
 void Gobby::History::Loader::on_stream_read(
 	const Glib::RefPtr<Gio::AsyncResult>& result)
 {
+	StallProfiler::Scope profile("History::Loader::on_stream_read");
+
 	gssize size;
 
 	try
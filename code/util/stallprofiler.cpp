@@ -0,0 +1,167 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "util/stallprofiler.hpp"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+namespace
+{
+	typedef std::map<std::string, Gobby::StallProfiler::Site> SiteMap;
+
+	// Allocated when profiling is enabled, and never freed, so that
+	// callbacks running late during shutdown can still record.
+	SiteMap* sites = NULL;
+
+	bool site_compare(const Gobby::StallProfiler::Site& first,
+	                  const Gobby::StallProfiler::Site& second)
+	{
+		if(first.stalls != second.stalls)
+			return first.stalls > second.stalls;
+		return first.max_time > second.max_time;
+	}
+
+	void write_json_string(std::ostream& stream, const std::string& str)
+	{
+		stream << '"';
+		for(std::string::const_iterator iter = str.begin();
+		    iter != str.end(); ++iter)
+		{
+			if(*iter == '"' || *iter == '\\')
+				stream << '\\';
+			stream << *iter;
+		}
+		stream << '"';
+	}
+}
+
+bool Gobby::StallProfiler::m_enabled = false;
+
+gint64 Gobby::StallProfiler::Site::get_percentile(double percentile) const
+{
+	const guint64 rank = static_cast<guint64>(dispatches * percentile);
+
+	guint64 count = 0;
+	for(unsigned int i = 0; i < N_BUCKETS - 1; ++i)
+	{
+		count += buckets[i];
+		if(count > rank)
+			return static_cast<gint64>(1) << i;
+	}
+
+	return -1;
+}
+
+void Gobby::StallProfiler::enable()
+{
+	if(sites == NULL)
+		sites = new SiteMap;
+	m_enabled = true;
+}
+
+std::vector<Gobby::StallProfiler::Site> Gobby::StallProfiler::get_sites()
+{
+	std::vector<Site> result;
+	if(sites != NULL)
+	{
+		for(SiteMap::const_iterator iter = sites->begin();
+		    iter != sites->end(); ++iter)
+		{
+			result.push_back(iter->second);
+		}
+	}
+
+	std::stable_sort(result.begin(), result.end(), site_compare);
+	return result;
+}
+
+std::string Gobby::StallProfiler::to_json()
+{
+	const std::vector<Site> result = get_sites();
+
+	std::ostringstream stream;
+	stream << "{\n  \"stall_threshold_us\": " << STALL_THRESHOLD << ",\n"
+	       << "  \"bucket_bounds_ms\": [";
+	for(unsigned int i = 0; i < N_BUCKETS - 1; ++i)
+	{
+		if(i > 0) stream << ", ";
+		stream << (static_cast<gint64>(1) << i);
+	}
+	stream << "],\n  \"sites\": [";
+
+	for(std::vector<Site>::const_iterator iter = result.begin();
+	    iter != result.end(); ++iter)
+	{
+		if(iter != result.begin()) stream << ',';
+		stream << "\n    {\n      \"name\": ";
+		write_json_string(stream, iter->name);
+		stream << ",\n      \"dispatches\": " << iter->dispatches
+		       << ",\n      \"stalls\": " << iter->stalls
+		       << ",\n      \"total_us\": " << iter->total_time
+		       << ",\n      \"max_us\": " << iter->max_time
+		       << ",\n      \"p50_ms\": " << iter->get_percentile(0.50)
+		       << ",\n      \"p95_ms\": " << iter->get_percentile(0.95)
+		       << ",\n      \"p99_ms\": " << iter->get_percentile(0.99)
+		       << ",\n      \"buckets\": [";
+		for(unsigned int i = 0; i < N_BUCKETS; ++i)
+		{
+			if(i > 0) stream << ", ";
+			stream << iter->buckets[i];
+		}
+		stream << "]\n    }";
+	}
+
+	stream << "\n  ]\n}\n";
+	return stream.str();
+}
+
+void Gobby::StallProfiler::record(const char* site, gint64 start)
+{
+	const gint64 duration = g_get_monotonic_time() - start;
+
+	SiteMap::iterator iter = sites->find(site);
+	if(iter == sites->end())
+	{
+		Site new_site;
+		new_site.name = site;
+		new_site.dispatches = 0;
+		new_site.stalls = 0;
+		new_site.total_time = 0;
+		new_site.max_time = 0;
+		std::fill(new_site.buckets, new_site.buckets + N_BUCKETS, 0);
+
+		iter = sites->insert(std::make_pair(new_site.name,
+		                                    new_site)).first;
+	}
+
+	Site& entry = iter->second;
+	++entry.dispatches;
+	entry.total_time += duration;
+	entry.max_time = std::max(entry.max_time, duration);
+	if(duration > STALL_THRESHOLD)
+		++entry.stalls;
+
+	unsigned int bucket = 0;
+	while(bucket < N_BUCKETS - 1 &&
+	      duration >= (static_cast<gint64>(1000) << bucket))
+	{
+		++bucket;
+	}
+
+	++entry.buckets[bucket];
+}
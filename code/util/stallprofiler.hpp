@@ -0,0 +1,97 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_STALLPROFILER_HPP_
+#define _GOBBY_STALLPROFILER_HPP_
+
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+namespace Gobby
+{
+
+// Keeps track of how long callbacks that run in the main loop take, per
+// callback site. This is off by default; when it is enabled, each
+// instrumented callback records the duration of its dispatch in a
+// histogram, so that it can be found out which of them makes the UI stall.
+// Only use this from the main thread.
+class StallProfiler
+{
+public:
+	// A dispatch that takes longer than one frame at 60 Hz is a stall.
+	static const gint64 STALL_THRESHOLD = 16000; // microseconds
+
+	// Bucket i counts dispatches that took less than 2^i milliseconds,
+	// the last bucket all the ones that took longer than that.
+	static const unsigned int N_BUCKETS = 12;
+
+	struct Site
+	{
+		std::string name;
+		guint64 dispatches;
+		guint64 stalls;
+		gint64 total_time;
+		gint64 max_time;
+		guint64 buckets[N_BUCKETS];
+
+		// Returns an upper bound for the given percentile of the
+		// dispatch time, in milliseconds, or -1 if it is beyond the
+		// last bucket.
+		gint64 get_percentile(double percentile) const;
+	};
+
+	// Measures the time from construction to destruction, and accounts
+	// it to the given site. Put one at the top of a callback. The site
+	// name needs to stay valid until the scope is left; typically, it
+	// is a string literal such as "OperationSave::on_stream_write".
+	class Scope
+	{
+	public:
+		Scope(const char* site):
+			m_site(site),
+			m_start(is_enabled() ? g_get_monotonic_time() : 0) {}
+		~Scope() { if(m_start != 0) record(m_site, m_start); }
+
+	private:
+		const char* m_site;
+		gint64 m_start;
+	};
+
+	static void enable();
+	static bool is_enabled() { return m_enabled; }
+
+	// Returns all sites seen so far, the ones with the most stalls first.
+	static std::vector<Site> get_sites();
+
+	// Returns the collected data as a JSON document.
+	static std::string to_json();
+
+	// Accounts the time from start, as returned by g_get_monotonic_time(),
+	// until now to the given site. This is for work that does not happen
+	// within a single function, such as the default handler of a signal,
+	// which can be timed with a pair of handlers. Only call this when
+	// profiling is enabled.
+	static void record(const char* site, gint64 start);
+
+private:
+	static bool m_enabled;
+};
+
+}
+
+#endif // _GOBBY_STALLPROFILER_HPP_
@@ -0,0 +1,195 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "util/textsearch.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	inline char fold(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+	}
+
+	inline bool is_letter(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+
+	bool equal_folded(const char* text, const std::string& needle)
+	{
+		for(std::string::size_type i = 0; i < needle.size(); ++i)
+			if(fold(text[i]) != fold(needle[i]))
+				return false;
+		return true;
+	}
+
+	// Finds the first occurrence of either c1 or c2 in [begin, end).
+	// This uses memchr() for both, which is typically vectorized, and
+	// remembers the position of the one that was not the closest, so
+	// that it does not need to be searched for again on the next call.
+	class DualScanner
+	{
+	public:
+		DualScanner(const char* end, char c1, char c2):
+			m_end(end), m_c1(c1), m_c2(c2),
+			m_next1(NULL), m_next2(NULL) {}
+
+		const char* find(const char* begin)
+		{
+			if(m_next1 == NULL || m_next1 < begin)
+				m_next1 = scan(begin, m_c1);
+			if(m_next2 == NULL || m_next2 < begin)
+				m_next2 = scan(begin, m_c2);
+			return std::min(m_next1, m_next2);
+		}
+
+	private:
+		const char* scan(const char* begin, char c)
+		{
+			const void* result =
+				std::memchr(begin, c, m_end - begin);
+			if(result == NULL) return m_end;
+			return static_cast<const char*>(result);
+		}
+
+		const char* m_end;
+		char m_c1;
+		char m_c2;
+		const char* m_next1;
+		const char* m_next2;
+	};
+}
+
+namespace Gobby
+{
+	bool text_search_supported(const std::string& needle,
+	                           bool case_sensitive)
+	{
+		if(needle.empty()) return false;
+		if(case_sensitive) return true;
+
+		for(std::string::size_type i = 0; i < needle.size(); ++i)
+			if(static_cast<unsigned char>(needle[i]) >= 0x80)
+				return false;
+		return true;
+	}
+
+	bool text_search_forward(const char* text, std::size_t from,
+	                         std::size_t to, const std::string& needle,
+	                         bool case_sensitive,
+	                         std::size_t& match_start)
+	{
+		const std::size_t len = needle.size();
+		if(len == 0 || to < from || to - from < len) return false;
+
+		// Last position at which a match can start
+		const char* last = text + to - len;
+		const char first = needle[0];
+
+		if(case_sensitive)
+		{
+			for(const char* cur = text + from; cur <= last; ++cur)
+			{
+				cur = static_cast<const char*>(std::memchr(
+					cur, first, last - cur + 1));
+				if(cur == NULL) return false;
+
+				if(std::memcmp(cur + 1, needle.data() + 1,
+				               len - 1) == 0)
+				{
+					match_start = cur - text;
+					return true;
+				}
+			}
+		}
+		else
+		{
+			char lower = fold(first);
+			char upper = is_letter(first) ?
+				lower - 'a' + 'A' : lower;
+
+			DualScanner scanner(last + 1, lower, upper);
+			for(const char* cur = text + from; cur <= last; ++cur)
+			{
+				cur = scanner.find(cur);
+				if(cur > last) return false;
+
+				if(equal_folded(cur, needle))
+				{
+					match_start = cur - text;
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	bool text_search_backward(const char* text, std::size_t from,
+	                          std::size_t to, const std::string& needle,
+	                          bool case_sensitive,
+	                          std::size_t& match_start)
+	{
+		const std::size_t len = needle.size();
+		if(len == 0 || from < to || from - to < len) return false;
+
+		const char* first = text + to;
+		for(const char* cur = text + from - len; ; --cur)
+		{
+			const bool equal = case_sensitive ?
+				std::memcmp(cur, needle.data(), len) == 0 :
+				equal_folded(cur, needle);
+
+			if(equal)
+			{
+				match_start = cur - text;
+				return true;
+			}
+
+			if(cur == first) return false;
+		}
+	}
+
+	std::size_t count_utf8_chars(const char* text, std::size_t size)
+	{
+		// Every byte that is not a continuation byte starts a
+		// character. This loop is simple enough to be vectorized by
+		// the compiler.
+		std::size_t count = 0;
+		for(std::size_t i = 0; i < size; ++i)
+			count += ((text[i] & 0xc0) != 0x80);
+		return count;
+	}
+
+	std::size_t skip_utf8_chars(const char* text, std::size_t size,
+	                            std::size_t n)
+	{
+		std::size_t i = 0;
+		for(; i < size; ++i)
+		{
+			if((text[i] & 0xc0) != 0x80)
+			{
+				if(n == 0) return i;
+				--n;
+			}
+		}
+
+		return size;
+	}
+}
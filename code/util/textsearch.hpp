@@ -0,0 +1,58 @@
+/* Gobby - GTK-based collaborative text editor
+ * Copyright (C) 2008-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _GOBBY_TEXTSEARCH_HPP_
+#define _GOBBY_TEXTSEARCH_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace Gobby
+{
+	// Searching for a string in a contiguous block of UTF-8 text. All
+	// offsets are byte offsets into the text. Case sensitive search
+	// compares the bytes as they are. Case insensitive search is only
+	// supported for needles that consist of ASCII characters only, and
+	// folds ASCII letters. Use text_search_supported() to find out
+	// whether a search can be done with these functions.
+	bool text_search_supported(const std::string& needle,
+	                           bool case_sensitive);
+
+	// Finds the first occurrence of needle that starts at or after from
+	// and ends at or before to. The start of the match is written into
+	// match_start.
+	bool text_search_forward(const char* text, std::size_t from,
+	                         std::size_t to, const std::string& needle,
+	                         bool case_sensitive,
+	                         std::size_t& match_start);
+
+	// Finds the last occurrence of needle that ends at or before from
+	// and starts at or after to.
+	bool text_search_backward(const char* text, std::size_t from,
+	                          std::size_t to, const std::string& needle,
+	                          bool case_sensitive,
+	                          std::size_t& match_start);
+
+	// Returns the number of characters in the given UTF-8 text.
+	std::size_t count_utf8_chars(const char* text, std::size_t size);
+
+	// Returns the byte offset of the n-th character in the given UTF-8
+	// text, or size if there are not that many characters.
+	std::size_t skip_utf8_chars(const char* text, std::size_t size,
+	                            std::size_t n);
+}
+
+#endif // _GOBBY_TEXTSEARCH_HPP_
@@ -20,22 +20,24 @@
 #include "commands/file-tasks/task-open.hpp"
 #include "commands/file-tasks/task-open-multiple.hpp"
 
+#include "core/noteplugin.hpp"
 #include "util/i18n.hpp"
 
 #include <gtkmm/frame.h>
 
 Gobby::Window::Window(Config& config,
-                      GtkSourceLanguageManager* language_manager,
+                      const LanguageIndex& language_index,
                       FileChooser& file_chooser,
                       Preferences& preferences,
                       CertificateManager& cert_manager):
 	m_config(config),
-	m_lang_manager(language_manager),
+	m_language_index(language_index),
 	m_file_chooser(file_chooser),
 	m_preferences(preferences), m_cert_manager(cert_manager),
+	m_auth_manager(preferences),
 	m_connection_manager(cert_manager, preferences),
-	m_text_folder(false, m_preferences, m_lang_manager),
-	m_chat_folder(true, m_preferences, m_lang_manager),
+	m_text_folder(false, m_preferences, m_language_index),
+	m_chat_folder(true, m_preferences, m_language_index),
 	m_statusbar(m_text_folder, m_preferences),
 	m_toolbar(m_preferences),
 	m_browser(*this, m_statusbar, m_connection_manager),
@@ -46,19 +48,20 @@ Gobby::Window::Window(Config& config,
 	m_folder_manager(m_browser, m_info_storage,
 	                 m_text_folder, m_chat_folder),
 	m_operations(m_info_storage, m_browser,
-	             m_folder_manager, m_statusbar),
+	             m_folder_manager, m_statusbar, m_preferences),
 	m_browser_commands(m_browser, m_folder_manager, m_statusbar,
 	                   m_operations, m_preferences),
 	m_browser_context_commands(*this, m_connection_manager.get_io(),
 	                           m_browser, m_file_chooser, m_operations,
 	                           m_cert_manager, m_preferences),
 	m_auth_commands(*this, m_browser, m_statusbar,
-	                m_connection_manager, m_preferences),
+	                m_connection_manager, m_auth_manager),
+	m_self_hoster_reporter(m_statusbar),
 	m_self_hoster(m_connection_manager.get_io(),
 	              m_connection_manager.get_communication_manager(),
 	              m_connection_manager.get_publisher(),
-	              m_auth_commands.get_sasl_context(),
-	              m_statusbar, m_cert_manager, m_preferences),
+	              m_auth_manager.get_sasl_context(),
+	              m_self_hoster_reporter, m_cert_manager, m_preferences),
 	m_autosave_commands(m_text_folder, m_operations,
 	                    m_info_storage, m_preferences),
 	m_subscription_commands(m_text_folder, m_chat_folder),
@@ -69,8 +72,9 @@ Gobby::Window::Window(Config& config,
 	m_file_commands(*this, m_actions, m_browser, m_folder_manager,
 	                m_statusbar, m_file_chooser, m_operations,
 	                m_info_storage, m_preferences),
-	m_edit_commands(*this, m_actions, m_text_folder, m_statusbar),
-	m_view_commands(*this, m_actions, m_lang_manager, m_text_folder,
+	m_edit_commands(*this, m_actions, m_browser, m_folder_manager,
+	                m_text_folder, m_statusbar, m_operations),
+	m_view_commands(*this, m_actions, m_language_index, m_text_folder,
 	                m_chat_frame, m_chat_folder, m_preferences),
 	m_title_bar(*this, m_text_folder)
 {
@@ -79,6 +83,13 @@ Gobby::Window::Window(Config& config,
 	m_chat_frame.signal_hide().connect(
 		sigc::mem_fun(*this, &Window::on_chat_hide), false);
 
+	m_preferences.editor.undo_history_size.signal_changed().connect(
+		sigc::mem_fun(*this, &Window::on_undo_history_size_changed));
+	on_undo_history_size_changed();
+	m_preferences.user.journal_local_documents.signal_changed().connect(
+		sigc::mem_fun(*this, &Window::on_journaling_changed));
+	on_journaling_changed();
+
 	m_browser.add_browser(INF_BROWSER(m_self_hoster.get_directory()),
 	                      _("This Computer"));
 
@@ -272,3 +283,14 @@ void Gobby::Window::on_chat_show()
 	Gtk::Widget* focus = get_focus();
 	if(!focus) on_switch_to_chat();
 }
+
+void Gobby::Window::on_undo_history_size_changed()
+{
+	Plugins::set_undo_history_size(
+		m_preferences.editor.undo_history_size);
+}
+
+void Gobby::Window::on_journaling_changed()
+{
+	Plugins::set_journaling(m_preferences.user.journal_local_documents);
+}
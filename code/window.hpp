@@ -36,6 +36,7 @@
 
 #include "dialogs/initial-dialog.hpp"
 
+#include "core/authmanager.hpp"
 #include "core/selfhoster.hpp"
 #include "core/toolbar.hpp"
 #include "core/folder.hpp"
@@ -62,13 +63,16 @@ namespace Gobby
 class Window : public Gtk::ApplicationWindow
 {
 public:
-	Window(Config& config, GtkSourceLanguageManager* language_manager,
+	Window(Config& config, const LanguageIndex& language_index,
 	       FileChooser& file_chooser, Preferences& preferences,
 	       CertificateManager& cert_manager);
 
 	void subscribe(const Glib::ustring& uri);
 	void open_files(const Operations::file_list& files);
 
+	const SelfHoster& get_self_hoster() const { return m_self_hoster; }
+	SelfHoster& get_self_hoster() { return m_self_hoster; }
+
 protected:
 	// Gtk::Window overrides
 	virtual bool on_key_press_event(GdkEventKey* event);
@@ -102,12 +106,16 @@ protected:
 	void on_chat_hide();
 	void on_chat_show();
 
+	void on_undo_history_size_changed();
+	void on_journaling_changed();
+
 	// Config
 	Config& m_config;
-	GtkSourceLanguageManager* m_lang_manager;
+	const LanguageIndex& m_language_index;
 	FileChooser& m_file_chooser;
 	Preferences& m_preferences;
 	CertificateManager& m_cert_manager;
+	AuthManager m_auth_manager;
 	ConnectionManager m_connection_manager;
 
 	// GUI
@@ -132,17 +140,11 @@ protected:
 	BrowserCommands m_browser_commands;
 	BrowserContextCommands m_browser_context_commands;
 
-	// TODO: This setup is a bit awkward. We need the auth commands to
-	// provide a SASL context to the self hoster.
-	// A better solution would be to have a new class, say AuthManager,
-	// which creates the SASL context, and the auth manager is passed to
-	// both connection manager and self hoster. The new class would not
-	// do any UI, but it would do password checking from remote. For the
-	// UI it would provide a hook which allows m_auth_commands to hook in.
-	// This would also get rid of the ugly
-	// connection_manager.set_sasl_context() call, since the connection
-	// manager would then set the SASL context by itself.
+	// TODO: The connection manager should take the SASL context from
+	// m_auth_manager by itself, which would get rid of the ugly
+	// connection_manager.set_sasl_context() call in m_auth_commands.
 	AuthCommands m_auth_commands;
+	StatusBarReporter m_self_hoster_reporter;
 	SelfHoster m_self_hoster;
 
 	AutosaveCommands m_autosave_commands;